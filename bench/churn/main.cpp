@@ -0,0 +1,200 @@
+﻿#include "common/bench_util.h"
+
+#include <cstdlib>
+#include <new>
+
+using namespace cxpnet;
+
+// 连接抖动基准：以最快速度建立并关闭短连接，统计每秒完成的连接数和每个连接的内存分配次数
+// 每个连接走完 accept → Server::on_new_connection_ → Conn::start_ → 关闭 → Conn::cleanup_ 的完整流程
+// 服务端先关闭 (TIME_WAIT 留在服务端)，避免客户端临时端口被 TIME_WAIT 耗尽
+//
+// bench_churn --threads 1 --concurrency 16 --duration 3 [--echo] --json out.json
+
+// 全局 operator new 计数，客户端 loop 线程单独统计，其余线程都算作服务端
+static std::atomic<uint64_t> g_client_allocs {0};
+static std::atomic<uint64_t> g_server_allocs {0};
+static std::atomic<uint64_t> g_client_bytes {0};
+static std::atomic<uint64_t> g_server_bytes {0};
+static thread_local bool     t_client_thread = false;
+
+static void note_alloc(size_t size) {
+  if (t_client_thread) {
+    g_client_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_client_bytes.fetch_add(size, std::memory_order_relaxed);
+  } else {
+    g_server_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_server_bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+}
+
+static void* counted_alloc(size_t size, size_t align) {
+  note_alloc(size);
+  void* p = nullptr;
+  if (align <= alignof(std::max_align_t)) {
+    p = std::malloc(size == 0 ? 1 : size);
+  } else if (posix_memalign(&p, align, size == 0 ? align : size) != 0) {
+    p = nullptr;
+  }
+  if (p == nullptr) { throw std::bad_alloc(); }
+  return p;
+}
+
+void* operator new(size_t size) { return counted_alloc(size, alignof(std::max_align_t)); }
+void* operator new[](size_t size) { return counted_alloc(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, std::align_val_t align) { return counted_alloc(size, static_cast<size_t>(align)); }
+void* operator new[](size_t size, std::align_val_t align) { return counted_alloc(size, static_cast<size_t>(align)); }
+void  operator delete(void* p) noexcept { std::free(p); }
+void  operator delete[](void* p) noexcept { std::free(p); }
+void  operator delete(void* p, size_t) noexcept { std::free(p); }
+void  operator delete[](void* p, size_t) noexcept { std::free(p); }
+void  operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void  operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void  operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void  operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+struct AllocSnapshot {
+  uint64_t client_allocs;
+  uint64_t server_allocs;
+  uint64_t client_bytes;
+  uint64_t server_bytes;
+
+  static AllocSnapshot take() {
+    return {g_client_allocs.load(std::memory_order_relaxed), g_server_allocs.load(std::memory_order_relaxed),
+            g_client_bytes.load(std::memory_order_relaxed), g_server_bytes.load(std::memory_order_relaxed)};
+  }
+};
+
+// 固定数量的连接槽，每个槽的连接关闭后立即发起下一个
+class ChurnClient {
+public:
+  ChurnClient(IOEventPoll* poll, uint16_t port, size_t concurrency, bool echo)
+      : event_poll_(poll)
+      , port_(port)
+      , echo_(echo)
+      , slots_(concurrency) { }
+
+  void start() {
+    for (size_t i = 0; i < slots_.size(); ++i) { connect_(i); }
+  }
+
+  // 在 poll 线程调用
+  void stop() {
+    stopped_ = true;
+    for (auto& conn : slots_) {
+      if (conn) { conn->close(); }
+    }
+  }
+
+  uint64_t completed() const { return completed_.load(std::memory_order_relaxed); }
+  uint64_t errors() const { return errors_.load(std::memory_order_relaxed); }
+private:
+  void connect_(size_t slot) {
+    if (stopped_) { return; }
+
+    auto conn    = std::make_shared<Conn>(event_poll_);
+    slots_[slot] = conn;
+    conn->connect("127.0.0.1", port_,
+        [this, slot](ConnPtr conn) {
+          conn->set_conn_user_callbacks(
+              [](Buffer* buffer) { buffer->been_read_all(); },
+              [this, slot](int) { finish_(slot, true); });
+          if (echo_) { conn->send("x", 1); }
+        },
+        [this, slot](int) { finish_(slot, false); });
+  }
+
+  void finish_(size_t slot, bool ok) {
+    (ok ? completed_ : errors_).fetch_add(1, std::memory_order_relaxed);
+    // 关闭回调在 Conn 的清理流程中触发，下一轮再释放旧连接并发起新连接
+    event_poll_->run_later([this, slot]() { connect_(slot); });
+  }
+
+  IOEventPoll*          event_poll_;
+  uint16_t              port_;
+  bool                  echo_;
+  std::vector<ConnPtr>  slots_;
+  bool                  stopped_ = false;
+  std::atomic<uint64_t> completed_ {0};
+  std::atomic<uint64_t> errors_ {0};
+};
+
+int main(int argc, char* argv[]) {
+  bench::Args args(argc, argv);
+
+  int         threads     = static_cast<int>(args.get_int("threads", 1));
+  RunningMode mode        = bench::parse_mode(args.get("mode", "one_poll_per_thread"));
+  uint16_t    port        = static_cast<uint16_t>(args.get_int("port", 9501));
+  double      warmup_s    = args.get_double("warmup", 1.0);
+  double      duration_s  = args.get_double("duration", 3.0);
+  size_t      concurrency = static_cast<size_t>(args.get_int("concurrency", 16));
+  bool        echo        = args.has("echo");
+
+  bench::JsonObject config;
+  config.add("threads", threads)
+      .add("mode", bench::mode_name(mode))
+      .add("concurrency", static_cast<uint64_t>(concurrency))
+      .add("echo", echo ? "true" : "false")
+      .add("warmup_s", warmup_s)
+      .add("duration_s", duration_s);
+  bench::Report report("churn", config);
+
+  // echo 模式下服务端收到一个字节后回显再关闭，否则连接建立后立即关闭
+  bench::BenchServer server;
+  bool ok = server.start(port, threads, mode, [echo](Server& srv) {
+    srv.set_conn_user_callback([echo](ConnPtr conn) {
+      Conn* raw = conn.get();
+      conn->set_conn_user_callbacks(
+          [raw](Buffer* buffer) {
+            raw->send(buffer->peek(), buffer->readable_size());
+            buffer->been_read_all();
+            raw->shutdown();
+          },
+          [](int) {});
+      if (!echo) { conn->shutdown(); }
+    });
+  });
+  if (!ok) {
+    std::cerr << "Failed to start server on port " << port << std::endl;
+    return 1;
+  }
+
+  bench::ClientLoop loop;
+  ChurnClient       client(loop.poll(), port, concurrency, echo);
+  bench::run_and_wait(loop.poll(), [&client]() {
+    t_client_thread = true;
+    client.start();
+  });
+
+  std::this_thread::sleep_for(std::chrono::duration<double>(warmup_s));
+  uint64_t      begin_completed = client.completed();
+  uint64_t      begin_errors    = client.errors();
+  AllocSnapshot begin_allocs    = AllocSnapshot::take();
+  auto          start           = bench::Clock::now();
+
+  std::this_thread::sleep_for(std::chrono::duration<double>(duration_s));
+
+  uint64_t      completed = client.completed() - begin_completed;
+  uint64_t      errors    = client.errors() - begin_errors;
+  AllocSnapshot allocs    = AllocSnapshot::take();
+  double        elapsed   = bench::elapsed_ns(start) / 1e9;
+
+  bench::run_and_wait(loop.poll(), [&client]() { client.stop(); });
+  loop.stop();
+  server.stop();
+
+  double per_conn = completed == 0 ? 0.0 : 1.0 / completed;
+
+  bench::JsonObject result;
+  result.add("case", "churn")
+      .add("connections", completed)
+      .add("errors", errors)
+      .add("conns_per_sec", completed / elapsed)
+      .add("client_allocs_per_conn", (allocs.client_allocs - begin_allocs.client_allocs) * per_conn)
+      .add("server_allocs_per_conn", (allocs.server_allocs - begin_allocs.server_allocs) * per_conn)
+      .add("client_bytes_per_conn", (allocs.client_bytes - begin_allocs.client_bytes) * per_conn)
+      .add("server_bytes_per_conn", (allocs.server_bytes - begin_allocs.server_bytes) * per_conn);
+  report.add(std::move(result));
+  report.write(args.get("json", ""));
+  return 0;
+}
@@ -0,0 +1,323 @@
+﻿#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include "cxpnet/cxpnet.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace bench {
+  using Clock = std::chrono::steady_clock;
+
+  // 命令行参数，支持 --key=value / --key value / --flag
+  class Args {
+  public:
+    Args(int argc, char* argv[]) {
+      for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (!arg.starts_with("--")) { continue; }
+
+        arg.remove_prefix(2);
+        size_t eq = arg.find('=');
+        if (eq != std::string_view::npos) {
+          values_[std::string(arg.substr(0, eq))] = std::string(arg.substr(eq + 1));
+        } else if (i + 1 < argc && std::string_view(argv[i + 1]).substr(0, 2) != "--") {
+          values_[std::string(arg)] = argv[++i];
+        } else {
+          values_[std::string(arg)] = "1";
+        }
+      }
+    }
+
+    bool has(const std::string& key) const { return values_.count(key) != 0; }
+
+    std::string get(const std::string& key, const std::string& def) const {
+      auto it = values_.find(key);
+      return it == values_.end() ? def : it->second;
+    }
+
+    long long get_int(const std::string& key, long long def) const {
+      auto it = values_.find(key);
+      return it == values_.end() ? def : std::atoll(it->second.c_str());
+    }
+
+    double get_double(const std::string& key, double def) const {
+      auto it = values_.find(key);
+      return it == values_.end() ? def : std::atof(it->second.c_str());
+    }
+
+    // 逗号分隔的整数列表，如 --sizes 64,1024,16384
+    std::vector<size_t> get_list(const std::string& key, const std::vector<size_t>& def) const {
+      auto it = values_.find(key);
+      if (it == values_.end()) { return def; }
+
+      std::vector<size_t> result;
+      std::string_view    rest = it->second;
+      while (!rest.empty()) {
+        size_t comma = rest.find(',');
+        result.push_back(static_cast<size_t>(std::atoll(std::string(rest.substr(0, comma)).c_str())));
+        if (comma == std::string_view::npos) { break; }
+        rest.remove_prefix(comma + 1);
+      }
+      return result;
+    }
+  private:
+    std::map<std::string, std::string> values_;
+  };
+
+  inline cxpnet::RunningMode parse_mode(const std::string& mode) {
+    return mode == "all_one_thread" ? cxpnet::RunningMode::kAllOneThread : cxpnet::RunningMode::kOnePollPerThread;
+  }
+
+  inline const char* mode_name(cxpnet::RunningMode mode) {
+    return mode == cxpnet::RunningMode::kAllOneThread ? "all_one_thread" : "one_poll_per_thread";
+  }
+
+  // --strategy 的取值，未知的名字按 round_robin 处理
+  inline cxpnet::PollSelectStrategy parse_strategy(const std::string& name) {
+    using cxpnet::PollSelectStrategy;
+    if (name == "least_conn") { return PollSelectStrategy::kLeastConnections; }
+    if (name == "least_busy") { return PollSelectStrategy::kLeastBusy; }
+    if (name == "p2c") { return PollSelectStrategy::kPowerOfTwoChoices; }
+    if (name == "address_hash") { return PollSelectStrategy::kAddressHash; }
+    return PollSelectStrategy::kRoundRobin;
+  }
+
+  inline const char* strategy_name(cxpnet::PollSelectStrategy strategy) {
+    switch (strategy) {
+    case cxpnet::PollSelectStrategy::kLeastConnections:
+      return "least_conn";
+    case cxpnet::PollSelectStrategy::kLeastBusy:
+      return "least_busy";
+    case cxpnet::PollSelectStrategy::kPowerOfTwoChoices:
+      return "p2c";
+    case cxpnet::PollSelectStrategy::kAddressHash:
+      return "address_hash";
+    case cxpnet::PollSelectStrategy::kRoundRobin:
+    default:
+      return "round_robin";
+    }
+  }
+
+  // 扁平 JSON 对象，值在 add 时就序列化好
+  class JsonObject {
+  public:
+    JsonObject& add(std::string_view key, std::string_view value) {
+      std::string quoted = "\"";
+      for (char c : value) {
+        if (c == '"' || c == '\\') { quoted += '\\'; }
+        quoted += c;
+      }
+      quoted += '"';
+      fields_.emplace_back(std::string(key), std::move(quoted));
+      return *this;
+    }
+    JsonObject& add(std::string_view key, const char* value) { return add(key, std::string_view(value)); }
+    JsonObject& add(std::string_view key, double value) {
+      fields_.emplace_back(std::string(key), std::format("{:.3f}", value));
+      return *this;
+    }
+    JsonObject& add(std::string_view key, uint64_t value) {
+      fields_.emplace_back(std::string(key), std::format("{}", value));
+      return *this;
+    }
+    JsonObject& add(std::string_view key, int value) { return add(key, static_cast<uint64_t>(value)); }
+    JsonObject& add(std::string_view key, const JsonObject& value) {
+      fields_.emplace_back(std::string(key), value.str());
+      return *this;
+    }
+
+    std::string str() const {
+      std::string out = "{";
+      for (size_t i = 0; i < fields_.size(); ++i) {
+        if (i > 0) { out += ", "; }
+        out += std::format("\"{}\": {}", fields_[i].first, fields_[i].second);
+      }
+      out += "}";
+      return out;
+    }
+  private:
+    std::vector<std::pair<std::string, std::string>> fields_;
+  };
+
+  // {"bench": name, "config": {...}, "results": [...]}
+  // 写到 --json 指定的文件，未指定时写到 stdout；可读的进度信息写到 stderr
+  class Report {
+  public:
+    Report(std::string name, JsonObject config)
+        : name_(std::move(name))
+        , config_(std::move(config)) { }
+
+    void add(JsonObject result) {
+      std::cerr << result.str() << std::endl;
+      results_.push_back(std::move(result));
+    }
+
+    // 每个结果单独一行，便于按行解析和 diff
+    std::string json() const {
+      std::string out = std::format("{{\"bench\": \"{}\", \"config\": {}, \"results\": [\n", name_, config_.str());
+      for (size_t i = 0; i < results_.size(); ++i) {
+        out += "  " + results_[i].str() + (i + 1 < results_.size() ? ",\n" : "\n");
+      }
+      out += "]}\n";
+      return out;
+    }
+
+    void write(const std::string& path) const {
+      std::string out = json();
+      if (path.empty()) {
+        std::cout << out;
+        return;
+      }
+
+      std::ofstream file(path);
+      file << out;
+    }
+  private:
+    std::string             name_;
+    JsonObject              config_;
+    std::vector<JsonObject> results_;
+  };
+
+  // 延迟直方图统一以纳秒记录，报告为微秒
+  inline void add_latency(JsonObject& result, const cxpnet::HistogramSnapshot& snap) {
+    result.add("samples", snap.count)
+        .add("mean_us", snap.mean() / 1000.0)
+        .add("p50_us", snap.percentile(50) / 1000.0)
+        .add("p90_us", snap.percentile(90) / 1000.0)
+        .add("p99_us", snap.percentile(99) / 1000.0)
+        .add("p999_us", snap.percentile(99.9) / 1000.0)
+        .add("max_us", snap.max / 1000.0);
+  }
+
+  inline uint64_t elapsed_ns(Clock::time_point start) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+  }
+
+  // 在独立线程上运行 Server，两种 RunningMode 都支持
+  // shutdown 会在返回前唤醒 poll，所以 Server / IOEventPoll 由调用 stop 的线程持有，join 之后再销毁
+  // kAllOneThread 下 Server 必须在 poll 线程上构造和关闭，所以整个生命周期都在该线程里
+  class BenchServer {
+  public:
+    using Setup = std::function<void(cxpnet::Server&)>;
+
+    bool start(uint16_t port, int threads, cxpnet::RunningMode mode, Setup setup) {
+      mode_ = mode;
+      if (mode == cxpnet::RunningMode::kOnePollPerThread) {
+        server_ = std::make_unique<cxpnet::Server>("127.0.0.1", port, cxpnet::ProtocolStack::kIPv4Only,
+                                                   cxpnet::SocketOption::kReuseAddr);
+        server_->set_thread_num(threads);
+        server_->set_shutdown_timeout(1000);
+        if (setup) { setup(*server_); }
+        if (!server_->start(mode)) {
+          server_.reset();
+          return false;
+        }
+
+        thread_ = std::thread([this]() { server_->run(); });
+        return true;
+      }
+
+      std::promise<bool> started;
+      auto               future = started.get_future();
+
+      thread_ = std::thread([this, port, threads, mode, setup = std::move(setup), &started]() {
+        cxpnet::Server server("127.0.0.1", port, cxpnet::ProtocolStack::kIPv4Only, cxpnet::SocketOption::kReuseAddr);
+        server.set_thread_num(threads);
+        server.set_shutdown_timeout(1000);
+        if (setup) { setup(server); }
+
+        bool ok = server.start(mode);
+        started.set_value(ok);
+        if (!ok) { return; }
+
+        while (!stop_.load(std::memory_order_acquire)) { server.poll(); }
+        server.shutdown();
+        auto deadline = Clock::now() + std::chrono::seconds(2);
+        while (server.connection_count() > 0 && Clock::now() < deadline) { server.poll(); }
+        server.poll();
+      });
+
+      if (!future.get()) {
+        thread_.join();
+        return false;
+      }
+      return true;
+    }
+
+    void stop() {
+      if (!thread_.joinable()) { return; }
+
+      if (mode_ == cxpnet::RunningMode::kOnePollPerThread) {
+        server_->shutdown();
+      } else {
+        stop_.store(true, std::memory_order_release);
+      }
+      thread_.join();
+      server_.reset();
+    }
+
+    ~BenchServer() { stop(); }
+  private:
+    std::thread                     thread_;
+    std::unique_ptr<cxpnet::Server> server_; // 只用于 kOnePollPerThread
+    cxpnet::RunningMode             mode_ = cxpnet::RunningMode::kOnePollPerThread;
+    std::atomic<bool>               stop_ {false};
+  };
+
+  // 客户端 IOEventPoll 在独立线程上 run，由 ClientLoop 持有，stop 时 join 之后再销毁
+  class ClientLoop {
+  public:
+    ClientLoop()
+        : poll_(std::make_unique<cxpnet::IOEventPoll>()) {
+      std::promise<void> ready;
+      auto               future = ready.get_future();
+      thread_                   = std::thread([this, &ready]() {
+        // run 会把 poll 线程切换到当前线程，先投递一个任务确认已经切换
+        poll_->run_later([&ready]() { ready.set_value(); });
+        poll_->run();
+      });
+      future.get();
+    }
+
+    ~ClientLoop() { stop(); }
+
+    cxpnet::IOEventPoll* poll() const { return poll_.get(); }
+
+    void stop() {
+      if (!thread_.joinable()) { return; }
+      poll_->shutdown();
+      thread_.join();
+    }
+  private:
+    std::unique_ptr<cxpnet::IOEventPoll> poll_;
+    std::thread                          thread_;
+  };
+
+  // 在 poll 线程执行 func 并等待完成
+  inline void run_and_wait(cxpnet::IOEventPoll* poll, std::function<void()> func) {
+    auto done   = std::make_shared<std::promise<void>>();
+    auto future = done->get_future();
+    poll->run_in_poll([func = std::move(func), done]() {
+      func();
+      done->set_value();
+    });
+    future.get();
+  }
+} // namespace bench
+
+#endif // BENCH_UTIL_H
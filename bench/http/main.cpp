@@ -0,0 +1,259 @@
+﻿#include "common/bench_util.h"
+
+#include <csignal>
+#include <deque>
+
+using namespace cxpnet;
+
+// 类似 wrk 的 HTTP/1.1 闭环压测：每个 keep-alive 连接保持 --pipeline 个在途请求，收到一个响应立即补发一个
+// 报告请求数/秒、吞吐和延迟 (从请求写出到响应收齐)
+// 未指定 --host 时在本进程内启动一个 HttpServer，返回固定的 "Hello, World!"
+//
+// bench_http --threads 2 --conns 64 --pipeline 1 --duration 10 [--host 127.0.0.1 --port 8080 --path /]
+
+struct HttpBenchConfig {
+  std::string host;
+  uint16_t    port;
+  std::string path;
+  size_t      conns; // 每个线程的连接数
+  size_t      pipeline;
+  double      warmup_s;
+  double      duration_s;
+};
+
+struct HttpBenchResult {
+  uint64_t completed = 0;
+  uint64_t errors    = 0; // 非 2xx 响应
+  uint64_t bytes     = 0; // 响应字节数
+};
+
+// 每个线程一个 IOEventPoll，由本线程构造并用 poll(timeout) 驱动
+class HttpBenchWorker {
+public:
+  HttpBenchWorker(const HttpBenchConfig& config, Histogram& latency)
+      : config_(config)
+      , latency_(latency)
+      , request_(std::format("GET {} HTTP/1.1\r\nHost: {}\r\nUser-Agent: bench_http\r\n\r\n", config.path,
+                             config.host)) { }
+
+  HttpBenchResult run(std::function<void(bool)> ready, std::shared_future<bench::Clock::time_point> start_future) {
+    IOEventPoll poll;
+    poll_ = &poll;
+
+    bool ok = connect_all_();
+    ready(ok);
+    auto start = start_future.get();
+    if (!ok) {
+      close_all_();
+      return {};
+    }
+
+    measure_start_ = start + std::chrono::duration_cast<bench::Clock::duration>(
+                                 std::chrono::duration<double>(config_.warmup_s));
+    auto end       = measure_start_ + std::chrono::duration_cast<bench::Clock::duration>(
+                                    std::chrono::duration<double>(config_.duration_s));
+
+    for (auto& session : sessions_) {
+      for (size_t i = 0; i < config_.pipeline; ++i) { send_(session); }
+    }
+    while (bench::Clock::now() < end) { poll.poll(1); }
+
+    stopping_ = true;
+    close_all_();
+    return result_;
+  }
+private:
+  struct Session {
+    ConnPtr                              conn;
+    std::deque<bench::Clock::time_point> sent;
+  };
+
+  bool connect_all_() {
+    SockOptions options;
+    options.tcp_nodelay = true;
+
+    sessions_.resize(config_.conns);
+    for (size_t i = 0; i < sessions_.size(); ++i) {
+      auto conn = std::make_shared<Conn>(poll_);
+      conn->set_sock_options(options);
+      conn->set_conn_user_callbacks(
+          [this, i](Buffer* buffer) { on_message_(sessions_[i], buffer); },
+          [](int) {});
+      sessions_[i].conn = conn;
+      if (!conn->connect_sync(config_.host.c_str(), config_.port)) { return false; }
+    }
+    return true;
+  }
+
+  void close_all_() {
+    for (auto& session : sessions_) {
+      if (session.conn) { session.conn->close(); }
+    }
+    poll_->poll();
+    sessions_.clear();
+  }
+
+  void send_(Session& session) {
+    if (stopping_ || !session.conn->connected()) { return; }
+    session.sent.push_back(bench::Clock::now());
+    session.conn->send(request_);
+  }
+
+  void on_message_(Session& session, Buffer* buffer) {
+    while (!session.sent.empty()) {
+      int    status = 0;
+      size_t size   = response_size_(buffer, status);
+      if (size == Buffer::npos) { break; }
+
+      auto now  = bench::Clock::now();
+      auto sent = session.sent.front();
+      session.sent.pop_front();
+      buffer->been_read(size);
+
+      if (sent >= measure_start_) {
+        ++result_.completed;
+        result_.bytes += size;
+        if (status < 200 || status >= 300) { ++result_.errors; }
+        latency_.record(static_cast<uint64_t>((now - sent).count()));
+      }
+      send_(session);
+    }
+  }
+
+  // 读缓冲开头的完整响应长度，不完整时返回 npos；只支持 Content-Length 响应
+  static size_t response_size_(Buffer* buffer, int& status) {
+    size_t head_end = buffer->find("\r\n\r\n");
+    if (head_end == Buffer::npos) { return Buffer::npos; }
+
+    std::string_view head(buffer->peek(), head_end);
+    if (head.size() < 12 || !head.starts_with("HTTP/1.")) { return Buffer::npos; }
+    status = std::atoi(std::string(head.substr(9, 3)).c_str());
+
+    size_t content_length = 0;
+    while (!head.empty()) {
+      size_t           crlf  = head.find("\r\n");
+      std::string_view line  = head.substr(0, crlf);
+      size_t           colon = line.find(':');
+      if (colon != std::string_view::npos && http_iequals(line.substr(0, colon), "Content-Length")) {
+        std::string_view value = line.substr(colon + 1);
+        while (!value.empty() && value.front() == ' ') { value.remove_prefix(1); }
+        content_length = static_cast<size_t>(std::atoll(std::string(value).c_str()));
+      }
+      if (crlf == std::string_view::npos) { break; }
+      head.remove_prefix(crlf + 2);
+    }
+
+    size_t total = head_end + 4 + content_length;
+    return buffer->readable_size() >= total ? total : Buffer::npos;
+  }
+
+  const HttpBenchConfig&   config_;
+  Histogram&               latency_;
+  std::string              request_;
+  IOEventPoll*             poll_ = nullptr;
+  std::vector<Session>     sessions_;
+  HttpBenchResult          result_;
+  bench::Clock::time_point measure_start_ {};
+  bool                     stopping_ = false;
+};
+
+int main(int argc, char* argv[]) {
+  // 结束时客户端直接关闭仍有在途响应的连接，服务端写到已重置的连接不能因 SIGPIPE 退出
+  std::signal(SIGPIPE, SIG_IGN);
+  bench::Args args(argc, argv);
+
+  int         threads  = static_cast<int>(std::max<long long>(1, args.get_int("threads", 1)));
+  size_t      conns    = static_cast<size_t>(std::max<long long>(threads, args.get_int("conns", 16)));
+  std::string host     = args.get("host", "");
+  bool        external = !host.empty();
+
+  HttpBenchConfig config;
+  config.host       = external ? host : "127.0.0.1";
+  config.port       = static_cast<uint16_t>(args.get_int("port", 9503));
+  config.path       = args.get("path", "/");
+  config.conns      = conns / static_cast<size_t>(threads);
+  config.pipeline   = static_cast<size_t>(std::max<long long>(1, args.get_int("pipeline", 1)));
+  config.warmup_s   = args.get_double("warmup", 1.0);
+  config.duration_s = args.get_double("duration", 5.0);
+
+  bench::JsonObject report_config;
+  report_config.add("target", std::format("{}:{}{}", config.host, config.port, config.path))
+      .add("threads", threads)
+      .add("conns", static_cast<uint64_t>(config.conns * threads))
+      .add("pipeline", static_cast<uint64_t>(config.pipeline))
+      .add("warmup_s", config.warmup_s)
+      .add("duration_s", config.duration_s);
+  bench::Report report("http", report_config);
+
+  HttpServer http([](const HttpRequest&, HttpResponse& response) {
+    response.add_header("Content-Type", "text/plain");
+    response.set_body("Hello, World!");
+  });
+
+  bench::BenchServer server;
+  if (!external) {
+    int         server_threads = static_cast<int>(args.get_int("server-threads", 1));
+    RunningMode mode           = bench::parse_mode(args.get("mode", "one_poll_per_thread"));
+    bool        ok             = server.start(config.port, server_threads, mode, [&http](Server& srv) {
+      SockOptions options;
+      options.tcp_nodelay = true;
+      srv.set_sock_options(options);
+      http.attach(srv);
+    });
+    if (!ok) {
+      std::cerr << "Failed to start HTTP server on port " << config.port << std::endl;
+      return 1;
+    }
+  }
+
+  Histogram                    latency;
+  std::vector<HttpBenchResult> results(static_cast<size_t>(threads));
+  std::vector<std::thread>     workers;
+  std::atomic<int>             ready {0};
+  std::atomic<bool>            connect_failed {false};
+
+  std::promise<bench::Clock::time_point>       start_promise;
+  std::shared_future<bench::Clock::time_point> start_future = start_promise.get_future().share();
+
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      HttpBenchWorker worker(config, latency);
+      results[static_cast<size_t>(t)] = worker.run(
+          [&](bool ok) {
+            if (!ok) { connect_failed.store(true); }
+            ready.fetch_add(1);
+          },
+          start_future);
+    });
+  }
+
+  while (ready.load() < threads) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+  start_promise.set_value(bench::Clock::now() + std::chrono::milliseconds(10));
+  for (auto& worker : workers) { worker.join(); }
+  server.stop();
+
+  if (connect_failed.load()) {
+    std::cerr << "Failed to connect to " << config.host << ":" << config.port << std::endl;
+    return 1;
+  }
+
+  HttpBenchResult total;
+  for (const auto& r : results) {
+    total.completed += r.completed;
+    total.errors += r.errors;
+    total.bytes += r.bytes;
+  }
+
+  bench::JsonObject latency_json;
+  bench::add_latency(latency_json, latency.snapshot());
+
+  bench::JsonObject result;
+  result.add("requests_per_sec", total.completed / config.duration_s)
+      .add("mb_per_sec", total.bytes / config.duration_s / (1024.0 * 1024.0))
+      .add("completed", total.completed)
+      .add("errors", total.errors)
+      .add("latency", latency_json);
+  report.add(std::move(result));
+  report.write(args.get("json", ""));
+  return 0;
+}
@@ -0,0 +1,434 @@
+﻿#include "common/bench_util.h"
+
+#include <csignal>
+#include <deque>
+
+using namespace cxpnet;
+
+// 开环压测：按固定目标速率发送请求，不等待响应，延迟从"计划发送时间"开始计算
+// 闭环客户端在服务端变慢时会自动少发请求，排队延迟被隐藏 (coordinated omission)
+// 这里每个请求的计划发送时间由速率决定，发送线程落后时延迟照样从计划时间算起
+//
+// 协议：发送 --size 字节的请求，服务端原样回显；同一连接上的响应按发送顺序匹配
+// 未指定 --host 时在本进程内启动一个 echo Server，--strategy 选择它的 sub poll 分配策略
+//
+// 偏斜负载 (--hogs N)：测量连接建立之前，先建立 N 个长连接持续收发大消息 (闭环，每个连接 --hog-depth 个在途)
+// 这些连接按 --hog-group (默认 server-threads) 个一组建立，每组只保留第一个，其余关闭
+// 轮询分配下保留的连接都落在同一个 sub poll 上，相当于连接流失后少数重连接集中在一个 loop 上
+// 之后建立的测量连接由 --strategy 决定是否避开这个 loop，对比各策略的尾延迟
+//
+// bench_loadgen --rate 50000 --threads 2 --conns 64 --size 64 --duration 10 [--host 127.0.0.1 --port 9000]
+// bench_loadgen --server-threads 4 --hogs 2 --strategy least_conn --rate 20000 --conns 32
+
+struct LoadConfig {
+  std::string host;
+  uint16_t    port;
+  double      rate;      // 每个线程的目标速率 (请求/秒)
+  size_t      conns;     // 每个线程的连接数
+  size_t      size;
+  double      warmup_s;
+  double      duration_s;
+  double      drain_s;
+};
+
+struct LoadResult {
+  uint64_t sent        = 0; // 计量窗口内计划发送的请求数
+  uint64_t completed   = 0;
+  uint64_t outstanding = 0; // 结束时仍未收到响应的请求
+  uint64_t failed      = 0; // 连接断开丢失的请求
+  uint64_t send_lag_ns = 0; // 实际发送时间晚于计划时间的最大值
+};
+
+// 每个线程一个 IOEventPoll，由本线程构造并用 poll(timeout) 驱动，发送节奏由本线程控制
+class LoadWorker {
+public:
+  LoadWorker(const LoadConfig& config, Histogram& corrected, Histogram& uncorrected)
+      : config_(config)
+      , corrected_(corrected)
+      , uncorrected_(uncorrected)
+      , payload_(config.size, 'x') { }
+
+  // 先建立全部连接并调用 ready，再等待所有线程共用的起始时间
+  LoadResult run(std::function<void(bool)> ready, std::shared_future<bench::Clock::time_point> start_future) {
+    IOEventPoll poll;
+    poll_ = &poll;
+
+    bool ok = connect_all_();
+    ready(ok);
+    auto start = start_future.get();
+    if (!ok) {
+      close_all_();
+      return {};
+    }
+
+    auto interval      = std::chrono::duration<double>(1.0 / config_.rate);
+    auto measure_start = start + std::chrono::duration_cast<bench::Clock::duration>(
+                                     std::chrono::duration<double>(config_.warmup_s));
+    auto measure_end   = measure_start + std::chrono::duration_cast<bench::Clock::duration>(
+                                           std::chrono::duration<double>(config_.duration_s));
+    measure_start_     = measure_start;
+    measure_end_       = measure_end;
+
+    // 第 k 个请求的计划发送时间是 start + k * interval，与实际何时发出无关
+    uint64_t next = 0;
+    while (true) {
+      auto now = bench::Clock::now();
+      auto due = start + std::chrono::duration_cast<bench::Clock::duration>(interval * static_cast<double>(next));
+      if (due >= measure_end) { break; }
+
+      while (due <= now) {
+        send_(next, due, now);
+        ++next;
+        due = start + std::chrono::duration_cast<bench::Clock::duration>(interval * static_cast<double>(next));
+      }
+
+      // 离下一个请求不足 1ms 时不阻塞
+      auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(due - bench::Clock::now()).count();
+      poll.poll(wait > 0 ? static_cast<uint32_t>(wait) : 0);
+    }
+
+    // 停止发送后等待在途响应
+    auto drain_end = bench::Clock::now() + std::chrono::duration_cast<bench::Clock::duration>(
+                                               std::chrono::duration<double>(config_.drain_s));
+    while (in_flight_() > 0 && bench::Clock::now() < drain_end) { poll.poll(1); }
+
+    result_.outstanding = measured_in_flight_();
+    close_all_();
+    return result_;
+  }
+private:
+  struct Request {
+    bench::Clock::time_point intended;
+    bench::Clock::time_point sent;
+  };
+
+  struct Session {
+    ConnPtr             conn;
+    std::deque<Request> pending;
+    size_t              received = 0; // 当前响应已收到的字节数
+  };
+
+  bool connect_all_() {
+    SockOptions options;
+    options.tcp_nodelay = true;
+
+    sessions_.resize(config_.conns);
+    for (size_t i = 0; i < sessions_.size(); ++i) {
+      auto conn = std::make_shared<Conn>(poll_);
+      conn->set_sock_options(options);
+      conn->set_conn_user_callbacks(
+          [this, i](Buffer* buffer) { on_message_(sessions_[i], buffer); },
+          [this, i](int) { on_close_(sessions_[i]); });
+      sessions_[i].conn = conn;
+      if (!conn->connect_sync(config_.host.c_str(), config_.port)) { return false; }
+    }
+    return true;
+  }
+
+  void close_all_() {
+    for (auto& session : sessions_) {
+      if (session.conn) { session.conn->close(); }
+    }
+    // close 的清理可能投递到任务队列，跑一轮让它执行完
+    poll_->poll();
+    sessions_.clear();
+  }
+
+  void send_(uint64_t seq, bench::Clock::time_point due, bench::Clock::time_point now) {
+    Session& session = sessions_[seq % sessions_.size()];
+    if (!session.conn->connected()) { return; }
+
+    if (in_window_(due)) {
+      ++result_.sent;
+      result_.send_lag_ns = (std::max)(result_.send_lag_ns, static_cast<uint64_t>((now - due).count()));
+    }
+    session.pending.push_back({due, now});
+    session.conn->send(payload_.data(), payload_.size());
+  }
+
+  void on_message_(Session& session, Buffer* buffer) {
+    auto now = bench::Clock::now();
+    session.received += buffer->readable_size();
+    buffer->been_read_all();
+
+    while (session.received >= config_.size && !session.pending.empty()) {
+      session.received -= config_.size;
+      Request request = session.pending.front();
+      session.pending.pop_front();
+
+      if (!in_window_(request.intended)) { continue; }
+      ++result_.completed;
+      corrected_.record(static_cast<uint64_t>((now - request.intended).count()));
+      uncorrected_.record(static_cast<uint64_t>((now - request.sent).count()));
+    }
+  }
+
+  void on_close_(Session& session) {
+    for (const auto& request : session.pending) {
+      if (in_window_(request.intended)) { ++result_.failed; }
+    }
+    // 在 Conn 自己的清理流程中，不在这里释放 conn，send_ 通过 connected() 跳过
+    session.pending.clear();
+  }
+
+  bool in_window_(bench::Clock::time_point intended) const {
+    return intended >= measure_start_ && intended < measure_end_;
+  }
+
+  size_t in_flight_() const {
+    size_t total = 0;
+    for (const auto& session : sessions_) { total += session.pending.size(); }
+    return total;
+  }
+
+  uint64_t measured_in_flight_() const {
+    uint64_t total = 0;
+    for (const auto& session : sessions_) {
+      for (const auto& request : session.pending) { total += in_window_(request.intended) ? 1 : 0; }
+    }
+    return total;
+  }
+
+  const LoadConfig&        config_;
+  Histogram&               corrected_;
+  Histogram&               uncorrected_;
+  std::string              payload_;
+  IOEventPoll*             poll_ = nullptr;
+  std::vector<Session>     sessions_;
+  LoadResult               result_;
+  bench::Clock::time_point measure_start_ {};
+  bench::Clock::time_point measure_end_ {};
+};
+
+// 背景重负载连接，一个线程一个 IOEventPoll，运行到 stop 为止
+class HogWorker {
+public:
+  HogWorker(const LoadConfig& config, size_t hogs, size_t group, size_t size, size_t depth)
+      : config_(config)
+      , hogs_(hogs)
+      , group_((std::max)(group, size_t(1)))
+      , depth_((std::max)(depth, size_t(1)))
+      , payload_(size, 'h') { }
+
+  // 连接建立、多余的连接关闭并开始发送后调用 ready
+  void run(std::function<void(bool)> ready, const std::atomic<bool>& stop) {
+    IOEventPoll poll;
+    SockOptions options;
+    options.tcp_nodelay = true;
+
+    bool                 ok = true;
+    std::vector<ConnPtr> extras;
+    sessions_.resize(hogs_);
+    for (size_t i = 0; i < hogs_ && ok; ++i) {
+      for (size_t j = 0; j < group_ && ok; ++j) {
+        auto conn = std::make_shared<Conn>(&poll);
+        conn->set_sock_options(options);
+        if (j == 0) {
+          conn->set_conn_user_callbacks([this, i](Buffer* buffer) { on_message_(sessions_[i], buffer); }, nullptr);
+          sessions_[i].conn = conn;
+        } else {
+          conn->set_conn_user_callbacks([](Buffer* buffer) { buffer->been_read_all(); }, nullptr);
+          extras.push_back(conn);
+        }
+        ok = conn->connect_sync(config_.host.c_str(), config_.port);
+      }
+    }
+
+    for (auto& conn : extras) { conn->close(); }
+    poll.poll();
+    extras.clear();
+
+    if (ok) {
+      for (auto& session : sessions_) {
+        for (size_t k = 0; k < depth_; ++k) { session.conn->send(payload_.data(), payload_.size()); }
+      }
+    }
+    ready(ok);
+
+    while (ok && !stop.load(std::memory_order_acquire)) { poll.poll(1); }
+
+    for (auto& session : sessions_) {
+      if (session.conn) { session.conn->close(); }
+    }
+    poll.poll();
+    sessions_.clear();
+  }
+
+  uint64_t messages() const { return messages_; }
+private:
+  struct Session {
+    ConnPtr conn;
+    size_t  received = 0;
+  };
+
+  // 每收回一个完整消息就再发一个，保持在途数量不变
+  void on_message_(Session& session, Buffer* buffer) {
+    session.received += buffer->readable_size();
+    buffer->been_read_all();
+    while (session.received >= payload_.size()) {
+      session.received -= payload_.size();
+      ++messages_;
+      session.conn->send(payload_.data(), payload_.size());
+    }
+  }
+
+  const LoadConfig&    config_;
+  size_t               hogs_;
+  size_t               group_;
+  size_t               depth_;
+  std::string          payload_;
+  std::vector<Session> sessions_;
+  uint64_t             messages_ = 0;
+};
+
+int main(int argc, char* argv[]) {
+  bench::Args args(argc, argv);
+
+  int         threads  = static_cast<int>(std::max<long long>(1, args.get_int("threads", 1)));
+  size_t      conns    = static_cast<size_t>(std::max<long long>(threads, args.get_int("conns", 16)));
+  double      rate     = args.get_double("rate", 10000);
+  std::string host     = args.get("host", "");
+  bool        external = !host.empty();
+
+  LoadConfig config;
+  config.host       = external ? host : "127.0.0.1";
+  config.port       = static_cast<uint16_t>(args.get_int("port", 9502));
+  config.rate       = rate / threads;
+  config.conns      = conns / static_cast<size_t>(threads);
+  config.size       = static_cast<size_t>(std::max<long long>(1, args.get_int("size", 64)));
+  config.warmup_s   = args.get_double("warmup", 1.0);
+  config.duration_s = args.get_double("duration", 5.0);
+  config.drain_s    = args.get_double("drain", 2.0);
+
+  int                server_threads = static_cast<int>(args.get_int("server-threads", 1));
+  PollSelectStrategy strategy       = bench::parse_strategy(args.get("strategy", "round_robin"));
+  size_t             hogs           = static_cast<size_t>(std::max<long long>(0, args.get_int("hogs", 0)));
+  size_t             hog_group      = static_cast<size_t>(std::max<long long>(1, args.get_int("hog-group", server_threads)));
+  size_t             hog_size       = static_cast<size_t>(std::max<long long>(1, args.get_int("hog-size", 16384)));
+  size_t             hog_depth      = static_cast<size_t>(std::max<long long>(1, args.get_int("hog-depth", 4)));
+
+  bench::JsonObject report_config;
+  report_config.add("target", std::format("{}:{}", config.host, config.port))
+      .add("rate", rate)
+      .add("threads", threads)
+      .add("conns", static_cast<uint64_t>(config.conns * threads))
+      .add("size", static_cast<uint64_t>(config.size))
+      .add("warmup_s", config.warmup_s)
+      .add("duration_s", config.duration_s)
+      .add("server_threads", server_threads)
+      .add("strategy", bench::strategy_name(strategy))
+      .add("hogs", static_cast<uint64_t>(hogs))
+      .add("hog_size", static_cast<uint64_t>(hog_size));
+  bench::Report report("loadgen", report_config);
+
+  bench::BenchServer server;
+  if (!external) {
+    RunningMode mode = bench::parse_mode(args.get("mode", "one_poll_per_thread"));
+    bool        ok   = server.start(config.port, server_threads, mode, [strategy](Server& srv) {
+      SockOptions options;
+      options.tcp_nodelay = true;
+      srv.set_sock_options(options);
+      srv.set_poll_select_strategy(strategy);
+      srv.set_conn_user_callback([](ConnPtr conn) {
+        Conn* raw = conn.get();
+        conn->set_conn_user_callbacks(
+            [raw](Buffer* buffer) {
+              raw->send(buffer->peek(), buffer->readable_size());
+              buffer->been_read_all();
+            },
+            [](int) {});
+      });
+    });
+    if (!ok) {
+      std::cerr << "Failed to start echo server on port " << config.port << std::endl;
+      return 1;
+    }
+  }
+
+  // 重负载连接结束时仍有在途消息，服务端写到已关闭的连接不能因 SIGPIPE 退出
+  std::signal(SIGPIPE, SIG_IGN);
+
+  // 重负载连接先建立并开始发送，让 least_busy 等策略在测量连接到来时能看到负载
+  std::atomic<bool> hog_stop {false};
+  std::atomic<int>  hog_state {0}; // 0 未就绪，1 成功，-1 失败
+  HogWorker         hog_worker(config, hogs, hog_group, hog_size, hog_depth);
+  std::thread       hog_thread;
+  if (hogs > 0) {
+    hog_thread = std::thread([&]() { hog_worker.run([&](bool ok) { hog_state.store(ok ? 1 : -1); }, hog_stop); });
+    while (hog_state.load() == 0) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+    if (hog_state.load() < 0) {
+      hog_stop.store(true, std::memory_order_release);
+      hog_thread.join();
+      std::cerr << "Failed to connect hog connections to " << config.host << ":" << config.port << std::endl;
+      return 1;
+    }
+    // 等服务端处理完多余连接的关闭，并积累一个负载统计窗口
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  }
+
+  // 所有线程连接建立后再统一确定起始时间
+  Histogram                corrected;
+  Histogram                uncorrected;
+  std::vector<LoadResult>  results(static_cast<size_t>(threads));
+  std::vector<std::thread> workers;
+  std::atomic<int>         ready {0};
+  std::atomic<bool>        connect_failed {false};
+
+  std::promise<bench::Clock::time_point>       start_promise;
+  std::shared_future<bench::Clock::time_point> start_future = start_promise.get_future().share();
+
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      LoadWorker worker(config, corrected, uncorrected);
+      results[static_cast<size_t>(t)] = worker.run(
+          [&](bool ok) {
+            if (!ok) { connect_failed.store(true); }
+            ready.fetch_add(1);
+          },
+          start_future);
+    });
+  }
+
+  while (ready.load() < threads) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+  start_promise.set_value(bench::Clock::now() + std::chrono::milliseconds(10));
+  for (auto& worker : workers) { worker.join(); }
+  if (hog_thread.joinable()) {
+    hog_stop.store(true, std::memory_order_release);
+    hog_thread.join();
+  }
+  server.stop();
+
+  if (connect_failed.load()) {
+    std::cerr << "Failed to connect to " << config.host << ":" << config.port << std::endl;
+    return 1;
+  }
+
+  LoadResult total;
+  for (const auto& r : results) {
+    total.sent += r.sent;
+    total.completed += r.completed;
+    total.outstanding += r.outstanding;
+    total.failed += r.failed;
+    total.send_lag_ns = (std::max)(total.send_lag_ns, r.send_lag_ns);
+  }
+
+  bench::JsonObject corrected_json;
+  bench::add_latency(corrected_json, corrected.snapshot());
+  bench::JsonObject uncorrected_json;
+  bench::add_latency(uncorrected_json, uncorrected.snapshot());
+
+  bench::JsonObject result;
+  result.add("target_rate", rate)
+      .add("achieved_rate", total.completed / config.duration_s)
+      .add("sent", total.sent)
+      .add("completed", total.completed)
+      .add("outstanding", total.outstanding)
+      .add("failed", total.failed)
+      .add("max_send_lag_us", total.send_lag_ns / 1000.0)
+      .add("hog_messages", hog_worker.messages())
+      .add("latency", corrected_json)
+      .add("uncorrected_latency", uncorrected_json);
+  report.add(std::move(result));
+  report.write(args.get("json", ""));
+  return 0;
+}
@@ -0,0 +1,354 @@
+﻿#include "common/bench_util.h"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace cxpnet;
+
+// 微基准：Buffer / scan (含 WebSocket 去掩码) / TimerManager / IOEventPoll::run_in_poll / 协程
+// 结果按 case 名输出 ns/op，--baseline 读入之前一次的 JSON 输出并打印每个 case 的变化，便于在提交之间对比
+//
+// bench_micro [--filter buffer] [--min-time 0.2] [--repetitions 5] [--timers 1000000] [--tasks 1000000]
+//             [--json out.json] [--baseline old.json]
+
+// 阻止编译器把基准循环中的结果优化掉
+template <typename T>
+inline void do_not_optimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// 自动确定迭代次数的循环基准：body(n) 执行 n 次操作
+// 先把 n 放大到单次运行不短于 min_time，再重复 repetitions 次取中位数
+class MicroRunner {
+public:
+  using Body = std::function<void(uint64_t)>;
+
+  MicroRunner(const bench::Args& args, bench::Report& report)
+      : report_(report)
+      , filter_(args.get("filter", ""))
+      , min_time_ns_(static_cast<uint64_t>(args.get_double("min-time", 0.2) * 1e9))
+      , repetitions_(static_cast<int>(std::max<long long>(1, args.get_int("repetitions", 5)))) { }
+
+  bool enabled(const std::string& name) const {
+    return filter_.empty() || name.find(filter_) != std::string::npos;
+  }
+
+  void run(const std::string& name, Body body) {
+    if (!enabled(name)) { return; }
+
+    uint64_t iterations = 1;
+    while (true) {
+      uint64_t ns = time_(body, iterations);
+      if (ns >= min_time_ns_ || iterations >= (1ull << 40)) { break; }
+      // 按已测得的速度估算，每次最多放大 10 倍
+      uint64_t target = ns == 0 ? iterations * 10 : iterations * min_time_ns_ / ns + 1;
+      iterations      = std::clamp(target, iterations + 1, iterations * 10);
+    }
+
+    std::vector<double> per_op;
+    for (int i = 0; i < repetitions_; ++i) {
+      per_op.push_back(static_cast<double>(time_(body, iterations)) / static_cast<double>(iterations));
+    }
+    std::sort(per_op.begin(), per_op.end());
+    double median = per_op[per_op.size() / 2];
+
+    bench::JsonObject result;
+    result.add("case", name)
+        .add("iterations", iterations)
+        .add("ns_per_op", median)
+        .add("min_ns_per_op", per_op.front())
+        .add("ops_per_sec", median > 0 ? 1e9 / median : 0.0);
+    report_.add(std::move(result));
+  }
+
+  void add_result(bench::JsonObject result) { report_.add(std::move(result)); }
+
+  // 固定规模的基准 (如 1M 定时器) 直接给出总耗时和操作数
+  void add_fixed(const std::string& name, uint64_t ops, uint64_t ns) {
+    double per_op = ops == 0 ? 0.0 : static_cast<double>(ns) / static_cast<double>(ops);
+
+    bench::JsonObject result;
+    result.add("case", name)
+        .add("iterations", ops)
+        .add("ns_per_op", per_op)
+        .add("ops_per_sec", per_op > 0 ? 1e9 / per_op : 0.0);
+    report_.add(std::move(result));
+  }
+private:
+  static uint64_t time_(const Body& body, uint64_t iterations) {
+    auto start = bench::Clock::now();
+    body(iterations);
+    return bench::elapsed_ns(start);
+  }
+
+  bench::Report& report_;
+  std::string    filter_;
+  uint64_t       min_time_ns_;
+  int            repetitions_;
+};
+
+static void run_buffer_cases(MicroRunner& runner) {
+  static const std::string payload(64 * 1024, 'x');
+
+  // 稳态：写入后立即读完，不触发搬移和扩容
+  for (size_t size : {64, 1024, 16384}) {
+    runner.run(std::format("buffer/append_read_{}", size), [size](uint64_t n) {
+      Buffer buffer;
+      for (uint64_t i = 0; i < n; ++i) {
+        buffer.append(payload.data(), size);
+        do_not_optimize(buffer.peek());
+        buffer.been_read(size);
+      }
+    });
+  }
+
+  // 一次写入多条小消息，再逐条读出，模拟流水线请求
+  runner.run("buffer/pipelined_16x64", [](uint64_t n) {
+    Buffer buffer;
+    for (uint64_t i = 0; i < n; ++i) {
+      for (int j = 0; j < 16; ++j) { buffer.append(payload.data(), 64); }
+      while (!buffer.empty()) {
+        do_not_optimize(buffer.peek());
+        buffer.been_read(64);
+      }
+    }
+  });
+
+  // 每次只读走一部分，残留数据会周期性地触发 ensure_writable_size 的搬移
+  runner.run("buffer/partial_read_compact", [](uint64_t n) {
+    Buffer buffer;
+    for (uint64_t i = 0; i < n; ++i) {
+      buffer.append(payload.data(), 1000);
+      buffer.been_read(std::min<size_t>(buffer.readable_size(), 990));
+    }
+    do_not_optimize(buffer.readable_size());
+  });
+
+  // 扩容到 256KB 再一次读完，触发 shrink_if_needed_ 收缩回初始容量
+  runner.run("buffer/grow_shrink_256k", [](uint64_t n) {
+    Buffer buffer;
+    for (uint64_t i = 0; i < n; ++i) {
+      for (int j = 0; j < 16; ++j) { buffer.append(payload.data(), 16384); }
+      do_not_optimize(buffer.peek());
+      buffer.been_read_all();
+    }
+  });
+
+  // 读到一半以上触发的收缩检查 (been_read 的部分读取路径)
+  runner.run("buffer/drain_in_chunks_64k", [](uint64_t n) {
+    Buffer buffer;
+    for (uint64_t i = 0; i < n; ++i) {
+      buffer.append(payload.data(), payload.size());
+      while (!buffer.empty()) {
+        do_not_optimize(buffer.peek());
+        buffer.been_read(std::min<size_t>(buffer.readable_size(), 4096));
+      }
+    }
+  });
+}
+
+// 每个 CPU 支持的 scan 实现各跑一遍，case 名带实现名，结束后恢复默认实现
+static void run_scan_cases(MicroRunner& runner) {
+  // 4KB 的长行 (如大 Cookie)，CRLF 在末尾
+  std::string long_line(4096 - 2, 'c');
+  long_line += "\r\n";
+  // 约 4KB 的请求头，每行都有 CRLF，"\r\n\r\n" 在末尾，多字节查找需要逐个排除候选
+  std::string headers = "GET /index.html HTTP/1.1\r\n";
+  for (int i = 0; headers.size() < 4096 - 32; ++i) { headers += std::format("X-Header-{}: some-value-{}\r\n", i, i); }
+  headers += "\r\n";
+
+  std::string default_kernel = scan::kernel_name();
+  for (const char* kernel : {"scalar", "sse2", "avx2"}) {
+    if (!scan::set_kernel(kernel)) { continue; }
+
+    runner.run(std::format("scan/find_crlf_4k_{}", kernel), [&long_line](uint64_t n) {
+      for (uint64_t i = 0; i < n; ++i) { do_not_optimize(scan::find(long_line.data(), long_line.size(), "\r\n")); }
+    });
+    runner.run(std::format("scan/find_header_end_4k_{}", kernel), [&headers](uint64_t n) {
+      for (uint64_t i = 0; i < n; ++i) { do_not_optimize(scan::find(headers.data(), headers.size(), "\r\n\r\n")); }
+    });
+    // 请求头按 64 字节分段到达，每段到达后查找一次，Buffer 只扫描新到达的部分
+    runner.run(std::format("buffer/find_incremental_4k_{}", kernel), [&headers](uint64_t n) {
+      Buffer buffer;
+      for (uint64_t i = 0; i < n; ++i) {
+        size_t found = Buffer::npos;
+        for (size_t pos = 0; pos < headers.size() && found == Buffer::npos; pos += 64) {
+          buffer.append(headers.data() + pos, std::min<size_t>(64, headers.size() - pos));
+          found = buffer.find("\r\n\r\n");
+        }
+        do_not_optimize(found);
+        buffer.been_read_all();
+      }
+    });
+    // WebSocket 帧 payload 的原地去掩码
+    runner.run(std::format("scan/xor_mask_4k_{}", kernel), [&long_line](uint64_t n) {
+      const unsigned char key[4] = {0x12, 0x34, 0x56, 0x78};
+      for (uint64_t i = 0; i < n; ++i) {
+        scan::xor_mask(long_line.data(), long_line.size(), key);
+        do_not_optimize(long_line[0]);
+      }
+    });
+  }
+  scan::set_kernel(default_kernel);
+}
+
+static Task<uint64_t> coro_leaf(uint64_t value) { co_return value + 1; }
+
+static Task<void> coro_driver(uint64_t n, uint64_t& sum) {
+  for (uint64_t i = 0; i < n; ++i) { sum += co_await coro_leaf(i); }
+}
+
+// 每次 co_await 一个新的 Task：帧分配 (帧池)、对称转移进入和返回、帧释放
+static void run_coro_cases(MicroRunner& runner) {
+  IOEventPoll poll;
+  runner.run("coro/task_await", [&poll](uint64_t n) {
+    uint64_t sum = 0;
+    // 在 poll 线程上 co_spawn 时同步执行完
+    co_spawn(&poll, coro_driver(n, sum));
+    do_not_optimize(sum);
+  });
+}
+
+static void run_timer_cases(MicroRunner& runner, uint64_t count) {
+  if (!runner.enabled("timer/")) { return; }
+
+  // 到期时间足够远，保证计时期间不会有定时器触发
+  TimerManager                manager;
+  std::vector<Timer::TimerID> ids;
+  ids.reserve(count);
+
+  auto start = bench::Clock::now();
+  for (uint64_t i = 0; i < count; ++i) {
+    ids.push_back(manager.add_timer(3600 * 1000 + static_cast<uint32_t>(i % 1000), []() {}));
+  }
+  uint64_t add_ns = bench::elapsed_ns(start);
+
+  // 按插入顺序的逆序取消，避免只测到 multimap 头部的删除
+  start = bench::Clock::now();
+  for (auto it = ids.rbegin(); it != ids.rend(); ++it) { manager.cancel_timer(*it); }
+  uint64_t cancel_ns = bench::elapsed_ns(start);
+
+  runner.add_fixed("timer/add_timer", count, add_ns);
+  runner.add_fixed("timer/cancel_timer", count, cancel_ns);
+
+  // 短生命周期定时器：添加后立即取消，容器始终很小
+  runner.run("timer/add_cancel_pair", [&manager](uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) { manager.cancel_timer(manager.add_timer(3600 * 1000, []() {})); }
+  });
+}
+
+static void run_poll_cases(MicroRunner& runner, uint64_t tasks) {
+  if (!runner.enabled("poll/")) { return; }
+
+  bench::ClientLoop loop;
+  IOEventPoll*      poll = loop.poll();
+
+  // 跨线程吞吐：连续投递 tasks 个任务，计时到最后一个任务执行完
+  {
+    uint64_t executed = 0; // 只在 poll 线程访问
+    auto     start    = bench::Clock::now();
+    for (uint64_t i = 0; i < tasks; ++i) {
+      poll->run_in_poll([&executed]() { ++executed; });
+    }
+    bench::run_and_wait(poll, []() {});
+    runner.add_fixed("poll/run_in_poll_cross_thread", tasks, bench::elapsed_ns(start));
+  }
+
+  // 跨线程延迟：一次只有一个任务在途，从投递到在 poll 线程开始执行的时间
+  {
+    Histogram             latency;
+    std::atomic<uint64_t> done {0};
+    uint64_t              samples = std::max<uint64_t>(1, tasks / 10);
+    for (uint64_t i = 0; i < samples; ++i) {
+      auto posted = bench::Clock::now();
+      poll->run_in_poll([&latency, &done, posted]() {
+        latency.record(bench::elapsed_ns(posted));
+        done.fetch_add(1, std::memory_order_release);
+      });
+      while (done.load(std::memory_order_acquire) <= i) { std::this_thread::yield(); }
+    }
+
+    bench::JsonObject result;
+    result.add("case", "poll/run_in_poll_latency");
+    bench::add_latency(result, latency.snapshot());
+    runner.add_result(std::move(result));
+  }
+
+  // poll 线程内的 run_later：不跨线程，但仍然加锁并写 wakeup fd
+  {
+    uint64_t elapsed = 0;
+    bench::run_and_wait(poll, [poll, tasks, &elapsed]() {
+      auto start = bench::Clock::now();
+      for (uint64_t i = 0; i < tasks; ++i) {
+        poll->run_later([]() {});
+      }
+      elapsed = bench::elapsed_ns(start);
+    });
+    bench::run_and_wait(poll, []() {});
+    runner.add_fixed("poll/run_later_in_poll", tasks, elapsed);
+  }
+}
+
+// 解析 Report::json() 的输出，每行一个结果，按行取出 case 和 ns_per_op
+static std::map<std::string, double> parse_results(std::istream& in) {
+  std::map<std::string, double> results;
+  std::string                   line;
+  while (std::getline(in, line)) {
+    size_t case_pos = line.find("\"case\": \"");
+    size_t ns_pos   = line.find("\"ns_per_op\": ");
+    if (case_pos == std::string::npos || ns_pos == std::string::npos) { continue; }
+
+    case_pos += 9;
+    std::string name = line.substr(case_pos, line.find('"', case_pos) - case_pos);
+    results[name]    = std::atof(line.c_str() + ns_pos + 13);
+  }
+  return results;
+}
+
+static void compare_with_baseline(const std::string& path, const bench::Report& report) {
+  std::ifstream file(path);
+  auto          baseline = parse_results(file);
+  if (baseline.empty()) {
+    std::cerr << "No results found in baseline " << path << std::endl;
+    return;
+  }
+
+  std::istringstream current_json(report.json());
+  auto               current = parse_results(current_json);
+
+  std::cerr << std::format("{:<36} {:>12} {:>12} {:>9}\n", "case", "base ns/op", "ns/op", "change");
+  for (const auto& [name, ns] : current) {
+    auto it = baseline.find(name);
+    if (it == baseline.end() || it->second <= 0 || ns <= 0) { continue; }
+    std::cerr << std::format("{:<36} {:>12.2f} {:>12.2f} {:>+8.1f}%\n", name, it->second, ns,
+                             (ns / it->second - 1.0) * 100.0);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  bench::Args args(argc, argv);
+
+  uint64_t timers = static_cast<uint64_t>(args.get_int("timers", 1000000));
+  uint64_t tasks  = static_cast<uint64_t>(args.get_int("tasks", 1000000));
+
+  bench::JsonObject config;
+  config.add("filter", args.get("filter", ""))
+      .add("min_time_s", args.get_double("min-time", 0.2))
+      .add("repetitions", static_cast<int>(args.get_int("repetitions", 5)))
+      .add("timers", timers)
+      .add("tasks", tasks);
+  bench::Report report("micro", config);
+  MicroRunner   runner(args, report);
+
+  run_buffer_cases(runner);
+  run_scan_cases(runner);
+  run_timer_cases(runner, timers);
+  run_poll_cases(runner, tasks);
+  run_coro_cases(runner);
+
+  report.write(args.get("json", ""));
+
+  std::string baseline = args.get("baseline", "");
+  if (!baseline.empty()) { compare_with_baseline(baseline, report); }
+  return 0;
+}
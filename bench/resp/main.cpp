@@ -0,0 +1,326 @@
+﻿#include "common/bench_util.h"
+
+#include <barrier>
+#include <csignal>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+using namespace cxpnet;
+
+// 与 redis-benchmark 相同的负载模型：每个客户端一次发出 --pipeline 条命令，收齐全部回复后再发下一批，
+// 直到本项测试的 --requests 条命令全部完成；各项测试依次进行，报告请求数/秒和延迟 (从整批写出到该条回复到达)
+// 参数对应 redis-benchmark 的 -c / -n / -P / -d / -r / -t；--keyspace 为 0 时所有命令使用同一个 key
+// 未指定 --host 时在本进程内启动一个只支持 PING / SET / GET / INCR 的 RespServer
+//
+// bench_resp --threads 2 --clients 50 --requests 100000 --pipeline 16 --tests ping,set,get,incr
+//            [--data-size 3 --keyspace 100000 --host 127.0.0.1 --port 6380]
+
+struct RespBenchConfig {
+  std::string host;
+  uint16_t    port;
+  size_t      clients; // 每个线程的连接数
+  size_t      pipeline;
+  size_t      data_size;
+  uint64_t    keyspace;
+};
+
+// 一项测试的共享状态，各线程从 remaining 中领取批次
+struct RespBenchTest {
+  std::string           name;
+  std::atomic<int64_t>  remaining {0};
+  std::atomic<uint64_t> completed {0};
+  std::atomic<uint64_t> errors {0}; // -ERR 回复
+  Histogram             latency;
+};
+
+// 每个线程一个 IOEventPoll，由本线程构造并用 poll(timeout) 驱动
+class RespBenchWorker {
+public:
+  explicit RespBenchWorker(const RespBenchConfig& config)
+      : config_(config)
+      , value_(config.data_size, 'x') { }
+
+  bool connect(IOEventPoll* poll, uint64_t seed) {
+    poll_ = poll;
+    rand_ = seed | 1;
+
+    SockOptions options;
+    options.tcp_nodelay = true;
+
+    clients_.resize(config_.clients);
+    for (size_t i = 0; i < clients_.size(); ++i) {
+      auto conn = std::make_shared<Conn>(poll_);
+      conn->set_sock_options(options);
+      conn->set_conn_user_callbacks([this, i](Buffer* buffer) { on_message_(clients_[i], buffer); },
+                                    [this](int) { ++disconnected_; });
+      clients_[i].conn = conn;
+      if (!conn->connect_sync(config_.host.c_str(), config_.port)) { return false; }
+    }
+    return true;
+  }
+
+  // 返回 false 表示有连接中途断开
+  bool run(RespBenchTest& test) {
+    test_   = &test;
+    active_ = 0;
+    for (auto& client : clients_) {
+      if (send_batch_(client)) { ++active_; }
+    }
+    while (active_ > 0 && disconnected_ == 0) { poll_->poll(1); }
+    return disconnected_ == 0;
+  }
+
+  void close() {
+    for (auto& client : clients_) { client.conn->close(); }
+    poll_->poll();
+    clients_.clear();
+  }
+private:
+  struct Client {
+    ConnPtr                  conn;
+    RespReplyParser          parser;
+    RespReply                reply;
+    Buffer                   out;
+    size_t                   outstanding = 0;
+    bench::Clock::time_point sent;
+  };
+
+  // 领取一批命令并一次写出，没有剩余命令时返回 false
+  bool send_batch_(Client& client) {
+    int64_t want = static_cast<int64_t>(config_.pipeline);
+    int64_t left = test_->remaining.fetch_sub(want, std::memory_order_relaxed);
+    if (left <= 0) { return false; }
+
+    size_t count = static_cast<size_t>((std::min)(left, want));
+    for (size_t i = 0; i < count; ++i) { encode_(client.out); }
+    client.outstanding = count;
+    client.sent        = bench::Clock::now();
+    client.conn->send(client.out.peek(), client.out.readable_size());
+    client.out.been_read_all();
+    return true;
+  }
+
+  void encode_(Buffer& out) {
+    const std::string& name = test_->name;
+    if (name == "ping") {
+      RespWriter::command(&out, {"PING"});
+    } else if (name == "set") {
+      RespWriter::command(&out, {"SET", next_key_("key:"), value_});
+    } else if (name == "get") {
+      RespWriter::command(&out, {"GET", next_key_("key:")});
+    } else {
+      RespWriter::command(&out, {"INCR", next_key_("counter:")});
+    }
+  }
+
+  // redis-benchmark -r 的 key 格式：前缀 + 12 位补零的随机数
+  std::string_view next_key_(std::string_view prefix) {
+    if (config_.keyspace == 0) {
+      key_.assign(prefix);
+      key_ += "__rand_int__";
+      return key_;
+    }
+    rand_ ^= rand_ << 13;
+    rand_ ^= rand_ >> 7;
+    rand_ ^= rand_ << 17;
+    key_ = std::format("{}{:012}", prefix, rand_ % config_.keyspace);
+    return key_;
+  }
+
+  void on_message_(Client& client, Buffer* buffer) {
+    while (client.outstanding > 0) {
+      RespParseResult result = client.parser.parse(buffer, client.reply);
+      if (result == RespParseResult::kIncomplete) { break; }
+      if (result == RespParseResult::kError) {
+        ++disconnected_;
+        client.conn->close();
+        return;
+      }
+
+      if (client.reply.is_error()) { test_->errors.fetch_add(1, std::memory_order_relaxed); }
+      client.parser.consume(buffer);
+      test_->completed.fetch_add(1, std::memory_order_relaxed);
+      test_->latency.record(static_cast<uint64_t>((bench::Clock::now() - client.sent).count()));
+
+      if (--client.outstanding == 0 && !send_batch_(client)) { --active_; }
+    }
+  }
+
+  const RespBenchConfig& config_;
+  std::string            value_;
+  std::string            key_;
+  IOEventPoll*           poll_ = nullptr;
+  uint64_t               rand_ = 1;
+  std::deque<Client>     clients_; // Client 不可移动
+  RespBenchTest*         test_         = nullptr;
+  size_t                 active_       = 0; // 还有批次在途的客户端
+  size_t                 disconnected_ = 0;
+};
+
+// 进程内的最小 KV 服务，一把锁保护一个 map
+class BenchStore {
+  struct Hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>()(s); }
+  };
+public:
+  void handle(const RespCommand& cmd, RespWriter& writer) {
+    const auto& args = cmd.args;
+    if (cmd.is("PING")) {
+      writer.simple_string("PONG");
+    } else if (cmd.is("SET") && args.size() == 3) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto                        it = map_.find(args[1]);
+      if (it == map_.end()) {
+        map_.emplace(args[1], args[2]);
+      } else {
+        it->second.assign(args[2].data(), args[2].size());
+      }
+      writer.ok();
+    } else if (cmd.is("GET") && args.size() == 2) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto                        it = map_.find(args[1]);
+      if (it == map_.end()) {
+        writer.null_bulk();
+      } else {
+        writer.bulk(it->second);
+      }
+    } else if (cmd.is("INCR") && args.size() == 2) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto                        it = map_.find(args[1]);
+      if (it == map_.end()) { it = map_.emplace(args[1], "0").first; }
+      it->second = std::to_string(std::atoll(it->second.c_str()) + 1);
+      writer.integer(std::atoll(it->second.c_str()));
+    } else if (cmd.is("CONFIG")) {
+      writer.array(0);
+    } else {
+      writer.error("ERR unknown command");
+    }
+  }
+private:
+  std::mutex                                                          mutex_;
+  std::unordered_map<std::string, std::string, Hash, std::equal_to<>> map_;
+};
+
+static std::vector<std::string> split_tests(const std::string& list) {
+  std::vector<std::string> tests;
+  std::string_view         rest = list;
+  while (!rest.empty()) {
+    size_t           comma = rest.find(',');
+    std::string_view name  = rest.substr(0, comma);
+    if (!name.empty()) { tests.emplace_back(name); }
+    if (comma == std::string_view::npos) { break; }
+    rest.remove_prefix(comma + 1);
+  }
+  return tests;
+}
+
+int main(int argc, char* argv[]) {
+  std::signal(SIGPIPE, SIG_IGN);
+  bench::Args args(argc, argv);
+
+  int         threads  = static_cast<int>(std::max<long long>(1, args.get_int("threads", 1)));
+  size_t      clients  = static_cast<size_t>(std::max<long long>(threads, args.get_int("clients", 50)));
+  int64_t     requests = std::max<long long>(1, args.get_int("requests", 100000));
+  std::string host     = args.get("host", "");
+  bool        external = !host.empty();
+
+  RespBenchConfig config;
+  config.host      = external ? host : "127.0.0.1";
+  config.port      = static_cast<uint16_t>(args.get_int("port", 9504));
+  config.clients   = clients / static_cast<size_t>(threads);
+  config.pipeline  = static_cast<size_t>(std::max<long long>(1, args.get_int("pipeline", 1)));
+  config.data_size = static_cast<size_t>(std::max<long long>(0, args.get_int("data-size", 3)));
+  config.keyspace  = static_cast<uint64_t>(std::max<long long>(0, args.get_int("keyspace", 0)));
+
+  std::vector<std::string> names = split_tests(args.get("tests", "ping,set,get"));
+  for (const auto& name : names) {
+    if (name != "ping" && name != "set" && name != "get" && name != "incr") {
+      std::cerr << "Unknown test '" << name << "', expected ping / set / get / incr" << std::endl;
+      return 1;
+    }
+  }
+
+  bench::JsonObject report_config;
+  report_config.add("target", std::format("{}:{}", config.host, config.port))
+      .add("threads", threads)
+      .add("clients", static_cast<uint64_t>(config.clients * threads))
+      .add("requests", static_cast<uint64_t>(requests))
+      .add("pipeline", static_cast<uint64_t>(config.pipeline))
+      .add("data_size", static_cast<uint64_t>(config.data_size))
+      .add("keyspace", config.keyspace);
+  bench::Report report("resp", report_config);
+
+  BenchStore store;
+  RespServer resp([&store](const RespCommand& cmd, RespWriter& writer) { store.handle(cmd, writer); });
+
+  bench::BenchServer server;
+  if (!external) {
+    int         server_threads = static_cast<int>(args.get_int("server-threads", 1));
+    RunningMode mode           = bench::parse_mode(args.get("mode", "one_poll_per_thread"));
+    bool        ok             = server.start(config.port, server_threads, mode, [&resp](Server& srv) {
+      SockOptions options;
+      options.tcp_nodelay = true;
+      srv.set_sock_options(options);
+      resp.attach(srv);
+    });
+    if (!ok) {
+      std::cerr << "Failed to start RESP server on port " << config.port << std::endl;
+      return 1;
+    }
+  }
+
+  std::deque<RespBenchTest> tests(names.size());
+  for (size_t i = 0; i < names.size(); ++i) { tests[i].name = names[i]; }
+
+  // 每项测试前后各同步一次，主线程在两次同步之间计时
+  std::barrier<>           sync(threads + 1);
+  std::atomic<bool>        failed {false};
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      IOEventPoll     poll;
+      RespBenchWorker worker(config);
+      if (!worker.connect(&poll, 0x9E3779B97F4A7C15ull * static_cast<uint64_t>(t + 1))) { failed.store(true); }
+      sync.arrive_and_wait();
+      for (auto& test : tests) {
+        sync.arrive_and_wait();
+        if (!failed.load() && !worker.run(test)) { failed.store(true); }
+        sync.arrive_and_wait();
+      }
+      worker.close();
+    });
+  }
+
+  sync.arrive_and_wait();
+  for (auto& test : tests) {
+    test.remaining.store(requests);
+    sync.arrive_and_wait();
+    auto start = bench::Clock::now();
+    sync.arrive_and_wait();
+    double seconds = std::chrono::duration<double>(bench::Clock::now() - start).count();
+    if (failed.load()) { continue; }
+
+    bench::JsonObject latency_json;
+    bench::add_latency(latency_json, test.latency.snapshot());
+
+    bench::JsonObject result;
+    result.add("test", test.name)
+        .add("completed", test.completed.load())
+        .add("errors", test.errors.load())
+        .add("seconds", seconds)
+        .add("requests_per_sec", test.completed.load() / seconds)
+        .add("latency", latency_json);
+    report.add(std::move(result));
+  }
+  for (auto& worker : workers) { worker.join(); }
+  server.stop();
+
+  if (failed.load()) {
+    std::cerr << "Connection to " << config.host << ":" << config.port << " failed" << std::endl;
+    return 1;
+  }
+  report.write(args.get("json", ""));
+  return 0;
+}
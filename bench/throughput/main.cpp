@@ -0,0 +1,367 @@
+﻿#include "common/bench_util.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+using namespace cxpnet;
+
+// 回环吞吐基准
+//   bulk          单向灌包，服务端只收不回，统计服务端收到的字节速率
+//   pingpong      每个连接一发一收，按消息大小统计 RTT 分位数
+//   fanout        大量连接同时 pingpong，统计总请求速率和 RTT
+//   cross_thread  服务端在业务线程上调用 Conn::send 回包，统计跨线程投递的开销
+//
+// bench_throughput --case all --threads 1 --mode one_poll_per_thread --sizes 64,1024,16384 --json out.json
+
+struct Config {
+  std::string         test_case;
+  int                 threads;
+  RunningMode         mode;
+  uint16_t            port;
+  double              warmup_s;
+  double              duration_s;
+  std::vector<size_t> sizes;
+  size_t              bulk_conns;
+  size_t              fanout_conns;
+  size_t              fanout_size;
+};
+
+// 服务端回显，回调里不持有 ConnPtr，避免连接和回调互相引用
+static void setup_echo_server(Server& server) {
+  server.set_sock_options(SockOptions {.tcp_nodelay = true});
+  server.set_conn_user_callback([](ConnPtr conn) {
+    Conn* raw = conn.get();
+    conn->set_conn_user_callbacks(
+        [raw](Buffer* buffer) {
+          raw->send(buffer->peek(), buffer->readable_size());
+          buffer->been_read_all();
+        },
+        [](int) {});
+  });
+}
+
+// 业务线程，模拟在 poll 线程之外处理请求再回包
+class Worker {
+public:
+  Worker() {
+    thread_ = std::thread([this]() { run_(); });
+  }
+
+  ~Worker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+  void post(std::weak_ptr<Conn> conn, std::string data) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      jobs_.emplace_back(std::move(conn), std::move(data));
+    }
+    cv_.notify_one();
+  }
+private:
+  void run_() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+      if (stop_) { return; }
+
+      auto job = std::move(jobs_.front());
+      jobs_.pop_front();
+      lock.unlock();
+
+      if (auto conn = job.first.lock()) { conn->send(job.second); }
+      lock.lock();
+    }
+  }
+
+  std::thread                                             thread_;
+  std::mutex                                              mutex_;
+  std::condition_variable                                 cv_;
+  std::deque<std::pair<std::weak_ptr<Conn>, std::string>> jobs_;
+  bool                                                    stop_ = false;
+};
+
+// 客户端连接，收满 message_size 字节算一次往返
+class RoundTripClient {
+public:
+  RoundTripClient(IOEventPoll* poll, size_t message_size, Histogram* rtt, std::atomic<bool>* measuring,
+                  std::atomic<uint64_t>* completed, std::atomic<size_t>* connected)
+      : event_poll_(poll)
+      , message_(message_size, 'x')
+      , rtt_(rtt)
+      , measuring_(measuring)
+      , completed_(completed)
+      , connected_(connected) { }
+
+  void start(uint16_t port) {
+    conn_ = std::make_shared<Conn>(event_poll_);
+    conn_->set_sock_options(SockOptions {.tcp_nodelay = true});
+    conn_->connect("127.0.0.1", port, [this](ConnPtr conn) {
+      conn->set_conn_user_callbacks([this](Buffer* buffer) { on_message_(buffer); }, [](int) {});
+      connected_->fetch_add(1, std::memory_order_relaxed);
+      send_();
+    });
+  }
+
+  void close() {
+    if (conn_) { conn_->close(); }
+  }
+private:
+  void send_() {
+    sent_at_ = bench::Clock::now();
+    conn_->send(message_);
+  }
+
+  void on_message_(Buffer* buffer) {
+    received_ += buffer->readable_size();
+    buffer->been_read_all();
+    if (received_ < message_.size()) { return; }
+
+    received_ = 0;
+    if (measuring_->load(std::memory_order_relaxed)) {
+      rtt_->record(bench::elapsed_ns(sent_at_));
+      completed_->fetch_add(1, std::memory_order_relaxed);
+    }
+    send_();
+  }
+
+  IOEventPoll*             event_poll_;
+  std::string              message_;
+  Histogram*               rtt_;
+  std::atomic<bool>*       measuring_;
+  std::atomic<uint64_t>*   completed_;
+  std::atomic<size_t>*     connected_;
+  ConnPtr                  conn_;
+  size_t                   received_ = 0;
+  bench::Clock::time_point sent_at_;
+};
+
+static bool wait_connected(const std::atomic<size_t>& connected, size_t expected) {
+  auto deadline = bench::Clock::now() + std::chrono::seconds(10);
+  while (connected.load(std::memory_order_relaxed) < expected) {
+    if (bench::Clock::now() > deadline) { return false; }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return true;
+}
+
+static void sleep_seconds(double seconds) {
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+}
+
+// pingpong / fanout / cross_thread 共用：conns 个连接各自循环往返
+static bench::JsonObject run_round_trip(const Config& config, std::string_view name, size_t conns, size_t size,
+                                        const bench::BenchServer::Setup& setup) {
+  bench::JsonObject result;
+  result.add("case", name).add("size", static_cast<uint64_t>(size)).add("conns", static_cast<uint64_t>(conns));
+
+  bench::BenchServer server;
+  if (!server.start(config.port, config.threads, config.mode, setup)) {
+    result.add("error", "server start failed");
+    return result;
+  }
+
+  Histogram             rtt;
+  std::atomic<bool>     measuring {false};
+  std::atomic<uint64_t> completed {0};
+  std::atomic<size_t>   connected {0};
+
+  bench::ClientLoop                             loop;
+  std::vector<std::unique_ptr<RoundTripClient>> clients;
+  for (size_t i = 0; i < conns; ++i) {
+    clients.push_back(
+        std::make_unique<RoundTripClient>(loop.poll(), size, &rtt, &measuring, &completed, &connected));
+  }
+  bench::run_and_wait(loop.poll(), [&]() {
+    for (auto& client : clients) { client->start(config.port); }
+  });
+
+  if (!wait_connected(connected, conns)) {
+    result.add("error", "connect timeout");
+  } else {
+    sleep_seconds(config.warmup_s);
+    auto start = bench::Clock::now();
+    measuring.store(true, std::memory_order_relaxed);
+    sleep_seconds(config.duration_s);
+    measuring.store(false, std::memory_order_relaxed);
+    double elapsed = bench::elapsed_ns(start) / 1e9;
+
+    uint64_t done = completed.load(std::memory_order_relaxed);
+    result.add("msgs_per_sec", done / elapsed).add("mb_per_sec", done * size * 2 / elapsed / 1e6);
+    bench::add_latency(result, rtt.snapshot());
+  }
+
+  bench::run_and_wait(loop.poll(), [&]() {
+    for (auto& client : clients) { client->close(); }
+  });
+  loop.stop();
+  server.stop();
+  return result;
+}
+
+// 单向灌包，客户端按写缓冲区高低水位暂停和恢复
+class BulkClient {
+public:
+  static constexpr uint   kHighWatermark = 4 * 1024 * 1024;
+  static constexpr uint   kLowWatermark  = 1024 * 1024;
+  static constexpr size_t kBatchBytes    = 256 * 1024;
+
+  BulkClient(IOEventPoll* poll, size_t block_size, std::atomic<size_t>* connected)
+      : event_poll_(poll)
+      , block_(block_size, 'x')
+      , connected_(connected) { }
+
+  void start(uint16_t port) {
+    conn_ = std::make_shared<Conn>(event_poll_);
+    conn_->set_sock_options(SockOptions {.tcp_nodelay = true});
+    conn_->connect("127.0.0.1", port, [this](ConnPtr conn) {
+      conn->set_conn_user_callbacks([](Buffer* buffer) { buffer->been_read_all(); }, [](int) {});
+      conn->set_watermark(kHighWatermark, kLowWatermark);
+      // 低水位回调在 Conn 清除高水位标记之前触发，放到下一轮再继续写
+      conn->set_watermark_callback([this](int mark) {
+        paused_ = mark == static_cast<int>(kHighWatermark);
+        if (!paused_) { event_poll_->run_later([this]() { pump_(); }); }
+      });
+      connected_->fetch_add(1, std::memory_order_relaxed);
+      pump_();
+    });
+  }
+
+  void close() {
+    stopped_ = true;
+    if (conn_) { conn_->close(); }
+  }
+private:
+  // 小块时 send 可能一直直接写成功而碰不到高水位，每轮最多写 kBatchBytes 后让出 loop
+  void pump_() {
+    size_t written = 0;
+    while (!paused_ && !stopped_ && conn_->connected()) {
+      conn_->send(block_);
+      written += block_.size();
+      if (written >= kBatchBytes) {
+        event_poll_->run_later([this]() { pump_(); });
+        return;
+      }
+    }
+  }
+
+  IOEventPoll*         event_poll_;
+  std::string          block_;
+  std::atomic<size_t>* connected_;
+  ConnPtr              conn_;
+  bool                 paused_  = false;
+  bool                 stopped_ = false;
+};
+
+static bench::JsonObject run_bulk(const Config& config, size_t size) {
+  bench::JsonObject result;
+  result.add("case", "bulk").add("size", static_cast<uint64_t>(size)).add("conns", static_cast<uint64_t>(config.bulk_conns));
+
+  Counter            received;
+  bench::BenchServer server;
+  bool               ok = server.start(config.port, config.threads, config.mode, [&received](Server& srv) {
+    srv.set_conn_user_callback([&received](ConnPtr conn) {
+      conn->set_conn_user_callbacks(
+          [&received](Buffer* buffer) {
+            received.add(buffer->readable_size());
+            buffer->been_read_all();
+          },
+          [](int) {});
+    });
+  });
+  if (!ok) {
+    result.add("error", "server start failed");
+    return result;
+  }
+
+  std::atomic<size_t>                      connected {0};
+  bench::ClientLoop                        loop;
+  std::vector<std::unique_ptr<BulkClient>> clients;
+  for (size_t i = 0; i < config.bulk_conns; ++i) {
+    clients.push_back(std::make_unique<BulkClient>(loop.poll(), size, &connected));
+  }
+  bench::run_and_wait(loop.poll(), [&]() {
+    for (auto& client : clients) { client->start(config.port); }
+  });
+
+  if (!wait_connected(connected, config.bulk_conns)) {
+    result.add("error", "connect timeout");
+  } else {
+    sleep_seconds(config.warmup_s);
+    uint64_t begin = received.value();
+    auto     start = bench::Clock::now();
+    sleep_seconds(config.duration_s);
+    uint64_t bytes   = received.value() - begin;
+    double   elapsed = bench::elapsed_ns(start) / 1e9;
+
+    result.add("msgs_per_sec", bytes / size / elapsed).add("mb_per_sec", bytes / elapsed / 1e6);
+  }
+
+  bench::run_and_wait(loop.poll(), [&]() {
+    for (auto& client : clients) { client->close(); }
+  });
+  loop.stop();
+  server.stop();
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  bench::Args args(argc, argv);
+
+  Config config;
+  config.test_case    = args.get("case", "all");
+  config.threads      = static_cast<int>(args.get_int("threads", 1));
+  config.mode         = bench::parse_mode(args.get("mode", "one_poll_per_thread"));
+  config.port         = static_cast<uint16_t>(args.get_int("port", 9500));
+  config.warmup_s     = args.get_double("warmup", 1.0);
+  config.duration_s   = args.get_double("duration", 3.0);
+  config.sizes        = args.get_list("sizes", {64, 1024, 16384});
+  config.bulk_conns   = static_cast<size_t>(args.get_int("bulk-conns", 1));
+  config.fanout_conns = static_cast<size_t>(args.get_int("fanout-conns", 100));
+  config.fanout_size  = static_cast<size_t>(args.get_int("fanout-size", 64));
+
+  bench::JsonObject config_json;
+  config_json.add("case", config.test_case)
+      .add("threads", config.threads)
+      .add("mode", bench::mode_name(config.mode))
+      .add("warmup_s", config.warmup_s)
+      .add("duration_s", config.duration_s);
+  bench::Report report("throughput", config_json);
+
+  auto enabled = [&config](std::string_view name) { return config.test_case == "all" || config.test_case == name; };
+
+  if (enabled("bulk")) {
+    for (size_t size : config.sizes) { report.add(run_bulk(config, size)); }
+  }
+  if (enabled("pingpong")) {
+    for (size_t size : config.sizes) { report.add(run_round_trip(config, "pingpong", 1, size, setup_echo_server)); }
+  }
+  if (enabled("fanout")) {
+    report.add(run_round_trip(config, "fanout", config.fanout_conns, config.fanout_size, setup_echo_server));
+  }
+  if (enabled("cross_thread")) {
+    Worker worker;
+    auto   setup = [&worker](Server& server) {
+      server.set_sock_options(SockOptions {.tcp_nodelay = true});
+      server.set_conn_user_callback([&worker](ConnPtr conn) {
+        Conn* raw = conn.get();
+        conn->set_conn_user_callbacks(
+            [raw, &worker](Buffer* buffer) {
+              worker.post(raw->shared_from_this(), std::string(buffer->peek(), buffer->readable_size()));
+              buffer->been_read_all();
+            },
+            [](int) {});
+      });
+    };
+    report.add(run_round_trip(config, "cross_thread", config.fanout_conns, config.fanout_size, setup));
+  }
+
+  report.write(args.get("json", ""));
+  return 0;
+}
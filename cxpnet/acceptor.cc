@@ -2,7 +2,9 @@
 #include "channel.h"
 #include "io_event_poll.h"
 #include "platform_api.h"
+#include "timer.h"
 
+#include <algorithm>
 #include <future>
 
 namespace cxpnet {
@@ -15,7 +17,8 @@ namespace cxpnet {
       , proto_stack_ {ProtocolStack::kIPv4Only}
       , on_err_func_ {nullptr}
       , on_conn_func_ {nullptr}
-      , local_addr_storage_ {} {
+      , local_addr_storage_ {}
+      , idle_handle_ {invalid_socket} {
   }
 
   Acceptor::~Acceptor() { shutdown(); }
@@ -57,6 +60,13 @@ namespace cxpnet {
 
   void Acceptor::shutdown_local_() {
     channel_.reset();
+    alive_.reset();
+    resume_scheduled_ = false; // 未执行的延迟任务随 alive_ 失效，不会再清除该标志
+
+    if (idle_handle_ != invalid_socket) {
+      Platform::close_handle(idle_handle_);
+      idle_handle_ = invalid_socket;
+    }
 
     if (listen_handle_ != invalid_socket) {
       Platform::close_handle(listen_handle_);
@@ -72,6 +82,13 @@ namespace cxpnet {
       channel_->remove();
       channel_.reset();
     }
+    alive_.reset();
+    resume_scheduled_ = false; // 未执行的延迟任务随 alive_ 失效，不会再清除该标志
+
+    if (idle_handle_ != invalid_socket) {
+      Platform::close_handle(idle_handle_);
+      idle_handle_ = invalid_socket;
+    }
 
     if (listen_handle_ != invalid_socket) {
       Platform::close_handle(listen_handle_);
@@ -81,12 +98,25 @@ namespace cxpnet {
     listening_ = false;
   }
 
+  AcceptStats Acceptor::stats() const {
+    AcceptStats stats;
+    stats.accepted = accepted_.load(std::memory_order_relaxed);
+    stats.rejected = rejected_.load(std::memory_order_relaxed);
+    stats.deferred = deferred_.load(std::memory_order_relaxed);
+    return stats;
+  }
+
   bool Acceptor::listen() {
     if (local_addr_storage_.ss_family == 0) { return false; }
 
-    listen_handle_ = Platform::listen(local_addr_storage_, proto_stack_, sock_option_);
+    listen_handle_ = Platform::listen(local_addr_storage_, proto_stack_, sock_option_, listen_options_, sock_options_);
     if (listen_handle_ == invalid_socket) { return false; }
 
+    idle_handle_ = Platform::open_idle_fd();
+    alive_       = std::make_shared<int>(0);
+    tokens_      = limits_.burst > 0 ? limits_.burst : limits_.rate_per_sec;
+    last_refill_ = std::chrono::steady_clock::now();
+
     listening_ = true;
     channel_   = std::make_unique<Channel>(event_poll_, listen_handle_);
     channel_->set_read_callback(std::bind(&Acceptor::handle_read_, this));
@@ -96,16 +126,84 @@ namespace cxpnet {
   }
 
   void Acceptor::handle_read_() {
-    int err = Platform::accept(listen_handle_, accepted_handles_);
-    if (err != 0) {
-      if (on_err_func_ != nullptr) { on_err_func_(err); }
+    if (!listening_) { return; }
+
+    size_t budget = accept_budget_();
+    if (budget == 0) {
+      // 令牌耗尽，等下一个令牌产生再继续
+      uint32_t delay_ms = static_cast<uint32_t>((1.0 - tokens_) * 1000.0 / limits_.rate_per_sec) + 1;
+      defer_accept_(delay_ms);
       return;
     }
 
+    size_t dropped = 0;
+    int    err     = 0;
+    while (accepted_handles_.size() + dropped < budget) {
+      err = Platform::accept(listen_handle_, accepted_handles_, budget - dropped);
+      if (err != EMFILE && err != ENFILE) { break; }
+      if (!Platform::reject_pending(listen_handle_, idle_handle_)) { break; }
+
+      dropped++;
+      err = 0;
+    }
+
+    size_t taken = accepted_handles_.size() + dropped;
+    if (limits_.rate_per_sec > 0) { tokens_ = (std::max)(0.0, tokens_ - static_cast<double>(taken)); }
+    accepted_.fetch_add(accepted_handles_.size(), std::memory_order_relaxed);
+    rejected_.fetch_add(dropped, std::memory_order_relaxed);
+
     for (auto&& [handle, addr] : accepted_handles_) {
       if (on_conn_func_ != nullptr) { on_conn_func_(handle, addr); }
     }
 
     accepted_handles_.clear();
+
+    if (err == EMFILE || err == ENFILE) {
+      // 空闲 fd 也拿不回来，稍后再试，避免忙等
+      static constexpr uint32_t kFdExhaustedRetryMS = 100;
+      defer_accept_(kFdExhaustedRetryMS);
+    } else if (err == 0 && taken >= budget) {
+      // 预算用完，backlog 里可能还有连接，边沿触发不会再通知，让出给其他 channel 后继续
+      defer_accept_(0);
+    }
+
+    if (err != 0 && on_err_func_ != nullptr) { on_err_func_(err); }
+  }
+
+  size_t Acceptor::accept_budget_() {
+    size_t budget = limits_.max_per_wakeup > 0 ? limits_.max_per_wakeup : SIZE_MAX;
+    if (limits_.rate_per_sec == 0) { return budget; }
+
+    auto   now      = std::chrono::steady_clock::now();
+    double elapsed  = std::chrono::duration<double>(now - last_refill_).count();
+    double capacity = limits_.burst > 0 ? limits_.burst : limits_.rate_per_sec;
+    tokens_         = (std::min)(capacity, tokens_ + elapsed * limits_.rate_per_sec);
+    last_refill_    = now;
+
+    return (std::min)(budget, static_cast<size_t>(tokens_));
+  }
+
+  void Acceptor::defer_accept_(uint32_t delay_ms) {
+    if (resume_scheduled_) { return; }
+
+    resume_scheduled_ = true;
+    deferred_.fetch_add(1, std::memory_order_relaxed);
+
+    std::weak_ptr<int> alive  = alive_;
+    auto               resume = [this, alive]() {
+      if (alive.expired()) { return; }
+      resume_scheduled_ = false;
+      handle_read_();
+    };
+
+    if (delay_ms == 0) {
+      event_poll_->run_later(std::move(resume));
+      return;
+    }
+
+    IOEventPoll* event_poll = event_poll_;
+    event_poll->timer_manager()->add_timer(delay_ms, [event_poll, resume]() {
+      event_poll->run_in_poll(resume);
+    });
   }
 } // namespace cxpnet
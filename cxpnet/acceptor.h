@@ -3,6 +3,8 @@
 
 #include "sock.h"
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <vector>
@@ -11,6 +13,12 @@ namespace cxpnet {
   class IOEventPoll;
   class Channel;
 
+  struct AcceptStats {
+    uint64_t accepted = 0; // 交给上层的连接数
+    uint64_t rejected = 0; // fd 耗尽或被上层拒绝而关闭的连接数
+    uint64_t deferred = 0; // 因单次预算、限速或 fd 耗尽而让出 accept 的次数
+  };
+
   class Acceptor : public NonCopyable {
   public:
     explicit Acceptor(IOEventPoll* event_poll);
@@ -19,12 +27,21 @@ namespace cxpnet {
     void set_listen_addr(const char* addr, uint16_t port,
                          ProtocolStack proto_stack = ProtocolStack::kIPv4Only,
                          int           option      = SocketOption::kNone);
+    void set_listen_options(const ListenOptions& listen_options) { listen_options_ = listen_options; }
+    // 只有缓冲区大小作用于 listen socket，见 Platform::listen
+    void set_sock_options(const SockOptions& sock_options) { sock_options_ = sock_options; }
+    void set_accept_limits(const AcceptLimits& limits) { limits_ = limits; }
 
     bool listen();
     void shutdown();
 
     bool is_listen() const { return listening_; }
 
+    // 任意线程可调用
+    AcceptStats stats() const;
+    // 上层 (如 Server 的 max_connections) 拒绝连接时计数
+    void note_rejected() { rejected_.fetch_add(1, std::memory_order_relaxed); }
+
     void set_new_conn_callback(std::function<void(int, struct sockaddr_storage)>&& func) {
       on_conn_func_ = std::move(func);
     }
@@ -35,6 +52,8 @@ namespace cxpnet {
     void shutdown_local_();
     void shutdown_in_poll_();
     void handle_read_();
+    size_t accept_budget_();
+    void   defer_accept_(uint32_t delay_ms);
   private:
     using HandlesListType           = std::vector<std::pair<int, struct sockaddr_storage>>;
     using NewConnectionCallbackType = std::function<void(int, struct sockaddr_storage)>;
@@ -45,10 +64,24 @@ namespace cxpnet {
     bool                      listening_;
     int                       sock_option_;
     ProtocolStack             proto_stack_;
+    ListenOptions             listen_options_;
+    SockOptions               sock_options_;
     std::function<void(int)>  on_err_func_;
     NewConnectionCallbackType on_conn_func_;
     sockaddr_storage          local_addr_storage_;
     HandlesListType           accepted_handles_;
+    int                       idle_handle_;
+    AcceptLimits              limits_;
+
+    // 令牌桶，仅在 poll 线程访问
+    double                                tokens_ = 0;
+    std::chrono::steady_clock::time_point last_refill_;
+    bool                                  resume_scheduled_ = false;
+    std::shared_ptr<int>                  alive_; // 延迟任务通过 weak_ptr 判断 Acceptor 是否已关闭
+
+    std::atomic<uint64_t> accepted_ {0};
+    std::atomic<uint64_t> rejected_ {0};
+    std::atomic<uint64_t> deferred_ {0};
   };
 } // namespace cxpnet
 
@@ -2,17 +2,22 @@
 #define BUFFER_H
 
 #include "ensure.h"
+#include "scan.h"
 #include "sock.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <string_view>
 
 namespace cxpnet {
   class Buffer {
     static constexpr size_t kInitialCapacity = 8192;
     static constexpr size_t kShrinkThreshold = 16384;
+    static constexpr size_t kMaxScanDelim    = 16; // 超过该长度的分隔符不记录续扫位置
   public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
     explicit Buffer(size_t initial_capacity = kInitialCapacity) {
       capacity_    = (std::max)(initial_capacity, kInitialCapacity);
       data_        = new char[capacity_];
@@ -36,6 +41,7 @@ namespace cxpnet {
       read_index_  = other.read_index_;
       write_index_ = other.write_index_;
       capacity_    = other.capacity_;
+      copy_scan_state_(other);
 
       other.data_        = nullptr;
       other.read_index_  = 0;
@@ -51,6 +57,7 @@ namespace cxpnet {
       read_index_        = other.read_index_;
       write_index_       = other.write_index_;
       capacity_          = other.capacity_;
+      copy_scan_state_(other);
       other.data_        = nullptr;
       other.read_index_  = 0;
       other.write_index_ = 0;
@@ -60,7 +67,10 @@ namespace cxpnet {
 
     ~Buffer() { delete[] data_; }
 
-    void   clear() { read_index_ = write_index_ = 0; }
+    void clear() {
+      read_index_ = write_index_ = 0;
+      scan_offset_               = 0;
+    }
     bool   empty() const { return readable_size() == 0; }
     size_t readable_size() const { return write_index_ - read_index_; }
     size_t writable_size() const { return capacity_ - write_index_; }
@@ -71,6 +81,7 @@ namespace cxpnet {
     void been_read(size_t len) {
       ENSURE(len <= readable_size(), "been_read: len exceeds readable size");
       if (len == 0) { return; }
+      scan_offset_ = scan_offset_ > len ? scan_offset_ - len : 0;
       if (len == readable_size()) {
         read_index_ = write_index_;
         shrink_if_needed_();
@@ -84,6 +95,32 @@ namespace cxpnet {
     }
     void been_read_all() { been_read(readable_size()); }
 
+    // 在可读区域中查找分隔符，返回相对 peek() 的偏移，未找到返回 npos
+    // 未找到时记住已扫描到的位置，追加数据后再查找同一分隔符只扫描新到达的部分
+    // 续扫假设已扫描过的可读数据没有被原地修改
+    size_t find(std::string_view delim) {
+      if (delim.empty()) { return 0; }
+
+      size_t readable = readable_size();
+      size_t start    = same_scan_delim_(delim) ? scan_offset_ : 0;
+      if (readable < start + delim.size()) {
+        remember_scan_(delim, start);
+        return npos;
+      }
+
+      const char* hit = scan::find(peek() + start, readable - start, delim);
+      if (hit != nullptr) {
+        size_t offset = static_cast<size_t>(hit - peek());
+        remember_scan_(delim, offset);
+        return offset;
+      }
+      // 分隔符可能跨越当前数据末尾，保留最后 delim.size() - 1 个字节下次重扫
+      remember_scan_(delim, readable - (delim.size() - 1));
+      return npos;
+    }
+    size_t find_crlf() { return find("\r\n"); }
+    size_t find_eol() { return find("\n"); }
+
     char* to_write() const { return data_ + write_index_; }
     void  been_written(size_t len) {
       ENSURE(len <= writable_size(), "been_written: len exceeds writable size");
@@ -127,6 +164,29 @@ namespace cxpnet {
       }
     }
   private:
+    bool same_scan_delim_(std::string_view delim) const {
+      return scan_delim_size_ == delim.size() && std::memcmp(scan_delim_, delim.data(), delim.size()) == 0;
+    }
+
+    void remember_scan_(std::string_view delim, size_t offset) {
+      if (delim.size() > kMaxScanDelim) {
+        scan_delim_size_ = 0;
+        scan_offset_     = 0;
+        return;
+      }
+      if (!same_scan_delim_(delim)) {
+        std::memcpy(scan_delim_, delim.data(), delim.size());
+        scan_delim_size_ = delim.size();
+      }
+      scan_offset_ = offset;
+    }
+
+    void copy_scan_state_(const Buffer& other) {
+      std::memcpy(scan_delim_, other.scan_delim_, other.scan_delim_size_);
+      scan_delim_size_ = other.scan_delim_size_;
+      scan_offset_     = other.scan_offset_;
+    }
+
     // 自动收缩：当闲置空间过大时释放内存
     void shrink_if_needed_() {
       size_t used = readable_size();
@@ -163,6 +223,11 @@ namespace cxpnet {
     size_t write_index_ = 0;
     size_t read_index_  = 0;
     size_t capacity_    = 0;
+
+    // 续扫状态，scan_offset_ 相对 read_index_
+    size_t scan_offset_     = 0;
+    size_t scan_delim_size_ = 0;
+    char   scan_delim_[kMaxScanDelim] {};
   };
 } // namespace cxpnet
 
@@ -0,0 +1,173 @@
+﻿#ifndef CODEC_H
+#define CODEC_H
+
+#include "buffer.h"
+#include "conn.h"
+#include "ensure.h"
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+namespace cxpnet {
+  // 长度前缀格式，定长前缀为网络字节序
+  enum class LengthField {
+    kFixed16, // 2 字节，帧长度最大 65535
+    kFixed32, // 4 字节
+    kVarint,  // LEB128 变长整数，1 ~ 10 字节
+  };
+
+  struct FrameOptions {
+    LengthField length_field   = LengthField::kFixed32;
+    size_t      max_frame_size = 16 * 1024 * 1024; // 超过该长度视为协议错误
+  };
+
+  // 长度前缀分帧
+  // 解码：一次读回调中解出所有完整帧，帧以 string_view 指向读缓冲，不复制、不分配
+  // 编码：帧头写在栈上，和 payload 一起通过 Conn::sendv 写出，不拼接临时字符串
+  class LengthCodec {
+  public:
+    static constexpr size_t kMaxHeaderSize = 10;
+
+    explicit LengthCodec(FrameOptions options = {})
+        : options_(options) { }
+
+    const FrameOptions& options() const { return options_; }
+
+    // 依次对 buffer 中每个完整帧调用 on_frame(std::string_view)，结束后一次性消费已解出的字节
+    // string_view 只在回调期间有效，回调中不要读取或消费 buffer
+    // 返回 false 表示帧长度超过 max_frame_size 或前缀非法，调用方应关闭连接
+    template <typename OnFrame>
+    bool decode(Buffer* buffer, OnFrame&& on_frame) const {
+      const char* data     = buffer->peek();
+      size_t      size     = buffer->readable_size();
+      size_t      consumed = 0;
+      bool        ok       = true;
+
+      while (consumed < size) {
+        uint64_t length      = 0;
+        size_t   header_size = 0;
+        int      result      = parse_header_(data + consumed, size - consumed, length, header_size);
+        if (result < 0) {
+          ok = false;
+          break;
+        }
+        if (result == 0) { break; }
+        if (length > options_.max_frame_size) {
+          ok = false;
+          break;
+        }
+        if (size - consumed - header_size < length) { break; }
+
+        on_frame(std::string_view(data + consumed + header_size, static_cast<size_t>(length)));
+        consumed += header_size + static_cast<size_t>(length);
+      }
+
+      if (consumed > 0) { buffer->been_read(consumed); }
+      return ok;
+    }
+
+    // payload_size 是否能编码为一帧；发送方据此在 encode_header 之前拒绝过大的帧
+    bool fits(size_t payload_size) const {
+      if (payload_size > options_.max_frame_size) { return false; }
+      switch (options_.length_field) {
+      case LengthField::kFixed16:
+        return payload_size <= 0xFFFF;
+      case LengthField::kFixed32:
+        return payload_size <= 0xFFFFFFFFull;
+      case LengthField::kVarint:
+        return true;
+      }
+      return false;
+    }
+
+    // 写入帧头，返回帧头长度，out 至少 kMaxHeaderSize 字节；调用方需要先用 fits 检查，不能编码时抛出
+    size_t encode_header(size_t payload_size, char* out) const {
+      ENSURE(payload_size <= options_.max_frame_size, "frame size {} exceeds max_frame_size {}", payload_size,
+             options_.max_frame_size);
+
+      switch (options_.length_field) {
+      case LengthField::kFixed16:
+        ENSURE(payload_size <= 0xFFFF, "frame size {} does not fit a 16-bit length", payload_size);
+        out[0] = static_cast<char>((payload_size >> 8) & 0xFF);
+        out[1] = static_cast<char>(payload_size & 0xFF);
+        return 2;
+      case LengthField::kFixed32:
+        ENSURE(payload_size <= 0xFFFFFFFFull, "frame size {} does not fit a 32-bit length", payload_size);
+        for (int i = 0; i < 4; ++i) { out[i] = static_cast<char>((payload_size >> (8 * (3 - i))) & 0xFF); }
+        return 4;
+      case LengthField::kVarint: {
+        uint64_t value = payload_size;
+        size_t   n     = 0;
+        while (value >= 0x80) {
+          out[n++] = static_cast<char>((value & 0x7F) | 0x80);
+          value >>= 7;
+        }
+        out[n++] = static_cast<char>(value);
+        return n;
+      }
+      }
+      return 0;
+    }
+
+    // payload 不能编码为一帧 (见 fits) 时不发送并返回 false，不抛出，可以在 poll 线程的回调中直接调用
+    bool send(Conn* conn, std::string_view payload) const {
+      if (!fits(payload.size())) { return false; }
+
+      char   header[kMaxHeaderSize];
+      size_t header_size = encode_header(payload.size(), header);
+      conn->sendv({std::string_view(header, header_size), payload});
+      return true;
+    }
+
+    bool send(const ConnPtr& conn, std::string_view payload) const { return send(conn.get(), payload); }
+
+    // 生成 on_message_func_：每个完整帧回调 on_frame，帧非法时关闭连接
+    // 连接在回调中被关闭后不再投递剩余的帧
+    std::function<void(Buffer*)> message_handler(Conn* conn, std::function<void(Conn*, std::string_view)> on_frame) const {
+      return [codec = *this, conn, on_frame = std::move(on_frame)](Buffer* buffer) {
+        bool ok = codec.decode(buffer, [conn, &on_frame](std::string_view frame) {
+          if (conn->connected()) { on_frame(conn, frame); }
+        });
+        if (!ok) { conn->close(); }
+      };
+    }
+  private:
+    // 返回 1 表示解析出完整前缀，0 表示数据不足，-1 表示前缀非法
+    int parse_header_(const char* data, size_t size, uint64_t& length, size_t& header_size) const {
+      const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+
+      switch (options_.length_field) {
+      case LengthField::kFixed16:
+        if (size < 2) { return 0; }
+        length      = (static_cast<uint64_t>(bytes[0]) << 8) | bytes[1];
+        header_size = 2;
+        return 1;
+      case LengthField::kFixed32:
+        if (size < 4) { return 0; }
+        length = (static_cast<uint64_t>(bytes[0]) << 24) | (static_cast<uint64_t>(bytes[1]) << 16) |
+                 (static_cast<uint64_t>(bytes[2]) << 8) | bytes[3];
+        header_size = 4;
+        return 1;
+      case LengthField::kVarint:
+        length = 0;
+        for (size_t i = 0; i < kMaxHeaderSize; ++i) {
+          if (i >= size) { return 0; }
+          length |= static_cast<uint64_t>(bytes[i] & 0x7F) << (7 * i);
+          if ((bytes[i] & 0x80) == 0) {
+            header_size = i + 1;
+            return 1;
+          }
+          // 提前拒绝超长的帧，不必等 10 字节收齐
+          if (length > options_.max_frame_size) { return -1; }
+        }
+        return -1;
+      }
+      return -1;
+    }
+
+    FrameOptions options_;
+  };
+} // namespace cxpnet
+
+#endif // CODEC_H
@@ -7,8 +7,21 @@
 
 #include <atomic>
 #include <memory>
+#include <sys/uio.h>
 
 namespace cxpnet {
+  static int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  static std::chrono::steady_clock::time_point from_steady_ns(int64_t ns) {
+    if (ns == 0) { return {}; }
+    return std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(ns)));
+  }
+
   Conn::Conn(IOEventPoll* event_poll, int handle)
       : event_poll_ {event_poll}
       , handle_ {handle}
@@ -27,9 +40,14 @@ namespace cxpnet {
       , write_buffer_ {nullptr}
       , on_connected_func_ {nullptr}
       , on_connect_error_func_ {nullptr} {
+    created_at_ns_.store(steady_now_ns(), std::memory_order_relaxed);
+
+    // accept 到的连接在选择 poll 后立即计入负载，避免同一批 accept 全部落到同一个 poll
+    if (handle_ != invalid_socket) { add_load_(); }
   }
 
   Conn::~Conn() {
+    remove_load_();
     cancel_close_timeout_();
     if (handle_ != invalid_socket) {
       Platform::close_handle(handle_);
@@ -45,6 +63,7 @@ namespace cxpnet {
     }
 
     cleanup_done_.store(false, std::memory_order_release);
+    created_at_ns_.store(steady_now_ns(), std::memory_order_relaxed);
     on_connected_func_     = std::move(on_connected);
     on_connect_error_func_ = std::move(on_connect_error);
 
@@ -69,6 +88,7 @@ namespace cxpnet {
     }
 
     cleanup_done_.store(false, std::memory_order_release);
+    created_at_ns_.store(steady_now_ns(), std::memory_order_relaxed);
 
     strncpy(addr_, addr, INET6_ADDRSTRLEN - 1);
     addr_[INET6_ADDRSTRLEN - 1] = '\0';
@@ -81,11 +101,12 @@ namespace cxpnet {
     struct sockaddr_storage addr_storage = Platform::get_sockaddr(addr, port, proto_stack);
     if (addr_storage.ss_family == 0) { return false; }
 
-    int handle = Platform::connect(addr_storage, false);
+    int handle = Platform::connect(addr_storage, false, 5000, sock_options_);
     if (handle < 0) { return false; }
 
     handle_ = handle;
     start_();
+    flush_connect_payload_();
     return connected();
   }
 
@@ -105,12 +126,15 @@ namespace cxpnet {
       return;
     }
 
-    int handle = Platform::connect(addr_storage);
+    size_t payload_sent = 0;
+    int    handle       = Platform::connect(addr_storage, true, 5000, sock_options_, connect_payload_, &payload_sent);
     if (handle < 0) {
       if (on_connect_error_func_) { on_connect_error_func_(Platform::get_last_error()); }
       return;
     }
 
+    connect_payload_.erase(0, payload_sent);
+
     handle_ = handle;
     set_state_(State::kConnecting);
 
@@ -119,11 +143,15 @@ namespace cxpnet {
     channel_->set_write_callback([self]() {
       self->handle_connect_event_();
     });
+    // 连接被拒绝时 epoll 只报告 EPOLLERR | EPOLLHUP，不报告可写
+    channel_->set_close_callback([self](int err) {
+      self->handle_connect_event_(err != 0 ? err : ECONNREFUSED);
+    });
     channel_->tie(self);
     channel_->add_write_event();
   }
 
-  void Conn::handle_connect_event_() {
+  void Conn::handle_connect_event_(int reported_err) {
     ENSURE(event_poll_->is_in_poll_thread(), "Must in IO thread");
 
     if (get_state_() != State::kConnecting) { return; }
@@ -133,6 +161,7 @@ namespace cxpnet {
     if (getsockopt(handle_, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
       err = Platform::get_last_error();
     }
+    if (err == 0) { err = reported_err; }
 
     if (err != 0) {
       if (channel_) {
@@ -158,12 +187,22 @@ namespace cxpnet {
     }
 
     start_();
+    flush_connect_payload_();
 
     if (on_connected_func_) {
-      on_connected_func_(shared_from_this());
+      event_poll_->run_user_callback_(CallbackKind::kConnection, this,
+                                      [this]() { on_connected_func_(shared_from_this()); });
     }
   }
 
+  void Conn::flush_connect_payload_() {
+    if (connect_payload_.empty()) { return; }
+
+    std::string payload;
+    payload.swap(connect_payload_);
+    send_in_poll_thread_(payload.data(), payload.size());
+  }
+
   void Conn::shutdown() {
     State current = get_state_();
     if (current == State::kDisconnected || current == State::kDisconnecting) { return; }
@@ -220,6 +259,8 @@ namespace cxpnet {
     if (!cleanup_done_.compare_exchange_strong(expected, true)) { return; }
 
     cancel_close_timeout_();
+    cancel_tcp_info_sample_();
+    note_high_watermark_(false);
 
     if (get_state_() == State::kConnected && handle_ != invalid_socket) {
       Platform::shut_wr(handle_);
@@ -241,12 +282,15 @@ namespace cxpnet {
     }
 
     set_state_(State::kDisconnected);
+    remove_load_();
 
     auto internal_close_callback = std::move(internal_close_callback_);
     auto close_func              = std::move(on_close_func_);
 
     if (internal_close_callback) { internal_close_callback(); }
-    if (close_func) { close_func(err); }
+    if (close_func) {
+      event_poll_->run_user_callback_(CallbackKind::kClose, this, [&close_func, err]() { close_func(err); });
+    }
 
     if (channel_) {
       Channel* raw_channel    = channel_.release();
@@ -255,6 +299,18 @@ namespace cxpnet {
     }
   }
 
+  void Conn::add_load_() {
+    if (load_counted_ || event_poll_ == nullptr) { return; }
+    event_poll_->add_conn_load_();
+    load_counted_ = true;
+  }
+
+  void Conn::remove_load_() {
+    if (!load_counted_) { return; }
+    event_poll_->remove_conn_load_();
+    load_counted_ = false;
+  }
+
   void Conn::start_close_timeout_() {
     if (close_timer_id_ != 0) { return; }
 
@@ -297,6 +353,138 @@ namespace cxpnet {
     send(msg.data(), msg.size());
   }
 
+  void Conn::sendv(const std::string_view* parts, size_t count) {
+    if (!connected() || parts == nullptr || count == 0) { return; }
+
+    if (event_poll_->is_in_poll_thread()) {
+      sendv_in_poll_thread_(parts, count);
+      return;
+    }
+
+    // 跨线程时必须复制，直接合并为一段
+    auto to_send = std::make_shared<std::string>();
+    for (size_t i = 0; i < count; ++i) { to_send->append(parts[i]); }
+    if (to_send->empty()) { return; }
+
+    event_poll_->run_in_poll([self = shared_from_this(), to_send]() {
+      self->send_in_poll_thread_(to_send->data(), to_send->size());
+    });
+  }
+
+  ConnStats Conn::stats() const {
+    ConnStats stats;
+    stats.bytes_in                = bytes_in_.load(std::memory_order_relaxed);
+    stats.bytes_out               = bytes_out_.load(std::memory_order_relaxed);
+    stats.read_calls              = read_calls_.load(std::memory_order_relaxed);
+    stats.write_calls             = write_calls_.load(std::memory_order_relaxed);
+    stats.eagain                  = eagain_.load(std::memory_order_relaxed);
+    stats.peak_write_buffer       = peak_write_buffer_.load(std::memory_order_relaxed);
+    stats.above_high_watermark_ns = above_high_watermark_ns_.load(std::memory_order_relaxed);
+    stats.created_at              = from_steady_ns(created_at_ns_.load(std::memory_order_relaxed));
+    stats.established_at          = from_steady_ns(established_at_ns_.load(std::memory_order_relaxed));
+
+    int64_t above_since = above_high_watermark_since_ns_.load(std::memory_order_relaxed);
+    if (above_since != 0) {
+      int64_t now = steady_now_ns();
+      if (now > above_since) { stats.above_high_watermark_ns += static_cast<uint64_t>(now - above_since); }
+    }
+
+    // seqlock 读端：字段都是 relaxed 原子量，两次读到相同的偶数序号时这一组字段来自同一次采样
+    uint32_t begin = 0;
+    int64_t  at_ns = 0;
+    do {
+      begin                        = tcp_info_seq_.load(std::memory_order_acquire);
+      stats.tcp_info.rtt_us        = tcp_rtt_us_.load(std::memory_order_relaxed);
+      stats.tcp_info.rttvar_us     = tcp_rttvar_us_.load(std::memory_order_relaxed);
+      stats.tcp_info.snd_cwnd      = tcp_snd_cwnd_.load(std::memory_order_relaxed);
+      stats.tcp_info.unacked       = tcp_unacked_.load(std::memory_order_relaxed);
+      stats.tcp_info.lost          = tcp_lost_.load(std::memory_order_relaxed);
+      stats.tcp_info.total_retrans = tcp_total_retrans_.load(std::memory_order_relaxed);
+      at_ns                        = tcp_info_at_ns_.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((begin & 1) != 0 || tcp_info_seq_.load(std::memory_order_relaxed) != begin);
+    stats.tcp_info_at = from_steady_ns(at_ns);
+    return stats;
+  }
+
+  void Conn::set_tcp_info_sample_interval(uint32_t interval_ms) {
+    cancel_tcp_info_sample_();
+    tcp_info_interval_ms_ = interval_ms;
+    schedule_tcp_info_sample_();
+  }
+
+  void Conn::schedule_tcp_info_sample_() {
+    if (tcp_info_interval_ms_ == 0 || tcp_info_timer_id_ != 0) { return; }
+    if (!event_poll_ || !event_poll_->timer_manager()) { return; }
+
+    std::weak_ptr<Conn> weak_self = shared_from_this();
+    tcp_info_timer_id_            = event_poll_->timer_manager()->add_timer(
+        tcp_info_interval_ms_,
+        [weak_self]() {
+          auto self = weak_self.lock();
+          if (!self) { return; }
+
+          self->event_poll_->run_in_poll([self]() {
+            self->tcp_info_timer_id_ = 0;
+            if (!self->connected()) { return; }
+
+            TcpInfo info;
+            if (Platform::get_tcp_info(self->handle_, info)) { self->publish_tcp_info_(info); }
+            self->schedule_tcp_info_sample_();
+          });
+        });
+  }
+
+  // seqlock 写端，只在 poll 线程调用
+  void Conn::publish_tcp_info_(const TcpInfo& info) {
+    uint32_t seq = tcp_info_seq_.load(std::memory_order_relaxed);
+    tcp_info_seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    tcp_rtt_us_.store(info.rtt_us, std::memory_order_relaxed);
+    tcp_rttvar_us_.store(info.rttvar_us, std::memory_order_relaxed);
+    tcp_snd_cwnd_.store(info.snd_cwnd, std::memory_order_relaxed);
+    tcp_unacked_.store(info.unacked, std::memory_order_relaxed);
+    tcp_lost_.store(info.lost, std::memory_order_relaxed);
+    tcp_total_retrans_.store(info.total_retrans, std::memory_order_relaxed);
+    tcp_info_at_ns_.store(steady_now_ns(), std::memory_order_relaxed);
+    tcp_info_seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  void Conn::cancel_tcp_info_sample_() {
+    if (tcp_info_timer_id_ == 0) { return; }
+
+    if (event_poll_ && event_poll_->timer_manager()) {
+      event_poll_->timer_manager()->cancel_timer(tcp_info_timer_id_);
+    }
+    tcp_info_timer_id_ = 0;
+  }
+
+  void Conn::note_io_(bool is_read, int n) {
+    single_writer_add(is_read ? read_calls_ : write_calls_, 1);
+    if (n > 0) {
+      CXP_TRACE_INSTANT(is_read ? "recv" : "send", n);
+      single_writer_add(is_read ? bytes_in_ : bytes_out_, static_cast<uint64_t>(n));
+      event_poll_->note_conn_io_(is_read, static_cast<uint64_t>(n));
+      return;
+    }
+
+    if (n < 0 && Platform::get_last_error() == EAGAIN) { single_writer_add(eagain_, 1); }
+  }
+
+  void Conn::note_high_watermark_(bool above) {
+    int64_t since = above_high_watermark_since_ns_.load(std::memory_order_relaxed);
+    if (above) {
+      if (since == 0) { above_high_watermark_since_ns_.store(steady_now_ns(), std::memory_order_relaxed); }
+      return;
+    }
+
+    if (since == 0) { return; }
+
+    int64_t now = steady_now_ns();
+    if (now > since) { single_writer_add(above_high_watermark_ns_, static_cast<uint64_t>(now - since)); }
+    above_high_watermark_since_ns_.store(0, std::memory_order_relaxed);
+  }
+
   std::string Conn::state_string() {
     switch (get_state_()) {
     case State::kDisconnected:
@@ -321,6 +509,7 @@ namespace cxpnet {
     }
 
     cleanup_done_.store(false, std::memory_order_release);
+    add_load_();
 
     if (!read_buffer_) {
       read_buffer_ = std::make_unique<Buffer>();
@@ -336,6 +525,7 @@ namespace cxpnet {
     channel_->add_read_event();
     channel_->tie(shared_from_this());
     set_state_(State::kConnected);
+    established_at_ns_.store(steady_now_ns(), std::memory_order_relaxed);
   }
 
   void Conn::handle_read_event_() {
@@ -351,12 +541,17 @@ namespace cxpnet {
       }
 
       int read_n = ::recv(handle_, read_buffer_->to_write(), read_buffer_->writable_size(), 0);
+      note_io_(true, read_n);
       if (read_n > 0) {
         read_buffer_->been_written(read_n);
         has_new_data = true;
         continue;
       }
 
+      if (has_new_data && sock_options_.quickack) {
+        Platform::rearm_quickack(handle_);
+      }
+
       // 对端关闭
       if (read_n == 0) {
         should_close = true;
@@ -379,7 +574,8 @@ namespace cxpnet {
     }
 
     if (has_new_data && on_message_func_ != nullptr) {
-      on_message_func_(read_buffer_.get());
+      event_poll_->run_user_callback_(CallbackKind::kMessage, this,
+                                      [this]() { on_message_func_(read_buffer_.get()); });
     }
 
     if (should_close) {
@@ -393,12 +589,14 @@ namespace cxpnet {
     while (write_buffer_->readable_size() > 0) {
       size_t size   = write_buffer_->readable_size();
       int    send_n = ::send(handle_, write_buffer_->peek(), size, 0);
+      note_io_(false, send_n);
       if (send_n > 0) {
         write_buffer_->been_read(send_n);
 
         if (high_watermark_warning_ && write_buffer_->readable_size() <= low_watermark_) {
-          if (watermark_func_ != nullptr) { watermark_func_(low_watermark_); }
           high_watermark_warning_ = false;
+          note_high_watermark_(false);
+          if (watermark_func_ != nullptr) { watermark_func_(low_watermark_); }
         }
         continue;
       }
@@ -433,8 +631,6 @@ namespace cxpnet {
       return;
     }
 
-    static constexpr size_t kDirectWriteBudget = 64 * 1024;
-
     if (write_buffer_->readable_size() > 0) {
       write_buffer_->append(data, size);
       channel_->add_write_event();
@@ -445,6 +641,7 @@ namespace cxpnet {
       while (sent_bytes < direct_write_goal) {
         size_t attempt_size = direct_write_goal - sent_bytes;
         int    send_n       = ::send(handle_, data + sent_bytes, attempt_size, 0);
+        note_io_(false, send_n);
         if (send_n > 0) {
           sent_bytes += static_cast<size_t>(send_n);
           continue;
@@ -467,9 +664,88 @@ namespace cxpnet {
       }
     }
 
+    note_write_buffer_();
+  }
+
+  void Conn::sendv_in_poll_thread_(const std::string_view* parts, size_t count) {
+    ENSURE(event_poll_->is_in_poll_thread(), "Must in IO thread");
+
+    if (get_state_() != State::kConnected || write_buffer_ == nullptr || channel_ == nullptr) {
+      return;
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) { total += parts[i].size(); }
+    if (total == 0) { return; }
+
+    // 已有待发数据时必须排在后面，直接追加
+    size_t sent_bytes = 0;
+    if (write_buffer_->readable_size() == 0) {
+      static constexpr size_t kMaxIov = 16;
+
+      size_t direct_write_goal = (std::min)(total, kDirectWriteBudget);
+      while (sent_bytes < direct_write_goal) {
+        // 跳过已经写出的部分，从第一段未写完的数据开始组 iovec
+        struct iovec iov[kMaxIov];
+        size_t       iov_count = 0;
+        size_t       skip      = sent_bytes;
+        for (size_t i = 0; i < count && iov_count < kMaxIov; ++i) {
+          if (skip >= parts[i].size()) {
+            skip -= parts[i].size();
+            continue;
+          }
+          iov[iov_count].iov_base = const_cast<char*>(parts[i].data() + skip);
+          iov[iov_count].iov_len  = parts[i].size() - skip;
+          ++iov_count;
+          skip = 0;
+        }
+
+        ssize_t send_n = ::writev(handle_, iov, static_cast<int>(iov_count));
+        note_io_(false, static_cast<int>(send_n));
+        if (send_n > 0) {
+          sent_bytes += static_cast<size_t>(send_n);
+          continue;
+        }
+
+        if (send_n == 0) { break; }
+
+        int         err    = Platform::get_last_error();
+        ErrorAction action = Platform::handle_error_action(err);
+        if (action == ErrorAction::kBreak) { break; }
+        if (action == ErrorAction::kContinue) { continue; }
+
+        handle_close_event_(err);
+        return;
+      }
+    }
+
+    if (sent_bytes < total) {
+      write_buffer_->ensure_writable_size(total - sent_bytes);
+      size_t skip = sent_bytes;
+      for (size_t i = 0; i < count; ++i) {
+        if (skip >= parts[i].size()) {
+          skip -= parts[i].size();
+          continue;
+        }
+        write_buffer_->append(parts[i].data() + skip, parts[i].size() - skip);
+        skip = 0;
+      }
+      channel_->add_write_event();
+    }
+
+    note_write_buffer_();
+  }
+
+  void Conn::note_write_buffer_() {
+    uint64_t pending = write_buffer_->readable_size();
+    if (pending > peak_write_buffer_.load(std::memory_order_relaxed)) {
+      peak_write_buffer_.store(pending, std::memory_order_relaxed);
+    }
+
     if (!high_watermark_warning_ && write_buffer_->readable_size() > high_watermark_) {
-      if (watermark_func_ != nullptr) { watermark_func_(high_watermark_); }
       high_watermark_warning_ = true;
+      note_high_watermark_(true);
+      if (watermark_func_ != nullptr) { watermark_func_(high_watermark_); }
     }
   }
 } // namespace cxpnet
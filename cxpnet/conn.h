@@ -2,19 +2,41 @@
 #define CONN_H
 
 #include "buffer.h"
+#include "poll_stats.h"
 #include "sock.h"
 #include "timer.h"
+#include "trace.h"
 
 #include <atomic>
+#include <chrono>
 #include <cstring>
+#include <initializer_list>
 #include <memory>
 #include <string_view>
 
 namespace cxpnet {
   class IOEventPoll;
   class Server;
+  class MetricsEndpoint;
   class Channel;
 
+  // 连接统计快照
+  struct ConnStats {
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    uint64_t  bytes_in                = 0;
+    uint64_t  bytes_out               = 0;
+    uint64_t  read_calls              = 0; // recv 调用次数
+    uint64_t  write_calls             = 0; // send 调用次数
+    uint64_t  eagain                  = 0; // recv / send 返回 EAGAIN 的次数
+    uint64_t  peak_write_buffer       = 0; // write_buffer_ 最大积压字节数
+    uint64_t  above_high_watermark_ns = 0; // write_buffer_ 处于高水位之上的累计时间，含当前这一段
+    TimePoint created_at {};               // accept 到连接或调用 connect 的时间
+    TimePoint established_at {};           // 连接建立的时间，未建立时为空
+    TcpInfo   tcp_info;                    // 最近一次 TCP_INFO 采样，未开启采样时为空
+    TimePoint tcp_info_at {};              // 最近一次采样的时间
+  };
+
   // 连接管理
   // 对齐 iocpnet 的 IOCPConn 接口
   // 合并了 Connector 的功能，支持客户端主动连接
@@ -46,11 +68,29 @@ namespace cxpnet {
     }
 
     void set_close_timeout(uint32_t ms) { close_timeout_ms_ = ms; }
+    // 在 connect / connect_sync 之前调用，握手前应用到主动连接的 socket
+    void set_sock_options(const SockOptions& sock_options) { sock_options_ = sock_options; }
+    // 在 connect 之前调用，连接建立后首先发送的数据
+    // 异步 connect 且 SockOptions::fastopen 开启、有 cookie 时随 SYN 发出，否则在握手完成后、on_connected 之前发送
+    void set_connect_payload(std::string_view payload) { connect_payload_.assign(payload.data(), payload.size()); }
 
     void send(const char* msg, size_t size);
     void send(std::string_view msg);
-
-    std::string state_string();
+    // 多段数据按顺序发送，poll 线程上用一次 writev 写出，不需要先拼接成一个字符串
+    void sendv(const std::string_view* parts, size_t count);
+    void sendv(std::initializer_list<std::string_view> parts) { sendv(parts.begin(), parts.size()); }
+
+    std::string  state_string();
+    IOEventPoll* event_poll() const { return event_poll_; }
+    // poll 线程上使用，连接建立之前为空
+    Buffer*      read_buffer() const { return read_buffer_.get(); }
+
+    // 任意线程可调用，不加锁，计数和 TCP_INFO 采样只由 poll 线程写入
+    ConnStats stats() const;
+    // 每隔 interval_ms 在 poll 线程采样一次 TCP_INFO 写入 stats()，0 表示关闭
+    // NOT thread-safe！
+    // Only invoke this function in OnConnectionCallback
+    void set_tcp_info_sample_interval(uint32_t interval_ms);
 
     // NOT thread-safe！
     // Only invoke this function in OnConnectionCallback
@@ -74,17 +114,25 @@ namespace cxpnet {
     void set_watermark_callback(std::function<void(int)> watermark_func) {
       if (watermark_func) { watermark_func_ = std::move(watermark_func); }
     }
+    // 只在 poll 线程调用；水位回调执行时已经是越过之后的状态
+    bool above_high_watermark() const { return high_watermark_warning_; }
   private:
     friend class cxpnet::IOEventPoll;
     friend class cxpnet::Server;
+    friend class cxpnet::MetricsEndpoint;
 
     void start_();
     void handle_read_event_();
     void handle_write_event_();
     void handle_close_event_(int err);
     void send_in_poll_thread_(const char* data, size_t size);
+    void sendv_in_poll_thread_(const std::string_view* parts, size_t count);
+    void note_write_buffer_();
 
-    void  set_state_(State s) { state_.store(static_cast<int>(s), std::memory_order_release); }
+    void  set_state_(State s) {
+      CXP_TRACE_INSTANT(state_name_(s), handle_);
+      state_.store(static_cast<int>(s), std::memory_order_release);
+    }
     State get_state_() const { return static_cast<State>(state_.load(std::memory_order_acquire)); }
     void  set_internal_close_callback_(Closure&& close_callback) { internal_close_callback_ = std::move(close_callback); }
     void  set_remote_addr_(const char* addr, uint16_t port) {
@@ -92,6 +140,20 @@ namespace cxpnet {
       port_ = port;
     }
 
+    static const char* state_name_(State s) {
+      switch (s) {
+      case State::kDisconnected:
+        return "conn_disconnected";
+      case State::kConnecting:
+        return "conn_connecting";
+      case State::kConnected:
+        return "conn_connected";
+      case State::kDisconnecting:
+        return "conn_disconnecting";
+      }
+      return "conn_unknown";
+    }
+
     // 关闭流程
     void shutdown_in_poll_();
     void cleanup_(int err);
@@ -99,9 +161,23 @@ namespace cxpnet {
     void start_close_timeout_();
     void cancel_close_timeout_();
 
+    // 计入 event_poll_ 的连接负载，供 PollThreadPool 选择 poll
+    void add_load_();
+    void remove_load_();
+
     void start_connect_in_poll_(const char* addr, uint16_t port);
-    void handle_connect_event_();
+    void handle_connect_event_(int reported_err = 0); // reported_err 为 Channel 已经取走的 SO_ERROR
+    void flush_connect_payload_();
+
+    void note_io_(bool is_read, int n);
+    void note_high_watermark_(bool above);
+    void schedule_tcp_info_sample_();
+    void cancel_tcp_info_sample_();
+    void publish_tcp_info_(const TcpInfo& info);
   private:
+    // 写缓冲为空时直接写 socket 的上限，超出部分进入写缓冲等待可写事件
+    static constexpr size_t kDirectWriteBudget = 64 * 1024;
+
     IOEventPoll*                 event_poll_;
     int                          handle_;
     std::unique_ptr<Channel>     channel_;
@@ -117,6 +193,32 @@ namespace cxpnet {
     std::atomic<int>             state_;
     std::unique_ptr<Buffer>      read_buffer_;
     std::unique_ptr<Buffer>      write_buffer_;
+    SockOptions                  sock_options_;
+    std::string                  connect_payload_;
+    bool                         load_counted_ = false;
+
+    // 统计，只由 poll 线程写入
+    std::atomic<uint64_t>                 bytes_in_ {0};
+    std::atomic<uint64_t>                 bytes_out_ {0};
+    std::atomic<uint64_t>                 read_calls_ {0};
+    std::atomic<uint64_t>                 write_calls_ {0};
+    std::atomic<uint64_t>                 eagain_ {0};
+    std::atomic<uint64_t>                 peak_write_buffer_ {0};
+    std::atomic<uint64_t>                 above_high_watermark_ns_ {0};
+    std::atomic<int64_t>                  above_high_watermark_since_ns_ {0}; // 0 表示当前不在高水位之上
+    std::atomic<int64_t>                  created_at_ns_ {0};
+    std::atomic<int64_t>                  established_at_ns_ {0};
+    uint32_t                              tcp_info_interval_ms_ = 0;
+    Timer::TimerID                        tcp_info_timer_id_    = 0;
+    // TCP_INFO 采样用 seqlock 发布：写入时 tcp_info_seq_ 为奇数，读者看到奇数或前后不一致时重读
+    std::atomic<uint32_t>                 tcp_info_seq_ {0};
+    std::atomic<uint32_t>                 tcp_rtt_us_ {0};
+    std::atomic<uint32_t>                 tcp_rttvar_us_ {0};
+    std::atomic<uint32_t>                 tcp_snd_cwnd_ {0};
+    std::atomic<uint32_t>                 tcp_unacked_ {0};
+    std::atomic<uint32_t>                 tcp_lost_ {0};
+    std::atomic<uint64_t>                 tcp_total_retrans_ {0};
+    std::atomic<int64_t>                  tcp_info_at_ns_ {0};
 
     uint32_t          close_timeout_ms_ = 30000; // 默认 30 秒
     Timer::TimerID    close_timer_id_   = 0;
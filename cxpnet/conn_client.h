@@ -0,0 +1,52 @@
+﻿#ifndef CONN_CLIENT_H
+#define CONN_CLIENT_H
+
+#include "conn.h"
+
+#include <cerrno>
+#include <memory>
+
+namespace cxpnet {
+  // 单连接客户端 (RespClient、RpcClient) 的共享状态基类
+  // 状态对象由客户端和 Conn 回调共同持有，只持有 Conn 的 weak_ptr，不形成环
+  // Derived 提供 on_message(Buffer*) 和 fail_pending_(int err)，后者让所有未完成的请求以 err 失败，
+  // 实现时先把请求取出再回调，回调中可能再发请求
+  template <typename Derived>
+  struct ConnClientState : std::enable_shared_from_this<Derived> {
+    std::weak_ptr<Conn> conn;
+    bool                closed = false; // 连接已关闭，之后的请求立即失败
+
+    // 接管 c 的消息和关闭回调，对端关闭时未完成的请求以关闭原因失败
+    static void bind(const ConnPtr& c, const std::shared_ptr<Derived>& state) {
+      state->conn = c;
+      std::weak_ptr<Derived> weak = state;
+      c->set_conn_user_callbacks(
+          [weak](Buffer* buffer) {
+            if (auto self = weak.lock()) { self->on_message(buffer); }
+          },
+          [weak](int err) {
+            if (auto self = weak.lock()) { self->fail_all(err != 0 ? err : ECONNRESET); }
+          });
+    }
+
+    void fail_all(int err) {
+      closed = true;
+      static_cast<Derived*>(this)->fail_pending_(err);
+    }
+
+    // 收到非法数据：未完成的请求以 EPROTO 失败并关闭连接
+    void fail_protocol() {
+      fail_all(EPROTO);
+      if (auto c = conn.lock()) { c->close(); }
+    }
+
+    // 客户端主动关闭，poll 线程上调用，未完成的请求以 ECANCELED 失败
+    void close() {
+      if (closed) { return; }
+      fail_all(ECANCELED);
+      if (auto c = conn.lock()) { c->close(); }
+    }
+  };
+} // namespace cxpnet
+
+#endif // CONN_CLIENT_H
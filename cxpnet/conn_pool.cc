@@ -0,0 +1,389 @@
+﻿#include "conn_pool.h"
+#include "conn.h"
+#include "ensure.h"
+#include "io_event_poll.h"
+#include "timer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+
+namespace cxpnet {
+  // 一条已建立的连接，Lease 持有它计数在途请求，连接重建后旧的 Link 随最后一个 Lease 释放
+  struct ConnPool::Link {
+    explicit Link(ConnPtr c)
+        : conn(std::move(c)) { }
+
+    ConnPtr             conn;
+    std::atomic<size_t> outstanding {0};
+  };
+
+  struct ConnPool::Shared {
+    std::string       host;
+    uint16_t          port = 0;
+    ConnPoolOptions   options;
+    ConnPoolCallbacks callbacks;
+    std::atomic<bool> closed {false};
+
+    std::mutex mutex; // 保护各 Slot 的 link
+
+    std::atomic<uint64_t> connects {0};
+    std::atomic<uint64_t> connect_failures {0};
+    std::atomic<uint64_t> disconnects {0};
+    std::atomic<uint64_t> health_failures {0};
+  };
+
+  // 连接池中的一个位置，除 link 外只在所属 poll 线程上访问
+  struct ConnPool::Slot : public std::enable_shared_from_this<Slot> {
+    Slot(std::shared_ptr<Shared> s, IOEventPoll* p, uint64_t seed)
+        : shared(std::move(s))
+        , poll(p)
+        , rand_state(seed | 1) { }
+
+    void connect_();
+    void on_connected_(const ConnPtr& c);
+    void on_connect_error_(Conn* raw, int err);
+    void on_closed_(Conn* raw, int err);
+    void schedule_retry_();
+    void schedule_health_check_();
+    void run_health_check_();
+    void set_link_(std::shared_ptr<Link> l);
+    void stop_();
+
+    std::shared_ptr<Shared> shared;
+    IOEventPoll*            poll;
+    ConnPtr                 conn;           // 正在连接或已建立的连接
+    std::shared_ptr<Link>   link;           // 已建立时非空，shared->mutex 保护
+    uint32_t                failures = 0;   // 连续失败次数，决定退避时间
+    uint64_t                generation = 0; // 每条连接加一，丢弃过期的健康检查结果
+    bool                    health_pending = false;
+    Timer::TimerID          retry_timer_id  = 0;
+    Timer::TimerID          health_timer_id = 0;
+    uint64_t                rand_state;
+  };
+
+  void ConnPool::Slot::connect_() {
+    if (shared->closed.load(std::memory_order_acquire)) { return; }
+
+    conn = std::make_shared<Conn>(poll);
+    conn->set_sock_options(shared->options.sock_options);
+
+    std::weak_ptr<Slot> weak = shared_from_this();
+    Conn*               raw  = conn.get();
+    conn->set_conn_user_callbacks(
+        // 连接池析构后，其他 poll 上的 stop_() 执行之前仍可能收到消息，不再交给用户
+        [s = shared, raw](Buffer* buffer) {
+          if (s->closed.load(std::memory_order_acquire)) { return; }
+          if (s->callbacks.on_message) { s->callbacks.on_message(raw, buffer); }
+        },
+        [weak, raw](int err) {
+          if (auto self = weak.lock()) { self->on_closed_(raw, err); }
+        });
+
+    IOEventPoll* event_poll = poll;
+    conn->connect(
+        shared->host.c_str(), shared->port,
+        [weak](ConnPtr c) {
+          if (auto self = weak.lock()) { self->on_connected_(c); }
+        },
+        [weak, raw, event_poll](int err) {
+          // 可能在 connect 内同步回调，推迟到下一轮处理
+          event_poll->run_later([weak, raw, err]() {
+            if (auto self = weak.lock()) { self->on_connect_error_(raw, err); }
+          });
+        });
+  }
+
+  void ConnPool::Slot::on_connected_(const ConnPtr& c) {
+    if (c != conn) { return; }
+    if (shared->closed.load(std::memory_order_acquire)) {
+      stop_();
+      return;
+    }
+
+    failures = 0;
+    ++generation;
+    shared->connects.fetch_add(1, std::memory_order_relaxed);
+    if (shared->callbacks.on_connected) { shared->callbacks.on_connected(c); }
+    // on_connected 中可能已经关闭了连接
+    if (c != conn || !c->connected()) { return; }
+
+    set_link_(std::make_shared<Link>(c));
+    schedule_health_check_();
+  }
+
+  void ConnPool::Slot::on_connect_error_(Conn* raw, int) {
+    if (raw != conn.get()) { return; }
+
+    shared->connect_failures.fetch_add(1, std::memory_order_relaxed);
+    poll->run_later([c = std::move(conn)]() {});
+    schedule_retry_();
+  }
+
+  void ConnPool::Slot::on_closed_(Conn* raw, int err) {
+    if (raw != conn.get()) { return; }
+
+    ConnPtr c = std::move(conn);
+    set_link_(nullptr);
+    health_pending = false;
+    if (health_timer_id != 0) {
+      poll->timer_manager()->cancel_timer(health_timer_id);
+      health_timer_id = 0;
+    }
+
+    shared->disconnects.fetch_add(1, std::memory_order_relaxed);
+    if (shared->callbacks.on_close && !shared->closed.load(std::memory_order_acquire)) {
+      shared->callbacks.on_close(c, err);
+    }
+    // 正处于该连接自己的关闭回调中，推迟到下一轮再释放
+    poll->run_later([c]() {});
+    schedule_retry_();
+  }
+
+  void ConnPool::Slot::schedule_retry_() {
+    if (shared->closed.load(std::memory_order_acquire) || retry_timer_id != 0) { return; }
+
+    // 等待 initial * 2^(failures - 1)，不超过上限，再取 [delay / 2, delay] 的随机值，避免所有连接同时重连
+    ++failures;
+    const ConnPoolOptions& options = shared->options;
+    uint64_t delay = static_cast<uint64_t>(options.backoff_initial_ms) << (std::min)(failures - 1, 20u);
+    delay          = (std::min)(delay, static_cast<uint64_t>(options.backoff_max_ms));
+
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 7;
+    rand_state ^= rand_state << 17;
+    delay = delay / 2 + rand_state % (delay / 2 + 1);
+
+    std::weak_ptr<Slot> weak = shared_from_this();
+    retry_timer_id           = poll->timer_manager()->add_timer(static_cast<uint32_t>(delay), [weak]() {
+      auto self = weak.lock();
+      if (!self) { return; }
+
+      self->poll->run_in_poll([self]() {
+        self->retry_timer_id = 0;
+        self->connect_();
+      });
+    });
+  }
+
+  void ConnPool::Slot::schedule_health_check_() {
+    uint32_t interval = shared->options.health_check_interval_ms;
+    if (interval == 0 || !shared->callbacks.health_check || health_timer_id != 0) { return; }
+
+    std::weak_ptr<Slot> weak = shared_from_this();
+    health_timer_id          = poll->timer_manager()->add_timer(interval, [weak]() {
+      auto self = weak.lock();
+      if (!self) { return; }
+
+      self->poll->run_in_poll([self]() {
+        self->health_timer_id = 0;
+        self->run_health_check_();
+      });
+    });
+  }
+
+  void ConnPool::Slot::run_health_check_() {
+    if (shared->closed.load(std::memory_order_acquire) || !conn || !conn->connected()) { return; }
+
+    // 上一次探测到现在还没有结果
+    if (health_pending) {
+      shared->health_failures.fetch_add(1, std::memory_order_relaxed);
+      conn->close();
+      return;
+    }
+
+    health_pending = true;
+    schedule_health_check_();
+
+    std::weak_ptr<Slot> weak = shared_from_this();
+    shared->callbacks.health_check(conn, [weak, generation = generation](bool healthy) {
+      auto self = weak.lock();
+      if (!self || self->generation != generation || !self->health_pending) { return; }
+
+      self->health_pending = false;
+      if (!healthy && self->conn) {
+        self->shared->health_failures.fetch_add(1, std::memory_order_relaxed);
+        self->conn->close();
+      }
+    });
+  }
+
+  void ConnPool::Slot::set_link_(std::shared_ptr<Link> l) {
+    std::lock_guard<std::mutex> lock(shared->mutex);
+    link.swap(l);
+  }
+
+  void ConnPool::Slot::stop_() {
+    TimerManager* timer_manager = poll->timer_manager();
+    if (retry_timer_id != 0) { timer_manager->cancel_timer(retry_timer_id); }
+    if (health_timer_id != 0) { timer_manager->cancel_timer(health_timer_id); }
+    retry_timer_id  = 0;
+    health_timer_id = 0;
+
+    set_link_(nullptr);
+    // 先置空，关闭回调中的身份检查不再匹配，不会触发重连
+    if (ConnPtr c = std::move(conn)) {
+      c->close();
+      poll->run_later([c]() {});
+    }
+  }
+
+  ConnPool::Lease& ConnPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+      release();
+      link_ = std::move(other.link_);
+    }
+    return *this;
+  }
+
+  const ConnPtr& ConnPool::Lease::conn() const {
+    static const ConnPtr empty;
+    return link_ ? link_->conn : empty;
+  }
+
+  void ConnPool::Lease::release() {
+    if (!link_) { return; }
+    link_->outstanding.fetch_sub(1, std::memory_order_relaxed);
+    link_.reset();
+  }
+
+  ConnPool::ConnPool(std::vector<IOEventPoll*> polls, std::string host, uint16_t port, ConnPoolOptions options,
+                     ConnPoolCallbacks callbacks)
+      : shared_(std::make_shared<Shared>()) {
+    ENSURE(!polls.empty(), "ConnPool needs at least one poll");
+
+    shared_->host      = std::move(host);
+    shared_->port      = port;
+    shared_->options   = std::move(options);
+    shared_->callbacks = std::move(callbacks);
+
+    size_t size = (std::max)(shared_->options.size, size_t(1));
+    slots_.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+      uint64_t seed = reinterpret_cast<uintptr_t>(this) + i * 0x9E3779B97F4A7C15ull;
+      slots_.push_back(std::make_shared<Slot>(shared_, polls[i % polls.size()], seed));
+    }
+  }
+
+  // 析构时等待其他 poll 执行 stop_()，claimed 保证每个 Slot 只由 poll 线程或析构线程中的一方执行
+  struct ConnPool::StopWait {
+    std::mutex              mutex;
+    std::condition_variable cv;
+    std::vector<bool>       claimed;
+    size_t                  pending = 0;
+
+    bool claim(size_t index) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (claimed[index]) { return false; }
+      claimed[index] = true;
+      return true;
+    }
+
+    void finish() {
+      std::lock_guard<std::mutex> lock(mutex);
+      --pending;
+      cv.notify_all();
+    }
+  };
+
+  ConnPool::~ConnPool() {
+    shared_->closed.store(true, std::memory_order_release);
+
+    // 其他 poll 线程可能刚通过 closed 检查、正在执行用户回调，等它们各自执行完 stop_() 再返回
+    // 已经停止的 poll 不再分发回调，不等待；在 poll 线程上析构时也不等待，两个 poll 互相等待会死锁
+    bool                               on_poll_thread = IOEventPoll::current() != nullptr;
+    std::vector<std::shared_ptr<Slot>> remote;
+    for (auto& slot : slots_) {
+      slot->set_link_(nullptr);
+      if (slot->poll->is_in_poll_thread()) {
+        slot->stop_();
+      } else if (on_poll_thread || slot->poll->is_shutdown()) {
+        slot->poll->run_in_poll([slot]() { slot->stop_(); });
+      } else {
+        remote.push_back(slot);
+      }
+    }
+    if (remote.empty()) { return; }
+
+    // 任务可能留在不再执行的 poll 队列里，wait 由任务共同持有
+    auto wait     = std::make_shared<StopWait>();
+    wait->claimed = std::vector<bool>(remote.size(), false);
+    wait->pending = remote.size();
+    for (size_t i = 0; i < remote.size(); ++i) {
+      remote[i]->poll->run_in_poll([slot = remote[i], wait, i]() {
+        if (!wait->claim(i)) { return; }
+        slot->stop_();
+        wait->finish();
+      });
+    }
+
+    // poll 在执行任务前停止 (检查 is_shutdown 之后、任务入队之前) 或从未运行时，任务不会再执行，
+    // 由析构线程自己执行 stop_()
+    constexpr auto               kRecheckInterval = std::chrono::milliseconds(10);
+    std::unique_lock<std::mutex> lock(wait->mutex);
+    while (wait->pending > 0) {
+      wait->cv.wait_for(lock, kRecheckInterval);
+      for (size_t i = 0; i < remote.size(); ++i) {
+        IOEventPoll* poll = remote[i]->poll;
+        if (wait->claimed[i] || (!poll->is_shutdown() && poll->has_run())) { continue; }
+
+        wait->claimed[i] = true;
+        lock.unlock();
+        remote[i]->stop_();
+        lock.lock();
+        --wait->pending;
+      }
+    }
+  }
+
+  void ConnPool::start() {
+    if (started_) { return; }
+    started_ = true;
+
+    for (auto& slot : slots_) {
+      if (slot->poll->is_in_poll_thread()) {
+        slot->connect_();
+      } else {
+        slot->poll->run_in_poll([slot]() { slot->connect_(); });
+      }
+    }
+  }
+
+  ConnPool::Lease ConnPool::acquire() {
+    std::shared_ptr<Link> best;
+    size_t                best_outstanding = 0;
+    bool                  best_local       = false;
+
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    for (auto& slot : slots_) {
+      const auto& link = slot->link;
+      if (!link || !link->conn->connected()) { continue; }
+
+      size_t outstanding = link->outstanding.load(std::memory_order_relaxed);
+      bool   local       = slot->poll->is_in_poll_thread();
+      if (!best || outstanding < best_outstanding || (outstanding == best_outstanding && local && !best_local)) {
+        best             = link;
+        best_outstanding = outstanding;
+        best_local       = local;
+      }
+    }
+
+    if (!best) { return Lease(); }
+    best->outstanding.fetch_add(1, std::memory_order_relaxed);
+    return Lease(std::move(best));
+  }
+
+  ConnPoolStats ConnPool::stats() const {
+    ConnPoolStats stats;
+    stats.connects         = shared_->connects.load(std::memory_order_relaxed);
+    stats.connect_failures = shared_->connect_failures.load(std::memory_order_relaxed);
+    stats.disconnects      = shared_->disconnects.load(std::memory_order_relaxed);
+    stats.health_failures  = shared_->health_failures.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    for (const auto& slot : slots_) {
+      if (slot->link && slot->link->conn->connected()) { ++stats.ready; }
+    }
+    return stats;
+  }
+} // namespace cxpnet
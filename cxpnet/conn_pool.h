@@ -0,0 +1,91 @@
+﻿#ifndef CONN_POOL_H
+#define CONN_POOL_H
+
+#include "sock.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cxpnet {
+  class Buffer;
+  class Conn;
+  class IOEventPoll;
+
+  struct ConnPoolOptions {
+    size_t      size                     = 8;     // 预热的连接数，轮流分布在各 poll 上
+    uint32_t    backoff_initial_ms       = 100;   // 连接失败或断开后第一次重连的等待
+    uint32_t    backoff_max_ms           = 10000; // 连续失败时等待翻倍，直到这个上限
+    uint32_t    health_check_interval_ms = 0;     // 0 表示不做健康检查
+    SockOptions sock_options {.tcp_nodelay = true};
+  };
+
+  // 回调都在连接所在的 poll 线程上执行
+  struct ConnPoolCallbacks {
+    std::function<void(const ConnPtr&)>      on_connected; // 每次连接 (重新) 建立，可在这里发握手数据
+    std::function<void(Conn*, Buffer*)>      on_message;
+    std::function<void(const ConnPtr&, int)> on_close; // 之后连接池会按退避重连
+    // 周期性探测：发出探测，在 poll 线程上调用 done(true / false)
+    // 下一次检查时还没有结果也视为失败，连接被关闭重建
+    std::function<void(const ConnPtr&, std::function<void(bool)> done)> health_check;
+  };
+
+  struct ConnPoolStats {
+    uint64_t connects         = 0; // 成功建立的连接数，含重连
+    uint64_t connect_failures = 0;
+    uint64_t disconnects      = 0; // 已建立的连接被关闭
+    uint64_t health_failures  = 0; // 健康检查失败或超时后主动关闭的连接
+    size_t   ready            = 0; // 当前可用的连接数
+  };
+
+  // 到一个后端的常驻连接池
+  // 连接失败或断开后由所在 poll 的定时器按指数退避 (带抖动) 重连，不阻塞调用方
+  // acquire() 选在途请求最少的可用连接，相同时优先调用线程所在的 poll
+  class ConnPool : public NonCopyable {
+    struct Link;
+    struct Slot;
+    struct Shared;
+    struct StopWait;
+  public:
+    // 持有期间计为连接上的一个在途请求，析构或 release() 时归还
+    class Lease {
+    public:
+      Lease() = default;
+      Lease(Lease&& other) noexcept = default;
+      Lease& operator=(Lease&& other) noexcept;
+      ~Lease() { release(); }
+
+      explicit operator bool() const { return link_ != nullptr; }
+      const ConnPtr& conn() const;
+      Conn*          operator->() const { return conn().get(); }
+      void           release();
+    private:
+      friend class ConnPool;
+      explicit Lease(std::shared_ptr<Link> link)
+          : link_(std::move(link)) { }
+
+      std::shared_ptr<Link> link_;
+    };
+
+    // polls 需要比连接池活得久，并且在 start() 之后有线程运行；host 需要是 IP 地址
+    ConnPool(std::vector<IOEventPoll*> polls, std::string host, uint16_t port, ConnPoolOptions options = {},
+             ConnPoolCallbacks callbacks = {});
+    // 关闭所有连接，取消重连和健康检查；返回后不会再发起新的用户回调
+    // 不在 poll 线程上析构时阻塞到各 poll 完成清理，返回后也不会有用户回调在执行；poll 在清理前停止或从未运行时由析构线程清理
+    // 在 poll 线程上析构时只向其他 poll 投递清理、不等待，其他 poll 上已经开始的回调可能仍在执行
+    ~ConnPool();
+
+    void start();
+    // 任意线程可调用，没有可用连接时返回空 Lease
+    Lease acquire();
+    // 任意线程可调用
+    ConnPoolStats stats() const;
+  private:
+    std::shared_ptr<Shared>            shared_;
+    std::vector<std::shared_ptr<Slot>> slots_;
+    bool                               started_ = false;
+  };
+} // namespace cxpnet
+
+#endif // CONN_POOL_H
@@ -0,0 +1,298 @@
+﻿#include "coro.h"
+
+#include <cerrno>
+#include <exception>
+#include <iostream>
+#include <new>
+
+namespace cxpnet {
+  namespace coro_detail {
+    namespace {
+      // 按 64 字节分级缓存释放的帧，超过 kMaxPooledSize 的帧直接走全局 new / delete
+      constexpr size_t   kGranularity   = 64;
+      constexpr size_t   kMaxPooledSize = 1024;
+      constexpr size_t   kClasses       = kMaxPooledSize / kGranularity;
+      constexpr uint32_t kMaxPerClass   = 64;
+
+      struct FreeFrame {
+        FreeFrame* next;
+      };
+
+      struct FramePool {
+        FreeFrame* heads[kClasses]  = {};
+        uint32_t   counts[kClasses] = {};
+        bool       destroyed        = false; // 线程退出后释放的帧直接归还全局堆
+
+        ~FramePool() {
+          destroyed = true;
+          for (FreeFrame*& head : heads) {
+            while (head != nullptr) {
+              FreeFrame* next = head->next;
+              ::operator delete(head);
+              head = next;
+            }
+          }
+        }
+      };
+
+      thread_local FramePool frame_pool;
+
+      size_t size_class(size_t size) { return (size + kGranularity - 1) / kGranularity - 1; }
+    } // namespace
+
+    void* allocate_frame(size_t size) {
+      if (size > kMaxPooledSize) { return ::operator new(size); }
+
+      size_t     index = size_class(size);
+      FramePool& pool  = frame_pool;
+      if (FreeFrame* frame = pool.heads[index]; frame != nullptr) {
+        pool.heads[index] = frame->next;
+        --pool.counts[index];
+        return frame;
+      }
+      return ::operator new((index + 1) * kGranularity);
+    }
+
+    void free_frame(void* frame, size_t size) {
+      if (size > kMaxPooledSize) {
+        ::operator delete(frame);
+        return;
+      }
+
+      size_t     index = size_class(size);
+      FramePool& pool  = frame_pool;
+      if (pool.destroyed || pool.counts[index] >= kMaxPerClass) {
+        ::operator delete(frame);
+        return;
+      }
+      auto* free        = static_cast<FreeFrame*>(frame);
+      free->next        = pool.heads[index];
+      pool.heads[index] = free;
+      ++pool.counts[index];
+    }
+
+    // 异常从 unhandled_exception 抛出后协程停在 final suspend，没有人能再销毁它的帧
+    // 与线程函数中未捕获的异常一样，打印后终止进程
+    [[noreturn]] void report_and_terminate() noexcept {
+      try {
+        throw;
+      } catch (const std::exception& e) {
+        std::cerr << "[CXPNET] ERROR: uncaught exception in co_spawn coroutine: " << e.what() << std::endl;
+      } catch (...) {
+        std::cerr << "[CXPNET] ERROR: uncaught exception in co_spawn coroutine" << std::endl;
+      }
+      std::terminate();
+    }
+
+    // co_spawn 的顶层协程，结束时自己释放帧
+    struct Detached {
+      struct promise_type {
+        static void* operator new(size_t size) { return allocate_frame(size); }
+        static void  operator delete(void* frame, size_t size) { free_frame(frame, size); }
+
+        Detached            get_return_object() { return Detached {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        std::suspend_never  final_suspend() const noexcept { return {}; }
+        void                return_void() const noexcept { }
+        void                unhandled_exception() const noexcept { report_and_terminate(); }
+      };
+
+      std::coroutine_handle<promise_type> handle;
+    };
+
+    Detached run_detached(Task<void> task) { co_await task; }
+  } // namespace coro_detail
+
+  void co_spawn(IOEventPoll* event_poll, Task<void> task) {
+    std::coroutine_handle<> handle = coro_detail::run_detached(std::move(task)).handle;
+    event_poll->run_in_poll([handle]() { handle.resume(); });
+  }
+
+  SleepAwaiter IOEventPoll::sleep(uint32_t ms) { return SleepAwaiter(this, ms); }
+
+  void SleepAwaiter::await_suspend(std::coroutine_handle<> handle) const {
+    IOEventPoll* event_poll = event_poll_;
+    if (ms_ == 0) {
+      event_poll->run_later([handle]() { handle.resume(); });
+      return;
+    }
+    event_poll->timer_manager()->add_timer(ms_, [event_poll, handle]() {
+      event_poll->run_in_poll([handle]() { handle.resume(); });
+    });
+  }
+
+  namespace {
+    // 交换两个缓冲的内容，两者都保持有效的存储
+    void swap_buffers(Buffer& a, Buffer& b) {
+      Buffer tmp = std::move(a);
+      a          = std::move(b);
+      b          = std::move(tmp);
+    }
+  } // namespace
+
+  // 与 Conn 回调共享的状态，AsyncConn 析构后可能还会收到关闭回调
+  // 读完成时把连接的读缓冲整个换到 held，结果指向 held；结果未消费期间 Conn 读到的数据写入换进去的空缓冲，
+  // 扩容或整理都不会移动结果
+  struct AsyncConn::State {
+    Conn*                   conn     = nullptr;
+    Buffer*                 buffer   = nullptr; // 连接的读缓冲
+    Buffer                  held;               // 上一次读结果及其后已到达的数据，未读结果时为空
+    size_t                  consumed = 0;       // 上一次读返回的字节数，下一次读开始时消费
+    bool                    closed   = false;
+    int                     error    = 0;
+    ReadAwaiter*            read_op  = nullptr; // 正在等待的读
+    std::coroutine_handle<> reader;
+    std::coroutine_handle<> writer;
+
+    // 消费上一次读的结果，held 中剩余的数据放回读缓冲，排在期间新到达的数据之前
+    void consume() {
+      if (consumed == 0) { return; }
+      held.been_read(consumed);
+      consumed = 0;
+      if (held.empty()) { return; }
+
+      if (!buffer->empty()) {
+        held.append(buffer->peek(), buffer->readable_size());
+        buffer->clear();
+      }
+      swap_buffers(*buffer, held);
+    }
+
+    // 数据足够或连接已关闭时填好结果，返回 true
+    bool try_complete(ReadAwaiter& op) {
+      size_t readable = buffer != nullptr ? buffer->readable_size() : 0;
+      size_t size     = 0;
+      switch (op.kind_) {
+      case ReadAwaiter::Kind::kSome:
+        size = readable;
+        break;
+      case ReadAwaiter::Kind::kExactly:
+        size = readable >= op.size_ ? op.size_ : 0;
+        break;
+      case ReadAwaiter::Kind::kUntil:
+        if (readable >= op.delim_.size()) {
+          size_t pos = buffer->find(op.delim_);
+          if (pos != Buffer::npos) { size = pos + op.delim_.size(); }
+        }
+        if (size == 0 && readable > op.size_ + op.delim_.size()) {
+          error      = EMSGSIZE;
+          op.result_ = {};
+          return true;
+        }
+        break;
+      }
+
+      if (size > 0) {
+        swap_buffers(*buffer, held);
+        op.result_ = std::string_view(held.peek(), size);
+        consumed   = size;
+        return true;
+      }
+      if (op.kind_ == ReadAwaiter::Kind::kExactly && op.size_ == 0) {
+        op.result_ = std::string_view("", 0);
+        return true;
+      }
+      if (closed) {
+        op.result_ = {};
+        return true;
+      }
+      return false;
+    }
+
+    void on_message(Buffer* b) {
+      buffer = b;
+      if (!reader || !try_complete(*read_op)) { return; }
+      read_op = nullptr;
+      std::exchange(reader, {}).resume();
+    }
+
+    void on_close(int err) {
+      closed = true;
+      if (error == 0) { error = err; }
+      if (reader) {
+        try_complete(*read_op);
+        read_op = nullptr;
+        std::exchange(reader, {}).resume();
+      }
+      if (writer) { std::exchange(writer, {}).resume(); }
+    }
+
+    // 回调时 Conn 已经更新了水位状态，直接读取，创建 AsyncConn 时已在高水位之上也不会反转
+    void on_watermark() {
+      if (!conn->above_high_watermark() && writer) { std::exchange(writer, {}).resume(); }
+    }
+  };
+
+  AsyncConn::AsyncConn(ConnPtr conn)
+      : conn_(std::move(conn))
+      , state_(std::make_shared<State>()) {
+    ENSURE(conn_->event_poll()->is_in_poll_thread(), "AsyncConn must be created on the connection's poll thread");
+
+    State* state  = state_.get();
+    state->conn   = conn_.get();
+    state->buffer = conn_->read_buffer();
+    state->closed = !conn_->connected();
+    conn_->set_conn_user_callbacks([s = state_](Buffer* buffer) { s->on_message(buffer); },
+                                   [s = state_](int err) { s->on_close(err); });
+    conn_->set_watermark_callback([s = state_](int) { s->on_watermark(); });
+  }
+
+  AsyncConn::~AsyncConn() {
+    // 可能在该连接的回调中恢复的协程里析构，最后一个引用推迟到回调结束后释放
+    conn_->close();
+    IOEventPoll* event_poll = conn_->event_poll();
+    event_poll->run_later([conn = std::move(conn_)]() { });
+  }
+
+  bool AsyncConn::closed() const { return state_->closed; }
+  int  AsyncConn::error() const { return state_->error; }
+
+  bool AsyncConn::ReadAwaiter::await_ready() {
+    ENSURE(state_->conn->event_poll()->is_in_poll_thread(), "AsyncConn must be awaited on its poll thread");
+    ENSURE(!state_->reader, "another read is already pending on this AsyncConn");
+    state_->consume();
+    return state_->try_complete(*this);
+  }
+
+  void AsyncConn::ReadAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    state_->read_op = this;
+    state_->reader  = handle;
+  }
+
+  bool AsyncConn::WriteAwaiter::await_ready() {
+    ENSURE(state_->conn->event_poll()->is_in_poll_thread(), "AsyncConn must be awaited on its poll thread");
+    ENSURE(!state_->writer, "another write is already pending on this AsyncConn");
+    if (state_->closed) { return true; }
+    if (!data_.empty()) { state_->conn->send(data_); }
+    return state_->closed || !state_->conn->above_high_watermark();
+  }
+
+  void AsyncConn::WriteAwaiter::await_suspend(std::coroutine_handle<> handle) { state_->writer = handle; }
+
+  bool AsyncConn::WriteAwaiter::await_resume() const noexcept { return !state_->closed; }
+
+  bool AsyncConn::ConnectAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    ENSURE(event_poll_->is_in_poll_thread(), "AsyncConn::connect must be awaited on its poll thread");
+
+    handle_      = handle;
+    auto conn    = std::make_shared<Conn>(event_poll_);
+    result_.conn = conn;
+    conn->set_sock_options(options_);
+
+    // 失败可能在 connect() 内同步报告，此时不挂起，直接继续执行
+    suspending_ = true;
+    conn->connect(addr_.c_str(), port_, [this](ConnPtr) { complete_(0); }, [this](int err) { complete_(err); });
+    suspending_ = false;
+    return !done_;
+  }
+
+  void AsyncConn::ConnectAwaiter::complete_(int err) {
+    result_.err = err;
+    if (err != 0) {
+      // 在 Conn 自己的回调中，最后一个引用推迟释放
+      event_poll_->run_later([conn = std::move(result_.conn)]() { });
+    }
+    done_ = true;
+    if (!suspending_) { handle_.resume(); }
+  }
+} // namespace cxpnet
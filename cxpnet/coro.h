@@ -0,0 +1,260 @@
+﻿#ifndef CORO_H
+#define CORO_H
+
+#include "conn.h"
+#include "ensure.h"
+#include "io_event_poll.h"
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace cxpnet {
+  // C++20 协程接口
+  // Task<T> 惰性启动，被 co_await 时才开始执行，结束时对称转移回等待者，不经过任务队列
+  // AsyncConn 在连接的消息 / 关闭回调中直接恢复等待的协程；只有 sleep 到期来自定时器线程，经 run_in_poll 回到 poll
+  // 协程帧从当前线程的帧池分配，一个 poll 一个线程，即每个 poll 一个池
+
+  template <typename T = void>
+  class Task;
+
+  namespace coro_detail {
+    void* allocate_frame(size_t size);
+    void  free_frame(void* frame, size_t size);
+
+    struct FinalAwaiter {
+      bool await_ready() const noexcept { return false; }
+      template <typename Promise>
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+        std::coroutine_handle<> continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+      }
+      void await_resume() const noexcept { }
+    };
+
+    struct PromiseBase {
+      static void* operator new(size_t size) { return allocate_frame(size); }
+      static void  operator delete(void* frame, size_t size) { free_frame(frame, size); }
+
+      std::suspend_always initial_suspend() const noexcept { return {}; }
+      FinalAwaiter        final_suspend() const noexcept { return {}; }
+      // 异常保存下来，在等待者的 co_await 处重新抛出
+      void unhandled_exception() noexcept { exception = std::current_exception(); }
+      void rethrow_if_failed() const {
+        if (exception) { std::rethrow_exception(exception); }
+      }
+
+      std::coroutine_handle<> continuation;
+      std::exception_ptr      exception;
+    };
+
+    template <typename T>
+    struct Promise : PromiseBase {
+      Task<T> get_return_object();
+
+      template <typename U>
+      void return_value(U&& value) {
+        result.emplace(std::forward<U>(value));
+      }
+      T take() {
+        rethrow_if_failed();
+        return std::move(*result);
+      }
+
+      std::optional<T> result;
+    };
+
+    template <>
+    struct Promise<void> : PromiseBase {
+      Task<void> get_return_object();
+
+      void return_void() const noexcept { }
+      void take() const { rethrow_if_failed(); }
+    };
+  } // namespace coro_detail
+
+  // 协程的返回类型，只能移动；未被等待就析构时协程不会执行
+  template <typename T>
+  class Task {
+  public:
+    using promise_type = coro_detail::Promise<T>;
+    using Handle       = std::coroutine_handle<promise_type>;
+
+    struct Awaiter {
+      Handle handle;
+
+      bool                    await_ready() const noexcept { return handle.done(); }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+        handle.promise().continuation = continuation;
+        return handle;
+      }
+      T await_resume() { return handle.promise().take(); }
+    };
+
+    explicit Task(Handle handle)
+        : handle_(handle) { }
+    Task(Task&& other) noexcept
+        : handle_(std::exchange(other.handle_, {})) { }
+    Task& operator=(Task&& other) noexcept {
+      if (this != &other) {
+        if (handle_) { handle_.destroy(); }
+        handle_ = std::exchange(other.handle_, {});
+      }
+      return *this;
+    }
+    Task(const Task&)            = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+      if (handle_) { handle_.destroy(); }
+    }
+
+    Awaiter operator co_await() const {
+      ENSURE(handle_, "co_await on an empty Task");
+      return Awaiter {handle_};
+    }
+  private:
+    Handle handle_;
+  };
+
+  namespace coro_detail {
+    template <typename T>
+    Task<T> Promise<T>::get_return_object() {
+      return Task<T>(Task<T>::Handle::from_promise(*this));
+    }
+
+    inline Task<void> Promise<void>::get_return_object() { return Task<void>(Task<void>::Handle::from_promise(*this)); }
+  } // namespace coro_detail
+
+  // 在 poll 上运行一个顶层协程，结束后自动释放；在 poll 线程上调用时立即开始执行
+  // 协程中未捕获的异常打印后调用 std::terminate，与线程函数中未捕获的异常相同
+  void co_spawn(IOEventPoll* event_poll, Task<void> task);
+
+  // co_await poll.sleep(ms)；0 表示让出一次，排到 poll 任务队列的末尾
+  // poll 在到期前停止时协程不再恢复
+  class SleepAwaiter {
+  public:
+    SleepAwaiter(IOEventPoll* event_poll, uint32_t ms)
+        : event_poll_(event_poll)
+        , ms_(ms) { }
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) const;
+    void await_resume() const noexcept { }
+  private:
+    IOEventPoll* event_poll_;
+    uint32_t     ms_;
+  };
+
+  struct ConnectResult {
+    int     err = 0; // 0 表示连接成功
+    ConnPtr conn;    // 失败时为空
+  };
+
+  // 协程式连接，接管 Conn 的消息、关闭和水位回调
+  // 所有操作都在连接所在的 poll 线程上 co_await；同一时刻最多一个读和一个写在等待
+  // 读到的 string_view 在下一次读之前有效，期间可以 co_await 写或 sleep，新到达的数据不会移动它
+  // 连接关闭后读返回空，closed() 为 true，error() 为关闭原因 (对端正常关闭为 0)
+  class AsyncConn : public NonCopyable {
+    struct State;
+  public:
+    static constexpr size_t kDefaultMaxLine = 64 * 1024;
+
+    class ReadAwaiter {
+    public:
+      enum class Kind { kSome, kExactly, kUntil };
+
+      ReadAwaiter(State* state, Kind kind, size_t size, std::string_view delim)
+          : state_(state)
+          , kind_(kind)
+          , size_(size)
+          , delim_(delim) { }
+
+      bool             await_ready();
+      void             await_suspend(std::coroutine_handle<> handle);
+      std::string_view await_resume() const noexcept { return result_; }
+    private:
+      friend struct State;
+
+      State*           state_;
+      Kind             kind_;
+      size_t           size_; // kExactly 为字节数，kUntil 为不含分隔符时的上限
+      std::string_view delim_;
+      std::string_view result_;
+    };
+
+    class WriteAwaiter {
+    public:
+      WriteAwaiter(State* state, std::string_view data)
+          : state_(state)
+          , data_(data) { }
+
+      // 数据交给 Conn 后立即完成；写缓冲超过高水位时等到降回低水位再恢复
+      bool await_ready();
+      void await_suspend(std::coroutine_handle<> handle);
+      // 返回 false 表示连接已经关闭
+      bool await_resume() const noexcept;
+    private:
+      State*           state_;
+      std::string_view data_;
+    };
+
+    class ConnectAwaiter {
+    public:
+      ConnectAwaiter(IOEventPoll* event_poll, std::string addr, uint16_t port, SockOptions options)
+          : event_poll_(event_poll)
+          , addr_(std::move(addr))
+          , port_(port)
+          , options_(options) { }
+
+      bool          await_ready() const noexcept { return false; }
+      bool          await_suspend(std::coroutine_handle<> handle);
+      ConnectResult await_resume() { return std::move(result_); }
+    private:
+      void complete_(int err);
+
+      IOEventPoll*            event_poll_;
+      std::string             addr_;
+      uint16_t                port_;
+      SockOptions             options_;
+      ConnectResult           result_;
+      std::coroutine_handle<> handle_;
+      bool                    suspending_ = false; // connect() 同步完成时不挂起
+      bool                    done_       = false;
+    };
+
+    // 在连接所在的 poll 线程上构造，conn 需要已经连接；已在读缓冲中的数据可以直接读到
+    explicit AsyncConn(ConnPtr conn);
+    // 立即关闭连接，未写出的数据被丢弃；需要优雅关闭时先 shutdown()，再等 read_some() 返回空
+    ~AsyncConn();
+
+    // 主动连接，addr 需要是 IP 地址；在 event_poll 的线程上 co_await
+    static ConnectAwaiter connect(IOEventPoll* event_poll, std::string addr, uint16_t port, SockOptions options = {}) {
+      return ConnectAwaiter(event_poll, std::move(addr), port, options);
+    }
+
+    // 至少一个字节
+    ReadAwaiter read_some() { return ReadAwaiter(state_.get(), ReadAwaiter::Kind::kSome, 0, {}); }
+    ReadAwaiter read_exactly(size_t n) { return ReadAwaiter(state_.get(), ReadAwaiter::Kind::kExactly, n, {}); }
+    // 结果包含分隔符；超过 max_size 仍未找到时返回空，error() 为 EMSGSIZE
+    ReadAwaiter read_until(std::string_view delim, size_t max_size = kDefaultMaxLine) {
+      return ReadAwaiter(state_.get(), ReadAwaiter::Kind::kUntil, max_size, delim);
+    }
+    WriteAwaiter write(std::string_view data) { return WriteAwaiter(state_.get(), data); }
+
+    void shutdown() { conn_->shutdown(); }
+    void close() { conn_->close(); }
+
+    const ConnPtr& conn() const { return conn_; }
+    bool           closed() const;
+    int            error() const;
+  private:
+    ConnPtr                conn_;
+    std::shared_ptr<State> state_;
+  };
+} // namespace cxpnet
+
+#endif // CORO_H
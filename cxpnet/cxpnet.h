@@ -2,8 +2,25 @@
 #define CXPNET_H
 
 #include "buffer.h"
+#include "codec.h"
 #include "conn.h"
+#include "conn_pool.h"
+#include "coro.h"
+#include "histogram.h"
+#include "http.h"
+#include "http_client.h"
+#include "http_server.h"
 #include "io_event_poll.h"
+#include "metrics.h"
+#include "offload.h"
+#include "resp.h"
+#include "resp_client.h"
+#include "resp_server.h"
+#include "rpc.h"
+#include "scan.h"
 #include "server.h"
+#include "server_session.h"
+#include "trace.h"
+#include "websocket.h"
 
 #endif // CXPNET_H
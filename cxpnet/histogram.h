@@ -0,0 +1,213 @@
+﻿#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "sock.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cxpnet {
+  // 单写者计数累加：只有一个线程写入时用 relaxed load + store 代替 fetch_add，不产生 lock 前缀指令
+  inline void single_writer_add(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  // HDR 风格的分桶：按 2 的幂分主桶，每个主桶再线性分成 16 个子桶，相对误差不超过 1/16
+  // [0, 16) 每个值一个桶，最大记录 2^44 - 1，超出部分计入最后一个桶
+  struct HistogramBuckets {
+    static constexpr uint32_t kSubBucketBits  = 4;
+    static constexpr uint64_t kSubBucketCount = uint64_t {1} << kSubBucketBits;
+    static constexpr uint32_t kMaxBit         = 43;
+    static constexpr size_t   kBucketCount    = (kMaxBit - kSubBucketBits + 2) * kSubBucketCount;
+    static constexpr uint64_t kMaxValue       = (uint64_t {1} << (kMaxBit + 1)) - 1;
+
+    static size_t index(uint64_t value) {
+      if (value < kSubBucketCount) { return static_cast<size_t>(value); }
+      if (value > kMaxValue) { return kBucketCount - 1; }
+
+      uint32_t exponent = static_cast<uint32_t>(std::bit_width(value)) - 1;
+      uint32_t shift    = exponent - kSubBucketBits;
+      uint64_t sub      = (value >> shift) & (kSubBucketCount - 1);
+      return static_cast<size_t>((shift + 1) * kSubBucketCount + sub);
+    }
+
+    static uint64_t lower_bound(size_t index) {
+      if (index < kSubBucketCount) { return index; }
+
+      uint32_t shift = static_cast<uint32_t>(index / kSubBucketCount) - 1;
+      uint64_t sub   = index % kSubBucketCount;
+      return (kSubBucketCount + sub) << shift;
+    }
+
+    static uint64_t upper_bound(size_t index) {
+      if (index < kSubBucketCount) { return index; }
+
+      uint32_t shift = static_cast<uint32_t>(index / kSubBucketCount) - 1;
+      return lower_bound(index) + (uint64_t {1} << shift) - 1;
+    }
+  };
+
+  // 直方图快照，可合并
+  struct HistogramSnapshot {
+    static constexpr size_t kBucketCount = HistogramBuckets::kBucketCount;
+
+    uint64_t                           count = 0;
+    uint64_t                           sum   = 0;
+    uint64_t                           min   = 0;
+    uint64_t                           max   = 0;
+    std::array<uint64_t, kBucketCount> buckets {};
+
+    double mean() const { return count == 0 ? 0.0 : static_cast<double>(sum) / count; }
+
+    // 返回所在桶的上界，并限制在 [min, max] 内
+    uint64_t percentile(double p) const {
+      if (count == 0) { return 0; }
+
+      uint64_t rank = static_cast<uint64_t>(p / 100.0 * count);
+      if (rank >= count) { rank = count - 1; }
+
+      uint64_t seen = 0;
+      for (size_t i = 0; i < kBucketCount; ++i) {
+        seen += buckets[i];
+        if (seen > rank) { return std::clamp(HistogramBuckets::upper_bound(i), min, max); }
+      }
+      return max;
+    }
+
+    void merge(const HistogramSnapshot& other) {
+      if (other.count == 0) { return; }
+
+      min    = count == 0 ? other.min : (std::min)(min, other.min);
+      max    = (std::max)(max, other.max);
+      count += other.count;
+      sum   += other.sum;
+      for (size_t i = 0; i < kBucketCount; ++i) { buckets[i] += other.buckets[i]; }
+    }
+  };
+
+  // 单写者直方图，只允许一个线程 record，任意线程可以 snapshot
+  // 写入用 relaxed load + store，编译后就是普通的加法，不产生 lock 前缀指令
+  class alignas(64) HistogramShard : public NonCopyable {
+  public:
+    HistogramShard() = default;
+
+    void record(uint64_t value) {
+      single_writer_add(buckets_[HistogramBuckets::index(value)], 1);
+      single_writer_add(count_, 1);
+      single_writer_add(sum_, value);
+      if (value < min_.load(std::memory_order_relaxed)) { min_.store(value, std::memory_order_relaxed); }
+      if (value > max_.load(std::memory_order_relaxed)) { max_.store(value, std::memory_order_relaxed); }
+    }
+
+    // 合并到 snap 中，读到的是近似一致的视图，count 与 buckets 之和可能有少量偏差
+    void merge_into(HistogramSnapshot& snap) const {
+      HistogramSnapshot local;
+      local.count = count_.load(std::memory_order_relaxed);
+      if (local.count == 0) { return; }
+
+      local.sum = sum_.load(std::memory_order_relaxed);
+      local.min = min_.load(std::memory_order_relaxed);
+      local.max = max_.load(std::memory_order_relaxed);
+      for (size_t i = 0; i < HistogramSnapshot::kBucketCount; ++i) {
+        local.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+      }
+      snap.merge(local);
+    }
+
+    HistogramSnapshot snapshot() const {
+      HistogramSnapshot snap;
+      merge_into(snap);
+      return snap;
+    }
+  private:
+    std::array<std::atomic<uint64_t>, HistogramSnapshot::kBucketCount> buckets_ {};
+    std::atomic<uint64_t>                                              count_ {0};
+    std::atomic<uint64_t>                                              sum_ {0};
+    std::atomic<uint64_t>                                              min_ {std::numeric_limits<uint64_t>::max()};
+    std::atomic<uint64_t>                                              max_ {0};
+  };
+
+  // 每个写入线程第一次访问时分配自己的 Shard，之后只访问本线程的 Shard
+  // 线程本地缓存按 id 直接映射到固定数量的槽位，命中时只比较一次 id，不持锁；
+  // 槽位冲突或首次访问时持锁按线程 id 查找或分配。Shard 归对象所有，对象销毁时一并释放，
+  // 缓存中残留的条目因 id 不复用永远不会再被命中，之后被其他对象覆盖
+  template <typename Shard>
+  class ThreadShards : public NonCopyable {
+  public:
+    ThreadShards()
+        : id_(next_id_()) { }
+
+    Shard& local() {
+      CacheSlot& slot = thread_cache_()[id_ % kCacheSlots];
+      if (slot.id == id_) { return *static_cast<Shard*>(slot.shard); }
+
+      Shard* shard = find_or_create_(std::this_thread::get_id());
+      slot         = {id_, shard};
+      return *shard;
+    }
+
+    template <typename Func>
+    void for_each(Func&& func) const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (const auto& entry : shards_) { func(*entry.second); }
+    }
+  private:
+    static constexpr size_t kCacheSlots = 64;
+
+    struct CacheSlot {
+      uint64_t id    = 0;
+      void*    shard = nullptr;
+    };
+
+    // 线程退出后它的 Shard 仍然保留，复用同一线程 id 的新线程接着写入，仍然只有一个写者
+    Shard* find_or_create_(std::thread::id tid) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (const auto& entry : shards_) {
+        if (entry.first == tid) { return entry.second.get(); }
+      }
+      shards_.emplace_back(tid, std::make_unique<Shard>());
+      return shards_.back().second.get();
+    }
+
+    // id 全局递增且不复用，0 留给空槽位
+    static uint64_t next_id_() {
+      static std::atomic<uint64_t> next_id {1};
+      return next_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static std::array<CacheSlot, kCacheSlots>& thread_cache_() {
+      thread_local std::array<CacheSlot, kCacheSlots> cache {};
+      return cache;
+    }
+
+    const uint64_t                                                  id_;
+    mutable std::mutex                                              mutex_;
+    std::vector<std::pair<std::thread::id, std::unique_ptr<Shard>>> shards_;
+  };
+
+  // 多线程直方图，record 只写本线程的 shard，snapshot 合并所有 shard
+  // 单位由调用方决定，建议统一使用微秒或纳秒
+  class Histogram : public NonCopyable {
+  public:
+    void record(uint64_t value) { shards_.local().record(value); }
+
+    HistogramSnapshot snapshot() const {
+      HistogramSnapshot snap;
+      shards_.for_each([&snap](const HistogramShard& shard) { shard.merge_into(snap); });
+      return snap;
+    }
+  private:
+    ThreadShards<HistogramShard> shards_;
+  };
+} // namespace cxpnet
+
+#endif // HISTOGRAM_H
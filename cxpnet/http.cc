@@ -0,0 +1,492 @@
+﻿#include "http.h"
+#include "scan.h"
+
+#include <charconv>
+
+namespace cxpnet {
+  namespace {
+    constexpr size_t kMaxChunkLine = 1024; // chunk-size 行 (含扩展) 的上限
+
+    char ascii_lower(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; }
+
+    bool is_ows(char c) { return c == ' ' || c == '\t'; }
+
+    std::string_view trim_ows(std::string_view s) {
+      while (!s.empty() && is_ows(s.front())) { s.remove_prefix(1); }
+      while (!s.empty() && is_ows(s.back())) { s.remove_suffix(1); }
+      return s;
+    }
+
+    // RFC 9110 tchar
+    bool is_token_char(char c) {
+      if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) { return true; }
+      return std::string_view("!#$%&'*+-.^_`|~").find(c) != std::string_view::npos;
+    }
+
+    bool is_token(std::string_view s) {
+      if (s.empty()) { return false; }
+      for (char c : s) {
+        if (!is_token_char(c)) { return false; }
+      }
+      return true;
+    }
+
+    // 十进制，拒绝空串、符号和溢出
+    bool parse_decimal(std::string_view s, size_t& value) {
+      if (s.empty()) { return false; }
+      auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+      return ec == std::errc() && end == s.data() + s.size();
+    }
+
+    // 取出下一行 (不含 CRLF)，没有 CRLF 时剩余部分作为最后一行
+    std::string_view next_line(std::string_view& rest) {
+      const char*      crlf = scan::find(rest.data(), rest.size(), "\r\n");
+      size_t           len  = crlf == nullptr ? rest.size() : static_cast<size_t>(crlf - rest.data());
+      std::string_view line = rest.substr(0, len);
+      rest.remove_prefix(crlf == nullptr ? rest.size() : len + 2);
+      return line;
+    }
+  } // namespace
+
+  bool http_iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) { return false; }
+    for (size_t i = 0; i < a.size(); ++i) {
+      if (ascii_lower(a[i]) != ascii_lower(b[i])) { return false; }
+    }
+    return true;
+  }
+
+  bool http_has_token(std::string_view list, std::string_view token) {
+    while (!list.empty()) {
+      size_t comma = list.find(',');
+      if (http_iequals(trim_ows(list.substr(0, comma)), token)) { return true; }
+      if (comma == std::string_view::npos) { break; }
+      list.remove_prefix(comma + 1);
+    }
+    return false;
+  }
+
+  const char* http_reason(int status) {
+    static const struct {
+      int         status;
+      const char* reason;
+    } kReasons[] = {
+      {100, "Continue"},
+      {101, "Switching Protocols"},
+      {200, "OK"},
+      {201, "Created"},
+      {202, "Accepted"},
+      {204, "No Content"},
+      {206, "Partial Content"},
+      {301, "Moved Permanently"},
+      {302, "Found"},
+      {303, "See Other"},
+      {304, "Not Modified"},
+      {307, "Temporary Redirect"},
+      {308, "Permanent Redirect"},
+      {400, "Bad Request"},
+      {401, "Unauthorized"},
+      {403, "Forbidden"},
+      {404, "Not Found"},
+      {405, "Method Not Allowed"},
+      {408, "Request Timeout"},
+      {411, "Length Required"},
+      {413, "Content Too Large"},
+      {414, "URI Too Long"},
+      {415, "Unsupported Media Type"},
+      {426, "Upgrade Required"},
+      {429, "Too Many Requests"},
+      {431, "Request Header Fields Too Large"},
+      {500, "Internal Server Error"},
+      {501, "Not Implemented"},
+      {502, "Bad Gateway"},
+      {503, "Service Unavailable"},
+      {504, "Gateway Timeout"},
+      {505, "HTTP Version Not Supported"},
+    };
+
+    for (const auto& entry : kReasons) {
+      if (entry.status == status) { return entry.reason; }
+    }
+    return "Unknown";
+  }
+
+  std::string_view HttpMessage::header(std::string_view name) const {
+    for (size_t i = 0; i < header_count; ++i) {
+      if (http_iequals(headers[i].name, name)) { return headers[i].value; }
+    }
+    return {};
+  }
+
+  bool HttpMessage::has_header(std::string_view name) const {
+    for (size_t i = 0; i < header_count; ++i) {
+      if (http_iequals(headers[i].name, name)) { return true; }
+    }
+    return false;
+  }
+
+  HttpParseResult HttpMessageParser::parse_(Buffer* buffer, HttpMessage& message) {
+    switch (state_) {
+    case State::kError:
+      return HttpParseResult::kError;
+    case State::kComplete:
+      return HttpParseResult::kComplete;
+    case State::kHeaders: {
+      HttpParseResult result = parse_headers_(buffer, message);
+      if (result != HttpParseResult::kComplete) { return result; }
+      break;
+    }
+    default:
+      break;
+    }
+
+    HttpParseResult result = HttpParseResult::kIncomplete;
+    if (state_ == State::kBody) {
+      if (buffer->readable_size() >= body_start_ + body_length_) {
+        result = complete_(buffer, message, body_length_, body_start_ + body_length_);
+      }
+    } else if (state_ == State::kUntilClose) {
+      if (buffer->readable_size() - body_start_ > limits_.max_body_size) { result = fail_(413); }
+    } else {
+      result = parse_chunked_(buffer, message);
+    }
+
+    // 等待 body 期间读缓冲可能搬移，完成时需要重新生成头部的 string_view
+    if (result == HttpParseResult::kIncomplete) { head_stale_ = true; }
+    return result;
+  }
+
+  HttpParseResult HttpMessageParser::finish_(Buffer* buffer, HttpMessage& message) {
+    if (state_ == State::kComplete) { return HttpParseResult::kComplete; }
+    if (state_ != State::kUntilClose) {
+      parse_(buffer, message);
+      if (state_ == State::kComplete) { return HttpParseResult::kComplete; }
+      // 以关闭为界的 body 之外，连接关闭时报文还不完整就是截断
+      if (state_ != State::kUntilClose) { return state_ == State::kError ? HttpParseResult::kError : fail_(400); }
+    }
+
+    size_t readable = buffer->readable_size();
+    return complete_(buffer, message, readable - body_start_, readable);
+  }
+
+  void HttpMessageParser::consume(Buffer* buffer) {
+    if (state_ == State::kComplete) { buffer->been_read(message_size_); }
+    reset_();
+  }
+
+  HttpParseResult HttpMessageParser::parse_headers_(Buffer* buffer, HttpMessage& message) {
+    // 报文之间多余的空行直接丢弃
+    while (buffer->readable_size() >= 2 && buffer->peek()[0] == '\r' && buffer->peek()[1] == '\n') {
+      buffer->been_read(2);
+    }
+
+    size_t head_end = buffer->find("\r\n\r\n");
+    if (head_end == Buffer::npos) {
+      if (buffer->readable_size() > limits_.max_header_size) { return fail_(431); }
+      return HttpParseResult::kIncomplete;
+    }
+    if (head_end + 4 > limits_.max_header_size) { return fail_(431); }
+
+    head_size_ = head_end;
+    int status = parse_head_(std::string_view(buffer->peek(), head_size_), message);
+    if (status != 0) { return fail_(status); }
+
+    body_start_ = head_end + 4;
+    if (!expects_body_(message)) {
+      body_length_ = 0;
+      state_       = State::kBody;
+    } else if (message.chunked) {
+      raw_pos_ = body_start_;
+      state_   = State::kChunkSize;
+    } else if (!has_length_ && body_until_close_()) {
+      state_ = State::kUntilClose;
+    } else {
+      if (body_length_ > limits_.max_body_size) { return fail_(413); }
+      state_ = State::kBody;
+    }
+    return HttpParseResult::kComplete;
+  }
+
+  int HttpMessageParser::parse_head_(std::string_view head, HttpMessage& message) {
+    message.header_count = 0;
+    message.body         = {};
+    message.chunked      = false;
+    body_length_         = 0;
+    has_length_          = false;
+
+    std::string_view rest   = head;
+    int              status = parse_start_line_(next_line(rest), message);
+    if (status != 0) { return status; }
+
+    while (!rest.empty()) {
+      std::string_view line = next_line(rest);
+      // 不支持已废弃的折行
+      if (line.empty() || is_ows(line.front())) { return 400; }
+
+      size_t colon = line.find(':');
+      if (colon == std::string_view::npos || !is_token(line.substr(0, colon))) { return 400; }
+      if (message.header_count == HttpMessage::kMaxHeaders) { return 431; }
+
+      HttpHeader& header = message.headers[message.header_count++];
+      header.name        = line.substr(0, colon);
+      header.value       = trim_ows(line.substr(colon + 1));
+
+      if (http_iequals(header.name, "Content-Length")) {
+        size_t length = 0;
+        if (!parse_decimal(header.value, length)) { return 400; }
+        // 多个 Content-Length 必须一致
+        if (has_length_ && length != body_length_) { return 400; }
+        has_length_  = true;
+        body_length_ = length;
+      } else if (http_iequals(header.name, "Transfer-Encoding")) {
+        // 只支持 chunked 作为最后一个编码
+        std::string_view codings = header.value;
+        size_t           comma   = codings.rfind(',');
+        if (!http_iequals(trim_ows(comma == std::string_view::npos ? codings : codings.substr(comma + 1)),
+                          "chunked")) {
+          return 501;
+        }
+        message.chunked = true;
+      } else if (http_iequals(header.name, "Connection")) {
+        if (http_has_token(header.value, "close")) {
+          message.keep_alive = false;
+        } else if (http_has_token(header.value, "keep-alive")) {
+          message.keep_alive = true;
+        }
+      }
+    }
+
+    // 同时带 Transfer-Encoding 和 Content-Length 的报文可用于请求走私，直接拒绝
+    if (message.chunked && has_length_) { return 400; }
+    return 0;
+  }
+
+  int HttpRequestParser::parse_start_line_(std::string_view line, HttpMessage& message) {
+    auto& request = static_cast<HttpRequest&>(message);
+
+    size_t sp1 = line.find(' ');
+    if (sp1 == std::string_view::npos) { return 400; }
+    size_t sp2 = line.find(' ', sp1 + 1);
+    if (sp2 == std::string_view::npos) { return 400; }
+
+    request.method = line.substr(0, sp1);
+    request.target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    if (!is_token(request.method) || request.target.empty()) { return 400; }
+
+    std::string_view version = line.substr(sp2 + 1);
+    if (version.size() != 8 || !version.starts_with("HTTP/")) { return 400; }
+    if (version[5] != '1' || version[6] != '.') { return 505; }
+    if (version[7] != '0' && version[7] != '1') { return 505; }
+    request.version_minor = version[7] - '0';
+    request.keep_alive    = request.version_minor == 1;
+
+    size_t question = request.target.find('?');
+    request.path    = request.target.substr(0, question);
+    request.query   = question == std::string_view::npos ? std::string_view() : request.target.substr(question + 1);
+    return 0;
+  }
+
+  int HttpResponseParser::parse_start_line_(std::string_view line, HttpMessage& message) {
+    auto& response = static_cast<HttpClientResponse&>(message);
+
+    // HTTP/1.x SP 3DIGIT SP [reason]
+    if (line.size() < 12 || !line.starts_with("HTTP/1.") || line[8] != ' ') { return 400; }
+    if (line[7] != '0' && line[7] != '1') { return 505; }
+    if (line.size() > 12 && line[12] != ' ') { return 400; }
+
+    size_t status = 0;
+    if (!parse_decimal(line.substr(9, 3), status) || status < 100) { return 400; }
+    response.status        = static_cast<int>(status);
+    response.reason        = line.size() > 13 ? line.substr(13) : std::string_view();
+    response.version_minor = line[7] - '0';
+    response.keep_alive    = response.version_minor == 1;
+    return 0;
+  }
+
+  bool HttpResponseParser::expects_body_(const HttpMessage& message) const {
+    int status = static_cast<const HttpClientResponse&>(message).status;
+    return !head_request_ && status >= 200 && status != 204 && status != 304;
+  }
+
+  HttpParseResult HttpMessageParser::parse_chunked_(Buffer* buffer, HttpMessage& message) {
+    char* data = buffer->to_read();
+
+    while (true) {
+      size_t readable = buffer->readable_size();
+      switch (state_) {
+      case State::kChunkSize: {
+        const char* crlf = scan::find(data + raw_pos_, readable - raw_pos_, "\r\n");
+        if (crlf == nullptr) {
+          if (readable - raw_pos_ > kMaxChunkLine) { return fail_(400); }
+          return HttpParseResult::kIncomplete;
+        }
+
+        std::string_view line(data + raw_pos_, static_cast<size_t>(crlf - (data + raw_pos_)));
+        if (line.size() > kMaxChunkLine) { return fail_(400); }
+        // chunk 扩展 (";name=value") 忽略
+        size_t           semicolon = line.find(';');
+        std::string_view digits    = trim_ows(line.substr(0, semicolon));
+        size_t           size      = 0;
+        auto [end, ec]             = std::from_chars(digits.data(), digits.data() + digits.size(), size, 16);
+        if (digits.empty() || ec != std::errc() || end != digits.data() + digits.size()) { return fail_(400); }
+
+        raw_pos_ += line.size() + 2;
+        if (size == 0) {
+          state_ = State::kTrailers;
+          break;
+        }
+        if (size > limits_.max_body_size - decoded_size_) { return fail_(413); }
+        chunk_left_ = size;
+        state_      = State::kChunkData;
+        break;
+      }
+      case State::kChunkData: {
+        size_t available = (std::min)(chunk_left_, readable - raw_pos_);
+        if (available == 0) { return HttpParseResult::kIncomplete; }
+
+        // 原地解码：把 chunk 数据前移，紧接在已解码的 body 之后
+        char* decoded_end = data + body_start_ + decoded_size_;
+        if (decoded_end != data + raw_pos_) { std::memmove(decoded_end, data + raw_pos_, available); }
+        decoded_size_ += available;
+        raw_pos_ += available;
+        chunk_left_ -= available;
+        if (chunk_left_ > 0) { return HttpParseResult::kIncomplete; }
+        state_ = State::kChunkDataEnd;
+        break;
+      }
+      case State::kChunkDataEnd:
+        if (readable - raw_pos_ < 2) { return HttpParseResult::kIncomplete; }
+        if (data[raw_pos_] != '\r' || data[raw_pos_ + 1] != '\n') { return fail_(400); }
+        raw_pos_ += 2;
+        state_ = State::kChunkSize;
+        break;
+      case State::kTrailers: {
+        // trailer 字段不向处理函数暴露，只跳过
+        const char* crlf = scan::find(data + raw_pos_, readable - raw_pos_, "\r\n");
+        if (crlf == nullptr) {
+          if (readable - body_start_ > limits_.max_body_size + limits_.max_header_size) { return fail_(431); }
+          return HttpParseResult::kIncomplete;
+        }
+
+        size_t line_size = static_cast<size_t>(crlf - (data + raw_pos_));
+        raw_pos_ += line_size + 2;
+        if (line_size == 0) { return complete_(buffer, message, decoded_size_, raw_pos_); }
+        break;
+      }
+      default:
+        return fail_(400);
+      }
+    }
+  }
+
+  HttpParseResult HttpMessageParser::complete_(Buffer* buffer, HttpMessage& message, size_t body_size,
+                                               size_t message_size) {
+    if (head_stale_) { parse_head_(std::string_view(buffer->peek(), head_size_), message); }
+
+    message.body  = std::string_view(buffer->peek() + body_start_, body_size);
+    message_size_ = message_size;
+    state_        = State::kComplete;
+    return HttpParseResult::kComplete;
+  }
+
+  HttpParseResult HttpMessageParser::fail_(int status) {
+    error_status_ = status;
+    state_        = State::kError;
+    return HttpParseResult::kError;
+  }
+
+  void HttpMessageParser::reset_() {
+    state_        = State::kHeaders;
+    error_status_ = 0;
+    head_size_    = 0;
+    body_start_   = 0;
+    body_length_  = 0;
+    has_length_   = false;
+    raw_pos_      = 0;
+    decoded_size_ = 0;
+    chunk_left_   = 0;
+    message_size_ = 0;
+    head_stale_   = false;
+  }
+
+  void HttpResponse::set_status(int status, std::string_view reason) {
+    status_ = status;
+    if (reason.empty()) { reason = http_reason(status); }
+    reason_.assign(reason.data(), reason.size());
+  }
+
+  void HttpResponse::add_header(std::string_view name, std::string_view value) {
+    headers_.append(name.data(), name.size());
+    headers_.append(": ");
+    headers_.append(value.data(), value.size());
+    headers_.append("\r\n");
+  }
+
+  void HttpResponse::reset(const HttpRequest& request) {
+    set_status(200);
+    headers_.clear();
+    body_.clear();
+    version_minor_ = request.version_minor;
+    keep_alive_    = request.keep_alive;
+    head_request_  = request.method == "HEAD";
+  }
+
+  void HttpResponse::reset_error(int status) {
+    set_status(status);
+    headers_.clear();
+    body_.assign(reason_);
+    body_.push_back('\n');
+    add_header("Content-Type", "text/plain");
+    version_minor_ = 1;
+    keep_alive_    = false;
+    head_request_  = false;
+  }
+
+  void HttpResponse::serialize(Buffer* out) const {
+    // 1xx / 204 / 304 没有 body，也不带 Content-Length
+    bool no_body = (status_ >= 100 && status_ < 200) || status_ == 204 || status_ == 304;
+
+    char   status_text[8];
+    char   length_text[24];
+    size_t status_size = static_cast<size_t>(std::to_chars(status_text, status_text + sizeof(status_text), status_).ptr -
+                                             status_text);
+    size_t length_size = static_cast<size_t>(
+        std::to_chars(length_text, length_text + sizeof(length_text), body_.size()).ptr - length_text);
+
+    std::string_view connection;
+    if (!keep_alive_) {
+      connection = "Connection: close\r\n";
+    } else if (version_minor_ == 0) {
+      connection = "Connection: keep-alive\r\n";
+    }
+    std::string_view content_length_name = "Content-Length: ";
+    std::string_view body                = (no_body || head_request_) ? std::string_view() : std::string_view(body_);
+
+    // 先算出总长度，一次扩容后直接写入 out 的可写区域
+    size_t total = 9 + status_size + 1 + reason_.size() + 2 + headers_.size() + connection.size() + 2 + body.size();
+    if (!no_body) { total += content_length_name.size() + length_size + 2; }
+    out->ensure_writable_size(total);
+
+    char* p      = out->to_write();
+    auto  append = [&p](std::string_view s) {
+      if (s.empty()) { return; }
+      std::memcpy(p, s.data(), s.size());
+      p += s.size();
+    };
+    append("HTTP/1.1 ");
+    append(std::string_view(status_text, status_size));
+    append(" ");
+    append(reason_);
+    append("\r\n");
+    append(headers_);
+    if (!no_body) {
+      append(content_length_name);
+      append(std::string_view(length_text, length_size));
+      append("\r\n");
+    }
+    append(connection);
+    append("\r\n");
+    append(body);
+    out->been_written(total);
+  }
+} // namespace cxpnet
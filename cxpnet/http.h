@@ -0,0 +1,186 @@
+﻿#ifndef HTTP_H
+#define HTTP_H
+
+#include "buffer.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace cxpnet {
+  // HTTP/1.x 报文的公共部分：请求 / 响应解析和响应序列化
+  // 解析结果中的 string_view 指向连接的读缓冲，不复制、不分配
+
+  struct HttpHeader {
+    std::string_view name;
+    std::string_view value;
+  };
+
+  struct HttpLimits {
+    size_t max_header_size = 8 * 1024;    // 起始行 + 头部，超过返回 431
+    size_t max_body_size   = 1024 * 1024; // 超过返回 413
+  };
+
+  // 名称比较不区分大小写
+  bool http_iequals(std::string_view a, std::string_view b);
+  // 逗号分隔的列表中是否有 token (不区分大小写)，如 Connection: keep-alive, Upgrade
+  bool http_has_token(std::string_view list, std::string_view token);
+  const char* http_reason(int status);
+
+  // 请求和响应共有的头部与 body
+  struct HttpMessage {
+    static constexpr size_t kMaxHeaders = 64; // 超过返回 431
+
+    int              version_minor = 1;
+    HttpHeader       headers[kMaxHeaders];
+    size_t           header_count = 0;
+    std::string_view body;
+    bool             keep_alive = true;
+    bool             chunked    = false;
+
+    // 返回第一个同名头部的值，不存在时返回空
+    std::string_view header(std::string_view name) const;
+    bool             has_header(std::string_view name) const;
+  };
+
+  struct HttpRequest : HttpMessage {
+    std::string_view method;
+    std::string_view target; // 原始请求目标，含 query
+    std::string_view path;
+    std::string_view query; // 不含 '?'
+  };
+
+  // 客户端收到的响应
+  struct HttpClientResponse : HttpMessage {
+    int              status = 0;
+    std::string_view reason;
+  };
+
+  enum class HttpParseResult {
+    kComplete,   // 解析出一个完整报文
+    kIncomplete, // 数据不足，等待下一次读
+    kError,      // 报文非法，error_status() 为对应的状态码
+  };
+
+  // 增量报文解析器，一个连接一个
+  // 头部未收齐时只依靠 Buffer::find 的续扫查找 "\r\n\r\n"，收齐后一次解析完起始行和头部
+  // chunked body 在读缓冲内原地解码，解码后的 body 是连续的一段
+  class HttpMessageParser {
+  public:
+    virtual ~HttpMessageParser() = default;
+
+    // 消费已解析的报文，准备解析同一连接上的下一个报文
+    void consume(Buffer* buffer);
+
+    int error_status() const { return error_status_; }
+  protected:
+    explicit HttpMessageParser(HttpLimits limits)
+        : limits_(limits) { }
+
+    // kComplete 时 message 中的 string_view 在 consume 之前有效
+    HttpParseResult parse_(Buffer* buffer, HttpMessage& message);
+    // 连接关闭时结束以关闭为界的 body
+    HttpParseResult finish_(Buffer* buffer, HttpMessage& message);
+
+    // 返回 0 表示成功，否则为对应的状态码
+    virtual int parse_start_line_(std::string_view line, HttpMessage& message) = 0;
+    // 头部解析完后判断是否有 body，如 HEAD 请求的响应没有 body
+    virtual bool expects_body_(const HttpMessage& message) const = 0;
+    // 既没有 Content-Length 也不是 chunked 时，body 是否一直到连接关闭
+    virtual bool body_until_close_() const = 0;
+  private:
+    enum class State {
+      kHeaders,
+      kBody, // Content-Length
+      kUntilClose,
+      kChunkSize,
+      kChunkData,
+      kChunkDataEnd,
+      kTrailers,
+      kComplete,
+      kError,
+    };
+
+    HttpParseResult parse_headers_(Buffer* buffer, HttpMessage& message);
+    int             parse_head_(std::string_view head, HttpMessage& message);
+    HttpParseResult parse_chunked_(Buffer* buffer, HttpMessage& message);
+    HttpParseResult complete_(Buffer* buffer, HttpMessage& message, size_t body_size, size_t message_size);
+    HttpParseResult fail_(int status);
+    void            reset_();
+
+    HttpLimits limits_;
+    State      state_        = State::kHeaders;
+    int        error_status_ = 0;
+    size_t     head_size_    = 0; // 以下偏移都相对 buffer->peek()，不含结尾的空行
+    size_t     body_start_   = 0;
+    size_t     body_length_  = 0; // Content-Length
+    bool       has_length_   = false;
+    size_t     raw_pos_      = 0; // chunked 原始数据的解析位置
+    size_t     decoded_size_ = 0; // chunked 已解码的 body 长度
+    size_t     chunk_left_   = 0;
+    size_t     message_size_ = 0; // 完整报文在读缓冲中占用的字节数
+    bool       head_stale_   = false;
+  };
+
+  class HttpRequestParser : public HttpMessageParser {
+  public:
+    explicit HttpRequestParser(HttpLimits limits = {})
+        : HttpMessageParser(limits) { }
+
+    HttpParseResult parse(Buffer* buffer, HttpRequest& request) { return parse_(buffer, request); }
+  private:
+    int  parse_start_line_(std::string_view line, HttpMessage& message) override;
+    bool expects_body_(const HttpMessage&) const override { return true; }
+    bool body_until_close_() const override { return false; }
+  };
+
+  class HttpResponseParser : public HttpMessageParser {
+  public:
+    explicit HttpResponseParser(HttpLimits limits = {})
+        : HttpMessageParser(limits) { }
+
+    // 在解析每个响应之前设置，HEAD 请求的响应没有 body
+    void            set_head_request(bool head_request) { head_request_ = head_request; }
+    HttpParseResult parse(Buffer* buffer, HttpClientResponse& response) { return parse_(buffer, response); }
+    // 连接关闭时调用，没有 Content-Length 的响应以关闭为结束
+    HttpParseResult finish(Buffer* buffer, HttpClientResponse& response) { return finish_(buffer, response); }
+  private:
+    int  parse_start_line_(std::string_view line, HttpMessage& message) override;
+    bool expects_body_(const HttpMessage& message) const override;
+    bool body_until_close_() const override { return true; }
+
+    bool head_request_ = false;
+  };
+
+  // 响应，由处理函数填写，序列化时追加 Content-Length 和必要的 Connection 头
+  // 连接复用同一个对象，字符串保留容量，稳态下不分配
+  class HttpResponse {
+  public:
+    void set_status(int status, std::string_view reason = {});
+    void add_header(std::string_view name, std::string_view value);
+    void set_body(std::string_view body) { body_.assign(body.data(), body.size()); }
+    void append_body(std::string_view data) { body_.append(data.data(), data.size()); }
+    // 处理函数可以要求在该响应之后关闭连接
+    void set_keep_alive(bool keep_alive) { keep_alive_ = keep_alive; }
+
+    int  status() const { return status_; }
+    bool keep_alive() const { return keep_alive_; }
+
+    // 为一个请求重置；HEAD 请求序列化时不写 body
+    void reset(const HttpRequest& request);
+    // 错误响应，总是关闭连接
+    void reset_error(int status);
+    // 把状态行、头部和 body 追加到 out
+    void serialize(Buffer* out) const;
+  private:
+    int         status_        = 200;
+    std::string reason_;
+    std::string headers_;
+    std::string body_;
+    int         version_minor_ = 1;
+    bool        keep_alive_    = true;
+    bool        head_request_  = false;
+  };
+} // namespace cxpnet
+
+#endif // HTTP_H
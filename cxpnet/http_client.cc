@@ -0,0 +1,343 @@
+﻿#include "http_client.h"
+#include "conn.h"
+#include "io_event_poll.h"
+
+#include <algorithm>
+#include <cerrno>
+
+namespace cxpnet {
+  namespace {
+    // 可以安全重发的方法
+    bool is_idempotent(std::string_view method) {
+      return method == "GET" || method == "HEAD" || method == "OPTIONS" || method == "TRACE" || method == "PUT" ||
+             method == "DELETE";
+    }
+  } // namespace
+
+  // 一个 keep-alive 连接，响应按请求顺序返回
+  struct HttpClient::Session {
+    Session(HttpClient* c, Endpoint* e, HttpLimits limits)
+        : client(c)
+        , endpoint(e)
+        , parser(limits) { }
+
+    HttpClient*         client; // 为空表示已从连接池移除，之后的 Conn 回调全部忽略
+    Endpoint*           endpoint;
+    ConnPtr             conn;
+    bool                connected   = false;
+    Buffer*             read_buffer = nullptr; // 连接关闭时结束以关闭为界的响应
+    HttpResponseParser  parser;
+    HttpClientResponse  response;
+    std::deque<Pending> in_flight; // 已写出、等待响应的请求
+  };
+
+  struct HttpClient::Endpoint {
+    std::string             host;
+    uint16_t                port = 0;
+    std::vector<SessionPtr> sessions;
+    std::deque<Pending>     queued; // 等待连接空闲的请求
+  };
+
+  HttpClient::HttpClient(IOEventPoll* event_poll, HttpClientOptions options)
+      : event_poll_(event_poll)
+      , options_(std::move(options)) {
+    options_.max_conns_per_host = (std::max)(options_.max_conns_per_host, size_t(1));
+    options_.max_pipeline       = (std::max)(options_.max_pipeline, size_t(1));
+  }
+
+  HttpClient::~HttpClient() { close(); }
+
+  void HttpClient::request(const std::string& host, uint16_t port, HttpClientRequest request, Callback callback) {
+    Pending pending;
+    pending.data       = serialize_(host, port, request);
+    pending.head       = request.method == "HEAD";
+    pending.idempotent = is_idempotent(request.method);
+    pending.callback   = std::move(callback);
+
+    if (event_poll_->is_in_poll_thread()) {
+      enqueue_(host, port, std::move(pending));
+      return;
+    }
+    event_poll_->run_in_poll([this, host, port, pending = std::move(pending)]() mutable {
+      enqueue_(host, port, std::move(pending));
+    });
+  }
+
+  void HttpClient::get(const std::string& host, uint16_t port, std::string target, Callback callback) {
+    HttpClientRequest request;
+    request.target = std::move(target);
+    this->request(host, port, std::move(request), std::move(callback));
+  }
+
+  void HttpClient::close() {
+    ++close_epoch_;
+    std::vector<Failure> failures;
+    for (auto& [key, endpoint] : endpoints_) {
+      for (auto& pending : endpoint->queued) { failures.emplace_back(std::move(pending.callback), ECANCELED); }
+      endpoint->queued.clear();
+
+      auto sessions = endpoint->sessions;
+      for (auto& session : sessions) {
+        for (auto& pending : session->in_flight) { failures.emplace_back(std::move(pending.callback), ECANCELED); }
+        session->in_flight.clear();
+        drop_session_(session, ECANCELED, failures);
+      }
+    }
+    endpoints_.clear();
+    run_failures_(failures);
+  }
+
+  void HttpClient::enqueue_(const std::string& host, uint16_t port, Pending pending) {
+    auto& slot = endpoints_[host + ":" + std::to_string(port)];
+    if (!slot) {
+      slot       = std::make_unique<Endpoint>();
+      slot->host = host;
+      slot->port = port;
+    }
+
+    Endpoint& endpoint = *slot;
+    if (endpoint.queued.size() >= options_.max_queued_per_host) {
+      ++stats_.failed;
+      pending.callback(ENOBUFS, nullptr);
+      return;
+    }
+
+    endpoint.queued.push_back(std::move(pending));
+    dispatch_(endpoint);
+  }
+
+  void HttpClient::dispatch_(Endpoint& endpoint) {
+    while (!endpoint.queued.empty()) {
+      Session* session = pick_session_(endpoint, endpoint.queued.front());
+      if (session == nullptr) { break; }
+
+      Pending pending = std::move(endpoint.queued.front());
+      endpoint.queued.pop_front();
+      ++stats_.requests;
+      session->conn->send(pending.data);
+      session->in_flight.push_back(std::move(pending));
+    }
+
+    // 排队的请求多于正在建立的连接时，在上限内补充连接
+    size_t connecting = static_cast<size_t>(std::count_if(endpoint.sessions.begin(), endpoint.sessions.end(),
+                                                          [](const SessionPtr& s) { return !s->connected; }));
+    while (connecting < endpoint.queued.size() && endpoint.sessions.size() < options_.max_conns_per_host) {
+      open_session_(endpoint);
+      ++connecting;
+    }
+  }
+
+  HttpClient::Session* HttpClient::pick_session_(Endpoint& endpoint, const Pending& pending) {
+    Session* best = nullptr;
+    for (auto& session : endpoint.sessions) {
+      if (!session->connected) { continue; }
+
+      size_t in_flight = session->in_flight.size();
+      if (in_flight == 0) { return session.get(); }
+      // 非幂等请求不进入流水线，也不在它后面排请求
+      if (!pending.idempotent || !session->in_flight.back().idempotent) { continue; }
+      if (in_flight >= options_.max_pipeline) { continue; }
+      if (best == nullptr || in_flight < best->in_flight.size()) { best = session.get(); }
+    }
+    return best;
+  }
+
+  void HttpClient::open_session_(Endpoint& endpoint) {
+    auto session  = std::make_shared<Session>(this, &endpoint, options_.limits);
+    session->conn = std::make_shared<Conn>(event_poll_);
+    session->conn->set_sock_options(options_.sock_options);
+
+    std::weak_ptr<Session> weak = session;
+    session->conn->set_conn_user_callbacks(
+        [weak](Buffer* buffer) {
+          if (auto s = weak.lock(); s && s->client) { s->client->on_message_(s, buffer); }
+        },
+        [weak](int err) {
+          if (auto s = weak.lock(); s && s->client) { s->client->on_close_(s, err); }
+        });
+    endpoint.sessions.push_back(session);
+    ++stats_.connects;
+
+    IOEventPoll* event_poll = event_poll_;
+    session->conn->connect(
+        endpoint.host.c_str(), endpoint.port,
+        [weak](ConnPtr) {
+          if (auto s = weak.lock(); s && s->client) { s->client->on_connected_(*s); }
+        },
+        [weak, event_poll](int err) {
+          // 连接失败可能在 connect 内同步回调，推迟处理以免重入 dispatch_
+          event_poll->run_later([weak, err]() {
+            if (auto s = weak.lock(); s && s->client) { s->client->on_connect_error_(s, err); }
+          });
+        });
+  }
+
+  void HttpClient::on_connected_(Session& session) {
+    session.connected = true;
+    dispatch_(*session.endpoint);
+  }
+
+  void HttpClient::on_connect_error_(const SessionPtr& session, int err) {
+    std::vector<Failure> failures;
+    Endpoint&            endpoint = *session->endpoint;
+    drop_session_(session, err, failures);
+
+    // 没有其他连接可用或正在建立时，排队的请求全部失败，不在这里重连
+    if (endpoint.sessions.empty()) {
+      for (auto& pending : endpoint.queued) { failures.emplace_back(std::move(pending.callback), err); }
+      endpoint.queued.clear();
+    }
+    run_failures_(failures);
+  }
+
+  void HttpClient::on_message_(const SessionPtr& session, Buffer* buffer) {
+    session->read_buffer = buffer;
+
+    std::vector<Failure> failures;
+    Endpoint&            endpoint = *session->endpoint;
+    uint64_t             epoch    = close_epoch_;
+    while (!session->in_flight.empty()) {
+      session->parser.set_head_request(session->in_flight.front().head);
+      HttpParseResult result = session->parser.parse(buffer, session->response);
+      if (result == HttpParseResult::kIncomplete) { break; }
+
+      if (result == HttpParseResult::kError) {
+        failures.emplace_back(std::move(session->in_flight.front().callback), EPROTO);
+        session->in_flight.pop_front();
+        drop_session_(session, EPROTO, failures);
+        break;
+      }
+      if (!deliver_(session, buffer, failures)) { break; }
+    }
+    // 回调中调用了 close()，endpoint 已经释放，之后可能又有新的请求创建了新的 endpoint
+    if (epoch != close_epoch_) {
+      run_failures_(failures);
+      return;
+    }
+
+    // 没有请求在途时收到的数据无法对应，连接不再使用
+    if (session->client != nullptr && session->in_flight.empty() && !buffer->empty()) {
+      drop_session_(session, EPROTO, failures);
+    }
+    dispatch_(endpoint);
+    run_failures_(failures);
+  }
+
+  bool HttpClient::deliver_(const SessionPtr& session, Buffer* buffer, std::vector<Failure>& failures) {
+    int status = session->response.status;
+    // 1xx 中间响应 (如 100 Continue) 之后还有最终响应
+    if (status >= 100 && status < 200 && status != 101) {
+      session->parser.consume(buffer);
+      return true;
+    }
+
+    Pending pending = std::move(session->in_flight.front());
+    session->in_flight.pop_front();
+    bool keep_alive = session->response.keep_alive && status != 101;
+
+    ++stats_.completed;
+    pending.callback(0, &session->response);
+    session->parser.consume(buffer);
+    if (session->client == nullptr) { return false; }
+
+    if (!keep_alive) {
+      // 对端声明关闭，排在后面的请求没有被处理，原样排回队首，不占用重试次数
+      auto& in_flight = session->in_flight;
+      stats_.retried += in_flight.size();
+      session->endpoint->queued.insert(session->endpoint->queued.begin(), std::make_move_iterator(in_flight.begin()),
+                                       std::make_move_iterator(in_flight.end()));
+      in_flight.clear();
+      drop_session_(session, ECONNRESET, failures);
+      return false;
+    }
+    return true;
+  }
+
+  void HttpClient::on_close_(const SessionPtr& session, int err) {
+    std::vector<Failure> failures;
+    Endpoint&            endpoint = *session->endpoint;
+    uint64_t             epoch    = close_epoch_;
+
+    // 没有 Content-Length 的响应以连接关闭为结束
+    Buffer* buffer = session->read_buffer;
+    if (!session->in_flight.empty() && buffer != nullptr && !buffer->empty()) {
+      session->parser.set_head_request(session->in_flight.front().head);
+      if (session->parser.finish(buffer, session->response) == HttpParseResult::kComplete) {
+        deliver_(session, buffer, failures);
+        if (epoch != close_epoch_) {
+          run_failures_(failures);
+          return;
+        }
+      }
+    }
+
+    if (session->client != nullptr) { drop_session_(session, err != 0 ? err : ECONNRESET, failures); }
+    dispatch_(endpoint);
+    run_failures_(failures);
+  }
+
+  void HttpClient::drop_session_(const SessionPtr& session, int err, std::vector<Failure>& failures) {
+    if (session->client == nullptr) { return; }
+    session->client = nullptr;
+
+    // 可以重试的请求按原顺序排回队首
+    Endpoint&            endpoint = *session->endpoint;
+    std::vector<Pending> retries;
+    for (auto& pending : session->in_flight) {
+      if (pending.idempotent && !pending.retried) {
+        pending.retried = true;
+        ++stats_.retried;
+        retries.push_back(std::move(pending));
+      } else {
+        failures.emplace_back(std::move(pending.callback), err);
+      }
+    }
+    session->in_flight.clear();
+    for (auto it = retries.rbegin(); it != retries.rend(); ++it) { endpoint.queued.push_front(std::move(*it)); }
+
+    auto& sessions = endpoint.sessions;
+    sessions.erase(std::remove(sessions.begin(), sessions.end(), session), sessions.end());
+
+    session->conn->close();
+    // 可能正处于该连接自己的回调中，推迟到下一轮再释放
+    event_poll_->run_later([session]() {});
+  }
+
+  void HttpClient::run_failures_(std::vector<Failure>& failures) {
+    stats_.failed += failures.size();
+    for (auto& [callback, err] : failures) {
+      if (callback) { callback(err, nullptr); }
+    }
+    failures.clear();
+  }
+
+  std::string HttpClient::serialize_(const std::string& host, uint16_t port, const HttpClientRequest& request) {
+    std::string out;
+    out.reserve(request.method.size() + request.target.size() + host.size() + request.body.size() + 128);
+    out.append(request.method).append(" ").append(request.target).append(" HTTP/1.1\r\n");
+
+    bool has_host   = false;
+    bool has_length = false;
+    for (const auto& [name, value] : request.headers) {
+      has_host   = has_host || http_iequals(name, "Host");
+      has_length = has_length || http_iequals(name, "Content-Length") || http_iequals(name, "Transfer-Encoding");
+      out.append(name).append(": ").append(value).append("\r\n");
+    }
+
+    if (!has_host) {
+      // IPv6 地址需要加方括号
+      bool ipv6 = host.find(':') != std::string::npos;
+      out.append("Host: ").append(ipv6 ? "[" : "").append(host).append(ipv6 ? "]" : "");
+      if (port != 80) { out.append(":").append(std::to_string(port)); }
+      out.append("\r\n");
+    }
+    bool needs_length = !request.body.empty() || request.method == "POST" || request.method == "PUT" ||
+                        request.method == "PATCH";
+    if (!has_length && needs_length) {
+      out.append("Content-Length: ").append(std::to_string(request.body.size())).append("\r\n");
+    }
+
+    out.append("\r\n").append(request.body);
+    return out;
+  }
+} // namespace cxpnet
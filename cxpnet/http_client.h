@@ -0,0 +1,102 @@
+﻿#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include "http.h"
+#include "sock.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cxpnet {
+  class Conn;
+  class IOEventPoll;
+
+  struct HttpClientOptions {
+    size_t      max_conns_per_host  = 8;    // 每个 host:port 的连接上限
+    size_t      max_pipeline        = 1;    // 每个连接的在途请求上限，大于 1 时开启流水线
+    size_t      max_queued_per_host = 1024; // 等待连接空闲的请求上限，超过立即以 ENOBUFS 失败
+    HttpLimits  limits;                     // 响应头部和 body 的上限
+    SockOptions sock_options {.tcp_nodelay = true};
+  };
+
+  struct HttpClientRequest {
+    std::string                                      method = "GET";
+    std::string                                      target = "/";
+    std::vector<std::pair<std::string, std::string>> headers; // 未给出 Host 时自动添加
+    std::string                                      body;    // 非空时自动添加 Content-Length
+  };
+
+  // 客户端统计，只在 poll 线程读写
+  struct HttpClientStats {
+    uint64_t connects  = 0; // 发起的 TCP 连接数
+    uint64_t requests  = 0; // 写出的请求数，含重试
+    uint64_t completed = 0;
+    uint64_t failed    = 0;
+    uint64_t retried   = 0; // 连接被对端关闭后重新发送的幂等请求
+  };
+
+  // HTTP/1.1 客户端：按 host:port 维护 keep-alive 连接池，可选流水线，响应增量解析
+  // 所有连接都在构造时给定的 IOEventPoll 上，回调在该 poll 线程上执行
+  // 非幂等请求 (POST / PATCH) 只在空闲连接上发送，也不会有请求排在它后面
+  // 连接在请求发出后被对端关闭时，幂等请求重新排队一次；排在 Connection: close 响应之后的请求直接重新排队
+  // host 需要是 IP 地址，不做 DNS 解析
+  class HttpClient : public NonCopyable {
+  public:
+    // err 为 0 时 response 有效，只在回调期间有效；否则 response 为空，err 为 errno 风格的错误码
+    using Callback = std::function<void(int err, const HttpClientResponse* response)>;
+
+    explicit HttpClient(IOEventPoll* event_poll, HttpClientOptions options = {});
+    // 在 poll 线程上析构，或 poll 已经停止运行，未完成的请求以 ECANCELED 失败
+    ~HttpClient();
+
+    // 任意线程可调用，HttpClient 需要活到回调执行完
+    void request(const std::string& host, uint16_t port, HttpClientRequest request, Callback callback);
+    void get(const std::string& host, uint16_t port, std::string target, Callback callback);
+    // poll 线程上调用，关闭所有连接，未完成的请求以 ECANCELED 失败
+    void close();
+
+    const HttpClientStats& stats() const { return stats_; }
+  private:
+    struct Pending {
+      std::string data; // 序列化好的请求，重试时重新发送
+      bool        head       = false;
+      bool        idempotent = true;
+      bool        retried    = false;
+      Callback    callback;
+    };
+    struct Endpoint;
+    struct Session;
+    using SessionPtr = std::shared_ptr<Session>;
+    using Failure    = std::pair<Callback, int>;
+
+    void     enqueue_(const std::string& host, uint16_t port, Pending pending);
+    void     dispatch_(Endpoint& endpoint);
+    Session* pick_session_(Endpoint& endpoint, const Pending& pending);
+    void     open_session_(Endpoint& endpoint);
+    void     on_connected_(Session& session);
+    void     on_connect_error_(const SessionPtr& session, int err);
+    void     on_message_(const SessionPtr& session, Buffer* buffer);
+    void     on_close_(const SessionPtr& session, int err);
+    // 交付一个完整响应，返回 false 表示该连接不能继续使用
+    bool     deliver_(const SessionPtr& session, Buffer* buffer, std::vector<Failure>& failures);
+    // 连接不可再用：从连接池移除，在途请求中可以重试的重新排队，其余的放入 failures
+    void     drop_session_(const SessionPtr& session, int err, std::vector<Failure>& failures);
+    // 最后执行失败回调，回调中可以再发请求
+    void     run_failures_(std::vector<Failure>& failures);
+
+    static std::string serialize_(const std::string& host, uint16_t port, const HttpClientRequest& request);
+
+    IOEventPoll*                                               event_poll_;
+    HttpClientOptions                                          options_;
+    std::unordered_map<std::string, std::unique_ptr<Endpoint>> endpoints_; // key 为 host:port
+    HttpClientStats                                            stats_;
+    uint64_t                                                   close_epoch_ = 0; // 每次 close() 加一，回调之后据此判断 endpoint 是否已释放
+  };
+} // namespace cxpnet
+
+#endif // HTTP_CLIENT_H
@@ -0,0 +1,81 @@
+﻿#include "http_server.h"
+#include "conn.h"
+
+namespace cxpnet {
+  // 解析器和响应对象跨请求复用；升级后 session 只活到切换回调的那次读回调结束
+  struct HttpServer::Session : ReplySession {
+    explicit Session(Conn* c, HttpLimits limits)
+        : ReplySession(c)
+        , parser(limits) { }
+
+    HttpRequestParser parser;
+    HttpRequest       request;
+    HttpResponse      response;
+    HttpUpgrade       upgrade; // 本次读回调结束时切换到的协议
+  };
+
+  void HttpServer::on_connection(const ConnPtr& conn) {
+    auto session = std::make_shared<Session>(conn.get(), limits_);
+    conn->set_conn_user_callbacks(
+        [this, session](Buffer* buffer) {
+          // 升级时本回调会被替换，先持有 session
+          auto keep = session;
+          on_message_(*keep, buffer);
+        },
+        nullptr);
+  }
+
+  void HttpServer::on_message_(Session& session, Buffer* buffer) {
+    if (session.begin(buffer)) { return; }
+
+    // 流水线上的请求依次处理，响应按请求顺序追加
+    while (true) {
+      HttpParseResult result = session.parser.parse(buffer, session.request);
+      if (result == HttpParseResult::kIncomplete) { break; }
+
+      if (result == HttpParseResult::kError) {
+        session.response.reset_error(session.parser.error_status());
+        session.response.serialize(session.out.get());
+        session.closing = true;
+        break;
+      }
+
+      session.response.reset(session.request);
+      if (upgrade_handler_ && session.request.has_header("Upgrade")) {
+        session.upgrade = upgrade_handler_(session.request, session.response, session.conn->shared_from_this());
+        if (session.upgrade.on_message) {
+          session.response.serialize(session.out.get());
+          session.parser.consume(buffer);
+          break;
+        }
+        // 升级被拒绝 (如握手非法返回 400) 时直接写出 response，否则按普通请求处理
+        if (session.response.status() == 200) {
+          session.response.reset(session.request);
+          handler_(session.request, session.response);
+        }
+      } else {
+        handler_(session.request, session.response);
+      }
+      session.response.serialize(session.out.get());
+      session.parser.consume(buffer);
+
+      if (!session.response.keep_alive()) {
+        session.closing = true;
+        break;
+      }
+    }
+
+    session.flush(buffer);
+    if (session.closing) { return; }
+
+    if (session.upgrade.on_message) {
+      // 替换回调后 session 只由 keep 持有，之后不再访问
+      HttpUpgrade upgrade    = std::move(session.upgrade);
+      Conn*       conn       = session.conn;
+      auto        on_message = upgrade.on_message;
+      conn->set_conn_user_callbacks(std::move(upgrade.on_message), std::move(upgrade.on_close));
+      if (upgrade.on_open) { upgrade.on_open(); }
+      if (!buffer->empty() && conn->connected()) { on_message(buffer); }
+    }
+  }
+} // namespace cxpnet
@@ -0,0 +1,46 @@
+﻿#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include "http.h"
+#include "server_session.h"
+
+#include <functional>
+
+namespace cxpnet {
+  // 协议升级后接管连接的回调，on_message 为空表示不升级
+  struct HttpUpgrade {
+    std::function<void(Buffer*)> on_message;
+    std::function<void(int)>     on_close;
+    std::function<void()>        on_open; // 应答写出之后、处理剩余数据之前调用
+  };
+
+  // HTTP/1.1 服务：keep-alive、流水线、chunked 请求体
+  // 处理函数在连接所在的 poll 线程上同步调用，填写 response 后返回
+  // 一次读回调中的所有响应先序列化到连接自己的输出缓冲，最后一次 send 写出
+  class HttpServer : public NonCopyable, public ServerAttachable<HttpServer> {
+  public:
+    using Handler        = std::function<void(const HttpRequest&, HttpResponse&)>;
+    using UpgradeHandler = std::function<HttpUpgrade(const HttpRequest&, HttpResponse&, const ConnPtr&)>;
+
+    explicit HttpServer(Handler handler, HttpLimits limits = {})
+        : handler_(std::move(handler))
+        , limits_(limits) { }
+
+    // 为 conn 建立请求解析状态并接管其消息回调；不经过 attach (如同一 Server 上按端口分流) 时直接调用
+    void on_connection(const ConnPtr& conn);
+    // 带 Upgrade 头的请求先交给 handler；返回的 on_message 非空时写出 response (如 101)，
+    // 之后连接上的数据 (含同一次读到的剩余字节) 都交给返回的回调；
+    // 返回空时若 response 状态被改为非 200 则直接写出，否则按普通请求交给 handler
+    void set_upgrade_handler(UpgradeHandler handler) { upgrade_handler_ = std::move(handler); }
+  private:
+    struct Session;
+
+    void on_message_(Session& session, Buffer* buffer);
+
+    Handler        handler_;
+    UpgradeHandler upgrade_handler_;
+    HttpLimits     limits_;
+  };
+} // namespace cxpnet
+
+#endif // HTTP_SERVER_H
@@ -4,6 +4,7 @@
 #include "platform_api.h"
 #include "poller_for_epoll.h"
 #include "timer.h"
+#include "trace.h"
 
 #if CXP_PLATFORM_MACOS
 #include "poller_for_kqueue.h"
@@ -17,9 +18,17 @@
 #include <vector>
 
 namespace cxpnet {
+  // busy_permille 统计窗口
+  static constexpr std::chrono::milliseconds kBusyWindow {100};
+
+  static thread_local IOEventPoll* t_current_poll = nullptr;
+
+  IOEventPoll* IOEventPoll::current() { return t_current_poll; }
+
   IOEventPoll::IOEventPoll()
       : on_err_func_ {nullptr} {
-    thread_id_ = std::this_thread::get_id();
+    thread_id_         = std::this_thread::get_id();
+    busy_window_start_ = std::chrono::steady_clock::now();
 
 #if CXP_PLATFORM_LINUX
     poller_ = std::make_unique<EpollPoller>(this);
@@ -51,13 +60,22 @@ namespace cxpnet {
     wakeup_read_fd_ = invalid_socket;
   }
 
-  void IOEventPoll::poll() {
+  void IOEventPoll::poll(uint32_t timeout_ms) {
     if (shut_.load(std::memory_order_acquire)) { return; }
-    poll_(0);
+
+    // 手动驱动时可能嵌套在另一个 poll 的回调里，返回前恢复
+    ran_.store(true, std::memory_order_release);
+    IOEventPoll* outer = t_current_poll;
+    t_current_poll     = this;
+    poll_(timeout_ms);
+    t_current_poll = outer;
   }
 
   void IOEventPoll::run() {
-    thread_id_ = std::this_thread::get_id();
+    thread_id_     = std::this_thread::get_id();
+    t_current_poll = this;
+    ran_.store(true, std::memory_order_release);
+    CXP_TRACE_THREAD_NAME(name_.empty() ? std::string_view("io_event_poll") : std::string_view(name_));
     while (true) {
       if (shut_.load(std::memory_order_acquire)) {
         std::vector<Closure> tmp_tasks;
@@ -75,6 +93,7 @@ namespace cxpnet {
 
       poll_(kPollTimeoutMS);
     }
+    t_current_poll = nullptr;
   }
 
   void IOEventPoll::shutdown() {
@@ -94,43 +113,120 @@ namespace cxpnet {
       return;
     }
 
-    std::lock_guard<std::mutex> lock(mutex_);
-    tasks_.push_back(std::move(func));
-    notify_wakeup_();
+    run_later(std::move(func));
   }
 
   void IOEventPoll::run_later(Closure func) {
+    CXP_TRACE_WRAP_TASK(func);
+
     std::lock_guard<std::mutex> lock(mutex_);
+    // 统计关闭时不取时间，记为空；之后打开统计时，这一批任务不计入排队时间
+    if (tasks_.empty()) {
+      oldest_task_time_ = stats_enabled_.load(std::memory_order_relaxed) ? std::chrono::steady_clock::now()
+                                                                         : std::chrono::steady_clock::time_point {};
+    }
     tasks_.push_back(std::move(func));
     notify_wakeup_();
   }
 
+  void IOEventPoll::set_slow_callback_options(SlowCallbackOptions options) {
+    slow_options_              = std::move(options);
+    slow_options_.sample_every = (std::max)(slow_options_.sample_every, uint32_t {1});
+    slow_threshold_ns_         = std::chrono::duration_cast<std::chrono::nanoseconds>(slow_options_.threshold).count();
+    slow_sample_tick_          = 0;
+  }
+
+  void IOEventPoll::note_callback_duration_(CallbackKind kind, const Conn* conn,
+                                            std::chrono::steady_clock::duration elapsed) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed);
+    if (ns.count() < slow_threshold_ns_) { return; }
+
+    ++slow_reported_;
+    stats_.record_slow_callback(kind, static_cast<uint64_t>(ns.count() / 1000));
+    if (slow_options_.handler) { slow_options_.handler(SlowCallback {kind, conn, name_, ns}); }
+  }
+
   void IOEventPoll::update_channel(Channel* channel) { poller_->update_channel(channel); }
   void IOEventPoll::remove_channel(Channel* channel) { poller_->remove_channel(channel); }
 
   void IOEventPoll::notify_wakeup_() { Platform::wakeup_write(wakeup_handle_); }
   void IOEventPoll::handle_wakeup_() { Platform::wakeup_read(wakeup_read_fd_); }
 
+  PollLoad IOEventPoll::load() const {
+    PollLoad load;
+    load.connections = conn_count_.load(std::memory_order_relaxed);
+
+    // 窗口长时间没有更新说明 loop 一直阻塞在 poll 里，视为空闲
+    int64_t window_end = busy_window_end_ns_.load(std::memory_order_relaxed);
+    int64_t now        = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+    if (now - window_end < 2 * std::chrono::duration_cast<std::chrono::nanoseconds>(kBusyWindow).count()) {
+      load.busy_permille = busy_permille_.load(std::memory_order_relaxed);
+    }
+
+    return load;
+  }
+
+  void IOEventPoll::update_busy_load_(std::chrono::steady_clock::time_point wake_time,
+                                      std::chrono::steady_clock::time_point done_time) {
+    busy_window_ns_ += done_time - wake_time;
+
+    auto elapsed = done_time - busy_window_start_;
+    if (elapsed < kBusyWindow) { return; }
+
+    auto permille = busy_window_ns_ * 1000 / elapsed;
+    busy_permille_.store(static_cast<uint32_t>((std::min)(permille, decltype(permille) {1000})), std::memory_order_relaxed);
+    busy_window_end_ns_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(done_time.time_since_epoch()).count(),
+                              std::memory_order_relaxed);
+    busy_window_start_ = done_time;
+    busy_window_ns_    = std::chrono::nanoseconds {0};
+  }
+
   void IOEventPoll::poll_(uint32_t poll_timeout) {
-    int result = 0;
-    int err    = 0;
+    using Clock = std::chrono::steady_clock;
+
+    int  result   = 0;
+    int  err      = 0;
+    bool stats_on = stats_enabled_.load(std::memory_order_relaxed);
+
+    Clock::time_point wait_start = stats_on ? Clock::now() : Clock::time_point {};
 
     active_channels_.clear();
-    result = poller_->poll(poll_timeout, active_channels_);
-    if (result < 0) { err = Platform::get_last_error(); }
+    {
+      CXP_TRACE_SCOPE("poll_wait", poll_timeout);
+      result = poller_->poll(poll_timeout, active_channels_);
+      if (result < 0) { err = Platform::get_last_error(); }
+    }
+    CXP_TRACE_INSTANT("poll_wakeup", active_channels_.size());
+
+    Clock::time_point wake_time = Clock::now();
 
     for (auto&& channel : active_channels_) {
+      CXP_TRACE_SCOPE("channel_dispatch", channel->handle());
       channel->handle_event();
     }
 
+    Clock::time_point channels_done = stats_on ? Clock::now() : wake_time;
+
     std::vector<Closure> tmp_tasks;
+    Clock::time_point    oldest_task_time;
     {
       std::lock_guard<std::mutex> lock(mutex_);
       tasks_.swap(tmp_tasks);
+      oldest_task_time = oldest_task_time_;
     }
 
     for (auto&& func : tmp_tasks) {
-      func();
+      run_user_callback_(CallbackKind::kTask, nullptr, func);
+    }
+
+    Clock::time_point done_time = Clock::now();
+    update_busy_load_(wake_time, done_time);
+
+    if (stats_on) {
+      stats_.record_iteration(wait_start, wake_time, channels_done, done_time,
+                              active_channels_.size(), tmp_tasks.size(), oldest_task_time);
     }
 
     if (err != 0 && err != EINTR && on_err_func_ != nullptr) {
@@ -2,11 +2,13 @@
 #define IO_POLL_H
 
 #include "platform_api.h"
+#include "poll_stats.h"
 #include "poller_base.h"
 #include "sock.h"
 #include "timer.h"
 
 #include <atomic>
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -16,13 +18,34 @@
 namespace cxpnet {
   class Channel;
   class Conn;
+  class SleepAwaiter;
+
+  // poll 负载，供 PollThreadPool 选择 poll，任意线程可读
+  struct PollLoad {
+    uint32_t connections   = 0; // 挂在该 poll 上的连接数
+    uint32_t busy_permille = 0; // 最近窗口内非阻塞时间占比 (千分比)
+  };
+
+  // 慢回调事件，在 poll 线程上传给 SlowCallbackOptions::handler
+  struct SlowCallback {
+    CallbackKind             kind;
+    const Conn*              conn; // kTask 时为 nullptr，只在 handler 调用期间有效
+    std::string_view         poll_name;
+    std::chrono::nanoseconds duration;
+  };
+
+  struct SlowCallbackOptions {
+    std::chrono::microseconds                threshold {0};    // 超过该耗时视为慢回调，0 表示关闭
+    uint32_t                                 sample_every = 1; // 每 N 次回调测量一次，减少 now() 的开销
+    std::function<void(const SlowCallback&)> handler;          // 可选，慢回调同时计入 stats()
+  };
 
   class IOEventPoll : public NonCopyable {
   public:
     IOEventPoll();
     ~IOEventPoll();
 
-    void poll(); // non-blocking
+    void poll(uint32_t timeout_ms = 0); // 默认不阻塞，timeout_ms > 0 时最多等待 timeout_ms 毫秒
     void run();  // blocking
     void shutdown();
     void run_in_poll(Closure func);
@@ -34,9 +57,55 @@ namespace cxpnet {
     std::string_view name() const { return name_; }
     bool             is_in_poll_thread() const { return thread_id_ == std::this_thread::get_id(); }
     bool             is_shutdown() const { return shut_.load(std::memory_order_acquire); }
+    // run / poll 至少调用过一次；从未运行的 poll 不会执行投递给它的任务
+    bool             has_run() const { return ran_.load(std::memory_order_acquire); }
+    // 调用线程正在 run / poll 的 IOEventPoll，不在任何 poll 线程上时返回 nullptr
+    static IOEventPoll* current();
     void             set_error_callback(std::function<void(IOEventPoll*, int)>&& func) { on_err_func_ = std::move(func); }
     TimerManager*    timer_manager() const { return timer_manager_.get(); }
+    PollLoad         load() const;
+
+    // 运行统计，默认开启，每次循环多 2 次 steady_clock::now()
+    // stats() 任意线程可调用
+    void              set_stats_enabled(bool enabled) { stats_enabled_.store(enabled, std::memory_order_relaxed); }
+    PollStatsSnapshot stats() const { return stats_.snapshot(); }
+
+    // 在 run / poll 之前调用
+    void set_slow_callback_options(SlowCallbackOptions options);
+
+    // co_await poll.sleep(ms)，见 coro.h
+    SleepAwaiter sleep(uint32_t ms);
   private:
+    friend class Conn;
+    friend class Server;
+
+    // 执行用户回调，开启慢回调检测时按采样间隔计时
+    // 嵌套时 (如任务中执行的连接回调) 只报告最内层的慢回调
+    template <typename Func>
+    void run_user_callback_(CallbackKind kind, const Conn* conn, Func&& func) {
+      if (slow_threshold_ns_ == 0 || ++slow_sample_tick_ < slow_options_.sample_every) {
+        func();
+        return;
+      }
+
+      slow_sample_tick_ = 0;
+      uint64_t reported = slow_reported_;
+      auto     start    = std::chrono::steady_clock::now();
+      func();
+      if (slow_reported_ == reported) {
+        note_callback_duration_(kind, conn, std::chrono::steady_clock::now() - start);
+      }
+    }
+    void note_callback_duration_(CallbackKind kind, const Conn* conn, std::chrono::steady_clock::duration elapsed);
+
+    void add_conn_load_() { conn_count_.fetch_add(1, std::memory_order_relaxed); }
+    void remove_conn_load_() { conn_count_.fetch_sub(1, std::memory_order_relaxed); }
+    void note_conn_io_(bool is_read, uint64_t bytes) {
+      if (stats_enabled_.load(std::memory_order_relaxed)) { stats_.record_io(is_read, bytes); }
+    }
+    void update_busy_load_(std::chrono::steady_clock::time_point wake_time,
+                           std::chrono::steady_clock::time_point done_time);
+
     void notify_wakeup_();
     void handle_wakeup_();
     void poll_(uint32_t poll_timeout);
@@ -51,8 +120,24 @@ namespace cxpnet {
     std::thread::id                        thread_id_;
     std::vector<Channel*>                  active_channels_;
     std::atomic<bool>                      shut_ {false};
+    std::atomic<bool>                      ran_ {false};
     std::function<void(IOEventPoll*, int)> on_err_func_;
     std::string                            name_;
+
+    std::atomic<uint32_t>                 conn_count_ {0};
+    std::atomic<uint32_t>                 busy_permille_ {0};
+    std::atomic<int64_t>                  busy_window_end_ns_ {0};
+    std::chrono::steady_clock::time_point busy_window_start_ {};
+    std::chrono::nanoseconds              busy_window_ns_ {0};
+
+    std::atomic<bool>                     stats_enabled_ {true};
+    PollStats                             stats_;
+    std::chrono::steady_clock::time_point oldest_task_time_ {}; // tasks_ 中最早入队任务的时间，统计关闭时入队为空，mutex_ 保护
+
+    SlowCallbackOptions slow_options_;
+    int64_t             slow_threshold_ns_ = 0; // 0 表示关闭
+    uint32_t            slow_sample_tick_  = 0; // 只在 poll 线程访问
+    uint64_t            slow_reported_     = 0; // 已报告的慢回调数，只在 poll 线程访问
   };
 } // namespace cxpnet
 
@@ -0,0 +1,217 @@
+﻿#include "metrics.h"
+#include "acceptor.h"
+#include "buffer.h"
+#include "conn.h"
+#include "io_event_poll.h"
+
+#include <format>
+#include <future>
+#include <string_view>
+
+namespace cxpnet {
+  void MetricsWriter::counter(std::string_view name, std::string_view help, double value, const Labels& labels) {
+    declare_(name, help, "counter");
+    sample_(name, "", labels, "", "", value);
+  }
+
+  void MetricsWriter::gauge(std::string_view name, std::string_view help, double value, const Labels& labels) {
+    declare_(name, help, "gauge");
+    sample_(name, "", labels, "", "", value);
+  }
+
+  void MetricsWriter::histogram(std::string_view name, std::string_view help, const HistogramSnapshot& snap,
+                                const Labels& labels, double scale) {
+    declare_(name, help, "histogram");
+
+    // 只在每个主桶 (2 的幂) 的边界输出 le，保证多次抓取之间边界一致，直到包含 max 的主桶为止
+    uint64_t cumulative = 0;
+    size_t   last_index = HistogramBuckets::index(snap.max);
+    for (size_t i = 0; i < HistogramSnapshot::kBucketCount && snap.count > 0; ++i) {
+      cumulative += snap.buckets[i];
+      if ((i + 1) % HistogramBuckets::kSubBucketCount != 0) { continue; }
+
+      double le = static_cast<double>(HistogramBuckets::upper_bound(i)) * scale;
+      sample_(name, "_bucket", labels, "le", std::format("{:.6g}", le), static_cast<double>(cumulative));
+      if (i >= last_index) { break; }
+    }
+    sample_(name, "_bucket", labels, "le", "+Inf", static_cast<double>(snap.count));
+    sample_(name, "_sum", labels, "", "", static_cast<double>(snap.sum) * scale);
+    sample_(name, "_count", labels, "", "", static_cast<double>(snap.count));
+  }
+
+  void MetricsWriter::declare_(std::string_view name, std::string_view help, std::string_view type) {
+    if (!declared_.emplace(name).second) { return; }
+
+    out_ += std::format("# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+  }
+
+  void MetricsWriter::sample_(std::string_view name, std::string_view suffix, const Labels& labels,
+                              std::string_view extra_label, std::string_view extra_value, double value) {
+    out_ += name;
+    out_ += suffix;
+
+    if (!labels.empty() || !extra_label.empty()) {
+      out_ += '{';
+      bool first = true;
+      auto append_label = [this, &first](std::string_view key, std::string_view label_value) {
+        if (!first) { out_ += ','; }
+        first = false;
+
+        out_ += key;
+        out_ += "=\"";
+        for (char c : label_value) {
+          if (c == '\\' || c == '"') {
+            out_ += '\\';
+            out_ += c;
+          } else if (c == '\n') {
+            out_ += "\\n";
+          } else {
+            out_ += c;
+          }
+        }
+        out_ += '"';
+      };
+
+      for (const auto& [key, label_value] : labels) { append_label(key, label_value); }
+      if (!extra_label.empty()) { append_label(extra_label, extra_value); }
+      out_ += '}';
+    }
+
+    out_ += std::format(" {}\n", value);
+  }
+
+  Counter& MetricsRegistry::counter(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& entry = counters_[name];
+    if (!entry.metric) {
+      entry.help   = help;
+      entry.metric = std::make_unique<Counter>();
+    }
+    return *entry.metric;
+  }
+
+  Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& entry = gauges_[name];
+    if (!entry.metric) {
+      entry.help   = help;
+      entry.metric = std::make_unique<Gauge>();
+    }
+    return *entry.metric;
+  }
+
+  Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, double scale) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& entry = histograms_[name];
+    if (!entry.metric) {
+      entry.help   = help;
+      entry.scale  = scale;
+      entry.metric = std::make_unique<Histogram>();
+    }
+    return *entry.metric;
+  }
+
+  void MetricsRegistry::add_collector(Collector collector) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    collectors_.push_back(std::move(collector));
+  }
+
+  std::string MetricsRegistry::render() const {
+    MetricsWriter               writer;
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (const auto& collector : collectors_) { collector(writer); }
+    for (const auto& [name, entry] : counters_) { writer.counter(name, entry.help, static_cast<double>(entry.metric->value())); }
+    for (const auto& [name, entry] : gauges_) {
+      writer.gauge(name, entry.help, static_cast<double>(entry.metric->value()));
+    }
+    for (const auto& [name, entry] : histograms_) {
+      writer.histogram(name, entry.help, entry.metric->snapshot(), {}, entry.scale);
+    }
+    return writer.text();
+  }
+
+  MetricsEndpoint::MetricsEndpoint(IOEventPoll* event_poll, const MetricsRegistry* registry)
+      : event_poll_(event_poll)
+      , registry_(registry) {
+    acceptor_ = std::make_unique<Acceptor>(event_poll_);
+    acceptor_->set_new_conn_callback(std::bind(&MetricsEndpoint::on_new_connection_, this,
+                                               std::placeholders::_1, std::placeholders::_2));
+  }
+
+  MetricsEndpoint::~MetricsEndpoint() { shutdown(); }
+
+  bool MetricsEndpoint::listen(const char* addr, uint16_t port) {
+    acceptor_->set_listen_addr(addr, port, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr);
+    return acceptor_->listen();
+  }
+
+  void MetricsEndpoint::shutdown() {
+    if (acceptor_) { acceptor_->shutdown(); }
+
+    if (event_poll_->is_in_poll_thread()) {
+      shutdown_in_poll_();
+      return;
+    }
+
+    if (event_poll_->is_shutdown()) {
+      conns_.clear();
+      return;
+    }
+
+    auto done   = std::make_shared<std::promise<void>>();
+    auto future = done->get_future();
+
+    event_poll_->run_in_poll([this, done]() {
+      shutdown_in_poll_();
+      done->set_value();
+    });
+
+    future.get();
+  }
+
+  void MetricsEndpoint::shutdown_in_poll_() {
+    auto conns = std::move(conns_);
+    conns_.clear();
+    for (auto& [handle, conn] : conns) { conn->close(); }
+  }
+
+  void MetricsEndpoint::on_new_connection_(int handle, struct sockaddr_storage addr_storage) {
+    (void)addr_storage;
+
+    auto conn = std::make_shared<Conn>(event_poll_, handle);
+    conn->set_close_timeout(kCloseTimeoutMS);
+
+    Conn* raw_conn = conn.get();
+    conn->set_conn_user_callbacks(
+        [this, raw_conn](Buffer* buffer) { on_message_(raw_conn, buffer); },
+        [this, handle](int) { conns_.erase(handle); });
+
+    conns_[handle] = conn;
+    conn->start_();
+  }
+
+  void MetricsEndpoint::on_message_(Conn* conn, Buffer* buffer) {
+    if (buffer->find("\r\n\r\n") == Buffer::npos) {
+      if (buffer->readable_size() > kMaxRequestSize) { conn->close(); }
+      return;
+    }
+
+    std::string_view request(buffer->peek(), buffer->readable_size());
+
+    bool        found = request.starts_with("GET /metrics ") || request.starts_with("GET /metrics?");
+    std::string body  = found ? registry_->render() : std::string("not found\n");
+    std::string response =
+        std::format("HTTP/1.1 {}\r\n"
+                    "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                    "Content-Length: {}\r\n"
+                    "Connection: close\r\n"
+                    "\r\n",
+                    found ? "200 OK" : "404 Not Found", body.size());
+    response += body;
+
+    buffer->been_read(buffer->readable_size());
+    conn->send(response);
+    conn->shutdown();
+  }
+} // namespace cxpnet
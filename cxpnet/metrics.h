@@ -0,0 +1,126 @@
+﻿#ifndef METRICS_H
+#define METRICS_H
+
+#include "histogram.h"
+#include "sock.h"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace cxpnet {
+  class Acceptor;
+  class Buffer;
+  class IOEventPoll;
+
+  // 多线程计数器，add 只写本线程的 shard，value 合并所有 shard
+  class Counter : public NonCopyable {
+  public:
+    void add(uint64_t n = 1) { single_writer_add(shards_.local().value, n); }
+
+    uint64_t value() const {
+      uint64_t total = 0;
+      shards_.for_each([&total](const Shard& shard) { total += shard.value.load(std::memory_order_relaxed); });
+      return total;
+    }
+  private:
+    struct alignas(64) Shard {
+      std::atomic<uint64_t> value {0};
+    };
+
+    ThreadShards<Shard> shards_;
+  };
+
+  class Gauge : public NonCopyable {
+  public:
+    void    set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+    void    add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+  private:
+    std::atomic<int64_t> value_ {0};
+  };
+
+  // Prometheus 文本格式 (0.0.4) 输出
+  // 同名指标的所有样本必须连续写出，HELP / TYPE 只在第一次出现时写入
+  class MetricsWriter {
+  public:
+    using Labels = std::vector<std::pair<std::string_view, std::string_view>>;
+
+    void counter(std::string_view name, std::string_view help, double value, const Labels& labels = {});
+    void gauge(std::string_view name, std::string_view help, double value, const Labels& labels = {});
+    // scale 把快照中的值换算为指标单位，如快照为微秒、指标为秒时传 1e-6
+    void histogram(std::string_view name, std::string_view help, const HistogramSnapshot& snap,
+                   const Labels& labels = {}, double scale = 1.0);
+
+    const std::string& text() const { return out_; }
+  private:
+    void declare_(std::string_view name, std::string_view help, std::string_view type);
+    void sample_(std::string_view name, std::string_view suffix, const Labels& labels,
+                 std::string_view extra_label, std::string_view extra_value, double value);
+
+    std::string                     out_;
+    std::unordered_set<std::string> declared_;
+  };
+
+  // 指标注册表
+  // 注册和抓取持锁，记录路径 (Counter::add / Histogram::record 等) 不持锁
+  // collector 在抓取时调用，用于导出已有的统计 (poll / accept / timer 等)，不需要在数据路径上重复计数
+  class MetricsRegistry : public NonCopyable {
+  public:
+    using Collector = std::function<void(MetricsWriter&)>;
+
+    // 同名指标只创建一次，返回的引用在注册表销毁前一直有效
+    Counter&   counter(const std::string& name, const std::string& help);
+    Gauge&     gauge(const std::string& name, const std::string& help);
+    Histogram& histogram(const std::string& name, const std::string& help, double scale = 1.0);
+
+    void        add_collector(Collector collector);
+    std::string render() const;
+  private:
+    template <typename T>
+    struct Entry {
+      std::string        help;
+      double             scale = 1.0;
+      std::unique_ptr<T> metric;
+    };
+
+    mutable std::mutex                      mutex_;
+    std::map<std::string, Entry<Counter>>   counters_;
+    std::map<std::string, Entry<Gauge>>     gauges_;
+    std::map<std::string, Entry<Histogram>> histograms_;
+    std::vector<Collector>                  collectors_;
+  };
+
+  // 在 event_poll 上提供 GET /metrics，只用于本地抓取，不是通用的 HTTP 服务器
+  // 每个请求渲染一次 registry 后关闭连接
+  class MetricsEndpoint : public NonCopyable {
+  public:
+    MetricsEndpoint(IOEventPoll* event_poll, const MetricsRegistry* registry);
+    ~MetricsEndpoint();
+
+    bool listen(const char* addr, uint16_t port);
+    void shutdown();
+  private:
+    void shutdown_in_poll_();
+    void on_new_connection_(int handle, struct sockaddr_storage addr_storage);
+    void on_message_(Conn* conn, Buffer* buffer);
+  private:
+    static constexpr size_t   kMaxRequestSize = 8192;
+    static constexpr uint32_t kCloseTimeoutMS = 5000;
+
+    IOEventPoll*                     event_poll_;
+    const MetricsRegistry*           registry_;
+    std::unique_ptr<Acceptor>        acceptor_;
+    std::unordered_map<int, ConnPtr> conns_; // 只在 poll 线程访问
+  };
+} // namespace cxpnet
+
+#endif // METRICS_H
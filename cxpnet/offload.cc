@@ -0,0 +1,228 @@
+﻿#include "offload.h"
+#include "ensure.h"
+#include "io_event_poll.h"
+#include "platform_api.h"
+#include "trace.h"
+
+#include <deque>
+
+namespace cxpnet {
+  // 每个工作线程的队列，独占缓存行，避免相邻队列的锁互相干扰
+  struct alignas(64) OffloadExecutor::Worker {
+    std::mutex          mutex;
+    std::deque<Closure> tasks;
+  };
+
+  // 一个 poll 上待执行的后续回调，scheduled 时已有一次 run_in_poll 在途
+  // dead 表示在途的那次 run_in_poll 没有执行就被 poll 丢弃，之后同一地址上的 poll 需要新的 mailbox
+  struct OffloadExecutor::Mailbox {
+    std::mutex           mutex;
+    std::vector<Closure> items;
+    bool                 scheduled = false;
+    std::atomic<bool>    dead {false};
+  };
+
+  namespace {
+    // 当前线程所属的 executor 和队列下标，用于工作线程上派生的任务
+    thread_local const OffloadExecutor* tls_executor     = nullptr;
+    thread_local size_t                 tls_worker_index = 0;
+
+    // 交给 poll 的一批后续回调；poll 停止后任务队列随 poll 析构，闭包没有执行就被销毁时
+    // 丢弃这批回调并把 mailbox 标记为失效，否则 scheduled 一直为 true，之后的回调再也不会提交
+    template <typename Mailbox>
+    class MailboxBatch : public NonCopyable {
+    public:
+      explicit MailboxBatch(std::shared_ptr<Mailbox> mailbox)
+          : mailbox_(std::move(mailbox)) { }
+      ~MailboxBatch() {
+        if (!mailbox_) { return; }
+
+        std::vector<Closure> dropped;
+        {
+          std::lock_guard<std::mutex> lock(mailbox_->mutex);
+          dropped.swap(mailbox_->items);
+          mailbox_->scheduled = false;
+          mailbox_->dead.store(true, std::memory_order_release);
+        }
+      }
+
+      void run() {
+        std::shared_ptr<Mailbox> mailbox = std::move(mailbox_);
+        std::vector<Closure>     batch;
+        {
+          std::lock_guard<std::mutex> lock(mailbox->mutex);
+          batch.swap(mailbox->items);
+          mailbox->scheduled = false;
+        }
+        for (auto& then_on_poll : batch) { then_on_poll(); }
+      }
+    private:
+      std::shared_ptr<Mailbox> mailbox_;
+    };
+  } // namespace
+
+  OffloadExecutor::OffloadExecutor(OffloadOptions options)
+      : options_(std::move(options)) {
+    size_t n = options_.threads;
+    if (n == 0) { n = (std::max)(std::thread::hardware_concurrency(), 1u); }
+
+    workers_.reserve(n);
+    for (size_t i = 0; i < n; ++i) { workers_.push_back(std::make_unique<Worker>()); }
+    threads_.reserve(n);
+    for (size_t i = 0; i < n; ++i) { threads_.emplace_back(&OffloadExecutor::worker_func_, this, i); }
+  }
+
+  OffloadExecutor::~OffloadExecutor() {
+    shutdown();
+  }
+
+  void OffloadExecutor::post(Closure work) {
+    ENSURE(work, "OffloadExecutor::post: empty work");
+    ENSURE(!stop_.load(std::memory_order_acquire) || tls_executor == this, "OffloadExecutor::post after shutdown");
+
+    posted_.fetch_add(1, std::memory_order_relaxed);
+    push_(std::move(work));
+  }
+
+  void OffloadExecutor::post(IOEventPoll* poll, Closure work, Closure then_on_poll) {
+    ENSURE(poll != nullptr, "OffloadExecutor::post: null poll");
+    post([this, poll, work = std::move(work), then_on_poll = std::move(then_on_poll)]() mutable {
+      work();
+      if (then_on_poll) { deliver_(poll, std::move(then_on_poll)); }
+    });
+  }
+
+  void OffloadExecutor::shutdown() {
+    if (joined_) { return; }
+    ENSURE(tls_executor != this, "OffloadExecutor::shutdown called on a worker thread");
+
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stop_.store(true, std::memory_order_release);
+    }
+    sleep_cv_.notify_all();
+
+    for (auto& t : threads_) { t.join(); }
+    joined_ = true;
+  }
+
+  OffloadStats OffloadExecutor::stats() const {
+    OffloadStats s;
+    s.posted    = posted_.load(std::memory_order_relaxed);
+    s.completed = completed_.load(std::memory_order_relaxed);
+    s.stolen    = stolen_.load(std::memory_order_relaxed);
+    s.delivered = delivered_.load(std::memory_order_relaxed);
+    s.batches   = batches_.load(std::memory_order_relaxed);
+    return s;
+  }
+
+  void OffloadExecutor::push_(Closure task) {
+    size_t index = tls_executor == this ? tls_worker_index
+                                        : next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    {
+      std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+      workers_[index]->tasks.push_back(std::move(task));
+    }
+
+    // 先增加 queued_ 再读 sleepers_，与 worker_func_ 中相反的顺序配合，不会丢失唤醒
+    queued_.fetch_add(1);
+    if (sleepers_.load() > 0) {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      sleep_cv_.notify_one();
+    }
+  }
+
+  bool OffloadExecutor::pop_(size_t index, Closure& task) {
+    {
+      Worker&                     own = *workers_[index];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (!own.tasks.empty()) {
+        task = std::move(own.tasks.back());
+        own.tasks.pop_back();
+        queued_.fetch_sub(1);
+        return true;
+      }
+    }
+
+    size_t n = workers_.size();
+    for (size_t i = 1; i < n; ++i) {
+      Worker&                      victim = *workers_[(index + i) % n];
+      std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+      if (!lock.owns_lock() || victim.tasks.empty()) { continue; }
+
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      queued_.fetch_sub(1);
+      stolen_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    return false;
+  }
+
+  void OffloadExecutor::worker_func_(size_t index) {
+    tls_executor     = this;
+    tls_worker_index = index;
+
+    std::string name = options_.name + "-" + std::to_string(index);
+    Platform::set_thread_name(name);
+    CXP_TRACE_THREAD_NAME(name);
+
+    Closure task;
+    while (true) {
+      if (pop_(index, task)) {
+        task();
+        task = nullptr;
+        completed_.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+
+      // try_lock 偷取失败时 queued_ 仍大于 0，重新扫描而不是睡眠
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      if (queued_.load() > 0) { continue; }
+      if (stop_.load(std::memory_order_acquire)) { break; }
+
+      sleepers_.fetch_add(1);
+      sleep_cv_.wait(lock, [this]() { return queued_.load() > 0 || stop_.load(std::memory_order_acquire); });
+      sleepers_.fetch_sub(1);
+    }
+
+    tls_executor = nullptr;
+  }
+
+  std::shared_ptr<OffloadExecutor::Mailbox> OffloadExecutor::mailbox_(IOEventPoll* poll) {
+    std::lock_guard<std::mutex> lock(mailbox_mutex_);
+    auto                        it = mailboxes_.find(poll);
+    if (it != mailboxes_.end() && !it->second->dead.load(std::memory_order_acquire)) { return it->second; }
+
+    // 新 poll 第一次交付时顺带清理已析构 poll 留下的失效 mailbox
+    std::erase_if(mailboxes_, [](const auto& entry) { return entry.second->dead.load(std::memory_order_acquire); });
+    auto mailbox     = std::make_shared<Mailbox>();
+    mailboxes_[poll] = mailbox;
+    return mailbox;
+  }
+
+  // 只有 mailbox 从空变为非空时才提交一次 run_in_poll，poll 线程执行时取走整批
+  void OffloadExecutor::deliver_(IOEventPoll* poll, Closure then_on_poll) {
+    // poll 已经停止，then 不会执行；之后在同一地址上创建的 poll 重新分配 mailbox
+    if (poll->is_shutdown()) {
+      std::lock_guard<std::mutex> lock(mailbox_mutex_);
+      mailboxes_.erase(poll);
+      return;
+    }
+
+    std::shared_ptr<Mailbox> mailbox = mailbox_(poll);
+    delivered_.fetch_add(1, std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> lock(mailbox->mutex);
+      mailbox->items.push_back(std::move(then_on_poll));
+      if (mailbox->scheduled) { return; }
+      mailbox->scheduled = true;
+    }
+
+    // 闭包持有 mailbox，executor 先于 poll 析构时也能执行
+    batches_.fetch_add(1, std::memory_order_relaxed);
+    auto batch = std::make_shared<MailboxBatch<Mailbox>>(std::move(mailbox));
+    poll->run_in_poll([batch = std::move(batch)]() { batch->run(); });
+  }
+} // namespace cxpnet
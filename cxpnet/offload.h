@@ -0,0 +1,100 @@
+﻿#ifndef OFFLOAD_H
+#define OFFLOAD_H
+
+#include "sock.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cxpnet {
+  class IOEventPoll;
+
+  struct OffloadOptions {
+    size_t      threads = 0;         // 工作线程数，0 表示 hardware_concurrency
+    std::string name    = "offload"; // 线程名前缀，第 i 个线程名为 name-i
+  };
+
+  // 统计，任意线程可读
+  struct OffloadStats {
+    uint64_t posted    = 0;
+    uint64_t completed = 0;
+    uint64_t stolen    = 0; // 从其他线程的队列偷来执行的任务
+    uint64_t delivered = 0; // 交回 poll 线程执行的后续回调
+    uint64_t batches   = 0; // 交付批次，每批一次 run_in_poll
+  };
+
+  // 阻塞任务卸载：磁盘 I/O、压缩等耗时工作交给工作线程，不阻塞 poll 线程上的其他连接
+  // 每个工作线程一个双端队列，本线程从尾部取 (LIFO)，空闲线程从其他队列头部偷 (FIFO)
+  // post(poll, work, then) 在工作线程上执行 work，再把 then 交回 poll 线程执行
+  // 同一 poll 上连续完成的后续回调合并为一批，只唤醒 poll 一次
+  // work 不应抛出异常；poll 已经停止时 then 不会执行
+  class OffloadExecutor : public NonCopyable {
+  public:
+    explicit OffloadExecutor(OffloadOptions options = {});
+    // 执行完已提交的任务后退出
+    ~OffloadExecutor();
+
+    // 任意线程可调用，工作线程上提交的任务放入本线程的队列
+    void post(Closure work);
+    // then_on_poll 在 poll 线程上执行
+    void post(IOEventPoll* poll, Closure work, Closure then_on_poll);
+    // work 的返回值传给 then_on_poll，如 post(poll, [] { return read_file(); }, [](std::string data) { ... })
+    template <typename Work, typename Then>
+      requires(!std::is_void_v<std::invoke_result_t<Work&>>)
+    void post(IOEventPoll* poll, Work work, Then then_on_poll) {
+      using Result = std::decay_t<std::invoke_result_t<Work&>>;
+      auto result  = std::make_shared<std::optional<Result>>();
+      post(
+          poll,
+          [work = std::move(work), result]() mutable { result->emplace(work()); },
+          [then_on_poll = std::move(then_on_poll), result]() mutable { then_on_poll(std::move(**result)); });
+    }
+
+    // 不再接受新任务 (工作线程上派生的除外)，执行完已提交的任务后等待线程退出
+    // 不能在工作线程上调用
+    void shutdown();
+
+    size_t       thread_num() const { return workers_.size(); }
+    OffloadStats stats() const;
+  private:
+    struct Worker;
+    struct Mailbox;
+
+    void                     push_(Closure task);
+    bool                     pop_(size_t index, Closure& task);
+    void                     worker_func_(size_t index);
+    std::shared_ptr<Mailbox> mailbox_(IOEventPoll* poll);
+    void                     deliver_(IOEventPoll* poll, Closure then_on_poll);
+
+    OffloadOptions                       options_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread>             threads_;
+    std::atomic<size_t>                  next_ {0};     // 外部提交时轮流选队列
+    std::atomic<size_t>                  queued_ {0};   // 所有队列中的任务数
+    std::atomic<size_t>                  sleepers_ {0}; // 等待中的工作线程数
+    std::atomic<bool>                    stop_ {false};
+    bool                                 joined_ = false;
+    std::mutex                           sleep_mutex_;
+    std::condition_variable              sleep_cv_;
+
+    std::mutex                                                 mailbox_mutex_;
+    std::unordered_map<IOEventPoll*, std::shared_ptr<Mailbox>> mailboxes_;
+
+    std::atomic<uint64_t> posted_ {0};
+    std::atomic<uint64_t> completed_ {0};
+    std::atomic<uint64_t> stolen_ {0};
+    std::atomic<uint64_t> delivered_ {0};
+    std::atomic<uint64_t> batches_ {0};
+  };
+} // namespace cxpnet
+
+#endif // OFFLOAD_H
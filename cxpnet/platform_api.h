@@ -25,11 +25,37 @@ namespace cxpnet {
     static int              get_last_error();
     static ErrorAction      handle_error_action(int err);
     static sockaddr_storage get_sockaddr(const char* address, uint16_t port, ProtocolStack stack);
-    static int              listen(sockaddr_storage addr_storage, ProtocolStack proto_stack, int option);
-    static int              accept(int listen_handle, std::vector<std::pair<int, sockaddr_storage>>& accepted_handles);
-    static int              connect(sockaddr_storage addr_storage, bool async = true, uint32_t timeout_ms = 5000);
+    // sock_options 只取 send_buffer_size / recv_buffer_size，在 listen 前设置，accept 到的连接继承
+    static int              listen(sockaddr_storage addr_storage, ProtocolStack proto_stack, int option,
+                                   const ListenOptions& listen_options = {}, const SockOptions& sock_options = {});
+    // 最多 accept max_count 个连接，返回 0 或错误码 (EMFILE 等)
+    static int              accept(int listen_handle, std::vector<std::pair<int, sockaddr_storage>>& accepted_handles,
+                                   size_t max_count = SIZE_MAX);
+    // 预留的空闲 fd，fd 耗尽 (EMFILE/ENFILE) 时临时释放，accept 一个连接后立即关闭
+    // 避免连接一直留在 backlog 里让边沿触发的 listen fd 再也不被唤醒
+    static int              open_idle_fd();
+    static bool             reject_pending(int listen_handle, int& idle_fd);
+    // async、sock_options.fastopen 且 first_payload 非空时，首包随 SYN 发出，否则为普通 connect
+    // payload_sent 返回已被内核接收的首包字节数，剩余部分由调用方在握手完成后发送
+    static int              connect(sockaddr_storage addr_storage, bool async = true, uint32_t timeout_ms = 5000,
+                                    const SockOptions& sock_options = {},
+                                    std::string_view   first_payload = {}, size_t* payload_sent = nullptr);
     static void             shut_wr(int fd);
 
+    // 尽力应用所有选项，任一失败返回 false，不影响其余选项
+    static bool apply_sock_options(int fd, const SockOptions& sock_options);
+    // TCP_QUICKACK 不是持久选项，内核会自动复位，需在每次读后重新设置
+    static void rearm_quickack(int fd);
+
+    static bool get_tcp_info(int fd, TcpInfo& info);
+
+    // 线程设置，均作用于调用线程
+    static bool set_thread_affinity(const std::vector<int>& cpus); // macOS 不支持绑核，返回 false
+    static void set_thread_name(std::string_view name);            // Linux 最长 15 字节，超出截断
+    // 把调用线程的内存分配策略设为优先当前 CPU 所在的 NUMA 节点
+    // 之后该线程首次访问的页 (Buffer 等) 从本地节点分配，应在绑核之后调用，macOS 返回 false
+    static bool bind_memory_to_local_node();
+
     // wakeup 机制: Linux 使用 eventfd, macOS 使用 pipe
     static int  create_wakeup_fd();         // 创建 wakeup fd，返回写端
     static int  get_wakeup_read_fd(int fd); // macOS 需要，Linux 返回相同值
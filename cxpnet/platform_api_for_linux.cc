@@ -2,10 +2,20 @@
 #include "platform_api.h"
 #include "sock.h"
 
+#include <algorithm>
+#include <cstring>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/syscall.h>
 
 namespace cxpnet {
+  static bool set_int_option(int fd, int level, int name, int value) {
+    return ::setsockopt(fd, level, name, &value, sizeof(value)) != SOCKET_ERROR;
+  }
+
   void Platform::close_handle(int fd) { close(fd); }
 
   bool Platform::set_non_blocking(int fd) {
@@ -74,7 +84,8 @@ namespace cxpnet {
     return addr_storage;
   }
 
-  int Platform::listen(sockaddr_storage addr_storage, ProtocolStack proto_stack, int option) {
+  int Platform::listen(sockaddr_storage addr_storage, ProtocolStack proto_stack, int option,
+                        const ListenOptions& listen_options, const SockOptions& sock_options) {
     if (addr_storage.ss_family == 0) { return invalid_socket; }
 
     int handle = ::socket(addr_storage.ss_family, SOCK_STREAM, IPPROTO_TCP);
@@ -119,6 +130,19 @@ namespace cxpnet {
       return invalid_socket;
     }
 
+    // 内核不支持 (net.ipv4.tcp_fastopen 未开启服务端) 时退化为普通握手，不视为错误
+    if (listen_options.fastopen_queue > 0) {
+      set_int_option(handle, IPPROTO_TCP, TCP_FASTOPEN, listen_options.fastopen_queue);
+    }
+
+    if (listen_options.defer_accept_s > 0) {
+      set_int_option(handle, IPPROTO_TCP, TCP_DEFER_ACCEPT, listen_options.defer_accept_s);
+    }
+
+    // 窗口扩大因子在握手时按 listen socket 的 SO_RCVBUF 协商，accept 之后再设置已经无效
+    if (sock_options.send_buffer_size > 0) { set_int_option(handle, SOL_SOCKET, SO_SNDBUF, sock_options.send_buffer_size); }
+    if (sock_options.recv_buffer_size > 0) { set_int_option(handle, SOL_SOCKET, SO_RCVBUF, sock_options.recv_buffer_size); }
+
     if (::listen(handle, SOMAXCONN) == SOCKET_ERROR) {
       close_handle(handle);
       return invalid_socket;
@@ -127,10 +151,11 @@ namespace cxpnet {
     return handle;
   }
 
-  int Platform::accept(int listen_handle, std::vector<std::pair<int, struct sockaddr_storage>>& accepted_handles) {
+  int Platform::accept(int listen_handle, std::vector<std::pair<int, struct sockaddr_storage>>& accepted_handles,
+                        size_t max_count) {
     if (listen_handle == -1) { return -1; }
 
-    while (true) {
+    while (accepted_handles.size() < max_count) {
       sockaddr_storage remote_addr_storage = {};
       socklen_t        addr_len            = sizeof(remote_addr_storage);
       // 使用 accept4 实现非阻塞 accept
@@ -151,7 +176,10 @@ namespace cxpnet {
     return 0;
   }
 
-  int Platform::connect(sockaddr_storage addr_storage, bool async, uint32_t timeout_ms) {
+  int Platform::connect(sockaddr_storage addr_storage, bool async, uint32_t timeout_ms,
+                         const SockOptions& sock_options,
+                         std::string_view first_payload, size_t* payload_sent) {
+    if (payload_sent != nullptr) { *payload_sent = 0; }
     if (addr_storage.ss_family == 0) { return -1; }
 
     int handle = socket(addr_storage.ss_family, SOCK_STREAM, IPPROTO_TCP);
@@ -162,10 +190,33 @@ namespace cxpnet {
       return -1;
     }
 
+    // SO_RCVBUF 等选项需在握手前设置才能影响窗口协商，失败不阻止连接
+    apply_sock_options(handle, sock_options);
+
     size_t addr_len = 0;
     if (addr_storage.ss_family == AF_INET) { addr_len = sizeof(sockaddr_in); }
     if (addr_storage.ss_family == AF_INET6) { addr_len = sizeof(sockaddr_in6); }
 
+    // TCP Fast Open: sendto + MSG_FASTOPEN 代替 connect，首包随 SYN 发出
+    // 没有 cookie 时内核只发送带 cookie 请求的 SYN 并返回 EINPROGRESS，首包需握手后重发
+    // 不使用 TCP_FASTOPEN_CONNECT: 它让没有首包的 connect 直接返回 0 而不发 SYN，握手失败只能在发送时才发现
+    if (async && sock_options.fastopen && !first_payload.empty()) {
+      ssize_t sent = ::sendto(handle, first_payload.data(), first_payload.size(), MSG_FASTOPEN | MSG_NOSIGNAL,
+                              reinterpret_cast<sockaddr*>(&addr_storage), static_cast<socklen_t>(addr_len));
+      if (sent >= 0) {
+        if (payload_sent != nullptr) { *payload_sent = static_cast<size_t>(sent); }
+        return handle;
+      }
+
+      // EOPNOTSUPP: 内核未开启客户端 TFO，退化为普通 connect
+      int err = get_last_error();
+      if (err == EINPROGRESS) { return handle; }
+      if (err != EOPNOTSUPP) {
+        close_handle(handle);
+        return invalid_socket;
+      }
+    }
+
     // EINPROGRESS is mean of async operation is in progress, ignore this error code
     int result = ::connect(handle, reinterpret_cast<sockaddr*>(&addr_storage), addr_len);
     if (result == 0) { return handle; }
@@ -201,10 +252,92 @@ namespace cxpnet {
     return handle;
   }
 
+  int Platform::open_idle_fd() {
+    return ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+  }
+
+  bool Platform::reject_pending(int listen_handle, int& idle_fd) {
+    if (idle_fd == invalid_socket) { return false; }
+
+    close_handle(idle_fd);
+    int handle = ::accept(listen_handle, nullptr, nullptr);
+    if (handle != invalid_socket) { close_handle(handle); }
+    idle_fd = open_idle_fd();
+
+    return handle != invalid_socket;
+  }
+
   void Platform::shut_wr(int fd) {
     ::shutdown(fd, SHUT_WR);
   }
 
+  bool Platform::apply_sock_options(int fd, const SockOptions& opts) {
+    bool ok = true;
+    if (opts.tcp_nodelay) { ok &= set_int_option(fd, IPPROTO_TCP, TCP_NODELAY, 1); }
+    if (opts.keepalive) {
+      ok &= set_int_option(fd, SOL_SOCKET, SO_KEEPALIVE, 1);
+      if (opts.keepalive_idle_s > 0) { ok &= set_int_option(fd, IPPROTO_TCP, TCP_KEEPIDLE, opts.keepalive_idle_s); }
+      if (opts.keepalive_intvl_s > 0) { ok &= set_int_option(fd, IPPROTO_TCP, TCP_KEEPINTVL, opts.keepalive_intvl_s); }
+      if (opts.keepalive_count > 0) { ok &= set_int_option(fd, IPPROTO_TCP, TCP_KEEPCNT, opts.keepalive_count); }
+    }
+    if (opts.send_buffer_size > 0) { ok &= set_int_option(fd, SOL_SOCKET, SO_SNDBUF, opts.send_buffer_size); }
+    if (opts.recv_buffer_size > 0) { ok &= set_int_option(fd, SOL_SOCKET, SO_RCVBUF, opts.recv_buffer_size); }
+    if (opts.notsent_lowat > 0) { ok &= set_int_option(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, opts.notsent_lowat); }
+    if (opts.quickack) { ok &= set_int_option(fd, IPPROTO_TCP, TCP_QUICKACK, 1); }
+#ifdef SO_BUSY_POLL
+    if (opts.busy_poll_us > 0) { ok &= set_int_option(fd, SOL_SOCKET, SO_BUSY_POLL, opts.busy_poll_us); }
+#endif
+    return ok;
+  }
+
+  void Platform::rearm_quickack(int fd) {
+    set_int_option(fd, IPPROTO_TCP, TCP_QUICKACK, 1);
+  }
+
+  bool Platform::get_tcp_info(int fd, TcpInfo& info) {
+    struct tcp_info raw {};
+    socklen_t       len = sizeof(raw);
+    if (::getsockopt(fd, IPPROTO_TCP, TCP_INFO, &raw, &len) == SOCKET_ERROR) { return false; }
+
+    info.rtt_us        = raw.tcpi_rtt;
+    info.rttvar_us     = raw.tcpi_rttvar;
+    info.snd_cwnd      = raw.tcpi_snd_cwnd;
+    info.unacked       = raw.tcpi_unacked;
+    info.lost          = raw.tcpi_lost;
+    info.total_retrans = raw.tcpi_total_retrans;
+    return true;
+  }
+
+  bool Platform::set_thread_affinity(const std::vector<int>& cpus) {
+    if (cpus.empty()) { return false; }
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : cpus) {
+      if (cpu >= 0 && cpu < CPU_SETSIZE) { CPU_SET(cpu, &cpu_set); }
+    }
+
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+  }
+
+  void Platform::set_thread_name(std::string_view name) {
+    char buf[16] = {0};
+    std::memcpy(buf, name.data(), (std::min)(name.size(), sizeof(buf) - 1));
+    ::pthread_setname_np(::pthread_self(), buf);
+  }
+
+  bool Platform::bind_memory_to_local_node() {
+    unsigned cpu  = 0;
+    unsigned node = 0;
+    if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) { return false; }
+
+    static constexpr unsigned kBitsPerMask = sizeof(unsigned long) * 8;
+    if (node >= kBitsPerMask) { return false; }
+
+    unsigned long node_mask = 1UL << node;
+    return ::syscall(SYS_set_mempolicy, MPOL_PREFERRED, &node_mask, kBitsPerMask) == 0;
+  }
+
   // 使用 eventfd 实现 wakeup
   int Platform::create_wakeup_fd() {
     int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
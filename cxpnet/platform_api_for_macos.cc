@@ -2,6 +2,7 @@
 #include "platform_api.h"
 #include "sock.h"
 
+#include <pthread.h>
 #include <sys/event.h>
 
 #include <unordered_map>
@@ -11,7 +12,12 @@ namespace cxpnet {
   // 使用 unordered_map 存储映射，避免 pipe fd 不连续假设
   static std::unordered_map<int, int> g_wakeup_fd_map;
   static std::mutex                   g_wakeup_fd_map_mutex;
-  void                                Platform::close_handle(int fd) { close(fd); }
+
+  static bool set_int_option(int fd, int level, int name, int value) {
+    return ::setsockopt(fd, level, name, &value, sizeof(value)) != SOCKET_ERROR;
+  }
+
+  void Platform::close_handle(int fd) { close(fd); }
 
   bool Platform::set_non_blocking(int fd) {
     int option = fcntl(fd, F_GETFL, 0);
@@ -79,7 +85,8 @@ namespace cxpnet {
     return addr_storage;
   }
 
-  int Platform::listen(sockaddr_storage addr_storage, ProtocolStack proto_stack, int option) {
+  int Platform::listen(sockaddr_storage addr_storage, ProtocolStack proto_stack, int option,
+                        const ListenOptions& listen_options, const SockOptions& sock_options) {
     if (addr_storage.ss_family == 0) { return invalid_socket; }
 
     int handle = ::socket(addr_storage.ss_family, SOCK_STREAM, IPPROTO_TCP);
@@ -119,6 +126,15 @@ namespace cxpnet {
       return invalid_socket;
     }
 
+    // macOS 的 TCP_FASTOPEN 只是开关，队列长度由系统决定；没有 TCP_DEFER_ACCEPT
+    if (listen_options.fastopen_queue > 0) {
+      set_int_option(handle, IPPROTO_TCP, TCP_FASTOPEN, 1);
+    }
+
+    // 窗口扩大因子在握手时按 listen socket 的 SO_RCVBUF 协商，accept 之后再设置已经无效
+    if (sock_options.send_buffer_size > 0) { set_int_option(handle, SOL_SOCKET, SO_SNDBUF, sock_options.send_buffer_size); }
+    if (sock_options.recv_buffer_size > 0) { set_int_option(handle, SOL_SOCKET, SO_RCVBUF, sock_options.recv_buffer_size); }
+
     if (::listen(handle, SOMAXCONN) == SOCKET_ERROR) {
       close_handle(handle);
       return invalid_socket;
@@ -127,10 +143,11 @@ namespace cxpnet {
     return handle;
   }
 
-  int Platform::accept(int listen_handle, std::vector<std::pair<int, struct sockaddr_storage>>& accepted_handles) {
+  int Platform::accept(int listen_handle, std::vector<std::pair<int, struct sockaddr_storage>>& accepted_handles,
+                        size_t max_count) {
     if (listen_handle == -1) { return -1; }
 
-    while (true) {
+    while (accepted_handles.size() < max_count) {
       sockaddr_storage remote_addr_storage = {};
       socklen_t        addr_len            = sizeof(remote_addr_storage);
       // macOS 没有 accept4，使用 accept + fcntl
@@ -158,7 +175,10 @@ namespace cxpnet {
     return 0;
   }
 
-  int Platform::connect(sockaddr_storage addr_storage, bool async, uint32_t timeout_ms) {
+  int Platform::connect(sockaddr_storage addr_storage, bool async, uint32_t timeout_ms,
+                         const SockOptions& sock_options,
+                         std::string_view first_payload, size_t* payload_sent) {
+    if (payload_sent != nullptr) { *payload_sent = 0; }
     if (addr_storage.ss_family == 0) { return -1; }
 
     int handle = socket(addr_storage.ss_family, SOCK_STREAM, IPPROTO_TCP);
@@ -169,10 +189,32 @@ namespace cxpnet {
       return -1;
     }
 
+    // SO_RCVBUF 等选项需在握手前设置才能影响窗口协商，失败不阻止连接
+    apply_sock_options(handle, sock_options);
+
     size_t addr_len = 0;
     if (addr_storage.ss_family == AF_INET) { addr_len = sizeof(sockaddr_in); }
     if (addr_storage.ss_family == AF_INET6) { addr_len = sizeof(sockaddr_in6); }
 
+    // TCP Fast Open: connectx + CONNECT_DATA_IDEMPOTENT，首包随 SYN 发出
+    if (async && sock_options.fastopen && !first_payload.empty()) {
+      sa_endpoints_t endpoints {};
+      endpoints.sae_dstaddr    = reinterpret_cast<sockaddr*>(&addr_storage);
+      endpoints.sae_dstaddrlen = static_cast<socklen_t>(addr_len);
+
+      iovec  iov {const_cast<char*>(first_payload.data()), first_payload.size()};
+      size_t sent   = 0;
+      int    result = ::connectx(handle, &endpoints, SAE_ASSOCID_ANY, CONNECT_DATA_IDEMPOTENT,
+                                 &iov, 1, &sent, nullptr);
+      if (result == 0 || get_last_error() == EINPROGRESS) {
+        if (payload_sent != nullptr) { *payload_sent = sent; }
+        return handle;
+      }
+
+      close_handle(handle);
+      return invalid_socket;
+    }
+
     // EINPROGRESS is mean of async operation is in progress, ignore this error code
     int result = ::connect(handle, reinterpret_cast<sockaddr*>(&addr_storage), addr_len);
     if (result == 0) { return handle; }
@@ -208,10 +250,69 @@ namespace cxpnet {
     return handle;
   }
 
+  int Platform::open_idle_fd() {
+    return ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+  }
+
+  bool Platform::reject_pending(int listen_handle, int& idle_fd) {
+    if (idle_fd == invalid_socket) { return false; }
+
+    close_handle(idle_fd);
+    int handle = ::accept(listen_handle, nullptr, nullptr);
+    if (handle != invalid_socket) { close_handle(handle); }
+    idle_fd = open_idle_fd();
+
+    return handle != invalid_socket;
+  }
+
   void Platform::shut_wr(int fd) {
     ::shutdown(fd, SHUT_WR);
   }
 
+  // macOS 不支持 TCP_QUICKACK / SO_BUSY_POLL，对应字段忽略；fastopen 由 connect 处理
+  bool Platform::apply_sock_options(int fd, const SockOptions& opts) {
+    bool ok = true;
+    if (opts.tcp_nodelay) { ok &= set_int_option(fd, IPPROTO_TCP, TCP_NODELAY, 1); }
+    if (opts.keepalive) {
+      ok &= set_int_option(fd, SOL_SOCKET, SO_KEEPALIVE, 1);
+      if (opts.keepalive_idle_s > 0) { ok &= set_int_option(fd, IPPROTO_TCP, TCP_KEEPALIVE, opts.keepalive_idle_s); }
+      if (opts.keepalive_intvl_s > 0) { ok &= set_int_option(fd, IPPROTO_TCP, TCP_KEEPINTVL, opts.keepalive_intvl_s); }
+      if (opts.keepalive_count > 0) { ok &= set_int_option(fd, IPPROTO_TCP, TCP_KEEPCNT, opts.keepalive_count); }
+    }
+    if (opts.send_buffer_size > 0) { ok &= set_int_option(fd, SOL_SOCKET, SO_SNDBUF, opts.send_buffer_size); }
+    if (opts.recv_buffer_size > 0) { ok &= set_int_option(fd, SOL_SOCKET, SO_RCVBUF, opts.recv_buffer_size); }
+    if (opts.notsent_lowat > 0) { ok &= set_int_option(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, opts.notsent_lowat); }
+    return ok;
+  }
+
+  void Platform::rearm_quickack(int fd) { (void)fd; }
+
+  bool Platform::get_tcp_info(int fd, TcpInfo& info) {
+    struct tcp_connection_info raw {};
+    socklen_t                  len = sizeof(raw);
+    if (::getsockopt(fd, IPPROTO_TCP, TCP_CONNECTION_INFO, &raw, &len) == SOCKET_ERROR) { return false; }
+
+    info.rtt_us        = raw.tcpi_srtt * 1000;
+    info.rttvar_us     = raw.tcpi_rttvar * 1000;
+    info.snd_cwnd      = raw.tcpi_snd_cwnd;
+    info.total_retrans = raw.tcpi_txretransmitpackets;
+    return true;
+  }
+
+  // macOS 只提供 THREAD_AFFINITY_POLICY 亲和性提示，不能绑定到指定 CPU
+  bool Platform::set_thread_affinity(const std::vector<int>& cpus) {
+    (void)cpus;
+    return false;
+  }
+
+  // macOS 的 pthread_setname_np 只能设置当前线程
+  void Platform::set_thread_name(std::string_view name) {
+    std::string thread_name(name);
+    ::pthread_setname_np(thread_name.c_str());
+  }
+
+  bool Platform::bind_memory_to_local_node() { return false; }
+
   // macOS 使用 pipe 实现 wakeup
   // 返回写端 fd，读端通过 get_wakeup_read_fd 获取
   int Platform::create_wakeup_fd() {
@@ -0,0 +1,139 @@
+﻿#ifndef POLL_STATS_H
+#define POLL_STATS_H
+
+#include "histogram.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace cxpnet {
+  // 在 poll 线程上执行的用户回调类型，用于慢回调检测
+  enum class CallbackKind : uint8_t {
+    kConnection, // Server::set_conn_user_callback / Conn::connect 的 on_connected
+    kMessage,    // on_message_func_
+    kClose,      // on_close_func_
+    kTask,       // run_in_poll / run_later 投递的任务
+  };
+  inline constexpr size_t kCallbackKindCount = 4;
+
+  inline const char* callback_kind_name(CallbackKind kind) {
+    switch (kind) {
+    case CallbackKind::kConnection:
+      return "connection";
+    case CallbackKind::kMessage:
+      return "message";
+    case CallbackKind::kClose:
+      return "close";
+    case CallbackKind::kTask:
+      return "task";
+    }
+    return "unknown";
+  }
+
+  // IOEventPoll 运行统计快照，时间单位为纳秒，直方图单位见字段注释
+  struct PollStatsSnapshot {
+    uint64_t iterations = 0; // poll 循环次数
+    uint64_t wait_ns    = 0; // 阻塞在 epoll_wait / kevent 中的时间
+    uint64_t channel_ns = 0; // 分发 channel 事件的时间
+    uint64_t task_ns    = 0; // 执行 run_in_poll / run_later 任务的时间
+    uint64_t events     = 0; // 分发的 channel 事件数
+    uint64_t tasks      = 0; // 执行的任务数
+    uint64_t bytes_in   = 0; // 该 poll 上所有连接读到的字节数
+    uint64_t bytes_out  = 0; // 该 poll 上所有连接写出的字节数
+
+    HistogramSnapshot iteration_us;      // 单次循环处理耗时 (不含等待)，微秒
+    HistogramSnapshot events_per_wakeup; // 每次唤醒的事件数
+    HistogramSnapshot task_queue_depth;  // 每批任务数
+    HistogramSnapshot task_wait_us;      // 每批中最早入队的任务等待执行的时间，微秒
+
+    std::array<uint64_t, kCallbackKindCount> slow_callbacks {}; // 按 CallbackKind 统计的慢回调次数
+    HistogramSnapshot                        slow_callback_us;  // 慢回调耗时，微秒
+
+    // 非阻塞时间占比 (0 ~ 1)
+    double utilization() const {
+      uint64_t total = wait_ns + channel_ns + task_ns;
+      return total == 0 ? 0.0 : static_cast<double>(channel_ns + task_ns) / total;
+    }
+  };
+
+  // IOEventPoll 内部使用，只由 poll 线程写入
+  class PollStats {
+  public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    void record_iteration(TimePoint wait_start, TimePoint wake_time, TimePoint channels_done, TimePoint done_time,
+                          size_t events, size_t tasks, TimePoint oldest_task_time) {
+      uint64_t wait_ns    = to_ns_(wake_time - wait_start);
+      uint64_t channel_ns = to_ns_(channels_done - wake_time);
+      uint64_t task_ns    = to_ns_(done_time - channels_done);
+
+      single_writer_add(iterations_, 1);
+      single_writer_add(wait_ns_, wait_ns);
+      single_writer_add(channel_ns_, channel_ns);
+      single_writer_add(task_ns_, task_ns);
+      single_writer_add(events_, events);
+      single_writer_add(tasks_, tasks);
+
+      iteration_us_.record((channel_ns + task_ns) / 1000);
+      if (events > 0) { events_per_wakeup_.record(events); }
+      if (tasks > 0) {
+        task_queue_depth_.record(tasks);
+        // 入队时统计还没有打开，没有入队时间
+        if (oldest_task_time != TimePoint {}) { task_wait_us_.record(to_ns_(channels_done - oldest_task_time) / 1000); }
+      }
+    }
+
+    void record_io(bool is_read, uint64_t bytes) { single_writer_add(is_read ? bytes_in_ : bytes_out_, bytes); }
+
+    void record_slow_callback(CallbackKind kind, uint64_t us) {
+      single_writer_add(slow_callbacks_[static_cast<size_t>(kind)], 1);
+      slow_callback_us_.record(us);
+    }
+
+    PollStatsSnapshot snapshot() const {
+      PollStatsSnapshot snap;
+      snap.iterations        = iterations_.load(std::memory_order_relaxed);
+      snap.wait_ns           = wait_ns_.load(std::memory_order_relaxed);
+      snap.channel_ns        = channel_ns_.load(std::memory_order_relaxed);
+      snap.task_ns           = task_ns_.load(std::memory_order_relaxed);
+      snap.events            = events_.load(std::memory_order_relaxed);
+      snap.tasks             = tasks_.load(std::memory_order_relaxed);
+      snap.bytes_in          = bytes_in_.load(std::memory_order_relaxed);
+      snap.bytes_out         = bytes_out_.load(std::memory_order_relaxed);
+      snap.iteration_us      = iteration_us_.snapshot();
+      snap.events_per_wakeup = events_per_wakeup_.snapshot();
+      snap.task_queue_depth  = task_queue_depth_.snapshot();
+      snap.task_wait_us      = task_wait_us_.snapshot();
+      for (size_t i = 0; i < kCallbackKindCount; ++i) {
+        snap.slow_callbacks[i] = slow_callbacks_[i].load(std::memory_order_relaxed);
+      }
+      snap.slow_callback_us = slow_callback_us_.snapshot();
+      return snap;
+    }
+  private:
+    static uint64_t to_ns_(std::chrono::steady_clock::duration d) {
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+      return ns > 0 ? static_cast<uint64_t>(ns) : 0;
+    }
+
+    std::atomic<uint64_t> iterations_ {0};
+    std::atomic<uint64_t> wait_ns_ {0};
+    std::atomic<uint64_t> channel_ns_ {0};
+    std::atomic<uint64_t> task_ns_ {0};
+    std::atomic<uint64_t> events_ {0};
+    std::atomic<uint64_t> tasks_ {0};
+    std::atomic<uint64_t> bytes_in_ {0};
+    std::atomic<uint64_t> bytes_out_ {0};
+    HistogramShard        iteration_us_;
+    HistogramShard        events_per_wakeup_;
+    HistogramShard        task_queue_depth_;
+    HistogramShard        task_wait_us_;
+
+    std::array<std::atomic<uint64_t>, kCallbackKindCount> slow_callbacks_ {};
+    HistogramShard                                        slow_callback_us_;
+  };
+} // namespace cxpnet
+
+#endif // POLL_STATS_H
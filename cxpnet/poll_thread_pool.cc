@@ -7,8 +7,23 @@ namespace cxpnet {
     if (polls_.empty()) { return; }
 
     threads_.reserve(polls_.size());
-    for (IOEventPoll* poll : polls_) {
-      threads_.emplace_back(std::make_unique<std::thread>([poll]() {
+    for (size_t i = 0; i < polls_.size(); ++i) {
+      IOEventPoll*     poll = polls_[i];
+      std::vector<int> cpus;
+      if (!thread_options_.cpu_sets.empty()) {
+        cpus = thread_options_.cpu_sets[i % thread_options_.cpu_sets.size()];
+      }
+
+      threads_.emplace_back(std::make_unique<std::thread>([poll, cpus = std::move(cpus), options = thread_options_]() {
+        if (options.name_threads && !poll->name().empty()) {
+          Platform::set_thread_name(poll->name());
+        }
+
+        bool pinned = !cpus.empty() && Platform::set_thread_affinity(cpus);
+        if (pinned && options.numa_local_memory) {
+          Platform::bind_memory_to_local_node();
+        }
+
         poll->run();
       }));
     }
@@ -32,11 +47,99 @@ namespace cxpnet {
     }
   }
 
-  IOEventPoll* PollThreadPool::next_poll() {
+  IOEventPoll* PollThreadPool::next_poll(const sockaddr_storage* remote_addr) {
     if (polls_.empty()) { return nullptr; }
+    if (polls_.size() == 1) { return polls_[0]; }
+
+    size_t index = 0;
+    switch (strategy_) {
+    case PollSelectStrategy::kLeastConnections:
+      index = least_loaded_index_(false);
+      break;
+    case PollSelectStrategy::kLeastBusy:
+      index = least_loaded_index_(true);
+      break;
+    case PollSelectStrategy::kPowerOfTwoChoices:
+      index = power_of_two_index_();
+      break;
+    case PollSelectStrategy::kAddressHash:
+      if (remote_addr != nullptr) {
+        index = address_hash_index_(*remote_addr);
+        break;
+      }
+      [[fallthrough]];
+    case PollSelectStrategy::kRoundRobin:
+    default:
+      index = next_.fetch_add(1, std::memory_order_relaxed) % polls_.size();
+      break;
+    }
 
-    size_t index = next_.fetch_add(1, std::memory_order_relaxed) % polls_.size();
     return polls_[index];
   }
 
+  // 从轮转的起点开始扫描，负载相同时依次分散，而不是总落在第一个 poll
+  size_t PollThreadPool::least_loaded_index_(bool by_busy) {
+    size_t n     = polls_.size();
+    size_t start = next_.fetch_add(1, std::memory_order_relaxed) % n;
+    size_t best  = start;
+
+    PollLoad best_load = polls_[start]->load();
+    for (size_t i = 1; i < n; ++i) {
+      size_t   index = (start + i) % n;
+      PollLoad load  = polls_[index]->load();
+
+      bool better = by_busy ? (load.busy_permille < best_load.busy_permille ||
+                               (load.busy_permille == best_load.busy_permille && load.connections < best_load.connections))
+                            : load.connections < best_load.connections;
+      if (better) {
+        best      = index;
+        best_load = load;
+      }
+    }
+
+    return best;
+  }
+
+  size_t PollThreadPool::power_of_two_index_() {
+    // xorshift64，每个线程一份状态，next_poll 可以在任意线程并发调用
+    static thread_local uint64_t rand_state = 0;
+    if (rand_state == 0) { rand_state = reinterpret_cast<uintptr_t>(&rand_state) | 1; }
+    auto next_rand = []() {
+      rand_state ^= rand_state << 13;
+      rand_state ^= rand_state >> 7;
+      rand_state ^= rand_state << 17;
+      return rand_state;
+    };
+
+    size_t n      = polls_.size();
+    size_t first  = next_rand() % n;
+    size_t second = (first + 1 + next_rand() % (n - 1)) % n;
+
+    PollLoad a = polls_[first]->load();
+    PollLoad b = polls_[second]->load();
+    if (a.connections != b.connections) { return a.connections < b.connections ? first : second; }
+    return a.busy_permille <= b.busy_permille ? first : second;
+  }
+
+  size_t PollThreadPool::address_hash_index_(const sockaddr_storage& addr) const {
+    const uint8_t* bytes = nullptr;
+    size_t         size  = 0;
+    if (addr.ss_family == AF_INET) {
+      bytes = reinterpret_cast<const uint8_t*>(&reinterpret_cast<const sockaddr_in*>(&addr)->sin_addr);
+      size  = sizeof(in_addr);
+    } else if (addr.ss_family == AF_INET6) {
+      bytes = reinterpret_cast<const uint8_t*>(&reinterpret_cast<const sockaddr_in6*>(&addr)->sin6_addr);
+      size  = sizeof(in6_addr);
+    }
+
+    // FNV-1a，只哈希 IP 不含端口，同一客户端的多个连接落在同一 poll
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+
+    return hash % polls_.size();
+  }
+
 } // namespace cxpnet
@@ -1,6 +1,8 @@
 ﻿#ifndef POLL_THREAD_POOL_H
 #define POLL_THREAD_POOL_H
 
+#include "sock.h"
+
 #include <atomic>
 #include <memory>
 #include <thread>
@@ -8,6 +10,23 @@
 
 namespace cxpnet {
   class IOEventPoll;
+
+  // sub poll 线程设置，在线程启动时由线程自身应用
+  struct PollThreadOptions {
+    // 第 i 个 poll 绑定到 cpu_sets[i % cpu_sets.size()]，为空则不绑核
+    std::vector<std::vector<int>> cpu_sets;
+    // 以 IOEventPoll::name() 命名系统线程，便于 top -H / perf 区分
+    bool name_threads = true;
+    // 绑核后把线程内存策略设为本地 NUMA 节点，连接的 Buffer 在 poll 线程中分配
+    bool numa_local_memory = false;
+  };
+
+  // 新连接选择 sub poll 的策略，负载数据来自 IOEventPoll::load()
+  // kRoundRobin:         轮询
+  // kLeastConnections:   连接数最少
+  // kLeastBusy:          最近窗口内 loop 忙碌占比最低，相同时比较连接数
+  // kPowerOfTwoChoices:  随机取两个，选连接数少的
+  // kAddressHash:        按客户端 IP 哈希，同一客户端固定落在同一 poll
   class PollThreadPool {
   public:
     PollThreadPool(const std::vector<IOEventPoll*>& event_polls)
@@ -23,12 +42,21 @@ namespace cxpnet {
 
     void         start();
     void         shutdown();
-    IOEventPoll* next_poll();
+    IOEventPoll* next_poll(const sockaddr_storage* remote_addr = nullptr);
+    const std::vector<IOEventPoll*>& polls() const { return polls_; }
+    void         set_select_strategy(PollSelectStrategy strategy) { strategy_ = strategy; }
+    void         set_thread_options(const PollThreadOptions& options) { thread_options_ = options; }
+  private:
+    size_t least_loaded_index_(bool by_busy);
+    size_t power_of_two_index_();
+    size_t address_hash_index_(const sockaddr_storage& addr) const;
   private:
     std::vector<IOEventPoll*>                 polls_;
     std::vector<std::unique_ptr<std::thread>> threads_;
     std::atomic<size_t>                       next_; // 改为 atomic 类型，确保线程安全
     std::atomic<bool>                         shut_;
+    PollSelectStrategy                        strategy_ = PollSelectStrategy::kRoundRobin;
+    PollThreadOptions                         thread_options_;
   };
 } // namespace cxpnet
 
@@ -0,0 +1,247 @@
+﻿#include "resp.h"
+
+#include <charconv>
+#include <cstring>
+
+namespace cxpnet {
+  namespace {
+    constexpr size_t kMaxNumberLine = 32; // "*" / "$" / ":" 之后的数字行
+
+    enum class LineResult { kOk, kIncomplete, kError };
+
+    char ascii_lower(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; }
+
+    // 从 pos 开始查找以 CRLF 结尾的一行，line_end 指向 '\r'
+    LineResult find_line(const char* data, size_t size, size_t pos, size_t max_line, size_t& line_end) {
+      size_t      limit = (std::min)(size - pos, max_line + 2);
+      const char* cr    = static_cast<const char*>(std::memchr(data + pos, '\r', limit));
+      if (cr == nullptr) { return size - pos >= max_line + 2 ? LineResult::kError : LineResult::kIncomplete; }
+
+      line_end = static_cast<size_t>(cr - data);
+      if (line_end + 1 >= size) { return LineResult::kIncomplete; }
+      return data[line_end + 1] == '\n' ? LineResult::kOk : LineResult::kError;
+    }
+
+    bool parse_int(const char* first, const char* last, int64_t& value) {
+      if (first == last) { return false; }
+      auto [ptr, ec] = std::from_chars(first, last, value);
+      return ec == std::errc() && ptr == last;
+    }
+
+    // pos 指向类型字节之后，解析数字行，pos 移到下一行开头
+    LineResult parse_number_line(const char* data, size_t size, size_t& pos, int64_t& value) {
+      size_t     line_end = 0;
+      LineResult result   = find_line(data, size, pos, kMaxNumberLine, line_end);
+      if (result != LineResult::kOk) { return result; }
+      if (!parse_int(data + pos, data + line_end, value)) { return LineResult::kError; }
+      pos = line_end + 2;
+      return LineResult::kOk;
+    }
+  } // namespace
+
+  bool RespCommand::is(std::string_view name) const {
+    if (args.empty() || args[0].size() != name.size()) { return false; }
+    for (size_t i = 0; i < name.size(); ++i) {
+      if (ascii_lower(args[0][i]) != ascii_lower(name[i])) { return false; }
+    }
+    return true;
+  }
+
+  RespParseResult RespCommandParser::parse(Buffer* buffer, RespCommand& command) {
+    if (buffer->empty() || need_more_(buffer)) { return RespParseResult::kIncomplete; }
+
+    const char* data = buffer->peek();
+    size_t      size = buffer->readable_size();
+    command.args.clear();
+    if (data[0] != '*') { return parse_inline_(data, size, command); }
+
+    size_t     pos    = 1;
+    int64_t    count  = 0;
+    LineResult result = parse_number_line(data, size, pos, count);
+    if (result == LineResult::kIncomplete) { return incomplete_(size + 1); }
+    if (result == LineResult::kError) { return fail_("invalid multibulk length"); }
+    // Redis 把 *0 和 *-1 当作空命令跳过
+    if (count <= 0) { return complete_(pos); }
+    if (static_cast<uint64_t>(count) > limits_.max_args) { return fail_("invalid multibulk length"); }
+
+    for (int64_t i = 0; i < count; ++i) {
+      if (pos >= size) { return incomplete_(pos + 1); }
+      if (data[pos] != '$') { return fail_("expected '$'"); }
+
+      ++pos;
+      int64_t length = 0;
+      result         = parse_number_line(data, size, pos, length);
+      if (result == LineResult::kIncomplete) { return incomplete_(size + 1); }
+      if (result == LineResult::kError || length < 0 || static_cast<uint64_t>(length) > limits_.max_bulk_size) {
+        return fail_("invalid bulk length");
+      }
+
+      size_t bulk_size = static_cast<size_t>(length);
+      if (size - pos < bulk_size + 2) { return incomplete_(pos + bulk_size + 2); }
+      if (data[pos + bulk_size] != '\r' || data[pos + bulk_size + 1] != '\n') { return fail_("bulk not terminated by CRLF"); }
+      command.args.emplace_back(data + pos, bulk_size);
+      pos += bulk_size + 2;
+    }
+    return complete_(pos);
+  }
+
+  RespParseResult RespCommandParser::parse_inline_(const char* data, size_t size, RespCommand& command) {
+    size_t      limit = (std::min)(size, limits_.max_inline_size);
+    const char* lf    = static_cast<const char*>(std::memchr(data, '\n', limit));
+    if (lf == nullptr) {
+      if (size >= limits_.max_inline_size) { return fail_("too big inline request"); }
+      return incomplete_(size + 1);
+    }
+
+    // 按空白切分，不支持引号
+    size_t line_size = static_cast<size_t>(lf - data);
+    size_t end       = line_size > 0 && data[line_size - 1] == '\r' ? line_size - 1 : line_size;
+    size_t pos       = 0;
+    while (pos < end) {
+      while (pos < end && (data[pos] == ' ' || data[pos] == '\t')) { ++pos; }
+      size_t start = pos;
+      while (pos < end && data[pos] != ' ' && data[pos] != '\t') { ++pos; }
+      if (pos > start) { command.args.emplace_back(data + start, pos - start); }
+    }
+    return complete_(line_size + 1);
+  }
+
+  RespParseResult RespReplyParser::parse(Buffer* buffer, RespReply& reply) {
+    if (buffer->empty() || need_more_(buffer)) { return RespParseResult::kIncomplete; }
+
+    const char* data = buffer->peek();
+    size_t      size = buffer->readable_size();
+    size_t      pos  = 0;
+    reply.elements.clear();
+
+    // 先序展开：每解析出一个 n 元素数组，剩余待解析的值加 n
+    uint64_t remaining = 1;
+    bool     first     = true;
+    while (remaining > 0) {
+      if (pos >= size) { return incomplete_(pos + 1); }
+
+      RespReply::Value value;
+      char             type   = data[pos++];
+      LineResult       result = LineResult::kOk;
+      if (type == '+' || type == '-') {
+        size_t line_end = 0;
+        result          = find_line(data, size, pos, limits_.max_inline_size, line_end);
+        if (result == LineResult::kOk) {
+          value.type = type == '+' ? RespType::kSimpleString : RespType::kError;
+          value.str  = std::string_view(data + pos, line_end - pos);
+          pos        = line_end + 2;
+        }
+      } else if (type == ':') {
+        value.type = RespType::kInteger;
+        result     = parse_number_line(data, size, pos, value.integer);
+      } else if (type == '$') {
+        int64_t length = 0;
+        result         = parse_number_line(data, size, pos, length);
+        if (result == LineResult::kOk) {
+          if (length < 0) {
+            value.type = RespType::kNullBulkString;
+          } else if (static_cast<uint64_t>(length) > limits_.max_bulk_size) {
+            return fail_("invalid bulk length");
+          } else {
+            size_t bulk_size = static_cast<size_t>(length);
+            if (size - pos < bulk_size + 2) { return incomplete_(pos + bulk_size + 2); }
+            if (data[pos + bulk_size] != '\r' || data[pos + bulk_size + 1] != '\n') {
+              return fail_("bulk not terminated by CRLF");
+            }
+            value.type = RespType::kBulkString;
+            value.str  = std::string_view(data + pos, bulk_size);
+            pos += bulk_size + 2;
+          }
+        }
+      } else if (type == '*') {
+        result = parse_number_line(data, size, pos, value.integer);
+        if (result == LineResult::kOk) {
+          if (value.integer < 0) {
+            value.type    = RespType::kNullArray;
+            value.integer = 0;
+          } else if (static_cast<uint64_t>(value.integer) > limits_.max_args) {
+            return fail_("invalid multibulk length");
+          } else {
+            value.type = RespType::kArray;
+            remaining += static_cast<uint64_t>(value.integer);
+          }
+        }
+      } else {
+        return fail_("invalid reply type");
+      }
+
+      if (result == LineResult::kIncomplete) { return incomplete_(size + 1); }
+      if (result == LineResult::kError) { return fail_("invalid reply line"); }
+      // 展开后 elements 的最终大小：已展开的加上待解析的，顶层值本身不在 elements 中
+      if (reply.elements.size() + remaining - (first ? 1 : 0) > limits_.max_args) {
+        return fail_("too many reply elements");
+      }
+
+      if (first) {
+        reply.value = value;
+        first       = false;
+      } else {
+        reply.elements.push_back(value);
+      }
+      --remaining;
+    }
+    return complete_(pos);
+  }
+
+  void RespWriter::simple_string(std::string_view s) {
+    out_->ensure_writable_size(s.size() + 3);
+    char* p = out_->to_write();
+    *p++    = '+';
+    std::memcpy(p, s.data(), s.size());
+    p += s.size();
+    *p++ = '\r';
+    *p++ = '\n';
+    out_->been_written(s.size() + 3);
+  }
+
+  void RespWriter::error(std::string_view message) {
+    out_->ensure_writable_size(message.size() + 3);
+    char* p = out_->to_write();
+    *p++    = '-';
+    std::memcpy(p, message.data(), message.size());
+    p += message.size();
+    *p++ = '\r';
+    *p++ = '\n';
+    out_->been_written(message.size() + 3);
+  }
+
+  void RespWriter::integer(int64_t value) { header_(':', value); }
+
+  void RespWriter::bulk(std::string_view data) {
+    header_('$', static_cast<int64_t>(data.size()));
+    out_->ensure_writable_size(data.size() + 2);
+    char* p = out_->to_write();
+    if (!data.empty()) { std::memcpy(p, data.data(), data.size()); }
+    p[data.size()]     = '\r';
+    p[data.size() + 1] = '\n';
+    out_->been_written(data.size() + 2);
+  }
+
+  void RespWriter::array(size_t count) { header_('*', static_cast<int64_t>(count)); }
+
+  void RespWriter::command(Buffer* out, std::initializer_list<std::string_view> args) {
+    command(out, args.begin(), args.size());
+  }
+
+  void RespWriter::command(Buffer* out, const std::string_view* args, size_t count) {
+    RespWriter writer(out);
+    writer.array(count);
+    for (size_t i = 0; i < count; ++i) { writer.bulk(args[i]); }
+  }
+
+  void RespWriter::header_(char type, int64_t value) {
+    out_->ensure_writable_size(kMaxNumberLine);
+    char* first = out_->to_write();
+    char* last  = first + kMaxNumberLine;
+    *first      = type;
+    char* p     = std::to_chars(first + 1, last, value).ptr;
+    *p++        = '\r';
+    *p++        = '\n';
+    out_->been_written(static_cast<size_t>(p - first));
+  }
+} // namespace cxpnet
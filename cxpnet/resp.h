@@ -0,0 +1,144 @@
+﻿#ifndef RESP_H
+#define RESP_H
+
+#include "buffer.h"
+
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+#include <vector>
+
+namespace cxpnet {
+  // RESP2 (Redis 协议) 编解码
+  // 解析结果中的 string_view 指向连接的读缓冲，不复制；RespCommand / RespReply 的 vector 在连接内复用，稳态下不分配
+  // 数据不足时记录至少还需要的字节数，大 bulk 分多次到达时不会反复从头解析
+
+  struct RespLimits {
+    size_t max_bulk_size   = 512 * 1024 * 1024; // 与 Redis 的 proto-max-bulk-len 相同
+    size_t max_args        = 1024 * 1024;
+    size_t max_inline_size = 64 * 1024; // inline 命令 (telnet 风格) 一行的上限
+  };
+
+  enum class RespParseResult {
+    kComplete,   // 解析出一条完整的命令 / 回复
+    kIncomplete, // 数据不足，等待下一次读
+    kError,      // 协议错误，error() 为描述
+  };
+
+  // 客户端发来的一条命令：RESP 数组或以空格分隔的 inline 命令
+  struct RespCommand {
+    std::vector<std::string_view> args;
+
+    bool             empty() const { return args.empty(); }
+    std::string_view name() const { return args.empty() ? std::string_view() : args[0]; }
+    // 命令名比较不区分大小写
+    bool is(std::string_view name) const;
+  };
+
+  enum class RespType : uint8_t {
+    kSimpleString,
+    kError,
+    kInteger,
+    kBulkString,
+    kNullBulkString,
+    kArray,
+    kNullArray,
+  };
+
+  // 服务端回复；数组的元素展开在 elements 中，嵌套数组的元素紧跟在它后面 (先序)
+  struct RespReply {
+    struct Value {
+      RespType         type    = RespType::kNullBulkString;
+      std::string_view str;         // 简单字符串 / 错误 / bulk 的内容
+      int64_t          integer = 0; // 整数回复的值，数组为元素个数
+    };
+
+    Value              value;
+    std::vector<Value> elements;
+
+    bool is_error() const { return value.type == RespType::kError; }
+  };
+
+  // 增量解析器的公共部分
+  class RespParserBase {
+  public:
+    // 消费已解析的命令 / 回复
+    void consume(Buffer* buffer) {
+      buffer->been_read(message_size_);
+      message_size_ = 0;
+    }
+    const char* error() const { return error_; }
+  protected:
+    explicit RespParserBase(RespLimits limits)
+        : limits_(limits) { }
+
+    // 读缓冲中的数据不足 need_ 字节时直接返回 kIncomplete
+    bool            need_more_(const Buffer* buffer) const { return buffer->readable_size() < need_; }
+    RespParseResult incomplete_(size_t need) {
+      need_ = need;
+      return RespParseResult::kIncomplete;
+    }
+    RespParseResult complete_(size_t size) {
+      need_         = 0;
+      message_size_ = size;
+      return RespParseResult::kComplete;
+    }
+    RespParseResult fail_(const char* error) {
+      error_ = error;
+      return RespParseResult::kError;
+    }
+
+    RespLimits  limits_;
+    size_t      need_         = 0;
+    size_t      message_size_ = 0;
+    const char* error_        = nullptr;
+  };
+
+  class RespCommandParser : public RespParserBase {
+  public:
+    explicit RespCommandParser(RespLimits limits = {})
+        : RespParserBase(limits) { }
+
+    // kComplete 时 command 在 consume 之前有效；"*0\r\n" 这样的空命令也返回 kComplete，args 为空
+    RespParseResult parse(Buffer* buffer, RespCommand& command);
+  private:
+    RespParseResult parse_inline_(const char* data, size_t size, RespCommand& command);
+  };
+
+  class RespReplyParser : public RespParserBase {
+  public:
+    explicit RespReplyParser(RespLimits limits = {})
+        : RespParserBase(limits) { }
+
+    // kComplete 时 reply 在 consume 之前有效
+    RespParseResult parse(Buffer* buffer, RespReply& reply);
+  };
+
+  // 把回复追加到 out；一次读回调中的所有回复写到同一个 Buffer，最后一次 send
+  class RespWriter {
+  public:
+    explicit RespWriter(Buffer* out)
+        : out_(out) { }
+
+    void simple_string(std::string_view s);
+    void ok() { out_->append("+OK\r\n", 5); }
+    void error(std::string_view message); // message 需要带前缀，如 "ERR unknown command"
+    void integer(int64_t value);
+    void bulk(std::string_view data);
+    void null_bulk() { out_->append("$-1\r\n", 5); }
+    void array(size_t count); // 之后写入 count 个元素
+    void null_array() { out_->append("*-1\r\n", 5); }
+
+    // 以 bulk 数组编码一条命令，客户端使用
+    static void command(Buffer* out, std::initializer_list<std::string_view> args);
+    static void command(Buffer* out, const std::string_view* args, size_t count);
+
+    Buffer* buffer() const { return out_; }
+  private:
+    void header_(char type, int64_t value);
+
+    Buffer* out_;
+  };
+} // namespace cxpnet
+
+#endif // RESP_H
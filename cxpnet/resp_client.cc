@@ -0,0 +1,107 @@
+﻿#include "resp_client.h"
+#include "conn_client.h"
+#include "io_event_poll.h"
+
+#include <cerrno>
+#include <deque>
+
+namespace cxpnet {
+  // 回复按命令顺序到达，等待中的回调用队列保存即可
+  struct RespClient::State : ConnClientState<State> {
+    explicit State(RespLimits limits)
+        : parser(limits) { }
+
+    RespReplyParser      parser;
+    RespReply            reply;
+    Buffer               out;                     // 本轮 poll 中还未写出的命令
+    bool                 flush_scheduled = false;
+    std::deque<Callback> callbacks;               // 已编码、等待回复的命令
+
+    // 命令已写入 out，登记回调并在本轮 poll 结束时写出
+    void enqueue(IOEventPoll* poll, Callback callback) {
+      callbacks.push_back(std::move(callback));
+      if (flush_scheduled) { return; }
+      flush_scheduled = true;
+      poll->run_later([self = shared_from_this()] { self->flush(); });
+    }
+
+    void flush() {
+      flush_scheduled = false;
+      if (out.empty()) { return; }
+      if (auto c = conn.lock()) { c->send(out.peek(), out.readable_size()); }
+      out.been_read_all();
+    }
+
+    void fail_pending_(int err) {
+      out.been_read_all();
+      std::deque<Callback> failed;
+      failed.swap(callbacks);
+      for (auto& callback : failed) { callback(err, nullptr); }
+    }
+
+    void on_message(Buffer* buffer) {
+      while (!closed) {
+        RespParseResult result = parser.parse(buffer, reply);
+        if (result == RespParseResult::kIncomplete) { return; }
+        if (result == RespParseResult::kError || callbacks.empty()) {
+          buffer->been_read_all();
+          fail_protocol();
+          return;
+        }
+
+        Callback callback = std::move(callbacks.front());
+        callbacks.pop_front();
+        callback(0, &reply);
+        parser.consume(buffer);
+      }
+      buffer->been_read_all();
+    }
+  };
+
+  RespClient::RespClient(ConnPtr conn, RespLimits limits)
+      : conn_(std::move(conn))
+      , state_(std::make_shared<State>(limits)) {
+    State::bind(conn_, state_);
+  }
+
+  RespClient::~RespClient() { close(); }
+
+  void RespClient::command(std::initializer_list<std::string_view> args, Callback callback) {
+    send_(args.begin(), args.size(), std::move(callback));
+  }
+
+  void RespClient::command(const std::vector<std::string>& args, Callback callback) {
+    std::vector<std::string_view> views(args.begin(), args.end());
+    send_(views.data(), views.size(), std::move(callback));
+  }
+
+  void RespClient::close() { state_->close(); }
+
+  size_t RespClient::pending() const { return state_->callbacks.size(); }
+
+  void RespClient::send_(const std::string_view* args, size_t count, Callback callback) {
+    IOEventPoll* poll = conn_->event_poll();
+    if (poll->is_in_poll_thread()) {
+      if (state_->closed) {
+        callback(ECONNRESET, nullptr);
+        return;
+      }
+      // 直接编码到输出缓冲，不经过临时字符串
+      RespWriter::command(&state_->out, args, count);
+      state_->enqueue(poll, std::move(callback));
+      return;
+    }
+
+    Buffer encoded(256);
+    RespWriter::command(&encoded, args, count);
+    poll->run_later([state = state_, poll, data = std::string(encoded.peek(), encoded.readable_size()),
+                     callback = std::move(callback)]() mutable {
+      if (state->closed) {
+        callback(ECONNRESET, nullptr);
+        return;
+      }
+      state->out.append(data);
+      state->enqueue(poll, std::move(callback));
+    });
+  }
+} // namespace cxpnet
@@ -0,0 +1,50 @@
+﻿#ifndef RESP_CLIENT_H
+#define RESP_CLIENT_H
+
+#include "resp.h"
+
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cxpnet {
+  class Conn;
+  using ConnPtr = std::shared_ptr<Conn>;
+
+  // 单连接 RESP 客户端，回复按命令顺序交付
+  // 同一轮 poll 中发出的命令先编码到输出缓冲，本轮结束时一次 send 写出，流水线不需要调用方攒批
+  // 回调在连接所在的 poll 线程上执行
+  class RespClient : public NonCopyable {
+  public:
+    // err 为 0 时 reply 有效，只在回调期间有效；服务端的 -ERR 回复也是 err 为 0，由 reply->is_error() 区分
+    // 连接关闭时未完成的命令以 ECONNRESET 失败，回复非法时以 EPROTO 失败
+    using Callback = std::function<void(int err, const RespReply* reply)>;
+
+    // 在已建立的 conn 上收发命令，conn 之前的消息和关闭回调被替换
+    explicit RespClient(ConnPtr conn, RespLimits limits = {});
+    // 关闭连接，等待回复的命令以 ECANCELED 失败；需要在 poll 线程上或 poll 停止之后析构
+    ~RespClient();
+
+    // 其他线程发出的命令先投递到 poll 线程再编码；回调执行完之前不要析构 RespClient
+    void command(std::initializer_list<std::string_view> args, Callback callback);
+    void command(const std::vector<std::string>& args, Callback callback);
+    // 主动断开，等待回复的命令以 ECANCELED 失败，之后的命令以 ECONNRESET 失败；poll 线程上调用
+    void close();
+
+    const ConnPtr& conn() const { return conn_; }
+    // 已发出、等待回复的命令数，poll 线程上读取
+    size_t pending() const;
+  private:
+    struct State;
+
+    void send_(const std::string_view* args, size_t count, Callback callback);
+
+    ConnPtr                conn_;
+    std::shared_ptr<State> state_;
+  };
+} // namespace cxpnet
+
+#endif // RESP_CLIENT_H
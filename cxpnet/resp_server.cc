@@ -0,0 +1,51 @@
+﻿#include "resp_server.h"
+#include "conn.h"
+
+#include <string>
+
+namespace cxpnet {
+  // command 的参数指向读缓冲，只在一条命令的处理期间有效
+  struct RespServer::Session : ReplySession {
+    explicit Session(Conn* c, RespLimits limits)
+        : ReplySession(c)
+        , parser(limits) { }
+
+    RespCommandParser parser;
+    RespCommand       command;
+  };
+
+  void RespServer::on_connection(const ConnPtr& conn) {
+    auto session = std::make_shared<Session>(conn.get(), limits_);
+    conn->set_conn_user_callbacks([this, session](Buffer* buffer) { on_message_(*session, buffer); }, nullptr);
+  }
+
+  void RespServer::on_message_(Session& session, Buffer* buffer) {
+    if (session.begin(buffer)) { return; }
+
+    RespWriter writer(session.out.get());
+    while (true) {
+      RespParseResult result = session.parser.parse(buffer, session.command);
+      if (result == RespParseResult::kIncomplete) { break; }
+
+      if (result == RespParseResult::kError) {
+        writer.error(std::string("ERR Protocol error: ") + session.parser.error());
+        session.closing = true;
+        break;
+      }
+
+      if (session.command.empty()) {
+        session.parser.consume(buffer);
+        continue;
+      }
+      if (session.command.is("QUIT")) {
+        writer.ok();
+        session.closing = true;
+        break;
+      }
+      handler_(session.command, writer);
+      session.parser.consume(buffer);
+    }
+
+    session.flush(buffer);
+  }
+} // namespace cxpnet
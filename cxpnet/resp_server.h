@@ -0,0 +1,33 @@
+﻿#ifndef RESP_SERVER_H
+#define RESP_SERVER_H
+
+#include "resp.h"
+#include "server_session.h"
+
+#include <functional>
+
+namespace cxpnet {
+  // RESP 服务：一次读回调中的所有流水线命令依次交给处理函数，回复攒在 ReplySession::out 中合并写出
+  // 处理函数在连接所在的 poll 线程上同步调用，必须为每条命令写出恰好一个回复
+  // QUIT 由服务自己处理：回复 +OK 后关闭连接；协议错误时回复 -ERR 并关闭连接
+  class RespServer : public NonCopyable, public ServerAttachable<RespServer> {
+  public:
+    using Handler = std::function<void(const RespCommand&, RespWriter&)>;
+
+    explicit RespServer(Handler handler, RespLimits limits = {})
+        : handler_(std::move(handler))
+        , limits_(limits) { }
+
+    // 开始在 conn 上接收命令，替换它的消息回调；RespServer 需要比 conn 活得久
+    void on_connection(const ConnPtr& conn);
+  private:
+    struct Session;
+
+    void on_message_(Session& session, Buffer* buffer);
+
+    Handler    handler_;
+    RespLimits limits_;
+  };
+} // namespace cxpnet
+
+#endif // RESP_SERVER_H
@@ -0,0 +1,192 @@
+﻿#include "rpc.h"
+#include "conn_client.h"
+#include "io_event_poll.h"
+
+#include <cerrno>
+#include <vector>
+
+namespace cxpnet {
+  namespace {
+    constexpr uint8_t kKindRequest = 0;
+    constexpr uint8_t kKindReply   = 1;
+    constexpr uint8_t kKindError   = 2;
+
+    constexpr size_t kIdKindSize      = 9;               // id + kind
+    constexpr size_t kRequestHeadSize = kIdKindSize + 2; // + method_len
+    constexpr size_t kMaxHeadSize     = LengthCodec::kMaxHeaderSize + kRequestHeadSize;
+
+    void put_u64(char* out, uint64_t value) {
+      for (int i = 0; i < 8; ++i) { out[i] = static_cast<char>((value >> (8 * (7 - i))) & 0xFF); }
+    }
+
+    uint64_t get_u64(const char* data) {
+      const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+      uint64_t    value = 0;
+      for (int i = 0; i < 8; ++i) { value = (value << 8) | bytes[i]; }
+      return value;
+    }
+
+    // 写入长度前缀、id 和 kind，返回写入的字节数
+    size_t encode_head(const LengthCodec& codec, size_t payload_size, uint64_t id, uint8_t kind, char* out) {
+      size_t n = codec.encode_header(payload_size, out);
+      put_u64(out + n, id);
+      out[n + 8] = static_cast<char>(kind);
+      return n + kIdKindSize;
+    }
+  } // namespace
+
+  void RpcResponder::send_(uint8_t kind, std::string_view body) const {
+    auto conn = conn_.lock();
+    if (!conn) { return; }
+
+    // 超过帧上限的回复改为失败回复，不在 poll 线程上抛出异常
+    if (!codec_.fits(kIdKindSize + body.size())) {
+      if (kind != kKindError) { send_(kKindError, "reply too large"); }
+      return;
+    }
+
+    char   head[kMaxHeadSize];
+    size_t head_size = encode_head(codec_, kIdKindSize + body.size(), id_, kind, head);
+    conn->sendv({std::string_view(head, head_size), body});
+  }
+
+  void RpcServer::add_method(std::string name, Handler handler) { methods_[std::move(name)] = std::move(handler); }
+
+  void RpcServer::on_connection(const ConnPtr& conn) {
+    conn->set_conn_user_callbacks(
+        codec_.message_handler(conn.get(), [this](Conn* c, std::string_view frame) { on_frame_(c, frame); }), nullptr);
+  }
+
+  void RpcServer::on_frame_(Conn* conn, std::string_view frame) {
+    if (frame.size() < kRequestHeadSize || static_cast<uint8_t>(frame[8]) != kKindRequest) {
+      conn->close();
+      return;
+    }
+
+    const auto* bytes      = reinterpret_cast<const unsigned char*>(frame.data());
+    size_t      method_len = (static_cast<size_t>(bytes[9]) << 8) | bytes[10];
+    if (frame.size() - kRequestHeadSize < method_len) {
+      conn->close();
+      return;
+    }
+
+    std::string_view method  = frame.substr(kRequestHeadSize, method_len);
+    std::string_view request = frame.substr(kRequestHeadSize + method_len);
+    RpcResponder     responder(conn->shared_from_this(), get_u64(frame.data()), codec_);
+
+    auto it = methods_.find(method);
+    if (it == methods_.end()) {
+      responder.fail("unknown method");
+      return;
+    }
+    it->second(request, responder);
+  }
+
+  // 响应可以乱序到达，在途调用按 request id 索引；定时器回调也持有 weak_ptr
+  struct RpcClient::State : ConnClientState<State> {
+    struct Call {
+      Callback       callback;
+      Timer::TimerID timer_id = 0;
+    };
+
+    State(IOEventPoll* p, RpcClientOptions o)
+        : poll(p)
+        , options(o)
+        , codec(o.frame) { }
+
+    IOEventPoll*                       poll;
+    RpcClientOptions                   options;
+    LengthCodec                        codec;
+    uint64_t                           next_id = 1;
+    std::unordered_map<uint64_t, Call> calls; // 在途调用，key 为 request id
+
+    void start(std::string_view method, std::string_view request, Callback callback, uint32_t timeout_ms) {
+      auto c = conn.lock();
+      if (closed || !c) {
+        callback(ECONNRESET, {});
+        return;
+      }
+      if (method.size() > 0xFFFF || !codec.fits(kRequestHeadSize + method.size() + request.size())) {
+        callback(EMSGSIZE, {});
+        return;
+      }
+
+      uint64_t id = next_id++;
+      char     head[kMaxHeadSize];
+      size_t   n = encode_head(codec, kRequestHeadSize + method.size() + request.size(), id, kKindRequest, head);
+      head[n]     = static_cast<char>((method.size() >> 8) & 0xFF);
+      head[n + 1] = static_cast<char>(method.size() & 0xFF);
+
+      Call& call    = calls[id];
+      call.callback = std::move(callback);
+      if (timeout_ms == kDefaultTimeout) { timeout_ms = options.default_timeout_ms; }
+      if (timeout_ms > 0) {
+        std::weak_ptr<State> weak = shared_from_this();
+        call.timer_id             = poll->timer_manager()->add_timer(timeout_ms, [weak, id]() {
+          auto self = weak.lock();
+          if (!self) { return; }
+          self->poll->run_in_poll([self, id]() { self->finish(id, ETIMEDOUT, {}, false); });
+        });
+      }
+      c->sendv({std::string_view(head, n + 2), method, request});
+    }
+
+    // 完成一个调用；id 不存在 (已超时或已失败) 时忽略
+    void finish(uint64_t id, int err, std::string_view response, bool cancel_timer) {
+      auto it = calls.find(id);
+      if (it == calls.end()) { return; }
+
+      Call call = std::move(it->second);
+      calls.erase(it);
+      if (cancel_timer && call.timer_id != 0) { poll->timer_manager()->cancel_timer(call.timer_id); }
+      call.callback(err, response);
+    }
+
+    void fail_pending_(int err) {
+      std::unordered_map<uint64_t, Call> failed;
+      failed.swap(calls);
+      for (auto& [id, call] : failed) {
+        if (call.timer_id != 0) { poll->timer_manager()->cancel_timer(call.timer_id); }
+        call.callback(err, {});
+      }
+    }
+
+    void on_message(Buffer* buffer) {
+      bool valid = true;
+      bool ok    = codec.decode(buffer, [this, &valid](std::string_view frame) {
+        if (!valid || closed) { return; }
+        uint8_t kind = frame.size() >= kIdKindSize ? static_cast<uint8_t>(frame[8]) : kKindRequest;
+        if (kind != kKindReply && kind != kKindError) {
+          valid = false;
+          return;
+        }
+        finish(get_u64(frame.data()), kind == kKindReply ? 0 : kRpcRemoteError, frame.substr(kIdKindSize), true);
+      });
+      if ((!ok || !valid) && !closed) { fail_protocol(); }
+    }
+  };
+
+  RpcClient::RpcClient(ConnPtr conn, RpcClientOptions options)
+      : conn_(std::move(conn))
+      , state_(std::make_shared<State>(conn_->event_poll(), options)) {
+    State::bind(conn_, state_);
+  }
+
+  RpcClient::~RpcClient() { close(); }
+
+  void RpcClient::call(std::string_view method, std::string_view request, Callback callback, uint32_t timeout_ms) {
+    IOEventPoll* poll = state_->poll;
+    if (poll->is_in_poll_thread()) {
+      state_->start(method, request, std::move(callback), timeout_ms);
+      return;
+    }
+    poll->run_in_poll([state = state_, method = std::string(method), request = std::string(request),
+                       callback = std::move(callback), timeout_ms]() mutable {
+      state->start(method, request, std::move(callback), timeout_ms);
+    });
+  }
+
+  void RpcClient::close() { state_->close(); }
+
+  size_t RpcClient::pending() const { return state_->calls.size(); }
+} // namespace cxpnet
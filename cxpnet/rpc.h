@@ -0,0 +1,109 @@
+﻿#ifndef RPC_H
+#define RPC_H
+
+#include "codec.h"
+#include "server_session.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace cxpnet {
+  // 请求 / 响应式 RPC，一个连接上可以有任意多个在途调用，响应按 request id 匹配，可以乱序返回
+  // 帧格式：LengthCodec 长度前缀 + payload，payload 中的整数为网络字节序
+  //   请求: id(8) kind(1)=0 method_len(2) method body
+  //   响应: id(8) kind(1)=1 成功 / 2 处理失败 body (失败时为错误信息)
+
+  // 服务端处理函数调用 fail() 时回调收到的 err，不与 errno 冲突
+  inline constexpr int kRpcRemoteError = -1;
+
+  struct RpcClientOptions {
+    FrameOptions frame;
+    uint32_t     default_timeout_ms = 5000; // call() 未指定超时时使用，0 表示不超时
+  };
+
+  // 回复一个请求，可以复制到其他线程，在任意线程上调用，每个请求只能回复一次
+  // 连接已经关闭时回复被丢弃；回复超过帧上限时对端收到 fail("reply too large")
+  class RpcResponder {
+  public:
+    RpcResponder(std::weak_ptr<Conn> conn, uint64_t id, LengthCodec codec)
+        : conn_(std::move(conn))
+        , id_(id)
+        , codec_(codec) { }
+
+    void reply(std::string_view body) const { send_(1, body); }
+    void fail(std::string_view message) const { send_(2, message); }
+
+    uint64_t id() const { return id_; }
+  private:
+    void send_(uint8_t kind, std::string_view body) const;
+
+    std::weak_ptr<Conn> conn_;
+    uint64_t            id_;
+    LengthCodec         codec_;
+  };
+
+  // RPC 服务：按方法名分发，处理函数在连接所在的 poll 线程上同步调用
+  // request 只在调用期间有效；可以立即回复，也可以保存 responder 稍后在其他线程回复
+  // 未注册的方法以 fail("unknown method") 回复；帧非法时关闭连接
+  class RpcServer : public NonCopyable, public ServerAttachable<RpcServer> {
+  public:
+    using Handler = std::function<void(std::string_view request, const RpcResponder& responder)>;
+
+    explicit RpcServer(FrameOptions frame = {})
+        : codec_(frame) { }
+
+    // 在 attach 之前注册
+    void add_method(std::string name, Handler handler);
+
+    // 在 conn 上按帧接收请求，客户端和服务端共用一个连接时 (如 ConnPool 的连接) 直接调用
+    void on_connection(const ConnPtr& conn);
+  private:
+    void on_frame_(Conn* conn, std::string_view frame);
+
+    // 透明哈希，用 string_view 查找不构造临时 string
+    struct NameHash {
+      using is_transparent = void;
+      size_t operator()(std::string_view s) const { return std::hash<std::string_view>()(s); }
+    };
+
+    LengthCodec                                                         codec_;
+    std::unordered_map<std::string, Handler, NameHash, std::equal_to<>> methods_;
+  };
+
+  // 单连接 RPC 客户端，调用可以并发，完成回调在连接所在的 poll 线程上执行
+  // 超时由该 poll 的 TimerManager 计时，超时后到达的响应被丢弃
+  class RpcClient : public NonCopyable {
+  public:
+    // err 为 0 时 response 为响应 body，只在回调期间有效；kRpcRemoteError 时 response 为服务端的错误信息
+    // 其他 err 为 errno 风格：ETIMEDOUT 超时，ECONNRESET 连接关闭，EPROTO 响应非法，ECANCELED 客户端关闭，
+    // EMSGSIZE 方法名超过 65535 字节或请求超过帧上限，请求没有发出
+    using Callback = std::function<void(int err, std::string_view response)>;
+
+    static constexpr uint32_t kDefaultTimeout = static_cast<uint32_t>(-1);
+
+    // 把一个已连接的 conn 用作调用通道，请求帧直接写到 conn 上
+    explicit RpcClient(ConnPtr conn, RpcClientOptions options = {});
+    // 取消在途调用的超时定时器并以 ECANCELED 完成它们；在 poll 线程上或 poll 停止之后析构
+    ~RpcClient();
+
+    // 可以从任意线程发起，调用在 poll 线程上编号并登记超时；在途调用全部完成之前 RpcClient 必须存在
+    void call(std::string_view method, std::string_view request, Callback callback,
+              uint32_t timeout_ms = kDefaultTimeout);
+    // 断开调用通道，在途调用以 ECANCELED 结束，之后的调用以 ECONNRESET 失败；poll 线程上调用
+    void close();
+
+    const ConnPtr& conn() const { return conn_; }
+    // 在途调用数，poll 线程上读取
+    size_t pending() const;
+  private:
+    struct State;
+
+    ConnPtr                conn_;
+    std::shared_ptr<State> state_;
+  };
+} // namespace cxpnet
+
+#endif // RPC_H
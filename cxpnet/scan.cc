@@ -0,0 +1,246 @@
+﻿#include "scan.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CXP_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace cxpnet {
+  namespace scan {
+    namespace {
+      using FindByteFunc = const char* (*)(const char*, size_t, char);
+      using FindSeqFunc  = const char* (*)(const char*, size_t, const char*, size_t);
+      using XorMaskFunc  = void (*)(char*, size_t, uint32_t);
+
+      struct Kernels {
+        const char*  name;
+        FindByteFunc find_byte;
+        FindSeqFunc  find_seq; // delim 长度 >= 2
+        XorMaskFunc  xor_mask;
+      };
+
+      const char* find_byte_scalar(const char* data, size_t size, char c) {
+        return static_cast<const char*>(std::memchr(data, c, size));
+      }
+
+      const char* find_seq_scalar(const char* data, size_t size, const char* delim, size_t len) {
+        std::string_view haystack(data, size);
+        size_t           pos = haystack.find(std::string_view(delim, len));
+        return pos == std::string_view::npos ? nullptr : data + pos;
+      }
+
+      // key 为 4 字节掩码按内存顺序读出的值，从 data[0] 对应掩码第 0 字节开始
+      void xor_mask_scalar(char* data, size_t size, uint32_t key) {
+        uint64_t key64 = (static_cast<uint64_t>(key) << 32) | key;
+        size_t   i     = 0;
+        for (; i + 8 <= size; i += 8) {
+          uint64_t block;
+          std::memcpy(&block, data + i, 8);
+          block ^= key64;
+          std::memcpy(data + i, &block, 8);
+        }
+        unsigned char key_bytes[4];
+        std::memcpy(key_bytes, &key, 4);
+        for (; i < size; ++i) { data[i] = static_cast<char>(data[i] ^ key_bytes[i & 3]); }
+      }
+
+      const Kernels kScalar {"scalar", find_byte_scalar, find_seq_scalar, xor_mask_scalar};
+
+      // 先用标量处理到 align 字节对齐，避免原地读写的向量跨缓存行；返回处理的字节数，key 转成剩余部分的相位
+      size_t xor_mask_prefix(char* data, size_t size, uint32_t& key, size_t align) {
+        size_t prefix = (align - reinterpret_cast<uintptr_t>(data) % align) % align;
+        prefix        = (std::min)(prefix, size);
+        if (prefix == 0) { return 0; }
+
+        xor_mask_scalar(data, prefix, key);
+        unsigned shift = static_cast<unsigned>(prefix % 4) * 8;
+        if (shift != 0) { key = (key >> shift) | (key << (32 - shift)); }
+        return prefix;
+      }
+
+#ifdef CXP_SCAN_X86
+      const char* find_byte_sse2(const char* data, size_t size, char c) {
+        const __m128i needle = _mm_set1_epi8(c);
+        size_t        i      = 0;
+        for (; i + 16 <= size; i += 16) {
+          __m128i  block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+          uint32_t mask  = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+          if (mask != 0) { return data + i + __builtin_ctz(mask); }
+        }
+        return find_byte_scalar(data + i, size - i, c);
+      }
+
+      const char* find_seq_sse2(const char* data, size_t size, const char* delim, size_t len) {
+        if (size < len) { return nullptr; }
+
+        const __m128i first = _mm_set1_epi8(delim[0]);
+        const __m128i last  = _mm_set1_epi8(delim[len - 1]);
+        size_t        i     = 0;
+        // 无候选的长段每次跳过 64 字节，只做一次分支判断
+        for (; i + len - 1 + 64 <= size; i += 64) {
+          __m128i any = _mm_setzero_si128();
+          for (size_t k = 0; k < 64; k += 16) {
+            __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + k));
+            __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + k + len - 1));
+            any          = _mm_or_si128(any, _mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last)));
+          }
+          if (_mm_movemask_epi8(any) != 0) { break; }
+        }
+        for (; i + len - 1 + 16 <= size; i += 16) {
+          __m128i  head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+          __m128i  tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + len - 1));
+          uint32_t mask = static_cast<uint32_t>(
+              _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last))));
+          while (mask != 0) {
+            size_t offset = i + static_cast<size_t>(__builtin_ctz(mask));
+            if (len == 2 || std::memcmp(data + offset + 1, delim + 1, len - 2) == 0) { return data + offset; }
+            mask &= mask - 1;
+          }
+        }
+        // 剩余不足一个向量宽度的尾部用标量实现
+        return find_seq_scalar(data + i, size - i, delim, len);
+      }
+
+      void xor_mask_sse2(char* data, size_t size, uint32_t key) {
+        size_t        i    = xor_mask_prefix(data, size, key, 16);
+        const __m128i mask = _mm_set1_epi32(static_cast<int>(key));
+        for (; i + 64 <= size; i += 64) {
+          for (size_t k = 0; k < 64; k += 16) {
+            __m128i* p = reinterpret_cast<__m128i*>(data + i + k);
+            _mm_store_si128(p, _mm_xor_si128(_mm_load_si128(p), mask));
+          }
+        }
+        for (; i + 16 <= size; i += 16) {
+          __m128i* p = reinterpret_cast<__m128i*>(data + i);
+          _mm_store_si128(p, _mm_xor_si128(_mm_load_si128(p), mask));
+        }
+        // 对齐后处理的长度是 4 的倍数，掩码相位不变
+        xor_mask_scalar(data + i, size - i, key);
+      }
+
+      const Kernels kSse2 {"sse2", find_byte_sse2, find_seq_sse2, xor_mask_sse2};
+
+      __attribute__((target("avx2"))) const char* find_byte_avx2(const char* data, size_t size, char c) {
+        const __m256i needle = _mm256_set1_epi8(c);
+        size_t        i      = 0;
+        for (; i + 32 <= size; i += 32) {
+          __m256i  block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+          uint32_t mask  = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+          if (mask != 0) { return data + i + __builtin_ctz(mask); }
+        }
+        return find_byte_sse2(data + i, size - i, c);
+      }
+
+      __attribute__((target("avx2"))) const char* find_seq_avx2(const char* data, size_t size, const char* delim,
+                                                                size_t len) {
+        if (size < len) { return nullptr; }
+
+        const __m256i first = _mm256_set1_epi8(delim[0]);
+        const __m256i last  = _mm256_set1_epi8(delim[len - 1]);
+        size_t        i     = 0;
+        // 无候选的长段 (如大 Cookie 行) 每次跳过 128 字节，只做一次分支判断
+        for (; i + len - 1 + 128 <= size; i += 128) {
+          __m256i any = _mm256_setzero_si256();
+          for (size_t k = 0; k < 128; k += 32) {
+            __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + k));
+            __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + k + len - 1));
+            any = _mm256_or_si256(any, _mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last)));
+          }
+          if (!_mm256_testz_si256(any, any)) { break; }
+        }
+        for (; i + len - 1 + 32 <= size; i += 32) {
+          __m256i  head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+          __m256i  tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + len - 1));
+          uint32_t mask = static_cast<uint32_t>(
+              _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last))));
+          while (mask != 0) {
+            size_t offset = i + static_cast<size_t>(__builtin_ctz(mask));
+            if (len == 2 || std::memcmp(data + offset + 1, delim + 1, len - 2) == 0) { return data + offset; }
+            mask &= mask - 1;
+          }
+        }
+        return find_seq_sse2(data + i, size - i, delim, len);
+      }
+
+      __attribute__((target("avx2"))) void xor_mask_avx2(char* data, size_t size, uint32_t key) {
+        size_t        i    = xor_mask_prefix(data, size, key, 32);
+        const __m256i mask = _mm256_set1_epi32(static_cast<int>(key));
+        for (; i + 128 <= size; i += 128) {
+          for (size_t k = 0; k < 128; k += 32) {
+            __m256i* p = reinterpret_cast<__m256i*>(data + i + k);
+            _mm256_store_si256(p, _mm256_xor_si256(_mm256_load_si256(p), mask));
+          }
+        }
+        for (; i + 32 <= size; i += 32) {
+          __m256i* p = reinterpret_cast<__m256i*>(data + i);
+          _mm256_store_si256(p, _mm256_xor_si256(_mm256_load_si256(p), mask));
+        }
+        // 尾部直接用标量，不调用非 VEX 编码的 SSE2 实现，避免 AVX / SSE 切换的代价
+        _mm256_zeroupper();
+        xor_mask_scalar(data + i, size - i, key);
+      }
+
+      const Kernels kAvx2 {"avx2", find_byte_avx2, find_seq_avx2, xor_mask_avx2};
+
+      bool cpu_has_avx2() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+      }
+#endif // CXP_SCAN_X86
+
+      const Kernels* select_kernels() {
+#ifdef CXP_SCAN_X86
+        if (cpu_has_avx2()) { return &kAvx2; }
+        return &kSse2;
+#else
+        return &kScalar;
+#endif
+      }
+
+      std::atomic<const Kernels*>& active_kernels() {
+        static std::atomic<const Kernels*> kernels {select_kernels()};
+        return kernels;
+      }
+
+      const Kernels& kernels() { return *active_kernels().load(std::memory_order_relaxed); }
+    } // namespace
+
+    const char* find_byte(const char* data, size_t size, char c) {
+      if (size == 0) { return nullptr; }
+      return kernels().find_byte(data, size, c);
+    }
+
+    const char* find(const char* data, size_t size, std::string_view delim) {
+      if (delim.empty()) { return data; }
+      if (size < delim.size()) { return nullptr; }
+      if (delim.size() == 1) { return kernels().find_byte(data, size, delim[0]); }
+      return kernels().find_seq(data, size, delim.data(), delim.size());
+    }
+
+    void xor_mask(char* data, size_t size, const unsigned char key[4]) {
+      if (size == 0) { return; }
+      uint32_t key32;
+      std::memcpy(&key32, key, 4);
+      kernels().xor_mask(data, size, key32);
+    }
+
+    const char* kernel_name() { return kernels().name; }
+
+    bool set_kernel(std::string_view name) {
+      const Kernels* target = nullptr;
+      if (name == kScalar.name) { target = &kScalar; }
+#ifdef CXP_SCAN_X86
+      if (name == kSse2.name) { target = &kSse2; }
+      if (name == kAvx2.name && cpu_has_avx2()) { target = &kAvx2; }
+#endif
+      if (target == nullptr) { return false; }
+
+      active_kernels().store(target, std::memory_order_relaxed);
+      return true;
+    }
+  } // namespace scan
+} // namespace cxpnet
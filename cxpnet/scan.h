@@ -0,0 +1,25 @@
+﻿#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstddef>
+#include <string_view>
+
+namespace cxpnet {
+  // 分隔符查找，按运行时 CPU 特性选择 AVX2 / SSE2 / 标量实现
+  // 多字节分隔符先用首尾两个字节做向量过滤，再 memcmp 确认
+  // 同一套实现选择也用于 WebSocket 掩码的原地异或
+  namespace scan {
+    // 返回第一个匹配的起始位置，未找到返回 nullptr
+    const char* find_byte(const char* data, size_t size, char c);
+    const char* find(const char* data, size_t size, std::string_view delim);
+    // data[i] ^= key[i % 4]，原地进行
+    void xor_mask(char* data, size_t size, const unsigned char key[4]);
+
+    // 当前使用的实现："avx2" / "sse2" / "scalar"
+    const char* kernel_name();
+    // 切换实现，用于基准对比；CPU 不支持时返回 false 并保持不变
+    bool set_kernel(std::string_view name);
+  } // namespace scan
+} // namespace cxpnet
+
+#endif // SCAN_H
@@ -20,6 +20,9 @@ namespace cxpnet {
     acceptor_->set_listen_addr(addr, port, proto_stack, option);
     acceptor_->set_new_conn_callback(std::bind(&Server::on_new_connection_, this, std::placeholders::_1, std::placeholders::_2));
     acceptor_->set_error_callback(std::bind(&Server::on_acceptor_error_, this, std::placeholders::_1));
+
+    metrics_ = std::make_unique<MetricsRegistry>();
+    metrics_->add_collector([this](MetricsWriter& writer) { collect_metrics_(writer); });
   }
 
   Server::~Server() {
@@ -52,6 +55,7 @@ namespace cxpnet {
 
   void Server::shutdown_impl_() {
     if (acceptor_) { acceptor_->shutdown(); }
+    if (metrics_endpoint_) { metrics_endpoint_->shutdown(); }
 
     std::vector<std::shared_ptr<Conn>> conns_snapshot;
     {
@@ -85,6 +89,7 @@ namespace cxpnet {
         if (conn) { conns_snapshot.push_back(conn); }
       }
       conns_.clear();
+      connection_count_.store(0, std::memory_order_relaxed);
     }
 
     for (auto& conn : conns_snapshot) {
@@ -124,6 +129,7 @@ namespace cxpnet {
                              : std::chrono::steady_clock::time_point::max();
 
     if (acceptor_) { acceptor_->shutdown(); }
+    if (metrics_endpoint_) { metrics_endpoint_->shutdown(); }
 
     std::vector<std::shared_ptr<Conn>> conns_snapshot;
     {
@@ -158,6 +164,7 @@ namespace cxpnet {
         if (conn) { conns_snapshot.push_back(conn); }
       }
       conns_.clear();
+      connection_count_.store(0, std::memory_order_relaxed);
     }
 
     for (auto& conn : conns_snapshot) {
@@ -171,6 +178,7 @@ namespace cxpnet {
 
   void Server::close_impl_() {
     if (acceptor_) { acceptor_->shutdown(); }
+    if (metrics_endpoint_) { metrics_endpoint_->shutdown(); }
 
     std::vector<std::shared_ptr<Conn>> conns_snapshot;
     {
@@ -180,6 +188,7 @@ namespace cxpnet {
         if (conn) { conns_snapshot.push_back(conn); }
       }
       conns_.clear();
+      connection_count_.store(0, std::memory_order_relaxed);
     }
 
     for (auto& conn : conns_snapshot) {
@@ -192,6 +201,136 @@ namespace cxpnet {
     shutting_down_.store(false, std::memory_order_release);
   }
 
+  void Server::set_sock_options(const SockOptions& sock_options) {
+    sock_options_ = sock_options;
+    if (acceptor_) { acceptor_->set_sock_options(sock_options); }
+  }
+
+  void Server::set_listen_options(const ListenOptions& listen_options) {
+    if (acceptor_) { acceptor_->set_listen_options(listen_options); }
+  }
+
+  void Server::set_accept_limits(const AcceptLimits& limits) {
+    if (acceptor_) { acceptor_->set_accept_limits(limits); }
+  }
+
+  AcceptStats Server::accept_stats() const {
+    return acceptor_ ? acceptor_->stats() : AcceptStats {};
+  }
+
+  void Server::collect_metrics_(MetricsWriter& writer) const {
+    writer.gauge("cxpnet_connections", "Current number of connections", static_cast<double>(connection_count()));
+    if (max_connections_ > 0) {
+      writer.gauge("cxpnet_max_connections", "Configured connection limit", static_cast<double>(max_connections_));
+    }
+
+    AcceptStats accept = accept_stats();
+    writer.counter("cxpnet_accepted_total", "Connections accepted", static_cast<double>(accept.accepted));
+    writer.counter("cxpnet_rejected_total", "Connections rejected by fd exhaustion or max_connections",
+                   static_cast<double>(accept.rejected));
+    writer.counter("cxpnet_accept_deferred_total", "Accept loops yielded by budget, rate limit or fd exhaustion",
+                   static_cast<double>(accept.deferred));
+
+    std::vector<const IOEventPoll*> polls;
+    polls.reserve(sub_polls_.size() + 1);
+    if (main_poll_) { polls.push_back(main_poll_.get()); }
+    for (const auto& poll : sub_polls_) { polls.push_back(poll.get()); }
+
+    std::vector<PollStatsSnapshot> stats;
+    std::vector<TimerStats>        timer_stats;
+    stats.reserve(polls.size());
+    timer_stats.reserve(polls.size());
+    for (const auto* poll : polls) {
+      stats.push_back(poll->stats());
+      timer_stats.push_back(poll->timer_manager() ? poll->timer_manager()->stats() : TimerStats {});
+    }
+
+    // 同名指标的样本必须连续，所以按指标遍历 poll
+    auto for_each_poll = [&polls](auto&& func) {
+      for (size_t i = 0; i < polls.size(); ++i) {
+        MetricsWriter::Labels labels {{"poll", polls[i]->name()}};
+        func(i, labels);
+      }
+    };
+
+    for_each_poll([&](size_t i, const MetricsWriter::Labels& labels) {
+      writer.gauge("cxpnet_poll_connections", "Connections owned by the poll",
+                   static_cast<double>(polls[i]->load().connections), labels);
+    });
+    for_each_poll([&](size_t i, const MetricsWriter::Labels& labels) {
+      writer.counter("cxpnet_poll_iterations_total", "Poll loop iterations", static_cast<double>(stats[i].iterations),
+                     labels);
+    });
+    for_each_poll([&](size_t i, const MetricsWriter::Labels& labels) {
+      writer.counter("cxpnet_poll_events_total", "Channel events dispatched", static_cast<double>(stats[i].events),
+                     labels);
+    });
+    for_each_poll([&](size_t i, const MetricsWriter::Labels& labels) {
+      writer.counter("cxpnet_poll_tasks_total", "Queued tasks executed", static_cast<double>(stats[i].tasks), labels);
+    });
+    for_each_poll([&](size_t i, const MetricsWriter::Labels& labels) {
+      writer.counter("cxpnet_poll_wait_seconds_total", "Time blocked waiting for events",
+                   static_cast<double>(stats[i].wait_ns) * 1e-9, labels);
+    });
+    for_each_poll([&](size_t i, const MetricsWriter::Labels& labels) {
+      writer.counter("cxpnet_poll_busy_seconds_total", "Time spent dispatching events and tasks",
+                   static_cast<double>(stats[i].channel_ns + stats[i].task_ns) * 1e-9, labels);
+    });
+    for_each_poll([&](size_t i, const MetricsWriter::Labels& labels) {
+      writer.counter("cxpnet_poll_received_bytes_total", "Bytes read by connections on the poll",
+                     static_cast<double>(stats[i].bytes_in), labels);
+    });
+    for_each_poll([&](size_t i, const MetricsWriter::Labels& labels) {
+      writer.counter("cxpnet_poll_sent_bytes_total", "Bytes written by connections on the poll",
+                     static_cast<double>(stats[i].bytes_out), labels);
+    });
+    for_each_poll([&](size_t i, const MetricsWriter::Labels& labels) {
+      writer.histogram("cxpnet_poll_iteration_seconds", "Poll iteration processing time, excluding wait",
+                       stats[i].iteration_us, labels, 1e-6);
+    });
+    for_each_poll([&](size_t i, const MetricsWriter::Labels& labels) {
+      writer.histogram("cxpnet_poll_task_wait_seconds", "Queueing delay of the oldest task per batch",
+                       stats[i].task_wait_us, labels, 1e-6);
+    });
+    for_each_poll([&](size_t i, const MetricsWriter::Labels& labels) {
+      for (size_t kind = 0; kind < kCallbackKindCount; ++kind) {
+        MetricsWriter::Labels kind_labels = labels;
+        kind_labels.emplace_back("kind", callback_kind_name(static_cast<CallbackKind>(kind)));
+        writer.counter("cxpnet_poll_slow_callbacks_total", "User callbacks that exceeded the slow callback threshold",
+                       static_cast<double>(stats[i].slow_callbacks[kind]), kind_labels);
+      }
+    });
+    for_each_poll([&](size_t i, const MetricsWriter::Labels& labels) {
+      writer.counter("cxpnet_timers_fired_total", "Timers fired", static_cast<double>(timer_stats[i].fired),
+                     labels);
+    });
+    for_each_poll([&](size_t i, const MetricsWriter::Labels& labels) {
+      writer.histogram("cxpnet_timer_lateness_seconds", "Delay between timer expiry and callback start",
+                       timer_stats[i].lateness_us, labels, 1e-6);
+    });
+  }
+
+  std::vector<std::pair<std::string, PollStatsSnapshot>> Server::poll_stats() const {
+    std::vector<std::pair<std::string, PollStatsSnapshot>> result;
+    result.reserve(sub_polls_.size() + 1);
+
+    if (main_poll_) { result.emplace_back(std::string(main_poll_->name()), main_poll_->stats()); }
+    for (const auto& poll : sub_polls_) {
+      result.emplace_back(std::string(poll->name()), poll->stats());
+    }
+    return result;
+  }
+
+  std::vector<IOEventPoll*> Server::io_polls() const {
+    std::vector<IOEventPoll*> polls;
+    if (running_mode_ == RunningMode::kOnePollPerThread && !sub_polls_.empty()) {
+      for (const auto& poll : sub_polls_) { polls.push_back(poll.get()); }
+    } else if (main_poll_) {
+      polls.push_back(main_poll_.get());
+    }
+    return polls;
+  }
+
   void Server::run_in_poll_and_wait_(IOEventPoll* event_poll, Closure func) {
     if (event_poll == nullptr) { return; }
 
@@ -262,6 +401,7 @@ namespace cxpnet {
     }
 
     running_mode_ = mode;
+    main_poll_->set_slow_callback_options(slow_callback_options_);
     if (running_mode_ == RunningMode::kOnePollPerThread) {
       sub_polls_.reserve(thread_num_);
       std::vector<IOEventPoll*> polls;
@@ -270,11 +410,14 @@ namespace cxpnet {
         auto poll = std::make_unique<IOEventPoll>();
         poll->set_name(std::format("sub_poll_{}", i + 1));
         poll->set_error_callback(std::bind(&Server::on_poll_error_, this, std::placeholders::_1, std::placeholders::_2));
+        poll->set_slow_callback_options(slow_callback_options_);
         polls.push_back(poll.get());
         sub_polls_.push_back(std::move(poll));
       }
 
       poll_thread_pool_ = std::make_unique<PollThreadPool>(polls);
+      poll_thread_pool_->set_select_strategy(select_strategy_);
+      poll_thread_pool_->set_thread_options(poll_thread_options_);
       poll_thread_pool_->start();
     }
 
@@ -283,6 +426,17 @@ namespace cxpnet {
       started_.store(false, std::memory_order_release);
       return false;
     }
+
+    if (metrics_port_ != 0) {
+      metrics_endpoint_ = std::make_unique<MetricsEndpoint>(main_poll_.get(), metrics_.get());
+      if (!metrics_endpoint_->listen(metrics_addr_.c_str(), metrics_port_)) {
+        metrics_endpoint_.reset();
+        acceptor_->shutdown();
+        shutdown_polls_();
+        started_.store(false, std::memory_order_release);
+        return false;
+      }
+    }
     return true;
   }
 
@@ -307,6 +461,15 @@ namespace cxpnet {
   void Server::on_conn_close_(int handle) {
     std::lock_guard<std::mutex> lock(conns_mutex_);
     conns_.erase(handle);
+    connection_count_.store(conns_.size(), std::memory_order_relaxed);
+  }
+
+  void Server::reject_connection_(int handle) {
+    Platform::close_handle(handle);
+    acceptor_->note_rejected();
+    if (on_error_func_ != nullptr) {
+      on_error_func_(EMFILE);
+    }
   }
 
   void Server::on_acceptor_error_(int err) {
@@ -327,15 +490,10 @@ namespace cxpnet {
   void Server::on_new_connection_(int handle, struct sockaddr_storage addr_storage) {
     if (handle == invalid_socket) { return; }
 
-    {
-      std::lock_guard<std::mutex> lock(conns_mutex_);
-      if (max_connections_ > 0 && conns_.size() >= max_connections_) {
-        Platform::close_handle(handle);
-        if (on_error_func_ != nullptr) {
-          on_error_func_(EMFILE);
-        }
-        return;
-      }
+    // 无锁快速拒绝，避免连接数已满时的风暴里仍然为每个连接做 inet_ntop 和内存分配
+    if (max_connections_ > 0 && connection_count_.load(std::memory_order_relaxed) >= max_connections_) {
+      reject_connection_(handle);
+      return;
     }
 
     char     client_ip_str[INET6_ADDRSTRLEN] = {0};
@@ -353,33 +511,54 @@ namespace cxpnet {
 
     if (client_port == 0 || strlen(client_ip_str) == 0) {
       Platform::close_handle(handle);
+      acceptor_->note_rejected();
       return;
     }
 
     IOEventPoll* event_poll = nullptr;
     if (running_mode_ == RunningMode::kOnePollPerThread) {
-      event_poll = poll_thread_pool_->next_poll();
+      event_poll = poll_thread_pool_->next_poll(&addr_storage);
       assert(event_poll != nullptr);
     } else {
       event_poll = main_poll_.get();
     }
 
+    // 缓冲区大小已从 listen socket 继承，fastopen 只对主动连接有效
+    SockOptions accepted_options      = sock_options_;
+    accepted_options.send_buffer_size = 0;
+    accepted_options.recv_buffer_size = 0;
+    accepted_options.fastopen         = false;
+    Platform::apply_sock_options(handle, accepted_options);
+
     auto conn = std::make_shared<Conn>(event_poll, handle);
     conn->set_remote_addr_(client_ip_str, client_port);
+    conn->set_sock_options(sock_options_);
     conn->set_internal_close_callback_([this, handle]() {
       on_conn_close_(handle);
     });
 
     {
       std::lock_guard<std::mutex> lock(conns_mutex_);
-      conns_[handle] = conn;
+      if (max_connections_ > 0 && conns_.size() >= max_connections_) {
+        conn->set_internal_close_callback_(nullptr);
+        conn.reset(); // ~Conn 关闭 handle
+      } else {
+        conns_[handle] = conn;
+        connection_count_.store(conns_.size(), std::memory_order_relaxed);
+      }
+    }
+
+    if (!conn) {
+      acceptor_->note_rejected();
+      if (on_error_func_ != nullptr) { on_error_func_(EMFILE); }
+      return;
     }
 
     auto on_conn_func = on_conn_func_;
-    event_poll->run_in_poll([conn, on_conn_func]() {
+    event_poll->run_in_poll([event_poll, conn, on_conn_func]() {
       conn->start_();
       if (on_conn_func != nullptr) {
-        on_conn_func(conn);
+        event_poll->run_user_callback_(CallbackKind::kConnection, conn.get(), [&]() { on_conn_func(conn); });
       }
     });
   }
@@ -1,6 +1,10 @@
 ﻿#ifndef SERVER_H
 #define SERVER_H
 
+#include "io_event_poll.h"
+#include "metrics.h"
+#include "poll_stats.h"
+#include "poll_thread_pool.h"
 #include "sock.h"
 #include <chrono>
 #include <atomic>
@@ -14,9 +18,9 @@
 
 namespace cxpnet {
   class Acceptor;
+  struct AcceptStats;
   class Conn;
   class IOEventPoll;
-  class PollThreadPool;
 
   // TCP 服务器
   // 对齐 iocpnet 的 IOCPServer 接口
@@ -37,6 +41,10 @@ namespace cxpnet {
     void poll(); // non-blocking
 
     void set_thread_num(int n) { thread_num_ = n; }
+    // 在 start 之前调用，kOnePollPerThread 下新连接选择 sub poll 的策略
+    void set_poll_select_strategy(PollSelectStrategy strategy) { select_strategy_ = strategy; }
+    // 在 start 之前调用，sub poll 线程的绑核、命名和 NUMA 设置
+    void set_poll_thread_options(const PollThreadOptions& options) { poll_thread_options_ = options; }
 
     void set_conn_user_callback(std::function<void(ConnPtr)> func) {
       on_conn_func_ = std::move(func);
@@ -51,9 +59,32 @@ namespace cxpnet {
     void set_shutdown_timeout(uint32_t ms) {
       shutdown_timeout_ms_ = ms;
     }
+    // 在 start 之前调用，应用到每个 accept 到的连接
+    // 缓冲区大小设置在 listen socket 上由连接继承，fastopen 只对主动连接有效，忽略
+    void set_sock_options(const SockOptions& sock_options);
+    // 在 start 之前调用，TCP_FASTOPEN / TCP_DEFER_ACCEPT
+    void set_listen_options(const ListenOptions& listen_options);
+    // 在 start 之前调用，单次唤醒 accept 预算与限速
+    void set_accept_limits(const AcceptLimits& limits);
+    // 在 start 之前调用，应用到 main_poll 和所有 sub poll，handler 在各自的 poll 线程上调用
+    void set_slow_callback_options(const SlowCallbackOptions& options) { slow_callback_options_ = options; }
+    // 任意线程可调用，rejected 包含 max_connections 拒绝的连接
+    AcceptStats accept_stats() const;
+    // 任意线程可调用，依次为 main_poll 和各 sub poll，first 为 poll 名称
+    std::vector<std::pair<std::string, PollStatsSnapshot>> poll_stats() const;
+    // start 之后调用，连接所在的 poll：kOnePollPerThread 下为各 sub poll，否则为 main_poll
+    // 可以交给 ConnPool，让上游连接和下游连接在同一组 poll 线程上
+    std::vector<IOEventPoll*> io_polls() const;
     size_t connection_count() const {
-      std::lock_guard<std::mutex> lock(conns_mutex_);
-      return conns_.size();
+      return connection_count_.load(std::memory_order_relaxed);
+    }
+
+    // 内置 server / poll / accept / timer 指标，用户也可以在这里注册自己的指标
+    MetricsRegistry& metrics() { return *metrics_; }
+    // 在 start 之前调用，在 main_poll 上提供 Prometheus 文本格式的 GET /metrics
+    void enable_metrics(const char* addr, uint16_t port) {
+      metrics_addr_ = addr;
+      metrics_port_ = port;
     }
   private:
     void shutdown_impl_();
@@ -68,29 +99,40 @@ namespace cxpnet {
     void on_acceptor_error_(int err);
     void on_poll_error_(IOEventPoll* event_poll, int err);
     void on_new_connection_(int handle, struct sockaddr_storage addr_storage);
+    void reject_connection_(int handle);
     void shutdown_polls_();
+    void collect_metrics_(MetricsWriter& writer) const;
   private:
     std::unique_ptr<IOEventPoll>              main_poll_;
     std::vector<std::unique_ptr<IOEventPoll>> sub_polls_;
     std::unique_ptr<Acceptor>                 acceptor_;
     std::unique_ptr<PollThreadPool>           poll_thread_pool_;
+    std::unique_ptr<MetricsRegistry>          metrics_;
+    std::unique_ptr<MetricsEndpoint>          metrics_endpoint_;
     std::thread                               exit_thread_;
     mutable std::mutex                        exit_thread_mutex_;
 
-    int               thread_num_ = 0;
-    std::atomic<bool> started_ {false};
-    std::atomic<bool> shutting_down_ {false};
-    RunningMode       running_mode_;
+    int                thread_num_ = 0;
+    std::atomic<bool>  started_ {false};
+    std::atomic<bool>  shutting_down_ {false};
+    RunningMode        running_mode_;
+    PollSelectStrategy select_strategy_ = PollSelectStrategy::kRoundRobin;
+    PollThreadOptions  poll_thread_options_;
     std::chrono::steady_clock::time_point shutdown_deadline_ {};
 
     std::unordered_map<int, std::shared_ptr<Conn>> conns_;
     mutable std::mutex                             conns_mutex_;
+    std::atomic<size_t>                            connection_count_ {0}; // conns_.size() 的无锁副本
 
     std::function<void(ConnPtr)> on_conn_func_;
     std::function<void(int)>     on_error_func_;
 
-    size_t   max_connections_     = 0;     // 0 表示无限制
-    uint32_t shutdown_timeout_ms_ = 30000; // 默认 30 秒
+    SockOptions         sock_options_;
+    SlowCallbackOptions slow_callback_options_;
+    size_t              max_connections_     = 0;     // 0 表示无限制
+    uint32_t            shutdown_timeout_ms_ = 30000; // 默认 30 秒
+    std::string         metrics_addr_;
+    uint16_t            metrics_port_ = 0; // 0 表示不开启 metrics 端口
   };
 } // namespace cxpnet
 
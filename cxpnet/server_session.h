@@ -0,0 +1,74 @@
+﻿#ifndef SERVER_SESSION_H
+#define SERVER_SESSION_H
+
+#include "buffer.h"
+#include "conn.h"
+#include "server.h"
+
+#include <memory>
+#include <vector>
+
+namespace cxpnet {
+  // 请求 / 应答式协议服务 (HttpServer、RespServer) 每个连接的公共状态
+  // 一次读回调中产生的所有应答先写入 out，回调结束时 flush 一次 send 写出
+  // out 在 begin 时从本线程的缓冲池借出，flush 后归还，空闲的 keep-alive 连接不持有应答缓冲
+  struct ReplySession {
+    explicit ReplySession(Conn* c)
+        : conn(c) { }
+
+    Conn*                   conn;
+    std::unique_ptr<Buffer> out;             // 本次读回调中所有应答的序列化结果，只在 begin 和 flush 之间有效
+    bool                    closing = false; // 已决定关闭，之后到达的数据丢弃
+
+    // 读回调开始时调用；已决定关闭时丢弃本次读到的数据，返回 true 表示调用方直接返回
+    bool begin(Buffer* buffer) {
+      if (closing) {
+        buffer->been_read_all();
+        return true;
+      }
+      // 处理函数抛出异常时上次借出的缓冲没有归还，直接复用
+      if (!out) { out = acquire_scratch_(); }
+      return false;
+    }
+
+    // 写出 out 并归还；closing 时丢弃剩余输入，写完后关闭写端
+    void flush(Buffer* buffer) {
+      if (closing) { buffer->been_read_all(); }
+      if (out && !out->empty()) {
+        conn->send(out->peek(), out->readable_size());
+        out->been_read_all();
+      }
+      if (out) { scratch_pool_().push_back(std::move(out)); }
+      if (closing) { conn->shutdown(); }
+    }
+  private:
+    // 同一 poll 线程上的读回调依次执行，池里通常只有一个缓冲；嵌套的读回调会借到另一个
+    static std::vector<std::unique_ptr<Buffer>>& scratch_pool_() {
+      thread_local std::vector<std::unique_ptr<Buffer>> pool;
+      return pool;
+    }
+
+    static std::unique_ptr<Buffer> acquire_scratch_() {
+      auto& pool = scratch_pool_();
+      if (pool.empty()) { return std::make_unique<Buffer>(); }
+
+      std::unique_ptr<Buffer> scratch = std::move(pool.back());
+      pool.pop_back();
+      return scratch;
+    }
+  };
+
+  // 挂在 Server 上的协议服务，Derived 提供 on_connection(const ConnPtr&)
+  template <typename Derived>
+  class ServerAttachable {
+  public:
+    // 接管 server 的连接回调，服务对象需要比 server 活得久
+    void attach(Server& server) {
+      server.set_conn_user_callback([this](ConnPtr conn) { static_cast<Derived*>(this)->on_connection(conn); });
+    }
+  protected:
+    ~ServerAttachable() = default;
+  };
+} // namespace cxpnet
+
+#endif // SERVER_SESSION_H
@@ -43,12 +43,53 @@ namespace cxpnet {
     static const int kReuseAddr = 1 << 1;
   } // namespace SocketOption
 
+  // 连接级 socket 选项
+  // Server 应用于 accept 到的连接，Conn::connect 在发起连接前应用
+  // 0 / false 表示保持系统默认值
+  struct SockOptions {
+    bool tcp_nodelay       = false; // TCP_NODELAY，关闭 Nagle
+    bool keepalive         = false; // SO_KEEPALIVE
+    int  keepalive_idle_s  = 0;     // TCP_KEEPIDLE (macOS: TCP_KEEPALIVE)
+    int  keepalive_intvl_s = 0;     // TCP_KEEPINTVL
+    int  keepalive_count   = 0;     // TCP_KEEPCNT
+    int  send_buffer_size  = 0;     // SO_SNDBUF
+    int  recv_buffer_size  = 0;     // SO_RCVBUF
+    int  notsent_lowat     = 0;     // TCP_NOTSENT_LOWAT
+    bool quickack          = false; // TCP_QUICKACK，Linux only，每次读后重新设置
+    int  busy_poll_us      = 0;     // SO_BUSY_POLL，Linux only
+    bool fastopen          = false; // TCP Fast Open 主动连接，只在异步 connect 且有 connect payload 时生效
+  };
+
+  // 监听 socket 选项，Acceptor 在 listen 前应用
+  struct ListenOptions {
+    int fastopen_queue = 0; // TCP_FASTOPEN 服务端队列长度，0 表示关闭 (macOS 只区分开关)
+    int defer_accept_s = 0; // TCP_DEFER_ACCEPT，数据到达前不唤醒 accept，Linux only
+  };
+
+  // TCP_INFO 采样结果 (macOS: TCP_CONNECTION_INFO，没有 unacked / lost)
+  struct TcpInfo {
+    uint32_t rtt_us        = 0; // 平滑 RTT
+    uint32_t rttvar_us     = 0;
+    uint32_t snd_cwnd      = 0; // 拥塞窗口，Linux 为报文数，macOS 为字节数
+    uint32_t unacked       = 0;
+    uint32_t lost          = 0;
+    uint64_t total_retrans = 0; // 累计重传报文数
+  };
+
+  // accept 节流，防止重连风暴时主 poll 长时间卡在 accept 循环里
+  struct AcceptLimits {
+    size_t   max_per_wakeup = 128; // 单次唤醒最多 accept 的连接数，剩余的让出给下一轮 poll，0 表示不限
+    uint32_t rate_per_sec   = 0;   // 令牌桶速率，0 表示不限速
+    uint32_t burst          = 0;   // 令牌桶容量，0 表示等于 rate_per_sec
+  };
+
   static constexpr size_t   kMaxPollEventCount = 64;
   static constexpr uint32_t kPollTimeoutMS     = 10000;
   // clang-format off
   enum class ProtocolStack { kIPv4Only, kIPv6Only, kDualStack };
   enum class IPType { kInvalid, kIPv4, kIPv6 };
   enum class RunningMode { kOnePollPerThread, kAllOneThread };
+  enum class PollSelectStrategy { kRoundRobin, kLeastConnections, kLeastBusy, kPowerOfTwoChoices, kAddressHash };
   enum class State { kDisconnected, kConnecting, kConnected, kDisconnecting };
   // clang-format on
  
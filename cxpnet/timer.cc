@@ -1,4 +1,5 @@
 ﻿#include "timer.h"
+#include "trace.h"
 
 namespace cxpnet {
 
@@ -46,6 +47,7 @@ namespace cxpnet {
     if (timer_it == timers_.end()) { return; }
 
     timer_it->second->cancel();
+    single_writer_add(cancelled_, 1);
 
     auto scheduled_it = scheduled_timers_.find(id);
     if (scheduled_it != scheduled_timers_.end()) {
@@ -72,6 +74,15 @@ namespace cxpnet {
     schedule_.clear();
   }
 
+  TimerStats TimerManager::stats() const {
+    TimerStats stats;
+    stats.fired       = fired_.load(std::memory_order_relaxed);
+    stats.cancelled   = cancelled_.load(std::memory_order_relaxed);
+    stats.lateness_us = lateness_us_.snapshot();
+    stats.callback_us = callback_us_.snapshot();
+    return stats;
+  }
+
   void TimerManager::timer_thread_func_() {
     while (running_.load(std::memory_order_acquire)) {
       std::unique_lock<std::mutex> lock_guard(mutex_);
@@ -93,7 +104,7 @@ namespace cxpnet {
       if (!running_.load(std::memory_order_acquire)) { break; }
 
       auto                         now = std::chrono::steady_clock::now();
-      std::vector<Timer::Callback> expired_callbacks;
+      std::vector<std::pair<TimePoint, Timer::Callback>> expired_callbacks;
 
       while (!schedule_.empty()) {
         auto scheduled_it = schedule_.begin();
@@ -110,16 +121,25 @@ namespace cxpnet {
           continue;
         }
 
-        expired_callbacks.push_back(std::move(timer_it->second->callback_));
+        expired_callbacks.emplace_back(timer_it->second->expire_time_, std::move(timer_it->second->callback_));
         timers_.erase(timer_it);
       }
 
       lock_guard.unlock();
 
-      for (auto& callback : expired_callbacks) {
+      for (auto& [expire_time, callback] : expired_callbacks) {
         if (!running_.load(std::memory_order_acquire)) { break; }
         if (callback) {
-          callback();
+          auto start = std::chrono::steady_clock::now();
+          {
+            CXP_TRACE_SCOPE("timer_fire", to_us_(start - expire_time));
+            callback();
+          }
+          auto done = std::chrono::steady_clock::now();
+
+          single_writer_add(fired_, 1);
+          lateness_us_.record(to_us_(start - expire_time));
+          callback_us_.record(to_us_(done - start));
         }
       }
     }
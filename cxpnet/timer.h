@@ -1,6 +1,7 @@
 ﻿#ifndef TIMER_H
 #define TIMER_H
 
+#include "histogram.h"
 #include "sock.h"
 
 #include <chrono>
@@ -43,6 +44,14 @@ namespace cxpnet {
     friend class TimerManager;
   };
 
+  // TimerManager 运行统计快照
+  struct TimerStats {
+    uint64_t          fired     = 0;
+    uint64_t          cancelled = 0;
+    HistogramSnapshot lateness_us; // 实际触发时间晚于到期时间的部分，微秒
+    HistogramSnapshot callback_us; // 定时器线程上回调的执行耗时，微秒
+  };
+
   class TimerManager : public NonCopyable {
   public:
     TimerManager();
@@ -51,9 +60,15 @@ namespace cxpnet {
     Timer::TimerID add_timer(uint32_t delay_ms, Timer::Callback cb);
     void           cancel_timer(Timer::TimerID id);
     void           shutdown();
+    TimerStats     stats() const;
   private:
     void timer_thread_func_();
 
+    static uint64_t to_us_(std::chrono::steady_clock::duration d) {
+      auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+      return us > 0 ? static_cast<uint64_t>(us) : 0;
+    }
+
     using TimePoint   = std::chrono::steady_clock::time_point;
     using ScheduleMap = std::multimap<TimePoint, Timer::TimerID>;
 
@@ -65,6 +80,11 @@ namespace cxpnet {
     std::thread                                                timer_thread_;
     std::atomic_bool                                           running_ {true};
     Timer::TimerID                                             next_id_ {1};
+    // 统计，fired_ / 直方图只由定时器线程写入，cancelled_ 在 mutex_ 保护下写入
+    std::atomic<uint64_t>                                      fired_ {0};
+    std::atomic<uint64_t>                                      cancelled_ {0};
+    HistogramShard                                             lateness_us_;
+    HistogramShard                                             callback_us_;
   };
 
 } // namespace cxpnet
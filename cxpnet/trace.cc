@@ -0,0 +1,238 @@
+﻿#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <mutex>
+
+namespace cxpnet {
+  namespace trace {
+    namespace {
+      struct ThreadEntry {
+        std::shared_ptr<Ring> ring;
+        std::string           name;
+        bool                  exited = false;
+      };
+
+      // 线程退出后缓冲连同线程名仍保留在注册表中，导出时可以看到已退出线程的事件
+      // 短命线程反复创建时只保留最近退出的 kMaxExitedThreads 个，更早的缓冲释放
+      constexpr size_t kMaxExitedThreads = 16;
+
+      struct Registry {
+        std::mutex               mutex;
+        std::vector<ThreadEntry> threads;
+        uint32_t                 next_tid      = 1;
+        size_t                   ring_capacity = 1 << 16;
+      };
+
+      // 不析构，保证线程退出和静态析构期间仍可访问
+      Registry& registry() {
+        static Registry* instance = new Registry();
+        return *instance;
+      }
+
+      std::atomic<bool>     g_enabled {true};
+      std::atomic<uint64_t> g_next_flow_id {1};
+      thread_local Ring*    t_ring   = nullptr;
+      thread_local bool     t_exited = false;
+
+      // 线程退出时把缓冲标记为已退出，超出保留数量时释放最早的一个
+      struct ExitGuard {
+        ~ExitGuard() {
+          Registry&                   reg = registry();
+          std::lock_guard<std::mutex> lock(reg.mutex);
+          size_t                      exited = 0;
+          for (auto& entry : reg.threads) {
+            if (entry.ring.get() == t_ring) { entry.exited = true; }
+            if (entry.exited) { ++exited; }
+          }
+          if (exited > kMaxExitedThreads) {
+            auto oldest = std::find_if(reg.threads.begin(), reg.threads.end(),
+                                       [](const ThreadEntry& entry) { return entry.exited; });
+            reg.threads.erase(oldest);
+          }
+
+          // 之后析构的 thread_local 中的事件不再记录，缓冲可能已经释放
+          t_ring   = nullptr;
+          t_exited = true;
+        }
+      };
+      thread_local ExitGuard t_exit_guard;
+
+      // 线程退出过程中返回 nullptr
+      Ring* local_ring() {
+        if (t_ring != nullptr) { return t_ring; }
+        if (t_exited) { return nullptr; }
+
+        Registry&                   reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        auto                        ring = std::make_shared<Ring>(reg.next_tid++, reg.ring_capacity);
+        reg.threads.push_back({ring, ""});
+        t_ring = ring.get();
+        // 只在线程第一次记录事件时构造，热路径上的 t_ring 仍是平凡的 thread_local
+        (void)&t_exit_guard;
+        return t_ring;
+      }
+
+      void append_escaped(std::string& out, std::string_view text) {
+        for (char c : text) {
+          if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+          } else if (static_cast<unsigned char>(c) < 0x20) {
+            out += std::format("\\u{:04x}", static_cast<int>(c));
+          } else {
+            out += c;
+          }
+        }
+      }
+
+      void append_event(std::string& out, uint32_t tid, const Event& event) {
+        out += std::format("{{\"ph\":\"{}\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"name\":\"",
+                           static_cast<char>(event.phase), tid, static_cast<double>(event.ts_ns) / 1000.0);
+        append_escaped(out, event.name != nullptr ? event.name : "");
+        out += '"';
+
+        switch (event.phase) {
+        case Phase::kComplete:
+          out += std::format(",\"dur\":{:.3f},\"args\":{{\"arg\":{}}}", static_cast<double>(event.dur_ns) / 1000.0, event.arg);
+          break;
+        case Phase::kInstant:
+          out += std::format(",\"s\":\"t\",\"args\":{{\"arg\":{}}}", event.arg);
+          break;
+        case Phase::kFlowStart:
+          out += std::format(",\"cat\":\"task\",\"id\":{}", event.arg);
+          break;
+        case Phase::kFlowEnd:
+          // bp=e 把终点绑定到包含它的区间 (执行任务的 "task")
+          out += std::format(",\"cat\":\"task\",\"id\":{},\"bp\":\"e\"", event.arg);
+          break;
+        }
+        out += "},\n";
+      }
+    } // namespace
+
+    Ring::Ring(uint32_t tid, size_t capacity)
+        : tid_(tid) {
+      size_t size = 1;
+      while (size < capacity) { size <<= 1; }
+      mask_   = size - 1;
+      slots_  = std::make_unique<Slot[]>(size);
+    }
+
+    std::vector<Event> Ring::snapshot() const {
+      uint64_t capacity = mask_ + 1;
+      uint64_t head     = head_.load(std::memory_order_acquire);
+      uint64_t begin    = head > capacity ? head - capacity : 0;
+
+      std::vector<Event> events;
+      events.reserve(head - begin);
+      for (uint64_t i = begin; i < head; ++i) {
+        const Slot& slot = slots_[i & mask_];
+        Event       event;
+        event.ts_ns  = slot.ts_ns.load(std::memory_order_relaxed);
+        event.dur_ns = slot.dur_ns.load(std::memory_order_relaxed);
+        event.name   = slot.name.load(std::memory_order_relaxed);
+        event.arg    = slot.arg.load(std::memory_order_relaxed);
+        event.phase  = slot.phase.load(std::memory_order_relaxed);
+        events.push_back(event);
+      }
+
+      // 复制期间写入的新事件可能覆盖了最旧的槽位，丢弃这部分
+      // 写者正在写下标 after 时覆盖的是 after - capacity，所以低于 after - capacity + 1 的都不可信
+      std::atomic_thread_fence(std::memory_order_acquire);
+      uint64_t after = head_.load(std::memory_order_relaxed);
+      if (after + 1 > capacity && after + 1 - capacity > begin) {
+        size_t overwritten = static_cast<size_t>((std::min)(after + 1 - capacity - begin, head - begin));
+        events.erase(events.begin(), events.begin() + static_cast<std::ptrdiff_t>(overwritten));
+      }
+      return events;
+    }
+
+    void set_enabled(bool enabled) { g_enabled.store(enabled, std::memory_order_relaxed); }
+    bool enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+    void set_ring_capacity(size_t events) {
+      Registry&                   reg = registry();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      reg.ring_capacity = (std::max)(events, size_t {16});
+    }
+
+    void set_thread_name(std::string_view name) {
+      Ring* ring = local_ring();
+      if (ring == nullptr) { return; }
+
+      Registry&                   reg = registry();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      for (auto& entry : reg.threads) {
+        if (entry.ring.get() == ring) { entry.name = name; }
+      }
+    }
+
+    int64_t now_ns() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    }
+
+    void complete(const char* name, int64_t start_ns, uint64_t arg) {
+      if (!enabled()) { return; }
+      if (Ring* ring = local_ring()) { ring->push({start_ns, now_ns() - start_ns, name, arg, Phase::kComplete}); }
+    }
+
+    void instant(const char* name, uint64_t arg) {
+      if (!enabled()) { return; }
+      if (Ring* ring = local_ring()) { ring->push({now_ns(), 0, name, arg, Phase::kInstant}); }
+    }
+
+    void flow(Phase phase, uint64_t id) {
+      if (!enabled()) { return; }
+      if (Ring* ring = local_ring()) { ring->push({now_ns(), 0, "task", id, phase}); }
+    }
+
+    Closure wrap_task(Closure func) {
+      if (!enabled()) { return func; }
+
+      uint64_t id = g_next_flow_id.fetch_add(1, std::memory_order_relaxed);
+      flow(Phase::kFlowStart, id);
+      return [func = std::move(func), id]() {
+        Scope scope("task", id);
+        flow(Phase::kFlowEnd, id);
+        func();
+      };
+    }
+
+    std::string chrome_json() {
+      std::vector<ThreadEntry> threads;
+      {
+        Registry&                   reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        threads = reg.threads;
+      }
+
+      std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+      for (const auto& entry : threads) {
+        uint32_t tid = entry.ring->tid();
+        if (!entry.name.empty()) {
+          out += std::format("{{\"ph\":\"M\",\"pid\":1,\"tid\":{},\"name\":\"thread_name\",\"args\":{{\"name\":\"", tid);
+          append_escaped(out, entry.name);
+          out += "\"}},\n";
+        }
+        for (const auto& event : entry.ring->snapshot()) { append_event(out, tid, event); }
+      }
+
+      // 去掉最后一个事件后的逗号
+      if (out.ends_with(",\n")) { out.erase(out.size() - 2, 1); }
+      out += "]}\n";
+      return out;
+    }
+
+    bool dump_chrome_json(const std::string& path) {
+      std::ofstream file(path);
+      if (!file) { return false; }
+      file << chrome_json();
+      return static_cast<bool>(file);
+    }
+  } // namespace trace
+} // namespace cxpnet
@@ -0,0 +1,120 @@
+﻿#ifndef TRACE_H
+#define TRACE_H
+
+#include "sock.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cxpnet {
+  // 事件追踪：每个线程一个定长环形缓冲，按需导出为 Chrome trace JSON (chrome://tracing / Perfetto)
+  // 编译期开关：CMake -DCXPNET_ENABLE_TRACING=ON 定义 CXP_ENABLE_TRACING
+  // 未定义时 CXP_TRACE_* 宏展开为空，热路径上没有任何额外代码；trace:: 函数仍可调用，导出为空
+  namespace trace {
+    enum class Phase : uint8_t {
+      kComplete  = 'X', // 有持续时间的区间
+      kInstant   = 'i', // 瞬时事件
+      kFlowStart = 's', // 跨线程任务的投递端
+      kFlowEnd   = 'f', // 跨线程任务的执行端
+    };
+
+    // 定长事件，name 只保存指针，必须是字符串字面量
+    struct Event {
+      int64_t     ts_ns  = 0;
+      int64_t     dur_ns = 0;
+      const char* name   = nullptr;
+      uint64_t    arg    = 0;
+      Phase       phase  = Phase::kInstant;
+    };
+
+    // 单写者环形缓冲，写满后覆盖最旧的事件
+    // 槽位字段都是 relaxed 原子变量，导出线程可以和写者并发读取而不构成数据竞争；x86 / ARM 上仍是普通的 mov
+    // 导出线程通过前后两次 head 丢弃可能被覆盖的槽位
+    class Ring : public NonCopyable {
+    public:
+      Ring(uint32_t tid, size_t capacity);
+
+      void push(const Event& event) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        Slot&    slot = slots_[head & mask_];
+        slot.ts_ns.store(event.ts_ns, std::memory_order_relaxed);
+        slot.dur_ns.store(event.dur_ns, std::memory_order_relaxed);
+        slot.name.store(event.name, std::memory_order_relaxed);
+        slot.arg.store(event.arg, std::memory_order_relaxed);
+        slot.phase.store(event.phase, std::memory_order_relaxed);
+        head_.store(head + 1, std::memory_order_release);
+      }
+
+      std::vector<Event> snapshot() const;
+      uint32_t           tid() const { return tid_; }
+    private:
+      struct Slot {
+        std::atomic<int64_t>     ts_ns {0};
+        std::atomic<int64_t>     dur_ns {0};
+        std::atomic<const char*> name {nullptr};
+        std::atomic<uint64_t>    arg {0};
+        std::atomic<Phase>       phase {Phase::kInstant};
+      };
+
+      uint32_t                tid_;
+      size_t                  mask_;
+      std::unique_ptr<Slot[]> slots_;
+      std::atomic<uint64_t>   head_ {0};
+    };
+
+    // 运行期开关，默认开启；只在编译期开启追踪时有意义
+    void set_enabled(bool enabled);
+    bool enabled();
+    // 之后新建的线程缓冲容量 (事件数)，向上取整为 2 的幂
+    void set_ring_capacity(size_t events);
+    void set_thread_name(std::string_view name);
+
+    int64_t now_ns();
+    void    complete(const char* name, int64_t start_ns, uint64_t arg);
+    void    instant(const char* name, uint64_t arg);
+    void    flow(Phase phase, uint64_t id);
+
+    // 包装跨线程投递的任务：投递时记录 flow 起点，执行时记录 "task" 区间和 flow 终点
+    Closure wrap_task(Closure func);
+
+    // 所有线程 (包括最近退出的线程) 的事件，Chrome trace event 格式
+    std::string chrome_json();
+    bool        dump_chrome_json(const std::string& path);
+
+    // RAII 区间
+    class Scope : public NonCopyable {
+    public:
+      Scope(const char* name, uint64_t arg)
+          : name_(name)
+          , arg_(arg)
+          , start_ns_(enabled() ? now_ns() : 0) { }
+      ~Scope() {
+        if (start_ns_ != 0) { complete(name_, start_ns_, arg_); }
+      }
+    private:
+      const char* name_;
+      uint64_t    arg_;
+      int64_t     start_ns_;
+    };
+  } // namespace trace
+} // namespace cxpnet
+
+#ifdef CXP_ENABLE_TRACING
+#define CXP_TRACE_CONCAT_(a, b)      a##b
+#define CXP_TRACE_CONCAT(a, b)       CXP_TRACE_CONCAT_(a, b)
+#define CXP_TRACE_SCOPE(name, arg)   ::cxpnet::trace::Scope CXP_TRACE_CONCAT(cxp_trace_scope_, __LINE__)((name), static_cast<uint64_t>(arg))
+#define CXP_TRACE_INSTANT(name, arg) ::cxpnet::trace::instant((name), static_cast<uint64_t>(arg))
+#define CXP_TRACE_WRAP_TASK(func)    (func) = ::cxpnet::trace::wrap_task(std::move(func))
+#define CXP_TRACE_THREAD_NAME(name)  ::cxpnet::trace::set_thread_name(name)
+#else
+#define CXP_TRACE_SCOPE(name, arg)   ((void)0)
+#define CXP_TRACE_INSTANT(name, arg) ((void)0)
+#define CXP_TRACE_WRAP_TASK(func)    ((void)0)
+#define CXP_TRACE_THREAD_NAME(name)  ((void)0)
+#endif // CXP_ENABLE_TRACING
+
+#endif // TRACE_H
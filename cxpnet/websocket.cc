@@ -0,0 +1,350 @@
+﻿#include "websocket.h"
+#include "conn.h"
+#include "io_event_poll.h"
+#include "scan.h"
+
+#include <cstring>
+
+namespace cxpnet {
+  namespace {
+    constexpr std::string_view kWsGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+    uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+    // 只用于握手，输入很短
+    void sha1(std::string_view input, unsigned char digest[20]) {
+      uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+      std::string data(input);
+      uint64_t    bit_size = static_cast<uint64_t>(input.size()) * 8;
+      data.push_back(static_cast<char>(0x80));
+      while (data.size() % 64 != 56) { data.push_back(0); }
+      for (int i = 7; i >= 0; --i) { data.push_back(static_cast<char>(bit_size >> (i * 8))); }
+
+      for (size_t block = 0; block < data.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+          const auto* p = reinterpret_cast<const unsigned char*>(data.data() + block + i * 4);
+          w[i]          = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+        }
+        for (int i = 16; i < 80; ++i) { w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1); }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+          uint32_t f, k;
+          if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+          } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+          } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+          } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+          }
+          uint32_t t = rotl(a, 5) + f + e + k + w[i];
+          e          = d;
+          d          = c;
+          c          = rotl(b, 30);
+          b          = a;
+          a          = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+      }
+
+      for (int i = 0; i < 5; ++i) {
+        for (int j = 0; j < 4; ++j) { digest[i * 4 + j] = static_cast<unsigned char>(h[i] >> (24 - j * 8)); }
+      }
+    }
+
+    std::string base64(const unsigned char* data, size_t size) {
+      static constexpr char kTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+      std::string out;
+      out.reserve((size + 2) / 3 * 4);
+      for (size_t i = 0; i < size; i += 3) {
+        uint32_t n = uint32_t(data[i]) << 16;
+        if (i + 1 < size) { n |= uint32_t(data[i + 1]) << 8; }
+        if (i + 2 < size) { n |= uint32_t(data[i + 2]); }
+        out.push_back(kTable[(n >> 18) & 63]);
+        out.push_back(kTable[(n >> 12) & 63]);
+        out.push_back(i + 1 < size ? kTable[(n >> 6) & 63] : '=');
+        out.push_back(i + 2 < size ? kTable[n & 63] : '=');
+      }
+      return out;
+    }
+
+    bool is_control(WsOpcode opcode) { return (static_cast<uint8_t>(opcode) & 0x8) != 0; }
+
+    // 关闭帧中允许出现的状态码 (RFC 6455 7.4)：已定义的 1000 ~ 1003、1007 ~ 1014，和应用使用的 3000 ~ 4999
+    // 1005 / 1006 / 1015 只用于本地报告，不能出现在帧中
+    bool is_valid_close_code(uint16_t code) {
+      return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1014) || (code >= 3000 && code <= 4999);
+    }
+  } // namespace
+
+  size_t ws_encode_header(char* out, WsOpcode opcode, size_t payload_size, bool fin) {
+    out[0] = static_cast<char>((fin ? 0x80 : 0x00) | static_cast<uint8_t>(opcode));
+    if (payload_size < 126) {
+      out[1] = static_cast<char>(payload_size);
+      return 2;
+    }
+    if (payload_size <= 0xFFFF) {
+      out[1] = 126;
+      out[2] = static_cast<char>(payload_size >> 8);
+      out[3] = static_cast<char>(payload_size);
+      return 4;
+    }
+    out[1] = 127;
+    for (int i = 0; i < 8; ++i) { out[2 + i] = static_cast<char>(static_cast<uint64_t>(payload_size) >> (56 - i * 8)); }
+    return 10;
+  }
+
+  std::string ws_encode_frame(WsOpcode opcode, std::string_view payload) {
+    char   header[10];
+    size_t header_size = ws_encode_header(header, opcode, payload.size());
+
+    std::string frame;
+    frame.reserve(header_size + payload.size());
+    frame.append(header, header_size).append(payload);
+    return frame;
+  }
+
+  std::string ws_accept_key(std::string_view client_key) {
+    std::string input;
+    input.reserve(client_key.size() + kWsGuid.size());
+    input.append(client_key).append(kWsGuid);
+
+    unsigned char digest[20];
+    sha1(input, digest);
+    return base64(digest, sizeof(digest));
+  }
+
+  WebSocketConn::WebSocketConn(const ConnPtr& conn, const WebSocketHandlers* handlers, WsLimits limits)
+      : conn_(conn)
+      , handlers_(handlers)
+      , limits_(limits) { }
+
+  void WebSocketConn::send(WsOpcode opcode, std::string_view payload) {
+    if (close_sent_.load(std::memory_order_acquire)) { return; }
+    auto conn = conn_.lock();
+    if (!conn) { return; }
+
+    char   header[10];
+    size_t header_size = ws_encode_header(header, opcode, payload.size());
+    conn->sendv({std::string_view(header, header_size), payload});
+  }
+
+  void WebSocketConn::send_encoded(std::string_view frame) {
+    if (close_sent_.load(std::memory_order_acquire)) { return; }
+    if (auto conn = conn_.lock()) { conn->send(frame); }
+  }
+
+  void WebSocketConn::send_encoded(const std::shared_ptr<const std::string>& frame) {
+    if (close_sent_.load(std::memory_order_acquire)) { return; }
+    auto conn = conn_.lock();
+    if (!conn) { return; }
+
+    // 跨线程时不复制，帧随任务一起交给连接的 poll 线程
+    if (conn->event_poll()->is_in_poll_thread()) {
+      conn->send(*frame);
+      return;
+    }
+    conn->event_poll()->run_in_poll([conn, frame]() { conn->send(*frame); });
+  }
+
+  void WebSocketConn::close(uint16_t code, std::string_view reason) {
+    if (close_sent_.exchange(true, std::memory_order_acq_rel)) { return; }
+    auto conn = conn_.lock();
+    if (!conn) { return; }
+
+    // 关闭帧是控制帧，payload 不超过 125 字节
+    char payload[125];
+    payload[0]         = static_cast<char>(code >> 8);
+    payload[1]         = static_cast<char>(code);
+    size_t reason_size = (std::min)(reason.size(), sizeof(payload) - 2);
+    if (reason_size > 0) { std::memcpy(payload + 2, reason.data(), reason_size); }
+
+    char   header[10];
+    size_t header_size = ws_encode_header(header, WsOpcode::kClose, reason_size + 2);
+    conn->sendv({std::string_view(header, header_size), std::string_view(payload, reason_size + 2)});
+    conn->shutdown();
+  }
+
+  void WebSocketConn::on_message_(Buffer* buffer) {
+    if (close_received_) {
+      buffer->been_read_all();
+      return;
+    }
+
+    while (true) {
+      size_t available = buffer->readable_size();
+      if (available < 2) { break; }
+
+      const auto* p      = reinterpret_cast<const unsigned char*>(buffer->peek());
+      bool        fin    = (p[0] & 0x80) != 0;
+      auto        opcode = static_cast<WsOpcode>(p[0] & 0x0F);
+      bool        masked = (p[1] & 0x80) != 0;
+      uint64_t    length = p[1] & 0x7F;
+
+      // RSV 位没有协商扩展时必须为 0；客户端发来的帧必须带掩码
+      if ((p[0] & 0x70) != 0 || !masked) {
+        fail_(kWsCloseProtocolError, buffer);
+        return;
+      }
+
+      size_t header_size = 2;
+      if (length == 126) {
+        header_size += 2;
+        if (available < header_size) { break; }
+        length = (uint64_t(p[2]) << 8) | p[3];
+      } else if (length == 127) {
+        header_size += 8;
+        if (available < header_size) { break; }
+        length = 0;
+        for (int i = 0; i < 8; ++i) { length = (length << 8) | p[2 + i]; }
+      }
+
+      // 控制帧不能分片，payload 不超过 125；数据帧要与分片状态一致
+      bool valid = false;
+      switch (opcode) {
+      case WsOpcode::kClose:
+      case WsOpcode::kPing:
+      case WsOpcode::kPong: valid = fin && length <= 125; break;
+      case WsOpcode::kContinuation: valid = fragmented_; break;
+      case WsOpcode::kText:
+      case WsOpcode::kBinary: valid = !fragmented_; break;
+      }
+      if (!valid) {
+        fail_(kWsCloseProtocolError, buffer);
+        return;
+      }
+      if (!is_control(opcode) && length > limits_.max_message_size - message_.size()) {
+        fail_(kWsCloseTooBig, buffer);
+        return;
+      }
+
+      header_size += 4;
+      if (available < header_size + length) { break; }
+
+      // 收齐一帧后在读缓冲内原地去掩码
+      char* payload = buffer->to_read() + header_size;
+      scan::xor_mask(payload, static_cast<size_t>(length), p + header_size - 4);
+
+      bool open = handle_frame_(fin, opcode, std::string_view(payload, static_cast<size_t>(length)));
+      buffer->been_read(header_size + static_cast<size_t>(length));
+      if (!open) {
+        buffer->been_read_all();
+        return;
+      }
+    }
+  }
+
+  bool WebSocketConn::handle_frame_(bool fin, WsOpcode opcode, std::string_view payload) {
+    switch (opcode) {
+    case WsOpcode::kPing: send(WsOpcode::kPong, payload); return true;
+    case WsOpcode::kPong: return true;
+    case WsOpcode::kClose:
+      close_received_ = true;
+      if (payload.empty()) {
+        close_code_ = kWsCloseNoStatus;
+        close(kWsCloseNormal);
+        return false;
+      }
+      // 只有 1 字节或状态码非法时以协议错误关闭，否则回应同样的状态码后关闭
+      close_code_ = payload.size() >= 2 ? static_cast<uint16_t>((uint8_t(payload[0]) << 8) | uint8_t(payload[1])) : 0;
+      if (!is_valid_close_code(close_code_)) { close_code_ = kWsCloseProtocolError; }
+      close(close_code_);
+      return false;
+    case WsOpcode::kContinuation:
+      message_.append(payload);
+      if (!fin) { return true; }
+      fragmented_ = false;
+      {
+        bool open = deliver_(message_, message_opcode_);
+        message_.clear();
+        return open;
+      }
+    case WsOpcode::kText:
+    case WsOpcode::kBinary:
+      // 未分片的消息直接交出读缓冲中的数据
+      if (fin) { return deliver_(payload, opcode); }
+      fragmented_     = true;
+      message_opcode_ = opcode;
+      message_.assign(payload);
+      return true;
+    }
+    return true;
+  }
+
+  bool WebSocketConn::deliver_(std::string_view data, WsOpcode opcode) {
+    if (handlers_->on_message) { handlers_->on_message(shared_from_this(), data, opcode); }
+    // 回调中可能调用了 close()，之后的帧不再交出
+    return is_open();
+  }
+
+  void WebSocketConn::fail_(uint16_t code, Buffer* buffer) {
+    close_received_ = true;
+    buffer->been_read_all();
+    close(code);
+  }
+
+  void WebSocketConn::on_close_(int) {
+    if (handlers_->on_close) { handlers_->on_close(shared_from_this(), close_code_); }
+  }
+
+  void WebSocketServer::attach(HttpServer& http, std::string path) {
+    path_ = std::move(path);
+    http.set_upgrade_handler([this](const HttpRequest& request, HttpResponse& response, const ConnPtr& conn) {
+      return upgrade(request, response, conn);
+    });
+  }
+
+  HttpUpgrade WebSocketServer::upgrade(const HttpRequest& request, HttpResponse& response, const ConnPtr& conn) {
+    if (!http_has_token(request.header("Upgrade"), "websocket")) { return {}; }
+    if (!path_.empty() && request.path != path_) { return {}; }
+
+    std::string_view key = request.header("Sec-WebSocket-Key");
+    if (request.method != "GET" || !http_has_token(request.header("Connection"), "upgrade") || key.empty()) {
+      response.set_status(400);
+      response.set_body("Bad WebSocket handshake\n");
+      return {};
+    }
+    if (request.header("Sec-WebSocket-Version") != "13") {
+      response.set_status(426);
+      response.add_header("Sec-WebSocket-Version", "13");
+      return {};
+    }
+
+    response.set_status(101);
+    response.add_header("Upgrade", "websocket");
+    response.add_header("Connection", "Upgrade");
+    response.add_header("Sec-WebSocket-Accept", ws_accept_key(key));
+
+    auto ws = std::make_shared<WebSocketConn>(conn, &handlers_, limits_);
+
+    HttpUpgrade result;
+    if (handlers_.on_open) {
+      result.on_open = [this, ws]() { handlers_.on_open(ws); };
+    }
+    result.on_message = [ws](Buffer* buffer) { ws->on_message_(buffer); };
+    result.on_close   = [ws](int err) { ws->on_close_(err); };
+    return result;
+  }
+
+  void WebSocketServer::broadcast(const std::vector<WsConnPtr>& conns, WsOpcode opcode, std::string_view payload) {
+    if (conns.empty()) { return; }
+
+    auto frame = std::make_shared<const std::string>(ws_encode_frame(opcode, payload));
+    for (const auto& ws : conns) {
+      if (ws) { ws->send_encoded(frame); }
+    }
+  }
+} // namespace cxpnet
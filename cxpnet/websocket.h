@@ -0,0 +1,118 @@
+﻿#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include "http_server.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cxpnet {
+  // WebSocket (RFC 6455) 服务端：通过 HttpServer 的升级回调接管连接
+  // 帧在读缓冲中增量解析，收齐一帧后原地去掩码 (scan::xor_mask，AVX2 / SSE2)，
+  // 未分片的消息直接以指向读缓冲的 string_view 交给回调，分片消息才拼接
+
+  enum class WsOpcode : uint8_t {
+    kContinuation = 0x0,
+    kText         = 0x1,
+    kBinary       = 0x2,
+    kClose        = 0x8,
+    kPing         = 0x9,
+    kPong         = 0xA,
+  };
+
+  inline constexpr uint16_t kWsCloseNormal        = 1000;
+  inline constexpr uint16_t kWsCloseGoingAway     = 1001;
+  inline constexpr uint16_t kWsCloseProtocolError = 1002;
+  inline constexpr uint16_t kWsCloseNoStatus      = 1005; // 对端的关闭帧没有状态码
+  inline constexpr uint16_t kWsCloseAbnormal      = 1006; // 没有收到关闭帧连接就断开了
+  inline constexpr uint16_t kWsCloseTooBig        = 1009;
+
+  struct WsLimits {
+    size_t max_message_size = 1024 * 1024; // 单帧或分片拼接后的上限，超过以 1009 关闭
+  };
+
+  // 服务端帧头 (不带掩码)，out 至少 10 字节，返回头部长度
+  size_t ws_encode_header(char* out, WsOpcode opcode, size_t payload_size, bool fin = true);
+  // 完整的帧 (头部 + payload)，用于广播时只编码一次
+  std::string ws_encode_frame(WsOpcode opcode, std::string_view payload);
+  // 握手应答中的 Sec-WebSocket-Accept
+  std::string ws_accept_key(std::string_view client_key);
+
+  class WebSocketConn;
+  using WsConnPtr = std::shared_ptr<WebSocketConn>;
+
+  // 回调都在连接所在的 poll 线程上执行
+  struct WebSocketHandlers {
+    std::function<void(const WsConnPtr&)> on_open;
+    // opcode 为 kText 或 kBinary；data 只在回调期间有效
+    std::function<void(const WsConnPtr&, std::string_view data, WsOpcode opcode)> on_message;
+    // code 为对端关闭帧中的状态码，没有关闭帧时为 kWsCloseAbnormal，关闭帧不带状态码时为 kWsCloseNoStatus，
+    // 状态码非法时为 kWsCloseProtocolError
+    std::function<void(const WsConnPtr&, uint16_t code)> on_close;
+  };
+
+  // 一个 WebSocket 连接，由底层 Conn 的回调持有，反过来只弱引用 Conn
+  class WebSocketConn : public NonCopyable
+      , public std::enable_shared_from_this<WebSocketConn> {
+  public:
+    WebSocketConn(const ConnPtr& conn, const WebSocketHandlers* handlers, WsLimits limits);
+
+    // 以下发送接口任意线程可调用，头部和 payload 用一次 sendv 写出；关闭帧发出后忽略
+    void send(WsOpcode opcode, std::string_view payload);
+    void send_text(std::string_view text) { send(WsOpcode::kText, text); }
+    void send_binary(std::string_view data) { send(WsOpcode::kBinary, data); }
+    void ping(std::string_view payload = {}) { send(WsOpcode::kPing, payload); }
+    // 发送 ws_encode_frame 编码好的帧
+    void send_encoded(std::string_view frame);
+    void send_encoded(const std::shared_ptr<const std::string>& frame);
+    // 发出关闭帧并半关闭，等待对端关闭连接
+    void close(uint16_t code = kWsCloseNormal, std::string_view reason = {});
+
+    bool    is_open() const { return !close_sent_.load(std::memory_order_acquire); }
+    ConnPtr conn() const { return conn_.lock(); }
+  private:
+    friend class WebSocketServer;
+
+    void on_message_(Buffer* buffer);
+    void on_close_(int err);
+    // 处理一个完整的帧，返回 false 表示连接已开始关闭
+    bool handle_frame_(bool fin, WsOpcode opcode, std::string_view payload);
+    bool deliver_(std::string_view data, WsOpcode opcode);
+    void fail_(uint16_t code, Buffer* buffer);
+
+    std::weak_ptr<Conn>      conn_;
+    const WebSocketHandlers* handlers_;
+    WsLimits                 limits_;
+    std::atomic<bool>        close_sent_ {false};
+    bool                     close_received_ = false;
+    uint16_t                 close_code_     = kWsCloseAbnormal;
+    bool                     fragmented_     = false; // 正在接收分片消息
+    WsOpcode                 message_opcode_ = WsOpcode::kText;
+    std::string              message_;                // 分片消息的拼接结果
+  };
+
+  class WebSocketServer : public NonCopyable {
+  public:
+    explicit WebSocketServer(WebSocketHandlers handlers, WsLimits limits = {})
+        : handlers_(std::move(handlers))
+        , limits_(limits) { }
+
+    // 接管 http 的升级回调；path 为空时任意路径都可以升级。WebSocketServer 需要比连接活得久
+    void attach(HttpServer& http, std::string path = {});
+    // 校验握手并填写 101 应答；不是 WebSocket 请求时返回空，握手非法时把 response 设为 400 / 426
+    HttpUpgrade upgrade(const HttpRequest& request, HttpResponse& response, const ConnPtr& conn);
+
+    // 帧只编码一次，各连接在自己的 poll 线程上写出同一份数据
+    static void broadcast(const std::vector<WsConnPtr>& conns, WsOpcode opcode, std::string_view payload);
+  private:
+    WebSocketHandlers handlers_;
+    WsLimits          limits_;
+    std::string       path_;
+  };
+} // namespace cxpnet
+
+#endif // WEBSOCKET_H
@@ -0,0 +1,26 @@
+﻿#ifndef EXAMPLES_CHECK_H
+#define EXAMPLES_CHECK_H
+
+#include <format>
+#include <iostream>
+#include <string_view>
+#include <utility>
+
+// 行为测试程序 (test_*) 共用的检查：失败时打印原因并计数，不中断后续用例
+
+inline int failures = 0;
+
+template <typename... Args>
+void check(bool ok, std::format_string<Args...> fmt, Args&&... args) {
+  if (ok) { return; }
+  ++failures;
+  std::cout << "FAIL: " << std::format(fmt, std::forward<Args>(args)...) << std::endl;
+}
+
+// main 的返回值：打印失败数，有失败时返回非 0
+inline int check_result(std::string_view name) {
+  std::cout << name << " failures: " << failures << std::endl;
+  return failures == 0 ? 0 : 1;
+}
+
+#endif // EXAMPLES_CHECK_H
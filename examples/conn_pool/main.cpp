@@ -0,0 +1,115 @@
+﻿#include "cxpnet/cxpnet.h"
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+using namespace cxpnet;
+
+// 连接池：两个 poll 线程上保持 4 条到后端的常驻连接
+// 后端 (本进程内的 echo 服务) 先不启动，连接池按退避重试；后端启动后连接建立，请求按在途最少分配；
+// 后端重启时连接断开并自动重建
+//
+// conn_pool [port]
+
+class EchoBackend {
+public:
+  explicit EchoBackend(uint16_t port)
+      : server_("127.0.0.1", port, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr) {
+    server_.set_thread_num(1);
+    server_.set_conn_user_callback([](ConnPtr conn) {
+      Conn* raw = conn.get();
+      conn->set_conn_user_callbacks(
+          [raw](Buffer* buffer) {
+            raw->send(buffer->peek(), buffer->readable_size());
+            buffer->been_read_all();
+          },
+          nullptr);
+    });
+  }
+  ~EchoBackend() {
+    server_.shutdown();
+    if (thread_.joinable()) { thread_.join(); }
+  }
+
+  bool start() {
+    if (!server_.start(RunningMode::kOnePollPerThread)) { return false; }
+    thread_ = std::thread([this]() { server_.run(); });
+    return true;
+  }
+private:
+  Server      server_;
+  std::thread thread_;
+};
+
+static void print_stats(const char* stage, const ConnPool& pool) {
+  ConnPoolStats stats = pool.stats();
+  std::cout << stage << ": ready=" << stats.ready << " connects=" << stats.connects
+            << " connect_failures=" << stats.connect_failures << " disconnects=" << stats.disconnects << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  uint16_t port = argc > 1 ? static_cast<uint16_t>(std::stoi(argv[1])) : 9097;
+
+  IOEventPoll poll_a;
+  IOEventPoll poll_b;
+  std::thread thread_a([&poll_a]() { poll_a.run(); });
+  std::thread thread_b([&poll_b]() { poll_b.run(); });
+
+  std::atomic<size_t> echoed {0};
+  {
+    ConnPoolOptions options;
+    options.size                     = 4;
+    options.backoff_initial_ms       = 50;
+    options.backoff_max_ms           = 1000;
+    options.health_check_interval_ms = 200;
+
+    ConnPoolCallbacks callbacks;
+    callbacks.on_message = [&echoed](Conn*, Buffer* buffer) {
+      echoed += buffer->readable_size();
+      buffer->been_read_all();
+    };
+    // 示例只检查连接状态；实际协议中发送 ping，收到应答后再调用 done(true)
+    callbacks.health_check = [](const ConnPtr& conn, std::function<void(bool)> done) { done(conn->connected()); };
+
+    ConnPool pool({&poll_a, &poll_b}, "127.0.0.1", port, options, callbacks);
+    pool.start();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    print_stats("backend down", pool);
+
+    {
+      EchoBackend backend(port);
+      if (!backend.start()) { std::cout << "Failed to start backend on port " << port << std::endl; }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+      print_stats("backend up", pool);
+
+      // 持有 Lease 期间计为在途请求，8 个请求平均落在 4 条连接上
+      std::vector<ConnPool::Lease> leases;
+      for (int i = 0; i < 8; ++i) {
+        ConnPool::Lease lease = pool.acquire();
+        if (!lease) { continue; }
+        lease->send("hello\n", 6);
+        leases.push_back(std::move(lease));
+      }
+      leases.clear();
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      std::cout << "echoed " << echoed.load() << " bytes" << std::endl;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    print_stats("backend restarting", pool);
+
+    EchoBackend backend(port);
+    if (backend.start()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+      print_stats("backend back", pool);
+    }
+  }
+
+  poll_a.shutdown();
+  poll_b.shutdown();
+  thread_a.join();
+  thread_b.join();
+  return 0;
+}
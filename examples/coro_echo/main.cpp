@@ -0,0 +1,70 @@
+﻿#include "cxpnet/cxpnet.h"
+
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace cxpnet;
+
+// 用协程写的行回显：服务端每个连接一个协程，客户端按顺序发送、等待回显、间隔休眠
+// 读写在连接的回调中直接恢复协程，不需要拆成回调里的状态机
+//
+// coro_echo [port] [lines]
+
+static Task<void> echo_session(ConnPtr conn) {
+  AsyncConn stream(conn);
+  while (true) {
+    std::string_view line = co_await stream.read_until("\n");
+    if (line.empty()) { break; } // 对端关闭或行太长
+    if (!co_await stream.write(line)) { break; }
+  }
+}
+
+static Task<void> run_client(IOEventPoll* poll, uint16_t port, int lines, bool& done) {
+  auto [err, conn] = co_await AsyncConn::connect(poll, "127.0.0.1", port, SockOptions {.tcp_nodelay = true});
+  if (err != 0) {
+    std::cerr << "connect failed: " << err << std::endl;
+    done = true;
+    co_return;
+  }
+
+  AsyncConn stream(conn);
+  for (int i = 0; i < lines; ++i) {
+    std::string line = "line " + std::to_string(i) + "\n";
+    co_await stream.write(line);
+    std::string_view echo = co_await stream.read_until("\n");
+    std::cout << "echo: " << echo;
+    co_await poll->sleep(100);
+  }
+
+  // 优雅关闭：半关闭后等对端关闭
+  stream.shutdown();
+  while (!(co_await stream.read_some()).empty()) { }
+  std::cout << "closed" << std::endl;
+  done = true;
+}
+
+int main(int argc, char* argv[]) {
+  uint16_t port  = argc > 1 ? static_cast<uint16_t>(std::stoi(argv[1])) : 9200;
+  int      lines = argc > 2 ? std::stoi(argv[2]) : 5;
+
+  Server server("127.0.0.1", port, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr);
+  server.set_thread_num(1);
+  server.set_sock_options(SockOptions {.tcp_nodelay = true});
+  // 连接回调在连接所在的 poll 线程上执行，co_spawn 立即开始运行会话协程
+  server.set_conn_user_callback([](ConnPtr conn) { co_spawn(conn->event_poll(), echo_session(conn)); });
+  if (!server.start(RunningMode::kOnePollPerThread)) {
+    std::cerr << "Failed to listen on port " << port << std::endl;
+    return 1;
+  }
+  std::thread server_thread([&server]() { server.run(); });
+
+  IOEventPoll poll;
+  bool        done = false;
+  co_spawn(&poll, run_client(&poll, port, lines, done));
+  while (!done) { poll.poll(10); }
+
+  server.shutdown();
+  server_thread.join();
+  return 0;
+}
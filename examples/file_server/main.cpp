@@ -10,8 +10,10 @@ using namespace cxpnet;
 
 class FileServer {
 public:
+  // 读文件在 offload 线程上进行，不阻塞 poll 线程上的其他连接
   FileServer(const std::string& addr, uint16_t port, int thread_num = 4)
-      : server_(addr.c_str(), port, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr) {
+      : server_(addr.c_str(), port, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr)
+      , offload_(OffloadOptions {.threads = 4, .name = "file-io"}) {
     server_.set_thread_num(thread_num);
     server_.set_conn_user_callback([this](const ConnPtr& conn) {
       std::cout << "New file transfer connection from "
@@ -47,19 +49,13 @@ private:
       filename             = filename.substr(0, filename.find_first_of("\r\n "));
       std::cout << "Received GET request for file: " << filename << std::endl;
 
-      std::ifstream file(filename, std::ios::binary);
-      if (!file.is_open()) {
-        conn->send("ERROR: file not found\n");
-        conn->shutdown();
-        return;
-      }
-
-      std::ostringstream content;
-      content << file.rdbuf();
-
-      std::string response = "OK\n" + content.str();
-      conn->send(response);
-      conn->shutdown();
+      offload_.post(
+          conn->event_poll(),
+          [filename]() { return readFile(filename); },
+          [conn](std::string response) {
+            conn->send(response);
+            conn->shutdown();
+          });
       return;
     }
 
@@ -68,11 +64,21 @@ private:
     conn->shutdown();
   }
 
+  static std::string readFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) { return "ERROR: file not found\n"; }
+
+    std::ostringstream content;
+    content << "OK\n" << file.rdbuf();
+    return content.str();
+  }
+
   void onClose(int err) {
     std::cout << "File transfer connection closed with error: " << err << std::endl;
   }
 
-  Server server_;
+  Server          server_;
+  OffloadExecutor offload_;
 };
 
 int main() {
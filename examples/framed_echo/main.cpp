@@ -0,0 +1,78 @@
+﻿#include "cxpnet/codec.h"
+#include "cxpnet/cxpnet.h"
+
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace cxpnet;
+
+// 长度前缀分帧的 echo：服务端逐帧回显，客户端一次性发出一批大小不同的帧并逐帧校验
+// TCP 不保证一次读回调对应一帧，多帧粘在一起或一帧被拆开都由 LengthCodec 处理
+//
+// framed_echo [port] [frame_count] [fixed16|fixed32|varint]
+
+static LengthField parse_length_field(const std::string& name) {
+  if (name == "fixed16") { return LengthField::kFixed16; }
+  if (name == "varint") { return LengthField::kVarint; }
+  return LengthField::kFixed32;
+}
+
+static std::string make_frame(int i) {
+  // 大小在 0 ~ 4000 字节之间变化，内容可校验
+  return std::string(static_cast<size_t>((i * 37) % 4001), static_cast<char>('a' + i % 26));
+}
+
+int main(int argc, char* argv[]) {
+  uint16_t port        = argc > 1 ? static_cast<uint16_t>(std::stoi(argv[1])) : 9096;
+  int      frame_count = argc > 2 ? std::stoi(argv[2]) : 1000;
+
+  FrameOptions options;
+  options.length_field   = parse_length_field(argc > 3 ? argv[3] : "fixed32");
+  options.max_frame_size = 64 * 1024;
+  LengthCodec codec(options);
+
+  Server server("127.0.0.1", port, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr);
+  server.set_thread_num(1);
+  server.set_conn_user_callback([&codec](ConnPtr conn) {
+    Conn* raw = conn.get();
+    conn->set_conn_user_callbacks(
+        codec.message_handler(raw, [&codec](Conn* c, std::string_view frame) { codec.send(c, frame); }),
+        nullptr);
+  });
+  if (!server.start(RunningMode::kOnePollPerThread)) {
+    std::cerr << "Failed to start server on port " << port << std::endl;
+    return 1;
+  }
+  std::thread server_thread([&server]() { server.run(); });
+
+  int  received = 0;
+  int  mismatch = 0;
+  auto poll     = std::make_unique<IOEventPoll>();
+  auto conn     = std::make_shared<Conn>(poll.get());
+  conn->set_conn_user_callbacks(
+      codec.message_handler(conn.get(), [&](Conn* c, std::string_view frame) {
+        if (frame != make_frame(received)) { ++mismatch; }
+        if (++received == frame_count) { c->shutdown(); }
+      }),
+      [&poll](int) { poll->shutdown(); });
+
+  if (!conn->connect_sync("127.0.0.1", port)) {
+    std::cerr << "Failed to connect" << std::endl;
+    server.shutdown();
+    server_thread.join();
+    return 1;
+  }
+
+  // 一次性发出所有帧，服务端会在一次读回调中收到多帧
+  for (int i = 0; i < frame_count; ++i) { codec.send(conn, make_frame(i)); }
+  poll->run();
+
+  std::cout << "Frames sent: " << frame_count << ", echoed: " << received << ", mismatched: " << mismatch
+            << std::endl;
+
+  conn.reset();
+  server.shutdown();
+  server_thread.join();
+  return received == frame_count && mismatch == 0 ? 0 : 1;
+}
@@ -1,93 +1,60 @@
 ﻿#include "cxpnet/cxpnet.h"
 
-#include <chrono>
+#include <atomic>
+#include <cstring>
+#include <future>
 #include <iostream>
 #include <thread>
 
 using namespace cxpnet;
 
-class HttpClient {
-public:
-  HttpClient(const std::string& addr, uint16_t port)
-      : addr_(addr)
-      , port_(port) {
-  }
-
-  void connect() {
-    conn_ = std::make_shared<Conn>(&event_poll_);
-
-    conn_->connect(addr_.c_str(), port_,
-        [this](ConnPtr conn) {
-          std::cout << "Connected to HTTP server" << std::endl;
-
-          // Set up message and close callbacks
-          conn->set_conn_user_callbacks(
-              [this](Buffer* buffer) {
-                this->onMessage(buffer);
-              },
-              [this](int err) {
-                this->onClose(err);
-              });
-
-          // Send HTTP GET request
-          std::string request =
-              "GET / HTTP/1.1\r\n"
-              "Host: " +
-              addr_ + "\r\n"
-                      "Connection: close\r\n"
-                      "\r\n";
-
-          conn->send(request);
-        },
-        [this](int err) {
-          std::cout << "Connection error: " << err << std::endl;
-          event_poll_.shutdown();
-        });
-  }
-
-  void disconnect() {
-    if (conn_) {
-      conn_->shutdown();
+// Pooled HTTP/1.1 client built on cxpnet::HttpClient
+// Run examples/http_server first, then:
+//   http_client [requests] [pipeline]
+int main(int argc, char* argv[]) {
+  int    total    = argc > 1 ? std::atoi(argv[1]) : 16;
+  size_t pipeline = argc > 2 ? static_cast<size_t>(std::atoi(argv[2])) : 1;
+
+  IOEventPoll event_poll;
+  std::thread poll_thread([&event_poll]() { event_poll.run(); });
+
+  HttpClientOptions options;
+  options.max_conns_per_host = 2;
+  options.max_pipeline       = pipeline;
+  HttpClient client(&event_poll, options);
+
+  std::atomic<int>   remaining {total + 1};
+  std::promise<void> done;
+  auto               on_response = [&](int err, const HttpClientResponse* response) {
+    if (err != 0) {
+      std::cout << "Request failed: " << std::strerror(err) << std::endl;
+    } else {
+      std::cout << response->status << " " << response->reason << ", " << response->body.size() << " bytes"
+                << std::endl;
     }
-  }
-
-  void run() {
-    event_poll_.run();
-  }
-
-private:
-  void onMessage(Buffer* buffer) {
-    std::string response(buffer->peek(), buffer->readable_size());
-    std::cout << "HTTP Response:" << std::endl;
-    std::cout << response << std::endl;
-    buffer->been_read_all();
-
-    // Close connection after receiving response
-    conn_->shutdown();
-  }
-
-  void onClose(int err) {
-    std::cout << "Connection closed with error: " << err << std::endl;
-    conn_.reset();
-    event_poll_.shutdown();
-  }
-
-  std::string addr_;
-  uint16_t   port_;
-  IOEventPoll event_poll_;
-  ConnPtr    conn_;
-};
-
-int main() {
-  HttpClient client("127.0.0.1", 8080);
-  std::thread t([&client]() {
-    client.run();
+    if (remaining.fetch_sub(1) == 1) { done.set_value(); }
+  };
+
+  // Requests are queued per host:port and share at most two keep-alive connections
+  for (int i = 0; i < total; ++i) { client.get("127.0.0.1", 8080, i % 4 == 3 ? "/missing" : "/", on_response); }
+
+  HttpClientRequest echo;
+  echo.method = "POST";
+  echo.target = "/echo";
+  echo.body   = "hello cxpnet";
+  client.request("127.0.0.1", 8080, echo, [&](int err, const HttpClientResponse* response) {
+    if (err == 0) { std::cout << "Echo: " << response->body << std::endl; }
+    on_response(err, response);
   });
 
-  std::this_thread::sleep_for(std::chrono::milliseconds(50));
-  client.connect();
+  done.get_future().wait();
 
-  t.join();
+  event_poll.shutdown();
+  poll_thread.join();
 
+  // Stats are owned by the poll thread, read them once it has stopped
+  const HttpClientStats& stats = client.stats();
+  std::cout << "connects=" << stats.connects << " requests=" << stats.requests << " completed=" << stats.completed
+            << " failed=" << stats.failed << " retried=" << stats.retried << std::endl;
   return 0;
 }
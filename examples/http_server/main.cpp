@@ -1,81 +1,42 @@
 ﻿#include "cxpnet/cxpnet.h"
-#include <atomic>
-#include <chrono>
 #include <iostream>
-#include <mutex>
-#include <queue>
-#include <thread>
 
 using namespace cxpnet;
 
-class HttpServer {
-public:
-  HttpServer(const std::string& addr, uint16_t port, int thread_num = 4)
-      : server_(addr.c_str(), port, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr) {
-    server_.set_thread_num(thread_num);
-    server_.set_conn_user_callback([this](const ConnPtr& conn) {
-      std::cout << "New HTTP connection from "
-                << conn->remote_addr_and_port().first << ":"
-                << conn->remote_addr_and_port().second << std::endl;
-
-      conn->set_conn_user_callbacks(
-          [this, conn](Buffer* buffer) {
-            this->onMessage(conn, buffer);
-          },
-          [this](int err) {
-            this->onClose(err);
-          });
-    });
+// Keep-alive HTTP/1.1 server built on cxpnet::HttpServer
+//   curl -v http://127.0.0.1:8080/
+//   curl -v http://127.0.0.1:8080/echo -H "Transfer-Encoding: chunked" --data-binary @somefile
+static void handle_request(const HttpRequest& request, HttpResponse& response) {
+  if (request.path == "/") {
+    response.add_header("Content-Type", "text/html");
+    response.set_body("<html><body><h1>Hello from cxpnet HTTP Server!</h1></body></html>");
+    return;
   }
 
-  void start() {
-    if (!server_.start(RunningMode::kOnePollPerThread)) {
-      std::cout << "Failed to start HTTP server" << std::endl;
-      return;
-    }
-    std::cout << "HTTP server started, listening on port 8080" << std::endl;
-    server_.run();
+  // Echo the (de-chunked) request body back
+  if (request.path == "/echo") {
+    response.add_header("Content-Type", "application/octet-stream");
+    response.set_body(request.body);
+    return;
   }
-private:
-  void onMessage(const ConnPtr& conn, Buffer* buffer) {
-    std::string request(buffer->peek(), buffer->readable_size());
-    buffer->been_read_all();
-
-    // Simple HTTP request parsing
-    if (request.find("GET /") != std::string::npos) {
-      std::string response =
-          "HTTP/1.1 200 OK\r\n"
-          "Content-Type: text/html\r\n"
-          "Connection: close\r\n"
-          "\r\n"
-          "<html><body><h1>Hello from cxpnet HTTP Server!</h1></body></html>";
 
-      conn->send(response);
-      conn->shutdown(); // Close connection after response
-    } else {
-      std::string response =
-          "HTTP/1.1 404 Not Found\r\n"
-          "Content-Type: text/html\r\n"
-          "Connection: close\r\n"
-          "\r\n"
-          "<html><body><h1>404 Not Found</h1></body></html>";
+  response.set_status(404);
+  response.add_header("Content-Type", "text/html");
+  response.set_body("<html><body><h1>404 Not Found</h1></body></html>");
+}
 
-      conn->send(response);
+int main() {
+  Server server("127.0.0.1", 8080, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr);
+  server.set_thread_num(4);
 
-      std::cout << "Conn Handle: " << conn->native_handle() << std::endl;
-      conn->shutdown(); // Close connection after response
-    }
-  }
+  HttpServer http(handle_request);
+  http.attach(server);
 
-  void onClose(int err) {
-    std::cout << "HTTP connection closed with error: " << err << std::endl;
+  if (!server.start(RunningMode::kOnePollPerThread)) {
+    std::cout << "Failed to start HTTP server" << std::endl;
+    return 1;
   }
-
-  Server server_;
-};
-
-int main() {
-  HttpServer server("127.0.0.1", 8080, 4);
-  server.start();
+  std::cout << "HTTP server started, listening on port 8080" << std::endl;
+  server.run();
   return 0;
 }
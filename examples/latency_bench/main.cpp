@@ -0,0 +1,159 @@
+﻿#include "cxpnet/cxpnet.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cxpnet;
+
+// 请求/响应延迟对比：每条消息拆成 header + body 两次 send (write-write-read)
+// 未开启 TCP_NODELAY 时，第二段会被 Nagle 扣留直到对端延迟 ACK，RTT 会出现几十毫秒的尖刺
+static constexpr size_t kHeaderSize  = 16;
+static constexpr size_t kBodySize    = 48;
+static constexpr size_t kMessageSize = kHeaderSize + kBodySize;
+
+struct LatencyResult {
+  double avg_us = 0;
+  double p50_us = 0;
+  double p99_us = 0;
+  double max_us = 0;
+};
+
+class PingPongClient {
+public:
+  PingPongClient(IOEventPoll* poll, int rounds)
+      : event_poll_(poll)
+      , rounds_(rounds)
+      , message_(kMessageSize, 'x') {
+    samples_.reserve(rounds);
+  }
+
+  void start(const char* addr, uint16_t port, const SockOptions& sock_options) {
+    conn_ = std::make_shared<Conn>(event_poll_);
+    conn_->set_sock_options(sock_options);
+    conn_->connect(addr, port,
+        [this](ConnPtr conn) {
+          conn->set_conn_user_callbacks(
+              [this](Buffer* buffer) { on_message_(buffer); },
+              [this](int) { event_poll_->shutdown(); });
+          send_request_();
+        },
+        [this](int err) {
+          std::cerr << "connect failed, err: " << err << std::endl;
+          event_poll_->shutdown();
+        });
+  }
+
+  const std::vector<double>& samples() const { return samples_; }
+private:
+  void send_request_() {
+    sent_at_ = std::chrono::steady_clock::now();
+    conn_->send(message_.data(), kHeaderSize);
+    conn_->send(message_.data() + kHeaderSize, kBodySize);
+  }
+
+  void on_message_(Buffer* buffer) {
+    while (buffer->readable_size() >= kMessageSize) {
+      buffer->been_read(kMessageSize);
+
+      auto elapsed = std::chrono::steady_clock::now() - sent_at_;
+      samples_.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+
+      if (static_cast<int>(samples_.size()) >= rounds_) {
+        conn_->close();
+        return;
+      }
+      send_request_();
+    }
+  }
+
+  IOEventPoll*                          event_poll_;
+  int                                   rounds_;
+  std::string                           message_;
+  ConnPtr                               conn_;
+  std::vector<double>                   samples_;
+  std::chrono::steady_clock::time_point sent_at_;
+};
+
+static LatencyResult summarize(std::vector<double> samples) {
+  LatencyResult result;
+  if (samples.empty()) { return result; }
+
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (double v : samples) { sum += v; }
+
+  result.avg_us = sum / samples.size();
+  result.p50_us = samples[samples.size() * 50 / 100];
+  result.p99_us = samples[(std::min)(samples.size() - 1, samples.size() * 99 / 100)];
+  result.max_us = samples.back();
+  return result;
+}
+
+static LatencyResult run_case(uint16_t port, int rounds, const SockOptions& sock_options) {
+  Server server("127.0.0.1", port, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr);
+  server.set_thread_num(1);
+  server.set_sock_options(sock_options);
+  server.set_conn_user_callback([](ConnPtr conn) {
+    conn->set_conn_user_callbacks(
+        [conn](Buffer* buffer) {
+          // 同样以两次 send 回复，服务端也受 Nagle 影响
+          while (buffer->readable_size() >= kMessageSize) {
+            conn->send(buffer->peek(), kHeaderSize);
+            conn->send(buffer->peek() + kHeaderSize, kBodySize);
+            buffer->been_read(kMessageSize);
+          }
+        },
+        [](int) {});
+  });
+
+  if (!server.start(RunningMode::kOnePollPerThread)) {
+    std::cerr << "Failed to start server on port " << port << std::endl;
+    return {};
+  }
+
+  std::thread server_thread([&server]() { server.run(); });
+
+  IOEventPoll    poll;
+  PingPongClient client(&poll, rounds);
+  client.start("127.0.0.1", port, sock_options);
+  poll.run();
+
+  server.shutdown();
+  server_thread.join();
+  return summarize(client.samples());
+}
+
+static void print_result(std::string_view name, const LatencyResult& r) {
+  std::cout << std::format("{:<14} avg {:>10.1f}us  p50 {:>10.1f}us  p99 {:>10.1f}us  max {:>10.1f}us",
+                           name, r.avg_us, r.p50_us, r.p99_us, r.max_us)
+            << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  int      rounds = argc > 1 ? std::atoi(argv[1]) : 200;
+  uint16_t port   = argc > 2 ? static_cast<uint16_t>(std::atoi(argv[2])) : 9096;
+
+  std::cout << "ping-pong " << rounds << " rounds, " << kMessageSize
+            << "B messages sent as " << kHeaderSize << "B + " << kBodySize << "B" << std::endl;
+
+  SockOptions nagle;
+  print_result("nagle", run_case(port, rounds, nagle));
+
+  SockOptions nodelay;
+  nodelay.tcp_nodelay = true;
+  print_result("tcp_nodelay", run_case(port, rounds, nodelay));
+
+  SockOptions quickack;
+  quickack.tcp_nodelay = true;
+  quickack.quickack    = true;
+  print_result("nodelay+qack", run_case(port, rounds, quickack));
+
+  return 0;
+}
@@ -0,0 +1,197 @@
+﻿#include "cxpnet/cxpnet.h"
+
+#include <charconv>
+#include <csignal>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+using namespace cxpnet;
+
+// 内存 KV 服务，兼容 redis-cli / redis-benchmark 的常用命令：
+// PING ECHO SET GET DEL EXISTS INCR MSET MGET DBSIZE FLUSHALL，CONFIG / COMMAND 返回空数组
+// 数据按 key 的哈希分片，每个分片一把锁，各 poll 线程之间很少竞争
+//
+// resp_kv_server [port] [threads]
+// redis-benchmark -p 6380 -t set,get -P 16 -q
+
+class KvStore {
+  static constexpr size_t kShards = 64;
+
+  // 透明哈希，用 string_view 查找不构造临时 string
+  struct Hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>()(s); }
+  };
+  using Map = std::unordered_map<std::string, std::string, Hash, std::equal_to<>>;
+
+  struct Shard {
+    std::mutex mutex;
+    Map        map;
+  };
+public:
+  void set(std::string_view key, std::string_view value) {
+    Shard&                      shard = shard_(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto                        it = shard.map.find(key);
+    if (it != shard.map.end()) {
+      it->second.assign(value.data(), value.size());
+    } else {
+      shard.map.emplace(key, value);
+    }
+  }
+
+  // 找到时在锁内把值写成 bulk 回复
+  void get(std::string_view key, RespWriter& writer) {
+    Shard&                      shard = shard_(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto                        it = shard.map.find(key);
+    if (it == shard.map.end()) {
+      writer.null_bulk();
+    } else {
+      writer.bulk(it->second);
+    }
+  }
+
+  bool erase(std::string_view key) {
+    Shard&                      shard = shard_(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto                        it = shard.map.find(key);
+    if (it == shard.map.end()) { return false; }
+    shard.map.erase(it);
+    return true;
+  }
+
+  bool exists(std::string_view key) {
+    Shard&                      shard = shard_(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.map.find(key) != shard.map.end();
+  }
+
+  // 值不是整数时返回 false
+  bool incr(std::string_view key, int64_t& result) {
+    Shard&                      shard = shard_(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto                        it    = shard.map.find(key);
+    int64_t                     value = 0;
+    if (it != shard.map.end()) {
+      const std::string& s = it->second;
+      auto [ptr, ec]       = std::from_chars(s.data(), s.data() + s.size(), value);
+      if (ec != std::errc() || ptr != s.data() + s.size() || value == INT64_MAX) { return false; }
+    } else {
+      it = shard.map.emplace(key, std::string()).first;
+    }
+    result     = value + 1;
+    it->second = std::to_string(result);
+    return true;
+  }
+
+  size_t size() {
+    size_t total = 0;
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      total += shard.map.size();
+    }
+    return total;
+  }
+
+  void clear() {
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.map.clear();
+    }
+  }
+private:
+  Shard& shard_(std::string_view key) { return shards_[Hash()(key) % kShards]; }
+
+  Shard shards_[kShards];
+};
+
+static void wrong_arity(RespWriter& writer, std::string_view name) {
+  writer.error("ERR wrong number of arguments for '" + std::string(name) + "' command");
+}
+
+static void handle(KvStore& store, const RespCommand& cmd, RespWriter& writer) {
+  const auto& args = cmd.args;
+  size_t      argc = args.size();
+
+  if (cmd.is("GET")) {
+    if (argc != 2) { return wrong_arity(writer, args[0]); }
+    store.get(args[1], writer);
+  } else if (cmd.is("SET")) {
+    // 不支持 EX / NX 等选项
+    if (argc != 3) { return wrong_arity(writer, args[0]); }
+    store.set(args[1], args[2]);
+    writer.ok();
+  } else if (cmd.is("PING")) {
+    if (argc > 2) { return wrong_arity(writer, args[0]); }
+    if (argc == 2) {
+      writer.bulk(args[1]);
+    } else {
+      writer.simple_string("PONG");
+    }
+  } else if (cmd.is("ECHO")) {
+    if (argc != 2) { return wrong_arity(writer, args[0]); }
+    writer.bulk(args[1]);
+  } else if (cmd.is("DEL") || cmd.is("EXISTS")) {
+    if (argc < 2) { return wrong_arity(writer, args[0]); }
+    bool    del   = cmd.is("DEL");
+    int64_t count = 0;
+    for (size_t i = 1; i < argc; ++i) { count += (del ? store.erase(args[i]) : store.exists(args[i])) ? 1 : 0; }
+    writer.integer(count);
+  } else if (cmd.is("INCR")) {
+    if (argc != 2) { return wrong_arity(writer, args[0]); }
+    int64_t value = 0;
+    if (store.incr(args[1], value)) {
+      writer.integer(value);
+    } else {
+      writer.error("ERR value is not an integer or out of range");
+    }
+  } else if (cmd.is("MSET")) {
+    if (argc < 3 || argc % 2 == 0) { return wrong_arity(writer, args[0]); }
+    for (size_t i = 1; i < argc; i += 2) { store.set(args[i], args[i + 1]); }
+    writer.ok();
+  } else if (cmd.is("MGET")) {
+    if (argc < 2) { return wrong_arity(writer, args[0]); }
+    writer.array(argc - 1);
+    for (size_t i = 1; i < argc; ++i) { store.get(args[i], writer); }
+  } else if (cmd.is("DBSIZE")) {
+    writer.integer(static_cast<int64_t>(store.size()));
+  } else if (cmd.is("FLUSHALL") || cmd.is("FLUSHDB")) {
+    store.clear();
+    writer.ok();
+  } else if (cmd.is("CONFIG") || cmd.is("COMMAND")) {
+    // redis-benchmark 启动时会发 CONFIG GET，空数组表示没有配置项
+    writer.array(0);
+  } else {
+    writer.error("ERR unknown command '" + std::string(args[0]) + "'");
+  }
+}
+
+int main(int argc, char* argv[]) {
+  uint16_t port    = argc > 1 ? static_cast<uint16_t>(std::stoi(argv[1])) : 6380;
+  int      threads = argc > 2 ? std::stoi(argv[2]) : 4;
+
+  std::signal(SIGPIPE, SIG_IGN);
+
+  KvStore    store;
+  RespServer resp([&store](const RespCommand& cmd, RespWriter& writer) { handle(store, cmd, writer); });
+
+  Server server("0.0.0.0", port, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr);
+  server.set_thread_num(threads);
+  SockOptions options;
+  options.tcp_nodelay = true;
+  server.set_sock_options(options);
+  resp.attach(server);
+
+  if (!server.start(RunningMode::kOnePollPerThread)) {
+    std::cerr << "Failed to listen on port " << port << std::endl;
+    return 1;
+  }
+
+  std::cout << "RESP KV server listening on port " << port << " with " << threads << " threads" << std::endl;
+  server.run();
+  return 0;
+}
@@ -0,0 +1,100 @@
+﻿#include "cxpnet/cxpnet.h"
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cxpnet;
+
+// 一个连接上的并发 RPC：
+// - echo 在 poll 线程上立即回复
+// - sleep 把 responder 交给后台线程，延迟后回复，响应与其他调用乱序返回
+// - 超时的调用以 ETIMEDOUT 完成，之后到达的响应被丢弃
+//
+// rpc [port] [calls]
+
+int main(int argc, char* argv[]) {
+  uint16_t port  = argc > 1 ? static_cast<uint16_t>(std::stoi(argv[1])) : 9100;
+  int      calls = argc > 2 ? std::stoi(argv[2]) : 10000;
+
+  // 后台回复的线程在关闭服务之前 join，不在 poll 停止之后再写连接
+  std::mutex               workers_mutex;
+  std::vector<std::thread> workers;
+
+  RpcServer rpc;
+  rpc.add_method("echo", [](std::string_view request, const RpcResponder& responder) { responder.reply(request); });
+  rpc.add_method("sleep", [&](std::string_view request, const RpcResponder& responder) {
+    int                         ms = std::stoi(std::string(request));
+    std::lock_guard<std::mutex> lock(workers_mutex);
+    workers.emplace_back([responder, ms]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+      responder.reply("slept " + std::to_string(ms) + "ms");
+    });
+  });
+
+  Server server("127.0.0.1", port, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr);
+  server.set_thread_num(1);
+  SockOptions options;
+  options.tcp_nodelay = true;
+  server.set_sock_options(options);
+  rpc.attach(server);
+  if (!server.start(RunningMode::kOnePollPerThread)) {
+    std::cerr << "Failed to listen on port " << port << std::endl;
+    return 1;
+  }
+  std::thread server_thread([&server]() { server.run(); });
+
+  IOEventPoll poll;
+  auto        conn = std::make_shared<Conn>(&poll);
+  conn->set_sock_options(options);
+  if (!conn->connect_sync("127.0.0.1", port)) {
+    std::cerr << "Failed to connect" << std::endl;
+    server.shutdown();
+    server_thread.join();
+    return 1;
+  }
+
+  RpcClient client(conn);
+  int       remaining = calls + 3;
+  int       failed    = 0;
+  auto      start     = std::chrono::steady_clock::now();
+
+  client.call("sleep", "200", [&](int err, std::string_view response) {
+    std::cout << "sleep 200: err=" << err << " " << response << std::endl;
+    --remaining;
+  });
+  client.call(
+      "sleep", "500",
+      [&](int err, std::string_view) {
+        std::cout << "sleep 500 with 100ms timeout: " << (err == ETIMEDOUT ? "timed out" : "unexpected") << std::endl;
+        --remaining;
+      },
+      100);
+  client.call("missing", "", [&](int err, std::string_view response) {
+    std::cout << "missing: " << (err == kRpcRemoteError ? "remote error: " : "unexpected: ") << response << std::endl;
+    --remaining;
+  });
+
+  for (int i = 0; i < calls; ++i) {
+    std::string payload = "hello " + std::to_string(i);
+    client.call("echo", payload, [&, payload](int err, std::string_view response) {
+      if (err != 0 || response != payload) { ++failed; }
+      --remaining;
+    });
+  }
+
+  while (remaining > 0) { poll.poll(1); }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << calls << " echo calls on one connection, " << failed << " failed, " << elapsed << "s total"
+            << std::endl;
+
+  client.close();
+  poll.poll();
+  for (auto& worker : workers) { worker.join(); }
+  server.shutdown();
+  server_thread.join();
+  return failed == 0 ? 0 : 1;
+}
@@ -1,9 +1,12 @@
-﻿#include "cxpnet/buffer.h"
+﻿#include "common/check.h"
+#include "cxpnet/buffer.h"
 #include "cxpnet/ensure.h"
+#include "cxpnet/scan.h"
 
 #include <format>
 #include <iostream>
 #include <string>
+#include <vector>
 
 template <typename... Args>
 void out(std::string fmt, Args&&... args) {
@@ -11,6 +14,122 @@ void out(std::string fmt, Args&&... args) {
   std::cout << msg << std::endl;
 }
 
+// 确定性的伪随机字节，只取少数几个字符，让分隔符的首尾字节经常单独出现
+static std::string make_data(size_t size, uint32_t seed) {
+  static const char kAlphabet[] = "ab\r\nE";
+  std::string       data(size, ' ');
+  for (auto& c : data) {
+    seed = seed * 1103515245u + 12345u;
+    c    = kAlphabet[(seed >> 16) % (sizeof(kAlphabet) - 1)];
+  }
+  return data;
+}
+
+static std::vector<std::string_view> available_kernels() {
+  std::vector<std::string_view> kernels;
+  for (std::string_view name : {"scalar", "sse2", "avx2"}) {
+    if (cxpnet::scan::set_kernel(name)) { kernels.push_back(name); }
+  }
+  return kernels;
+}
+
+// 各实现与 std::string_view::find 的结果一致，覆盖 16 / 32 字节边界两侧和末尾的匹配
+static void test_scan_kernels() {
+  const std::string_view delims[] = {"\n", "\r\n", "END", "\r\n\r\n", "0123456789abcdefXY"};
+
+  for (std::string_view kernel : available_kernels()) {
+    cxpnet::scan::set_kernel(kernel);
+    for (size_t size = 0; size <= 300; ++size) {
+      std::string data = make_data(size, static_cast<uint32_t>(size));
+      for (std::string_view delim : delims) {
+        std::string_view view(data);
+        const char*      hit    = cxpnet::scan::find(data.data(), data.size(), delim);
+        size_t           actual = hit != nullptr ? static_cast<size_t>(hit - data.data()) : std::string_view::npos;
+        check(actual == view.find(delim), "[{}] find size={} delim_len={}", kernel, size, delim.size());
+      }
+      for (char c : {'\n', 'E', 'z'}) {
+        const char* hit    = cxpnet::scan::find_byte(data.data(), data.size(), c);
+        size_t      actual = hit != nullptr ? static_cast<size_t>(hit - data.data()) : std::string_view::npos;
+        check(actual == std::string_view(data).find(c), "[{}] find_byte size={} c={}", kernel, size, static_cast<int>(c));
+      }
+    }
+
+    // 唯一一次出现的分隔符放在每个偏移上，包括跨越 16 / 32 字节边界和紧贴末尾
+    for (std::string_view delim : delims) {
+      for (size_t size : {size_t {31}, size_t {32}, size_t {33}, size_t {64}, size_t {97}}) {
+        for (size_t pos = 0; pos + delim.size() <= size; ++pos) {
+          std::string data(size, '.');
+          data.replace(pos, delim.size(), delim);
+          const char* hit = cxpnet::scan::find(data.data(), data.size(), delim);
+          check(hit == data.data() + pos, "[{}] planted delim_len={} size={} pos={}", kernel, delim.size(), size, pos);
+        }
+      }
+    }
+
+    // 只差最后一个字节的前缀出现在末尾时不算匹配
+    std::string tail(40, '.');
+    tail += "\r\n\r";
+    check(cxpnet::scan::find(tail.data(), tail.size(), "\r\n\r\n") == nullptr, "[{}] partial match at end", kernel);
+  }
+}
+
+// Buffer::find 的续扫：部分匹配后追加、been_read 之后、换分隔符
+static void test_buffer_find() {
+  constexpr size_t npos = cxpnet::Buffer::npos;
+
+  for (std::string_view kernel : available_kernels()) {
+    cxpnet::scan::set_kernel(kernel);
+
+    {
+      cxpnet::Buffer buffer;
+      buffer.append("GET / HTTP/1.1\r\nHost: a\r\n\r");
+      check(buffer.find("\r\n\r\n") == npos, "[{}] header end not complete yet", kernel);
+      buffer.append("\n");
+      check(buffer.find("\r\n\r\n") == 23, "[{}] header end spanning appends", kernel);
+    }
+
+    {
+      cxpnet::Buffer buffer;
+      buffer.append(std::string(40, 'x') + "\r");
+      check(buffer.find_crlf() == npos, "[{}] lone CR", kernel);
+      buffer.append("\n");
+      check(buffer.find_crlf() == 40, "[{}] CRLF split across appends", kernel);
+    }
+
+    {
+      cxpnet::Buffer buffer;
+      buffer.append("line1\nline2");
+      check(buffer.find_eol() == 5, "[{}] first line", kernel);
+      buffer.been_read(6);
+      check(buffer.find_eol() == npos, "[{}] no second EOL yet", kernel);
+      buffer.been_read(2);
+      check(buffer.find_eol() == npos, "[{}] no EOL after partial been_read", kernel);
+      buffer.append("\n");
+      check(buffer.find_eol() == 3, "[{}] EOL after been_read", kernel);
+    }
+
+    {
+      cxpnet::Buffer buffer;
+      buffer.append(std::string(50, 'y') + "\n");
+      check(buffer.find_crlf() == npos, "[{}] no CRLF", kernel);
+      check(buffer.find_eol() == 50, "[{}] EOL after switching delimiter", kernel);
+      check(buffer.find("yy\n") == 48, "[{}] three-byte delimiter after switching", kernel);
+      buffer.append("\r\n");
+      check(buffer.find_crlf() == 51, "[{}] CRLF after switching back", kernel);
+    }
+
+    {
+      // 超过续扫记录长度的分隔符每次从头扫描
+      std::string    delim = "--boundary-0123456789--";
+      cxpnet::Buffer buffer;
+      buffer.append("abc" + delim.substr(0, 10));
+      check(buffer.find(delim) == npos, "[{}] long delimiter incomplete", kernel);
+      buffer.append(delim.substr(10));
+      check(buffer.find(delim) == 3, "[{}] long delimiter", kernel);
+    }
+  }
+}
+
 int main() {
   out("hello world");
 
@@ -41,4 +160,9 @@ int main() {
   buffer.append("12345678901234567");
   out("last, readable_size: {}, writable_size: {}, content: {}",
       buffer.readable_size(), buffer.writable_size(), std::string(buffer.peek(), buffer.readable_size()));
-}
\ No newline at end of file
+
+  test_scan_kernels();
+  test_buffer_find();
+  out("scan kernels: {}", available_kernels().size());
+  return check_result("test_buffer");
+}
@@ -0,0 +1,96 @@
+﻿#include "common/check.h"
+#include "cxpnet/cxpnet.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+using namespace cxpnet;
+
+// ConnPool 析构的行为测试：所在 poll 停止或从未运行时析构不能挂住，失败时返回非 0
+//
+// test_conn_pool [port]
+
+static constexpr auto kDeadline = std::chrono::seconds(5);
+
+// 析构挂住时无法再回收线程，直接报告失败退出
+static void expect_finishes(std::function<void()> func, const char* what) {
+  auto done = std::async(std::launch::async, std::move(func));
+  if (done.wait_for(kDeadline) == std::future_status::ready) { return; }
+
+  check(false, "{} did not finish within {}s", what, kDeadline.count());
+  std::exit(check_result("test_conn_pool"));
+}
+
+static void wait_ready(const ConnPool& pool) {
+  auto deadline = std::chrono::steady_clock::now() + kDeadline;
+  while (pool.stats().ready == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+// 连接池挂在前端 Server 的 poll 上，前端 shutdown 与连接池析构并发
+// poll 可能在析构投递清理任务前后的任意时刻停止
+static void test_destroy_during_server_shutdown(uint16_t backend_port, uint16_t front_port) {
+  for (int round = 0; round < 20; ++round) {
+    Server front("127.0.0.1", front_port, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr);
+    front.set_thread_num(2);
+    if (!front.start(RunningMode::kOnePollPerThread)) {
+      check(false, "round {}: front server failed to start", round);
+      return;
+    }
+    std::thread front_thread([&front]() { front.run(); });
+
+    auto pool = std::make_unique<ConnPool>(front.io_polls(), "127.0.0.1", backend_port, ConnPoolOptions {.size = 4});
+    pool->start();
+    wait_ready(*pool);
+    check(pool->stats().ready > 0, "round {}: pool never became ready", round);
+
+    std::thread stopper([&front, round]() {
+      std::this_thread::sleep_for(std::chrono::microseconds(round * 50));
+      front.shutdown();
+    });
+    expect_finishes([&pool]() { pool.reset(); }, "~ConnPool during Server::shutdown");
+
+    stopper.join();
+    front_thread.join();
+  }
+}
+
+// 投递到从未运行的 poll 的清理任务不会执行，由析构线程自己清理
+static void test_destroy_on_idle_poll(uint16_t backend_port) {
+  // 在其他线程上创建，析构线程不是它的 poll 线程
+  std::unique_ptr<IOEventPoll> idle;
+  std::thread([&idle]() { idle = std::make_unique<IOEventPoll>(); }).join();
+
+  auto pool = std::make_unique<ConnPool>(std::vector<IOEventPoll*> {idle.get()}, "127.0.0.1", backend_port,
+                                         ConnPoolOptions {.size = 2});
+  pool->start();
+  expect_finishes([&pool]() { pool.reset(); }, "~ConnPool on a poll that never ran");
+}
+
+int main(int argc, char* argv[]) {
+  uint16_t port = argc > 1 ? static_cast<uint16_t>(std::stoi(argv[1])) : 9099;
+
+  Server backend("127.0.0.1", port, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr);
+  backend.set_thread_num(1);
+  // 停止的 poll 上的连接池连接不会再关闭，后端不等待它们断开
+  backend.set_shutdown_timeout(100);
+  if (!backend.start(RunningMode::kOnePollPerThread)) {
+    std::cout << "Failed to start backend on port " << port << std::endl;
+    return 1;
+  }
+  std::thread backend_thread([&backend]() { backend.run(); });
+
+  test_destroy_during_server_shutdown(port, static_cast<uint16_t>(port + 1));
+  test_destroy_on_idle_poll(port);
+
+  backend.shutdown();
+  backend_thread.join();
+
+  return check_result("test_conn_pool");
+}
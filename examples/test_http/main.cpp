@@ -0,0 +1,248 @@
+﻿#include "common/check.h"
+#include "cxpnet/http.h"
+
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace cxpnet;
+
+// HttpRequestParser / HttpResponseParser 的行为测试，失败时返回非 0
+// 数据按不同方式切分后逐段追加到读缓冲，模拟多次读回调
+
+struct Parsed {
+  std::string method;
+  std::string target;
+  std::string body;
+  bool        keep_alive = false;
+};
+
+// 把 pieces 依次追加到同一个读缓冲，每次追加后解析出所有完整请求
+// 返回 false 表示遇到错误，status 为错误状态码
+static bool feed(const std::vector<std::string>& pieces, std::vector<Parsed>& out, int& status,
+                 HttpLimits limits = {}) {
+  Buffer            buffer;
+  HttpRequestParser parser(limits);
+  HttpRequest       request;
+  for (const auto& piece : pieces) {
+    if (!piece.empty()) { buffer.append(piece); }
+    while (true) {
+      HttpParseResult result = parser.parse(&buffer, request);
+      if (result == HttpParseResult::kIncomplete) { break; }
+      if (result == HttpParseResult::kError) {
+        status = parser.error_status();
+        return false;
+      }
+      out.push_back({std::string(request.method), std::string(request.target), std::string(request.body),
+                     request.keep_alive});
+      parser.consume(&buffer);
+    }
+  }
+  status = 0;
+  return true;
+}
+
+static int parse_error(const std::string& data, HttpLimits limits = {}) {
+  std::vector<Parsed> parsed;
+  int                 status = 0;
+  feed({data}, parsed, status, limits);
+  return status;
+}
+
+static void test_pipelined() {
+  const std::string data = "GET /a HTTP/1.1\r\nHost: x\r\n\r\n"
+                           "POST /b?q=1 HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello"
+                           "GET /c HTTP/1.1\r\nConnection: close\r\n\r\n";
+
+  // 一次读到全部，以及在每个字节处切成两次读
+  for (size_t split = 0; split <= data.size(); ++split) {
+    std::vector<Parsed> parsed;
+    int                 status = 0;
+    bool                ok     = feed({data.substr(0, split), data.substr(split)}, parsed, status);
+    check(ok && parsed.size() == 3, "pipelined split={} ok={} count={}", split, ok, parsed.size());
+    if (parsed.size() != 3) { continue; }
+    check(parsed[0].method == "GET" && parsed[0].target == "/a" && parsed[0].body.empty(), "pipelined #1 split={}",
+          split);
+    check(parsed[1].method == "POST" && parsed[1].target == "/b?q=1" && parsed[1].body == "hello",
+          "pipelined #2 split={}", split);
+    check(parsed[2].target == "/c" && !parsed[2].keep_alive, "pipelined #3 split={}", split);
+  }
+
+  // 逐字节到达
+  std::vector<std::string> bytes;
+  for (char c : data) { bytes.emplace_back(1, c); }
+  std::vector<Parsed> parsed;
+  int                 status = 0;
+  check(feed(bytes, parsed, status) && parsed.size() == 3, "pipelined byte by byte");
+}
+
+static void test_chunked() {
+  const std::string data = "POST /upload HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n"
+                           "5;name=value\r\nhello\r\n"
+                           "1\r\n \r\n"
+                           "A ; ext\r\n0123456789\r\n"
+                           "0\r\nX-Checksum: abc\r\nX-More: 1\r\n\r\n"
+                           "GET /next HTTP/1.1\r\n\r\n";
+
+  for (size_t split = 0; split <= data.size(); ++split) {
+    std::vector<Parsed> parsed;
+    int                 status = 0;
+    bool                ok     = feed({data.substr(0, split), data.substr(split)}, parsed, status);
+    check(ok && parsed.size() == 2, "chunked split={} ok={} status={} count={}", split, ok, status, parsed.size());
+    if (parsed.size() != 2) { continue; }
+    check(parsed[0].body == "hello 0123456789", "chunked body split={}: '{}'", split, parsed[0].body);
+    check(parsed[1].target == "/next", "request after chunked split={}", split);
+  }
+
+  std::vector<std::string> bytes;
+  for (char c : data) { bytes.emplace_back(1, c); }
+  std::vector<Parsed> parsed;
+  int                 status = 0;
+  bool                ok     = feed(bytes, parsed, status);
+  check(ok && parsed.size() == 2 && parsed[0].body == "hello 0123456789", "chunked byte by byte");
+
+  check(parse_error("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nZZ\r\n") == 400, "bad chunk size");
+  check(parse_error("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabcX\r\n") == 400,
+        "chunk data not followed by CRLF");
+}
+
+static void test_smuggling() {
+  check(parse_error("POST / HTTP/1.1\r\nContent-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n") == 400,
+        "CL + TE rejected");
+  check(parse_error("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 3\r\n\r\n") == 400,
+        "TE + CL rejected");
+  check(parse_error("POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 4\r\n\r\nabcd") == 400,
+        "conflicting Content-Length rejected");
+  check(parse_error("POST / HTTP/1.1\r\nContent-Length: +3\r\n\r\nabc") == 400, "signed Content-Length rejected");
+  check(parse_error("POST / HTTP/1.1\r\nTransfer-Encoding: chunked, gzip\r\n\r\n") == 501,
+        "TE not ending in chunked");
+  check(parse_error("POST / HTTP/1.1\r\nTransfer-Encoding: identity\r\n\r\n") == 501, "TE identity");
+  check(parse_error("GET / HTTP/1.1\r\n Folded: x\r\n\r\n") == 400, "obsolete line folding");
+  check(parse_error("GET / HTTP/2.0\r\n\r\n") == 505, "unsupported version");
+
+  // 一致的重复 Content-Length 可以接受
+  std::vector<Parsed> parsed;
+  int                 status = 0;
+  bool ok = feed({"POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 3\r\n\r\nabc"}, parsed, status);
+  check(ok && parsed.size() == 1 && parsed[0].body == "abc", "matching duplicate Content-Length");
+}
+
+static void test_limits() {
+  HttpLimits limits {.max_header_size = 128, .max_body_size = 16};
+
+  std::string long_header = "GET / HTTP/1.1\r\nX-Long: " + std::string(200, 'a') + "\r\n\r\n";
+  check(parse_error(long_header, limits) == 431, "complete header over limit");
+  // 头部还没收齐就已超过上限
+  check(parse_error("GET / HTTP/1.1\r\nX-Long: " + std::string(200, 'a'), limits) == 431, "partial header over limit");
+
+  std::string many = "GET / HTTP/1.1\r\n";
+  for (size_t i = 0; i <= HttpMessage::kMaxHeaders; ++i) { many += std::format("X-{}: 1\r\n", i); }
+  check(parse_error(many + "\r\n") == 431, "too many headers");
+
+  check(parse_error("POST / HTTP/1.1\r\nContent-Length: 17\r\n\r\n", limits) == 413, "Content-Length over limit");
+  check(parse_error("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n8\r\n12345678\r\n9\r\n", limits) == 413,
+        "chunked body over limit");
+
+  std::vector<Parsed> parsed;
+  int                 status = 0;
+  bool ok = feed({"POST / HTTP/1.1\r\nContent-Length: 16\r\n\r\n0123456789abcdef"}, parsed, status, limits);
+  check(ok && parsed.size() == 1, "body exactly at limit");
+}
+
+static void test_keep_alive() {
+  const std::string data = "GET /1 HTTP/1.0\r\n\r\n"
+                           "GET /2 HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n"
+                           "GET /3 HTTP/1.1\r\n\r\n"
+                           "GET /4 HTTP/1.1\r\nConnection: upgrade, close\r\n\r\n";
+
+  std::vector<Parsed> parsed;
+  int                 status = 0;
+  bool                ok     = feed({data}, parsed, status);
+  check(ok && parsed.size() == 4, "keep-alive requests parsed");
+  if (parsed.size() != 4) { return; }
+  check(!parsed[0].keep_alive, "HTTP/1.0 defaults to close");
+  check(parsed[1].keep_alive, "HTTP/1.0 with Connection: keep-alive");
+  check(parsed[2].keep_alive, "HTTP/1.1 defaults to keep-alive");
+  check(!parsed[3].keep_alive, "HTTP/1.1 with Connection: close");
+}
+
+// 等待 body 期间读缓冲扩容搬移，完成时头部的 string_view 需要指向新的存储
+static void test_head_stale() {
+  const size_t body_size = 256 * 1024;
+
+  Buffer            buffer(64);
+  HttpRequestParser parser;
+  HttpRequest       request;
+  buffer.append(std::format("PUT /big HTTP/1.1\r\nHost: example\r\nContent-Length: {}\r\n\r\nx", body_size));
+  check(parser.parse(&buffer, request) == HttpParseResult::kIncomplete, "big body incomplete");
+
+  const char* old_data = buffer.peek();
+  buffer.append(std::string(body_size - 1, 'x'));
+  check(buffer.peek() != old_data, "buffer moved while waiting for body");
+  check(parser.parse(&buffer, request) == HttpParseResult::kComplete, "big body complete");
+
+  auto inside = [&buffer](std::string_view s) {
+    return s.data() >= buffer.peek() && s.data() + s.size() <= buffer.peek() + buffer.readable_size();
+  };
+  check(inside(request.method) && inside(request.target) && inside(request.header("Host")),
+        "head views point into the current buffer");
+  check(request.target == "/big" && request.header("Host") == "example" && request.body.size() == body_size,
+        "head re-parsed after move");
+
+  // 同样的情况，chunked body
+  Buffer chunked(64);
+  parser.consume(&buffer);
+  chunked.append("PUT /c HTTP/1.1\r\nHost: h\r\nTransfer-Encoding: chunked\r\n\r\n");
+  chunked.append(std::format("{:x}\r\n", body_size));
+  check(parser.parse(&chunked, request) == HttpParseResult::kIncomplete, "chunked big body incomplete");
+  chunked.append(std::string(body_size, 'y') + "\r\n0\r\n\r\n");
+  check(parser.parse(&chunked, request) == HttpParseResult::kComplete && request.header("Host") == "h" &&
+            request.body.size() == body_size,
+        "chunked head re-parsed after move");
+}
+
+static void test_response() {
+  Buffer             buffer;
+  HttpResponseParser parser;
+  HttpClientResponse response;
+
+  buffer.append("HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nhi"
+                "HTTP/1.1 204 No Content\r\n\r\n");
+  check(parser.parse(&buffer, response) == HttpParseResult::kComplete && response.body == "hi", "response body");
+  parser.consume(&buffer);
+  check(parser.parse(&buffer, response) == HttpParseResult::kComplete && response.status == 204 &&
+            response.body.empty(),
+        "204 without body");
+  parser.consume(&buffer);
+
+  // HEAD 的响应带 Content-Length 但没有 body
+  parser.set_head_request(true);
+  buffer.append("HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\n");
+  check(parser.parse(&buffer, response) == HttpParseResult::kComplete && response.body.empty(), "HEAD response");
+  parser.consume(&buffer);
+  parser.set_head_request(false);
+
+  // 没有长度的响应以连接关闭为界
+  buffer.append("HTTP/1.0 200 OK\r\n\r\nuntil close");
+  check(parser.parse(&buffer, response) == HttpParseResult::kIncomplete, "until-close body incomplete");
+  check(parser.finish(&buffer, response) == HttpParseResult::kComplete && response.body == "until close",
+        "until-close body finished");
+  parser.consume(&buffer);
+
+  buffer.append("HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nshort");
+  check(parser.finish(&buffer, response) == HttpParseResult::kError && parser.error_status() == 400,
+        "truncated response");
+}
+
+int main() {
+  test_pipelined();
+  test_chunked();
+  test_smuggling();
+  test_limits();
+  test_keep_alive();
+  test_head_stale();
+  test_response();
+
+  return check_result("test_http");
+}
@@ -0,0 +1,216 @@
+﻿#include "common/check.h"
+#include "cxpnet/resp.h"
+
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace cxpnet;
+
+// RespCommandParser / RespReplyParser 的行为测试，失败时返回非 0
+
+// 暴露 need_，验证数据不足时记录的字节数
+class ProbeCommandParser : public RespCommandParser {
+public:
+  using RespCommandParser::RespCommandParser;
+  size_t need() const { return need_; }
+};
+
+class ProbeReplyParser : public RespReplyParser {
+public:
+  using RespReplyParser::RespReplyParser;
+  size_t need() const { return need_; }
+};
+
+static std::vector<std::string> args_of(const RespCommand& command) {
+  return std::vector<std::string>(command.args.begin(), command.args.end());
+}
+
+// 解析 data 中所有命令，遇到错误时返回 false
+static bool parse_commands(const std::string& data, std::vector<std::vector<std::string>>& out,
+                           RespLimits limits = {}) {
+  Buffer            buffer;
+  RespCommandParser parser(limits);
+  RespCommand       command;
+  buffer.append(data);
+  while (true) {
+    RespParseResult result = parser.parse(&buffer, command);
+    if (result == RespParseResult::kIncomplete) { return true; }
+    if (result == RespParseResult::kError) { return false; }
+    out.push_back(args_of(command));
+    parser.consume(&buffer);
+  }
+}
+
+static std::string command_error(const std::string& data, RespLimits limits = {}) {
+  Buffer            buffer;
+  RespCommandParser parser(limits);
+  RespCommand       command;
+  buffer.append(data);
+  if (parser.parse(&buffer, command) != RespParseResult::kError) { return ""; }
+  return parser.error();
+}
+
+// 大 bulk 分多次到达：第一次解析出需要的总字节数，之后数据不足时直接返回，不再从头解析
+static void test_need_short_circuit() {
+  const size_t      bulk_size = 100000;
+  const std::string head      = std::format("*2\r\n$3\r\nSET\r\n${}\r\n", bulk_size);
+  const std::string data      = head + std::string(bulk_size, 'v') + "\r\n";
+
+  Buffer             buffer;
+  ProbeCommandParser parser;
+  RespCommand        command;
+  buffer.append(data.substr(0, head.size() + 10));
+  check(parser.parse(&buffer, command) == RespParseResult::kIncomplete, "large bulk first piece");
+  check(parser.need() == data.size(), "need_ is the whole command: {} vs {}", parser.need(), data.size());
+
+  // 已解析过的前缀被改坏也不会被发现，说明没有重新解析
+  buffer.to_read()[0] = '!';
+  buffer.append(data.substr(head.size() + 10, 1000));
+  check(parser.parse(&buffer, command) == RespParseResult::kIncomplete, "short-circuited while below need_");
+  buffer.to_read()[0] = '*';
+
+  size_t pos = head.size() + 1010;
+  while (pos < data.size() - 1) {
+    size_t n = (std::min)(size_t {4096}, data.size() - 1 - pos);
+    buffer.append(data.substr(pos, n));
+    pos += n;
+    check(parser.parse(&buffer, command) == RespParseResult::kIncomplete, "incomplete at {}", pos);
+  }
+  buffer.append(data.substr(pos));
+  check(parser.parse(&buffer, command) == RespParseResult::kComplete && command.args.size() == 2 &&
+            command.is("set") && command.args[1].size() == bulk_size,
+        "large bulk complete");
+  parser.consume(&buffer);
+  check(buffer.empty() && parser.need() == 0, "consumed large bulk");
+
+  // 每个字节处切分的命令都能解析
+  const std::string small = "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$5\r\nhello\r\n";
+  for (size_t split = 1; split < small.size(); ++split) {
+    Buffer            b;
+    RespCommandParser p;
+    b.append(small.substr(0, split));
+    bool first_incomplete = p.parse(&b, command) == RespParseResult::kIncomplete;
+    b.append(small.substr(split));
+    check(first_incomplete && p.parse(&b, command) == RespParseResult::kComplete && command.args[2] == "hello",
+          "command split={}", split);
+  }
+}
+
+static void test_inline() {
+  std::vector<std::vector<std::string>> commands;
+  bool ok = parse_commands("PING\r\nSET  key\tvalue\r\n\r\n  get key  \n*1\r\n$4\r\nPING\r\n", commands);
+  check(ok && commands.size() == 5, "inline commands parsed: {}", commands.size());
+  if (commands.size() == 5) {
+    check(commands[0] == std::vector<std::string> {"PING"}, "inline PING");
+    check(commands[1] == std::vector<std::string> {"SET", "key", "value"}, "inline SET with tab");
+    check(commands[2].empty(), "empty inline line");
+    check(commands[3] == std::vector<std::string> {"get", "key"}, "inline with LF only");
+    check(commands[4] == std::vector<std::string> {"PING"}, "multibulk after inline");
+  }
+
+  ProbeCommandParser parser;
+  Buffer             buffer;
+  RespCommand        command;
+  buffer.append("GET k");
+  check(parser.parse(&buffer, command) == RespParseResult::kIncomplete && parser.need() == 6, "inline incomplete");
+
+  RespLimits limits;
+  limits.max_inline_size = 16;
+  check(command_error(std::string(20, 'a'), limits) == "too big inline request", "inline over limit");
+}
+
+static void test_empty_multibulk() {
+  std::vector<std::vector<std::string>> commands;
+  bool ok = parse_commands("*0\r\n*-1\r\n*1\r\n$4\r\nPING\r\n", commands);
+  check(ok && commands.size() == 3, "empty multibulk parsed");
+  if (commands.size() == 3) {
+    check(commands[0].empty() && commands[1].empty(), "*0 and *-1 are empty commands");
+    check(commands[2] == std::vector<std::string> {"PING"}, "command after empty ones");
+  }
+}
+
+static void test_command_errors() {
+  check(command_error("*1\r\n:5\r\n") == "expected '$'", "non-bulk argument");
+  check(command_error("*1\r\n$3\r\nabcX\r\n") == "bulk not terminated by CRLF", "bulk without CRLF");
+  check(command_error("*1\r\n$3\r\nabc\rX") == "bulk not terminated by CRLF", "bulk with CR only");
+  check(command_error("*x\r\n") == "invalid multibulk length", "bad multibulk length");
+  check(command_error("*1\r\n$-1\r\n") == "invalid bulk length", "negative bulk length");
+
+  RespLimits limits;
+  limits.max_args      = 2;
+  limits.max_bulk_size = 4;
+  check(command_error("*3\r\n", limits) == "invalid multibulk length", "too many args");
+  check(command_error("*1\r\n$5\r\n", limits) == "invalid bulk length", "bulk over limit");
+}
+
+static void test_replies() {
+  // [[1, "a"], nil-array, nil-bulk, -ERR x, +OK]
+  const std::string data = "*5\r\n*2\r\n:1\r\n$1\r\na\r\n*-1\r\n$-1\r\n-ERR x\r\n+OK\r\n";
+
+  for (size_t split = 0; split <= data.size(); ++split) {
+    Buffer          buffer;
+    RespReplyParser parser;
+    RespReply       reply;
+    buffer.append(data.substr(0, split == 0 ? data.size() : split));
+    RespParseResult result = parser.parse(&buffer, reply);
+    if (split != 0 && split < data.size()) {
+      check(result == RespParseResult::kIncomplete, "reply split={} incomplete", split);
+      buffer.append(data.substr(split));
+      result = parser.parse(&buffer, reply);
+    }
+    check(result == RespParseResult::kComplete, "reply split={} complete", split);
+    if (result != RespParseResult::kComplete) { continue; }
+
+    const auto& e = reply.elements;
+    check(reply.value.type == RespType::kArray && reply.value.integer == 5 && e.size() == 7, "nested shape split={}",
+          split);
+    if (e.size() != 7) { continue; }
+    check(e[0].type == RespType::kArray && e[0].integer == 2, "inner array");
+    check(e[1].type == RespType::kInteger && e[1].integer == 1, "inner integer");
+    check(e[2].type == RespType::kBulkString && e[2].str == "a", "inner bulk");
+    check(e[3].type == RespType::kNullArray, "null array");
+    check(e[4].type == RespType::kNullBulkString, "null bulk");
+    check(e[5].type == RespType::kError && e[5].str == "ERR x", "error element");
+    check(e[6].type == RespType::kSimpleString && e[6].str == "OK", "simple string element");
+    parser.consume(&buffer);
+    check(buffer.empty(), "reply consumed");
+  }
+
+  // 元素上限按展开后的总数计算，嵌套数组不能绕过
+  RespLimits limits;
+  limits.max_args = 3;
+  auto parse_reply = [&limits](const std::string& text, RespReply& reply) {
+    Buffer          buffer;
+    RespReplyParser parser(limits);
+    buffer.append(text);
+    RespParseResult result = parser.parse(&buffer, reply);
+    return std::pair {result, std::string(parser.error() != nullptr ? parser.error() : "")};
+  };
+  RespReply reply;
+  check(parse_reply("*2\r\n*1\r\n:1\r\n:2\r\n", reply).first == RespParseResult::kComplete && reply.elements.size() == 3,
+        "nested reply at element cap");
+  check(parse_reply("*2\r\n*2\r\n:1\r\n:2\r\n:3\r\n", reply).second == "too many reply elements",
+        "nested reply over element cap");
+  check(parse_reply("*4\r\n", reply).second == "invalid multibulk length", "top-level array over cap");
+  check(parse_reply("$3\r\nabcX\r\n", reply).second == "bulk not terminated by CRLF", "reply bulk without CRLF");
+  check(parse_reply("?\r\n", reply).second == "invalid reply type", "unknown reply type");
+
+  // 大 bulk 回复同样记录需要的字节数
+  ProbeReplyParser parser;
+  Buffer           buffer;
+  buffer.append("$10000\r\nabc");
+  check(parser.parse(&buffer, reply) == RespParseResult::kIncomplete && parser.need() == 8 + 10000 + 2,
+        "reply need_ for large bulk");
+}
+
+int main() {
+  test_need_short_circuit();
+  test_inline();
+  test_empty_multibulk();
+  test_command_errors();
+  test_replies();
+
+  return check_result("test_resp");
+}
@@ -0,0 +1,368 @@
+﻿#include "common/check.h"
+#include "cxpnet/cxpnet.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <format>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace cxpnet;
+
+// WebSocketConn 帧解析的行为测试：阻塞 socket 作为客户端发送原始帧，检查服务端的应答，失败时返回非 0
+//
+// test_websocket [port]
+
+struct Frame {
+  bool        fin    = false;
+  uint8_t     opcode = 0;
+  std::string payload;
+};
+
+class WsClient {
+public:
+  explicit WsClient(uint16_t port) {
+    fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    timeval timeout {2, 0};
+    ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(port);
+    ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (::connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) { return; }
+
+    write_all("GET /ws HTTP/1.1\r\nHost: test\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
+    size_t end = std::string::npos;
+    while ((end = in_.find("\r\n\r\n")) == std::string::npos && fill()) { }
+    if (end == std::string::npos) { return; }
+
+    std::string head = in_.substr(0, end);
+    in_.erase(0, end + 4);
+    open_ = head.starts_with("HTTP/1.1 101") &&
+            head.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != std::string::npos;
+  }
+  ~WsClient() { disconnect(); }
+
+  bool open() const { return open_; }
+
+  // 客户端帧默认带掩码
+  void send_frame(uint8_t opcode, std::string_view payload, bool fin = true, bool masked = true) {
+    std::string frame;
+    frame.push_back(static_cast<char>((fin ? 0x80 : 0x00) | opcode));
+    uint8_t mask_bit = masked ? 0x80 : 0x00;
+    if (payload.size() < 126) {
+      frame.push_back(static_cast<char>(mask_bit | payload.size()));
+    } else if (payload.size() <= 0xFFFF) {
+      frame.push_back(static_cast<char>(mask_bit | 126));
+      frame.push_back(static_cast<char>(payload.size() >> 8));
+      frame.push_back(static_cast<char>(payload.size()));
+    } else {
+      frame.push_back(static_cast<char>(mask_bit | 127));
+      for (int i = 7; i >= 0; --i) { frame.push_back(static_cast<char>(static_cast<uint64_t>(payload.size()) >> (i * 8))); }
+    }
+
+    const unsigned char key[4] = {0x37, 0xfa, 0x21, 0x3d};
+    if (masked) { frame.append(reinterpret_cast<const char*>(key), 4); }
+    for (size_t i = 0; i < payload.size(); ++i) {
+      frame.push_back(masked ? static_cast<char>(payload[i] ^ key[i % 4]) : payload[i]);
+    }
+    write_all(frame);
+  }
+
+  // 只发帧头，用于超过上限的长度
+  void send_header(uint8_t opcode, uint64_t length) {
+    std::string frame;
+    frame.push_back(static_cast<char>(0x80 | opcode));
+    frame.push_back(static_cast<char>(0x80 | 127));
+    for (int i = 7; i >= 0; --i) { frame.push_back(static_cast<char>(length >> (i * 8))); }
+    frame.append("\x01\x02\x03\x04", 4);
+    write_all(frame);
+  }
+
+  void send_close(uint16_t code, std::string_view reason = {}) {
+    std::string payload;
+    payload.push_back(static_cast<char>(code >> 8));
+    payload.push_back(static_cast<char>(code));
+    payload.append(reason);
+    send_frame(0x8, payload);
+  }
+
+  // 服务端帧不带掩码；超时或连接关闭时返回 false
+  bool read_frame(Frame& frame) {
+    while (true) {
+      if (in_.size() >= 2) {
+        const auto* p           = reinterpret_cast<const unsigned char*>(in_.data());
+        uint64_t    length      = p[1] & 0x7F;
+        size_t      header_size = 2;
+        if (length == 126) { header_size = 4; }
+        if (length == 127) { header_size = 10; }
+        if (in_.size() >= header_size) {
+          if (length == 126) { length = (uint64_t(p[2]) << 8) | p[3]; }
+          if (length == 127) {
+            length = 0;
+            for (int i = 0; i < 8; ++i) { length = (length << 8) | p[2 + i]; }
+          }
+          if (in_.size() >= header_size + length) {
+            frame.fin     = (p[0] & 0x80) != 0;
+            frame.opcode  = p[0] & 0x0F;
+            frame.payload = in_.substr(header_size, static_cast<size_t>(length));
+            in_.erase(0, header_size + static_cast<size_t>(length));
+            return true;
+          }
+        }
+      }
+      if (!fill()) { return false; }
+    }
+  }
+
+  // 读到关闭帧，返回其中的状态码；没有关闭帧时返回 0
+  uint16_t read_close() {
+    Frame frame;
+    while (read_frame(frame)) {
+      if (frame.opcode != 0x8) { continue; }
+      if (frame.payload.size() < 2) { return 0; }
+      return static_cast<uint16_t>((uint8_t(frame.payload[0]) << 8) | uint8_t(frame.payload[1]));
+    }
+    return 0;
+  }
+
+  // 服务端发出关闭帧后半关闭，之后读到 EOF，中间没有其他数据
+  bool read_eof() {
+    while (fill()) { }
+    return eof_ && in_.empty();
+  }
+
+  void disconnect() {
+    if (fd_ >= 0) { ::close(fd_); }
+    fd_ = -1;
+  }
+private:
+  void write_all(std::string_view data) {
+    while (!data.empty()) {
+      ssize_t n = ::send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+      if (n <= 0) { return; }
+      data.remove_prefix(static_cast<size_t>(n));
+    }
+  }
+
+  bool fill() {
+    char    chunk[16384];
+    ssize_t n = ::recv(fd_, chunk, sizeof(chunk), 0);
+    if (n == 0) { eof_ = true; }
+    if (n <= 0) { return false; }
+    in_.append(chunk, static_cast<size_t>(n));
+    return true;
+  }
+
+  int         fd_   = -1;
+  bool        open_ = false;
+  bool        eof_  = false;
+  std::string in_;
+};
+
+static std::atomic<int> g_messages {0};
+static std::atomic<int> g_close_code {-1}; // 最近一次 on_close 的状态码，每个用例等待并取走
+
+// 等服务端的 on_close 报告状态码
+static int wait_close_code() {
+  for (int i = 0; i < 200 && g_close_code.load() < 0; ++i) { std::this_thread::sleep_for(std::chrono::milliseconds(10)); }
+  return g_close_code.exchange(-1);
+}
+
+// 服务端以 sent 关闭：收到关闭帧和 EOF；客户端断开后 on_close 报告 reported
+// 服务端因协议错误主动关闭时没有收到对端的关闭帧，按 RFC 6455 7.1.5 报告 1006
+static void expect_close(WsClient& client, uint16_t sent, uint16_t reported, std::string_view what) {
+  uint16_t code = client.read_close();
+  check(code == sent, "{}: server sent close {}, expected {}", what, code, sent);
+  check(client.read_eof(), "{}: shutdown after close", what);
+  client.disconnect();
+  int on_close = wait_close_code();
+  check(on_close == reported, "{}: on_close reported {}, expected {}", what, on_close, reported);
+}
+
+// 客户端直接断开，没有关闭帧
+static void expect_abnormal(WsClient& client, std::string_view what) {
+  client.disconnect();
+  int on_close = wait_close_code();
+  check(on_close == kWsCloseAbnormal, "{}: on_close reported {} after disconnect", what, on_close);
+}
+
+// 各个 scan 实现在不同起始对齐和长度下的原地异或与逐字节计算一致，结束后恢复原来的实现
+static void test_xor_mask() {
+  const unsigned char key[4] = {0x12, 0x34, 0x56, 0x78};
+  std::string         saved  = scan::kernel_name();
+
+  for (std::string_view kernel : {"scalar", "sse2", "avx2"}) {
+    if (!scan::set_kernel(kernel)) { continue; }
+    for (size_t offset = 0; offset < 8; ++offset) {
+      for (size_t size = 0; size <= 300; size += (size < 70 ? 1 : 7)) {
+        std::string data(offset + size + 8, ' ');
+        for (size_t i = 0; i < data.size(); ++i) { data[i] = static_cast<char>((i * 131 + size * 31 + offset) & 0xff); }
+        std::string expected = data;
+        for (size_t i = 0; i < size; ++i) { expected[offset + i] ^= static_cast<char>(key[i % 4]); }
+
+        scan::xor_mask(data.data() + offset, size, key);
+        check(data == expected, "[{}] xor_mask offset={} size={}", kernel, offset, size);
+      }
+    }
+  }
+  scan::set_kernel(saved);
+}
+
+static void test_lengths(uint16_t port) {
+  WsClient client(port);
+  check(client.open(), "handshake");
+
+  // 7 位、16 位、64 位长度，回显的帧使用同样的长度编码
+  for (size_t size : {size_t {0}, size_t {125}, size_t {126}, size_t {300}, size_t {65535}, size_t {65536}, size_t {70000}}) {
+    std::string payload(size, 'a');
+    for (size_t i = 0; i < size; ++i) { payload[i] = static_cast<char>('a' + i % 26); }
+    client.send_frame(0x2, payload);
+
+    Frame frame;
+    bool  ok = client.read_frame(frame);
+    check(ok && frame.fin && frame.opcode == 0x2 && frame.payload == payload, "echo of {} bytes", size);
+  }
+  expect_abnormal(client, "lengths");
+}
+
+static void test_fragmentation(uint16_t port) {
+  WsClient client(port);
+  int      before = g_messages.load();
+
+  // 分片之间插入 ping，pong 先于拼好的消息返回
+  client.send_frame(0x1, "Hel", false);
+  client.send_frame(0x9, "ping!");
+  client.send_frame(0x0, "lo ", false);
+  client.send_frame(0xA, "unsolicited pong");
+  client.send_frame(0x0, "world", true);
+
+  Frame pong;
+  Frame message;
+  check(client.read_frame(pong) && pong.opcode == 0xA && pong.payload == "ping!", "pong for interleaved ping");
+  check(client.read_frame(message) && message.opcode == 0x1 && message.payload == "Hello world",
+        "reassembled fragmented message");
+  check(g_messages.load() == before + 1, "fragmented message delivered once");
+  expect_abnormal(client, "fragmentation");
+
+  // 没有进行中的分片时收到 continuation，以及分片中途开始新消息，都是协议错误
+  WsClient stray(port);
+  stray.send_frame(0x0, "x");
+  expect_close(stray, kWsCloseProtocolError, kWsCloseAbnormal, "continuation without start");
+
+  WsClient restart(port);
+  restart.send_frame(0x1, "a", false);
+  restart.send_frame(0x1, "b");
+  expect_close(restart, kWsCloseProtocolError, kWsCloseAbnormal, "new message inside fragmented one");
+
+  WsClient control(port);
+  control.send_frame(0x9, "p", false);
+  expect_close(control, kWsCloseProtocolError, kWsCloseAbnormal, "fragmented control frame");
+}
+
+static void test_protocol_errors(uint16_t port) {
+  WsClient unmasked(port);
+  unmasked.send_frame(0x1, "hello", true, false);
+  expect_close(unmasked, kWsCloseProtocolError, kWsCloseAbnormal, "unmasked frame");
+
+  WsClient rsv(port);
+  rsv.send_frame(0x1 | 0x40, ""); // RSV1 置位
+  expect_close(rsv, kWsCloseProtocolError, kWsCloseAbnormal, "RSV bit");
+
+  WsClient big_ping(port);
+  big_ping.send_frame(0x9, std::string(126, 'p'));
+  expect_close(big_ping, kWsCloseProtocolError, kWsCloseAbnormal, "control frame over 125 bytes");
+}
+
+static void test_too_big(uint16_t port, size_t limit) {
+  WsClient single(port);
+  single.send_header(0x2, limit + 1);
+  expect_close(single, kWsCloseTooBig, kWsCloseAbnormal, "single frame over limit");
+
+  // 每个分片都不超过上限，拼接后超过
+  WsClient fragmented(port);
+  fragmented.send_frame(0x2, std::string(limit / 2 + 1, 'x'), false);
+  fragmented.send_frame(0x0, std::string(limit / 2 + 1, 'y'), true);
+  expect_close(fragmented, kWsCloseTooBig, kWsCloseAbnormal, "fragments over limit");
+
+  WsClient exact(port);
+  exact.send_frame(0x2, std::string(limit, 'z'));
+  Frame echo;
+  check(exact.read_frame(echo) && echo.payload.size() == limit, "message exactly at limit");
+  expect_abnormal(exact, "message exactly at limit");
+}
+
+static void test_close(uint16_t port) {
+  // 合法的状态码原样回显，on_close 报告对端的状态码
+  for (uint16_t code : {uint16_t {1000}, uint16_t {1001}, uint16_t {1011}, uint16_t {3000}, uint16_t {4999}}) {
+    WsClient client(port);
+    client.send_close(code, "bye");
+    expect_close(client, code, code, std::format("close {}", code));
+  }
+
+  // 保留或非法的状态码以 1002 回应
+  for (uint16_t code : {uint16_t {0}, uint16_t {999}, uint16_t {1004}, uint16_t {1005}, uint16_t {1006}, uint16_t {1015},
+                        uint16_t {2999}, uint16_t {5000}}) {
+    WsClient client(port);
+    client.send_close(code);
+    expect_close(client, kWsCloseProtocolError, kWsCloseProtocolError, std::format("invalid close code {}", code));
+  }
+
+  // 没有状态码时回应 1000，on_close 报告 1005；只有 1 字节的 payload 是协议错误
+  WsClient empty(port);
+  empty.send_frame(0x8, "");
+  expect_close(empty, kWsCloseNormal, kWsCloseNoStatus, "empty close");
+
+  WsClient one_byte(port);
+  one_byte.send_frame(0x8, "x");
+  expect_close(one_byte, kWsCloseProtocolError, kWsCloseProtocolError, "one-byte close payload");
+
+  // 关闭帧之后的数据被忽略
+  WsClient trailing(port);
+  trailing.send_close(kWsCloseNormal);
+  trailing.send_frame(0x1, "after close");
+  expect_close(trailing, kWsCloseNormal, kWsCloseNormal, "data after close frame");
+}
+
+int main(int argc, char* argv[]) {
+  uint16_t     port  = argc > 1 ? static_cast<uint16_t>(std::stoi(argv[1])) : 9098;
+  const size_t limit = 128 * 1024;
+
+  WebSocketHandlers handlers;
+  handlers.on_message = [](const WsConnPtr& ws, std::string_view data, WsOpcode opcode) {
+    ++g_messages;
+    ws->send(opcode, data);
+  };
+  handlers.on_close = [](const WsConnPtr&, uint16_t code) { g_close_code.store(code); };
+
+  Server server("127.0.0.1", port, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr);
+  server.set_thread_num(1);
+  HttpServer      http([](const HttpRequest&, HttpResponse& response) { response.set_status(404); });
+  WebSocketServer websocket(handlers, {.max_message_size = limit});
+  websocket.attach(http, "/ws");
+  http.attach(server);
+  if (!server.start(RunningMode::kOnePollPerThread)) {
+    std::cout << "Failed to start server on port " << port << std::endl;
+    return 1;
+  }
+  std::thread server_thread([&server]() { server.run(); });
+
+  test_xor_mask();
+  test_lengths(port);
+  test_fragmentation(port);
+  test_protocol_errors(port);
+  test_too_big(port, limit);
+  test_close(port);
+
+  server.shutdown();
+  server_thread.join();
+
+  return check_result("test_websocket");
+}
@@ -0,0 +1,87 @@
+﻿#include "cxpnet/cxpnet.h"
+
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace cxpnet;
+
+// WebSocket 聊天室：浏览器打开 http://127.0.0.1:8081/ ，每条消息广播给所有连接
+// 广播帧只编码一次，各连接在自己的 poll 线程上写出同一份数据
+//
+// websocket_chat [port]
+
+static const char* kPage = R"html(<!doctype html>
+<html><body>
+<input id="msg" placeholder="say something"><button onclick="send()">Send</button>
+<pre id="log"></pre>
+<script>
+  const ws = new WebSocket("ws://" + location.host + "/chat");
+  ws.onmessage = e => { document.getElementById("log").textContent += e.data + "\n"; };
+  function send() { const m = document.getElementById("msg"); ws.send(m.value); m.value = ""; }
+</script>
+</body></html>
+)html";
+
+class ChatRoom {
+public:
+  void join(const WsConnPtr& ws) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    members_.push_back(ws);
+  }
+  void leave(const WsConnPtr& ws) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::erase(members_, ws);
+  }
+  void broadcast(std::string_view text) {
+    std::vector<WsConnPtr> members;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      members = members_;
+    }
+    WebSocketServer::broadcast(members, WsOpcode::kText, text);
+  }
+private:
+  std::mutex             mutex_;
+  std::vector<WsConnPtr> members_;
+};
+
+int main(int argc, char* argv[]) {
+  uint16_t port = argc > 1 ? static_cast<uint16_t>(std::stoi(argv[1])) : 8081;
+
+  Server server("127.0.0.1", port, ProtocolStack::kIPv4Only, SocketOption::kReuseAddr);
+  server.set_thread_num(2);
+
+  ChatRoom room;
+
+  WebSocketHandlers handlers;
+  handlers.on_open = [&room](const WsConnPtr& ws) {
+    room.join(ws);
+    ws->send_text("welcome");
+  };
+  handlers.on_message = [&room](const WsConnPtr&, std::string_view data, WsOpcode opcode) {
+    if (opcode == WsOpcode::kText) { room.broadcast(data); }
+  };
+  handlers.on_close = [&room](const WsConnPtr& ws, uint16_t) { room.leave(ws); };
+
+  HttpServer http([](const HttpRequest& request, HttpResponse& response) {
+    if (request.path != "/") {
+      response.set_status(404);
+      return;
+    }
+    response.add_header("Content-Type", "text/html");
+    response.set_body(kPage);
+  });
+  WebSocketServer websocket(handlers, {.max_message_size = 64 * 1024});
+  websocket.attach(http, "/chat");
+  http.attach(server);
+
+  if (!server.start(RunningMode::kOnePollPerThread)) {
+    std::cout << "Failed to start chat server" << std::endl;
+    return 1;
+  }
+  std::cout << "Chat server started, open http://127.0.0.1:" << port << "/" << std::endl;
+  server.run();
+  return 0;
+}